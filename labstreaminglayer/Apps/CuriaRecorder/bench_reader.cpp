@@ -0,0 +1,107 @@
+/**
+ * XDF reader benchmark.
+ * Indexes and decodes an XDF file with xdf_reader and reports the throughput as JSON.
+ * Small recordings (like fisshy.xdf) can be scaled up first: with --scale N, a copy of the file
+ * is written in which every Samples chunk is repeated N times, and that copy is benchmarked.
+ *
+ * Usage: benchXDFReader file.xdf [--threads N] [--scale N] [--iterations N]
+ */
+#include "xdf_reader.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Write a copy of the file in which every Samples chunk is repeated n times.
+static void write_scaled_copy(const std::string &filename, const std::string &scaled, int n) {
+	xdf_reader reader(filename);
+	std::ofstream out(scaled, std::ios::binary | std::ios::trunc);
+	out.write(reader.data(), 4); // [MagicCode]
+	const auto &chunks = reader.chunks();
+	for (std::size_t k = 0; k < chunks.size(); k++) {
+		const uint64_t end = chunks[k].content_offset + chunks[k].content_length;
+		const int repeat = chunks[k].tag == chunk_tag_t::samples ? n : 1;
+		for (int r = 0; r < repeat; r++)
+			out.write(reader.data() + chunks[k].offset, end - chunks[k].offset);
+	}
+	if (!out) throw std::runtime_error("Could not write " + scaled);
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0]
+				  << " file.xdf [--threads N] [--scale N] [--iterations N]" << std::endl;
+		return 2;
+	}
+	std::string filename = argv[1];
+	unsigned threads = 0;
+	int scale = 1, iterations = 3;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		const std::string name(argv[i]), value(argv[i + 1]);
+		if (name == "--threads")
+			threads = static_cast<unsigned>(std::stoul(value));
+		else if (name == "--scale")
+			scale = std::stoi(value);
+		else if (name == "--iterations")
+			iterations = std::stoi(value);
+		else {
+			std::cerr << "Unknown option " << name << std::endl;
+			return 2;
+		}
+	}
+
+	try {
+		std::string scaled;
+		if (scale > 1) {
+			scaled = filename + ".x" + std::to_string(scale) + ".xdf";
+			write_scaled_copy(filename, scaled, scale);
+			filename = scaled;
+		}
+		double best_index = 0, best_total = 0;
+		uint64_t file_size = 0, samples = 0, chunks = 0;
+		std::size_t streams = 0, warnings = 0;
+		for (int it = 0; it < iterations; it++) {
+			const auto start = std::chrono::steady_clock::now();
+			xdf_reader reader(filename);
+			const double index_seconds = seconds_since(start);
+			reader.decode(threads);
+			const double total_seconds = seconds_since(start);
+			if (it == 0 || total_seconds < best_total) {
+				best_total = total_seconds;
+				best_index = index_seconds;
+			}
+			file_size = reader.size();
+			chunks = reader.chunks().size();
+			streams = reader.streams().size();
+			warnings = reader.warnings().size();
+			samples = 0;
+			for (const auto &s : reader.streams()) samples += s.sample_count();
+		}
+		if (!scaled.empty()) std::remove(scaled.c_str());
+
+		std::ostringstream out;
+		out.precision(6);
+		out << "{\n"
+			<< "  \"file\": \"" << filename << "\",\n"
+			<< "  \"file_bytes\": " << file_size << ",\n"
+			<< "  \"streams\": " << streams << ",\n"
+			<< "  \"chunks\": " << chunks << ",\n"
+			<< "  \"samples\": " << samples << ",\n"
+			<< "  \"warnings\": " << warnings << ",\n"
+			<< "  \"threads\": " << threads << ",\n"
+			<< "  \"index_seconds\": " << best_index << ",\n"
+			<< "  \"decode_seconds\": " << best_total - best_index << ",\n"
+			<< "  \"gb_per_second\": " << file_size / best_total / 1e9 << "\n"
+			<< "}";
+		std::cout << out.str() << std::endl;
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,280 @@
+/**
+ * End-to-end recording benchmark.
+ * Starts a number of synthetic outlets on this machine, records them with the regular recording
+ * class for a fixed duration and prints the sustained throughput, CPU usage, peak memory, dropped
+ * samples and writer latency (upper bounds of the metrics histogram buckets) as JSON.
+ * The synthetic outlets run in the same process, so the CPU figures include their share.
+ *
+ * Usage: benchRecording [--streams N] [--channels C] [--srate Hz] [--format float32|double64|
+ *        int32|int16|int8|string] [--chunk samples] [--duration seconds] [--chunk-interval ms]
+ *        [--output file.xdf|file.csv]
+ */
+#include "recording.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#ifdef _WIN32
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+struct bench_options {
+	int streams = 4;
+	int channels = 32;
+	double srate = 1000;
+	std::string format = "float32";
+	int chunk = 10;
+	double duration = 10;
+	int chunk_interval = 500;
+	std::string output = "bench_recording.xdf";
+};
+
+/// Maximum time to wait for the recording to subscribe to all synthetic streams.
+static const auto subscribe_timeout = std::chrono::seconds(30);
+
+/// Consumed CPU time (user + system) of this process, in seconds.
+static double process_cpu_seconds() {
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+	auto seconds = [](const FILETIME &t) {
+		return ((static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) * 1e-7;
+	};
+	return seconds(kernel) + seconds(user);
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec +
+		   usage.ru_stime.tv_usec * 1e-6;
+#endif
+}
+
+/// Peak resident set size of this process, in bytes.
+static uint64_t peak_rss_bytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize;
+#elif defined(__APPLE__)
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss; // bytes on macOS
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss * 1024ull; // kilobytes on Linux
+#endif
+}
+
+template <class T> static T synthetic_value(uint64_t sample, int channel) {
+	return static_cast<T>((sample + channel) % 100);
+}
+template <> std::string synthetic_value(uint64_t sample, int channel) {
+	return "sample " + std::to_string(sample) + " channel " + std::to_string(channel);
+}
+
+/// Push chunks of synthetic data at the nominal rate until told to stop.
+template <class T>
+static void outlet_loop(lsl::stream_outlet &outlet, const bench_options &opts,
+	std::atomic<bool> &stop, std::atomic<uint64_t> &pushed) {
+	std::vector<T> chunk(static_cast<std::size_t>(opts.chunk) * opts.channels);
+	const auto chunk_duration = std::chrono::duration<double>(opts.chunk / opts.srate);
+	auto next = std::chrono::steady_clock::now();
+	uint64_t sample = 0;
+	while (!stop) {
+		for (int s = 0; s < opts.chunk; s++, sample++)
+			for (int c = 0; c < opts.channels; c++)
+				chunk[s * opts.channels + c] = synthetic_value<T>(sample, c);
+		outlet.push_chunk_multiplexed(chunk);
+		pushed += opts.chunk;
+		next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(chunk_duration);
+		std::this_thread::sleep_until(next);
+	}
+}
+
+static lsl::channel_format_t parse_format(const std::string &format) {
+	if (format == "float32") return lsl::cf_float32;
+	if (format == "double64") return lsl::cf_double64;
+	if (format == "int32") return lsl::cf_int32;
+	if (format == "int16") return lsl::cf_int16;
+	if (format == "int8") return lsl::cf_int8;
+	if (format == "string") return lsl::cf_string;
+	throw std::invalid_argument("Unsupported format " + format);
+}
+
+static bench_options parse_options(int argc, char **argv) {
+	bench_options opts;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		const std::string name(argv[i]), value(argv[i + 1]);
+		if (name == "--streams")
+			opts.streams = std::stoi(value);
+		else if (name == "--channels")
+			opts.channels = std::stoi(value);
+		else if (name == "--srate")
+			opts.srate = std::stod(value);
+		else if (name == "--format")
+			opts.format = value;
+		else if (name == "--chunk")
+			opts.chunk = std::stoi(value);
+		else if (name == "--duration")
+			opts.duration = std::stod(value);
+		else if (name == "--chunk-interval")
+			opts.chunk_interval = std::stoi(value);
+		else if (name == "--output")
+			opts.output = value;
+		else
+			throw std::invalid_argument("Unknown option " + name);
+	}
+	if (opts.streams < 1 || opts.channels < 1 || opts.srate <= 0 || opts.chunk < 1)
+		throw std::invalid_argument("streams, channels, srate and chunk must be positive");
+	return opts;
+}
+
+int main(int argc, char **argv) {
+	bench_options opts;
+	lsl::channel_format_t format;
+	try {
+		opts = parse_options(argc, argv);
+		format = parse_format(opts.format);
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+	const std::string source_prefix = "benchRecording_" + std::to_string(lsl::local_clock());
+
+	// Create the synthetic outlets.
+	std::vector<std::unique_ptr<lsl::stream_outlet>> outlets;
+	std::vector<lsl::stream_info> infos;
+	std::atomic<bool> stop{false};
+	std::vector<std::atomic<uint64_t>> pushed(opts.streams);
+	std::list<thread_p> outlet_threads;
+	for (int k = 0; k < opts.streams; k++) {
+		lsl::stream_info info("BenchStream" + std::to_string(k), "Bench", opts.channels,
+			opts.srate, format, source_prefix + "_" + std::to_string(k));
+		outlets.emplace_back(new lsl::stream_outlet(info, opts.chunk));
+		pushed[k] = 0;
+	}
+	// Resolve them the way a recording would see them.
+	for (int k = 0; k < opts.streams; k++) {
+		const std::string source_id = source_prefix + "_" + std::to_string(k);
+		auto results = lsl::resolve_stream("source_id", source_id, 1, 5);
+		if (results.empty()) {
+			std::cerr << "Could not resolve the synthetic stream " << k << std::endl;
+			return 1;
+		}
+		infos.push_back(results[0]);
+	}
+	// Start recording them.
+	const file_type_t file_type =
+		opts.output.size() > 4 && opts.output.substr(opts.output.size() - 4) == ".csv"
+			? file_type_t::csv
+			: file_type_t::xdf;
+	std::unique_ptr<recording> rec(new recording(opts.output, file_type, infos, {}, {}, -1, false,
+		false, std::chrono::milliseconds(opts.chunk_interval)));
+	// Only start sending once every inlet is subscribed, so that no sample is lost before that.
+	const auto subscribe_deadline = std::chrono::steady_clock::now() + subscribe_timeout;
+	while (rec->statistics().size() < static_cast<std::size_t>(opts.streams)) {
+		if (std::chrono::steady_clock::now() >= subscribe_deadline) {
+			const stream_stats_map stats = rec->statistics();
+			std::string missing;
+			for (int k = 0; k < opts.streams; k++) {
+				const std::string name = "BenchStream" + std::to_string(k);
+				const auto subscribed = [&](const stream_stats_map::value_type &s) {
+					return s.second.name == name;
+				};
+				if (std::none_of(stats.begin(), stats.end(), subscribed))
+					missing += (missing.empty() ? "" : ", ") + name;
+			}
+			std::cerr << "The recording did not subscribe to " << missing << " within "
+					  << subscribe_timeout.count() << " seconds" << std::endl;
+			return 1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	const double cpu_start = process_cpu_seconds();
+	const auto wall_start = std::chrono::steady_clock::now();
+	// Send for the given duration.
+	for (int k = 0; k < opts.streams; k++) {
+		auto &outlet = *outlets[k];
+		auto &count = pushed[k];
+		switch (format) {
+		case lsl::cf_float32:
+			outlet_threads.emplace_back(new std::thread(outlet_loop<float>, std::ref(outlet),
+				std::cref(opts), std::ref(stop), std::ref(count)));
+			break;
+		case lsl::cf_double64:
+			outlet_threads.emplace_back(new std::thread(outlet_loop<double>, std::ref(outlet),
+				std::cref(opts), std::ref(stop), std::ref(count)));
+			break;
+		case lsl::cf_int32:
+			outlet_threads.emplace_back(new std::thread(outlet_loop<int32_t>, std::ref(outlet),
+				std::cref(opts), std::ref(stop), std::ref(count)));
+			break;
+		case lsl::cf_int16:
+			outlet_threads.emplace_back(new std::thread(outlet_loop<int16_t>, std::ref(outlet),
+				std::cref(opts), std::ref(stop), std::ref(count)));
+			break;
+		case lsl::cf_int8:
+			outlet_threads.emplace_back(new std::thread(outlet_loop<char>, std::ref(outlet),
+				std::cref(opts), std::ref(stop), std::ref(count)));
+			break;
+		default:
+			outlet_threads.emplace_back(new std::thread(outlet_loop<std::string>, std::ref(outlet),
+				std::cref(opts), std::ref(stop), std::ref(count)));
+		}
+	}
+	std::this_thread::sleep_for(std::chrono::duration<double>(opts.duration));
+
+	// Stop the outlets and let the recording drain what was already sent.
+	stop = true;
+	for (auto &t : outlet_threads) t->join();
+	const double wall_seconds = seconds_since(wall_start);
+	std::this_thread::sleep_for(3 * std::chrono::milliseconds(opts.chunk_interval));
+	const stream_stats_map stats = rec->statistics();
+	const writer_metrics &writer = rec->file_metrics();
+	const double write_p50 = writer.write_latency.quantile(0.5),
+				 write_p90 = writer.write_latency.quantile(0.9),
+				 write_p99 = writer.write_latency.quantile(0.99);
+	const uint64_t bytes_written = writer.bytes_written.get();
+	rec.reset();
+	const double cpu_seconds = process_cpu_seconds() - cpu_start;
+
+	uint64_t total_pushed = 0, total_recorded = 0, gap_dropped = 0;
+	for (const auto &count : pushed) total_pushed += count;
+	for (const auto &entry : stats) {
+		total_recorded += entry.second.sample_count;
+		gap_dropped += entry.second.dropped_samples;
+	}
+
+	// Report.
+	std::ostringstream out;
+	out.precision(6);
+	out << "{\n"
+		<< "  \"streams\": " << opts.streams << ",\n"
+		<< "  \"channels\": " << opts.channels << ",\n"
+		<< "  \"srate\": " << opts.srate << ",\n"
+		<< "  \"format\": \"" << opts.format << "\",\n"
+		<< "  \"chunk\": " << opts.chunk << ",\n"
+		<< "  \"chunk_interval_ms\": " << opts.chunk_interval << ",\n"
+		<< "  \"duration_s\": " << wall_seconds << ",\n"
+		<< "  \"samples_pushed\": " << total_pushed << ",\n"
+		<< "  \"samples_recorded\": " << total_recorded << ",\n"
+		<< "  \"samples_per_second\": " << total_recorded / wall_seconds << ",\n"
+		<< "  \"dropped_samples\": "
+		<< (total_pushed > total_recorded ? total_pushed - total_recorded : 0) << ",\n"
+		<< "  \"timestamp_gap_samples\": " << gap_dropped << ",\n"
+		<< "  \"bytes_written\": " << bytes_written << ",\n"
+		<< "  \"cpu_seconds\": " << cpu_seconds << ",\n"
+		<< "  \"cpu_percent_per_stream\": " << 100 * cpu_seconds / wall_seconds / opts.streams
+		<< ",\n"
+		<< "  \"peak_rss_bytes\": " << peak_rss_bytes() << ",\n"
+		<< "  \"write_latency_s\": {\"p50\": " << write_p50 << ", \"p90\": " << write_p90
+		<< ", \"p99\": " << write_p99 << "}\n"
+		<< "}";
+	std::cout << out.str() << std::endl;
+	return 0;
+}
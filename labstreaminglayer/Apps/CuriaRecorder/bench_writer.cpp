@@ -0,0 +1,177 @@
+/**
+ * Microbenchmarks for LSLStreamWriter and the serialization helpers in conversions.h.
+ * Every sample type is written in chunks of varying size and channel count, in XDF mode to a null
+ * sink and to a file in a tmpfs directory, and in CSV mode to the tmpfs directory (CSV file names
+ * are derived per stream, so there is no null sink for CSV). Reports MB/s of serialized output
+ * and heap allocations per chunk as JSON.
+ *
+ * Usage: benchLSLStreamWriter [--tmpdir directory] [--min-time seconds]
+ */
+#include "LSLStreamWriter.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+// === allocation counting ===
+
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+
+// === benchmark helpers ===
+
+#ifdef _WIN32
+const std::string null_sink = "NUL";
+const std::string default_tmpdir = ".";
+#else
+const std::string null_sink = "/dev/null";
+const std::string default_tmpdir = "/dev/shm";
+#endif
+
+/// A streambuf that discards everything (to time the conversion helpers on their own).
+class null_streambuf : public std::streambuf {
+protected:
+	int overflow(int c) override { return c; }
+	std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+};
+
+template <class T> static T bench_value(std::size_t k) { return static_cast<T>(k % 100); }
+template <> std::string bench_value(std::size_t k) { return "marker " + std::to_string(k); }
+
+template <class T> static const char *type_name();
+template <> const char *type_name<char>() { return "int8"; }
+template <> const char *type_name<int16_t>() { return "int16"; }
+template <> const char *type_name<int32_t>() { return "int32"; }
+template <> const char *type_name<float>() { return "float32"; }
+template <> const char *type_name<double>() { return "double64"; }
+template <> const char *type_name<std::string>() { return "string"; }
+
+static bool first_result = true;
+
+static void report(const std::string &name, const std::string &fields) {
+	std::cout << (first_result ? "[\n" : ",\n") << "{\"bench\":\"" << name << "\"," << fields
+			  << "}";
+	first_result = false;
+}
+
+/// Write the same chunk repeatedly for at least min_time seconds and report the throughput.
+template <class T>
+static void bench_write_data_chunk(const std::string &mode, const std::string &sink,
+	const std::string &filename, file_type_t file_type, uint32_t n_samples, uint32_t n_channels,
+	double min_time) {
+	const streamid_t streamid = 1;
+	std::vector<T> chunk(n_samples * n_channels);
+	for (std::size_t k = 0; k < chunk.size(); k++) chunk[k] = bench_value<T>(k);
+	std::vector<double> timestamps(n_samples, 0.0);
+	timestamps[0] = 1000.0;
+
+	LSLStreamWriter writer(filename, file_type);
+	writer.init_stream_file(streamid, "bench");
+	writer.write_stream_header(streamid,
+		"<?xml version=\"1.0\"?><info><name>bench</name><channel_count>" +
+			std::to_string(n_channels) + "</channel_count><desc/></info>",
+		n_channels);
+
+	const uint64_t bytes_before = writer.metrics().bytes_written.get();
+	const uint64_t allocations_before = allocations.load();
+	const auto start = std::chrono::steady_clock::now();
+	uint64_t chunks = 0;
+	double elapsed = 0;
+	while (elapsed < min_time) {
+		for (int k = 0; k < 16; k++)
+			writer.write_data_chunk(streamid, timestamps, chunk, n_channels);
+		chunks += 16;
+		elapsed = seconds_since(start);
+	}
+	const uint64_t chunk_allocations = allocations.load() - allocations_before;
+	const uint64_t bytes = writer.metrics().bytes_written.get() - bytes_before;
+
+	std::ostringstream fields;
+	fields << "\"mode\":\"" << mode << "\",\"sink\":\"" << sink << "\",\"type\":\""
+		   << type_name<T>() << "\",\"samples\":" << n_samples << ",\"channels\":" << n_channels
+		   << ",\"chunks\":" << chunks << ",\"mb_per_s\":" << bytes / elapsed / 1e6
+		   << ",\"allocations_per_chunk\":" << static_cast<double>(chunk_allocations) / chunks;
+	report("write_data_chunk", fields.str());
+}
+
+template <class T> static void bench_type(const std::string &tmpdir, double min_time) {
+	for (uint32_t n_samples : {1u, 32u, 512u}) {
+		for (uint32_t n_channels : {1u, 8u, 64u}) {
+			bench_write_data_chunk<T>("xdf", "null", null_sink, file_type_t::xdf, n_samples,
+				n_channels, min_time);
+			const std::string xdf_file = tmpdir + "/bench_writer.xdf";
+			bench_write_data_chunk<T>("xdf", "tmpfs", xdf_file, file_type_t::xdf, n_samples,
+				n_channels, min_time);
+			std::remove(xdf_file.c_str());
+			bench_write_data_chunk<T>("csv", "tmpfs", tmpdir + "/bench_writer.csv",
+				file_type_t::csv, n_samples, n_channels, min_time);
+			std::remove((tmpdir + "/bench_writer - bench.data.csv").c_str());
+			std::remove((tmpdir + "/bench_writer - bench.meta.xml").c_str());
+		}
+	}
+}
+
+/// Time a serialization helper (in ns per call) on a discarding stream.
+template <class Fn> static void bench_helper(const std::string &name, Fn fn, double min_time) {
+	null_streambuf buf;
+	std::ostream out(&buf);
+	const uint64_t allocations_before = allocations.load();
+	const auto start = std::chrono::steady_clock::now();
+	uint64_t calls = 0;
+	double elapsed = 0;
+	while (elapsed < min_time) {
+		for (int k = 0; k < 1024; k++) fn(out);
+		calls += 1024;
+		elapsed = seconds_since(start);
+	}
+	std::ostringstream fields;
+	fields << "\"ns_per_call\":" << elapsed * 1e9 / calls << ",\"allocations_per_call\":"
+		   << static_cast<double>(allocations.load() - allocations_before) / calls;
+	report(name, fields.str());
+}
+
+int main(int argc, char **argv) {
+	std::string tmpdir = default_tmpdir;
+	double min_time = 0.2;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		const std::string name(argv[i]), value(argv[i + 1]);
+		if (name == "--tmpdir")
+			tmpdir = value;
+		else if (name == "--min-time")
+			min_time = std::stod(value);
+		else {
+			std::cerr << "Unknown option " << name << std::endl;
+			return 2;
+		}
+	}
+
+	bench_helper("write_varlen_int_1", [](std::ostream &out) { write_varlen_int(out, 100); },
+		min_time);
+	bench_helper("write_varlen_int_4", [](std::ostream &out) { write_varlen_int(out, 70000); },
+		min_time);
+	bench_helper("write_varlen_int_8",
+		[](std::ostream &out) { write_varlen_int(out, 5000000000ull); }, min_time);
+	bench_helper("write_fixlen_int",
+		[](std::ostream &out) { write_fixlen_int(out, static_cast<uint32_t>(12345)); }, min_time);
+	bench_helper("write_ts", [](std::ostream &out) { write_ts(out, 1234.5678); }, min_time);
+
+	bench_type<char>(tmpdir, min_time);
+	bench_type<int16_t>(tmpdir, min_time);
+	bench_type<int32_t>(tmpdir, min_time);
+	bench_type<float>(tmpdir, min_time);
+	bench_type<double>(tmpdir, min_time);
+	bench_type<std::string>(tmpdir, min_time);
+	std::cout << "\n]" << std::endl;
+	return 0;
+}
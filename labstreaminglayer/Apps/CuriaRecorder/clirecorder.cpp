@@ -1,9 +1,14 @@
 #include "LSLStreamWriter.h"
+#include "metrics.h"
 #include "process.h"
 #include "recording.h"
+#include "trace.h"
 #include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
 #include <Windows.h>
 #include <conio.h>
+#include <cctype>
 #include <csignal>
 #include <iostream>
 #include <time.h>
@@ -20,6 +25,9 @@
 #define CHUNK_INTERVAL_DEFAULT 500
 #define CHUNK_INTERVAL_DEFAULT_STR "500"
 
+#define METRICS_PORT_DEFAULT 0
+#define METRICS_PORT_DEFAULT_STR "0"
+
 #define EMPTY_PLACEHOLDER " "
 
 volatile bool NOEXIT = true;
@@ -102,9 +110,27 @@ int execute_find_command(QString query, double timeout, double resolve_timeout,
 	return matches ? 0 : 2;
 }
 
+/**
+ * Write the trace spans recorded so far by the recorder and by liblsl (the latter as
+ * <name>_liblsl.<suffix> next to the former).
+ */
+void write_traces(const QString &trace_filename) {
+	if (trace_dump(trace_filename.toStdString()))
+		std::cout << "Wrote trace to " << trace_filename.toStdString() << "." << std::endl;
+	else
+		std::cout << "Could not write trace (tracing requires a LABRECORDER_TRACING build)."
+				  << std::endl;
+	const QFileInfo info(trace_filename);
+	const QString lsl_filename =
+		info.dir().filePath(info.completeBaseName() + "_liblsl." + info.suffix());
+	if (lsl::dump_trace(lsl_filename.toStdString()))
+		std::cout << "Wrote liblsl trace to " << lsl_filename.toStdString() << "." << std::endl;
+}
+
 int execute_record_command(QString query, QString filename, file_type_t file_type, double timeout,
 	double resolve_timeout, bool collect_offsets, bool recording_timestamps,
-	int post_processing_flag, std::chrono::milliseconds chunk_interval) {
+	int post_processing_flag, std::chrono::milliseconds chunk_interval, bool gap_markers,
+	uint16_t metrics_port, QString trace_filename) {
 	std::vector<lsl::stream_info> streams;
 	bool matches = find_streams(query, timeout, resolve_timeout, streams);
 	display_stream_info(streams, matches, query);
@@ -118,10 +144,27 @@ int execute_record_command(QString query, QString filename, file_type_t file_typ
 	std::cout << "-------------------------------------------------------" << std::endl;
 	std::cout << "--- Starting the recording, press Ctrl+C to quit... ---" << std::endl;
 	std::cout << "-------------------------------------------------------" << std::endl;
-	recording r(filename.toStdString(), file_type, streams, watchfor, sync_options,
-		post_processing_flag, collect_offsets, recording_timestamps, chunk_interval);
-	signal(SIGINT, exitHandler); // Check for Ctrl + C hit to cancel.
-	while (NOEXIT) { std::this_thread::sleep_for(std::chrono::milliseconds(500)); }
+	if (!trace_filename.isEmpty())
+		std::cout << "--- Press T to write the trace spans recorded so far. ---" << std::endl;
+	{
+		recording r(filename.toStdString(), file_type, streams, watchfor, sync_options,
+			post_processing_flag, collect_offsets, recording_timestamps, chunk_interval,
+			gap_markers);
+		// Serve the live metrics (if requested) for as long as the recording runs.
+		std::unique_ptr<metrics_server> metrics;
+		if (metrics_port) {
+			metrics.reset(new metrics_server(metrics_port, [&r]() { return r.metrics_text(); }));
+		}
+		signal(SIGINT, exitHandler); // Check for Ctrl + C hit to cancel.
+		while (NOEXIT) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+			// Write the trace on demand while the recording goes on.
+			if (!trace_filename.isEmpty() && _kbhit() && toupper(_getch()) == 'T')
+				write_traces(trace_filename);
+		}
+	}
+	// Write out the trace (if requested) once all recording threads have finished.
+	if (!trace_filename.isEmpty()) write_traces(trace_filename);
 	return 0;
 }
 
@@ -178,6 +221,17 @@ std::chrono::milliseconds parse_chunk_interval(QString chunk_interval_str, QStri
 	invalid_arg(option_names.join(", "));
 }
 
+uint16_t parse_metrics_port(QString metrics_port_str, QStringList option_names) {
+	try {
+		if (metrics_port_str.isEmpty()) return METRICS_PORT_DEFAULT;
+		int port = std::stoi(metrics_port_str.toStdString());
+		if (port >= 0 && port <= 65535) return static_cast<uint16_t>(port);
+	}
+	catch (std::invalid_argument) {}
+	catch (std::out_of_range) {}
+	invalid_arg(option_names.join(", "));
+}
+
 void process_command(QCommandLineParser &parser, QCoreApplication &app, QStringList &pos_args,
 	int expected_num_pos_args = 0) {
 	// Process args.
@@ -270,6 +324,12 @@ int main(int argc, char **argv) {
 																 << "recording-timestamps",
 		"Add (as an LSL channel) a timestamp indicating when the sample was recorded.");
 
+	// Gap markers option (-g, --gap-markers).
+	QCommandLineOption gap_markers_option(QStringList() << "g"
+														<< "gap-markers",
+		"Write a marker into an extra marker stream whenever a gap is detected in a recorded "
+		"stream.");
+
 	// Post processing flag option (-p, --post-flag).
 	QCommandLineOption post_processing_option(QStringList() << "p"
 															<< "post-process",
@@ -284,6 +344,20 @@ int main(int argc, char **argv) {
 		"= " CHUNK_INTERVAL_DEFAULT_STR ".",
 		"milliseconds", QString(CHUNK_INTERVAL_DEFAULT_STR));
 
+	// Metrics port option (-m, --metrics-port). Default value = 0 (disabled).
+	QCommandLineOption metrics_port_option(QStringList() << "m"
+														 << "metrics-port",
+		"Serve live recording metrics (Prometheus text format) on this local port. Default "
+		"= " METRICS_PORT_DEFAULT_STR " (disabled).",
+		"port", QString(METRICS_PORT_DEFAULT_STR));
+
+	// Trace option (--trace).
+	QCommandLineOption trace_option(QStringList() << "trace",
+		"Write hot-path trace spans (Chrome trace JSON) to this file when the recording ends, or "
+		"whenever T is pressed. The spans of liblsl go to <name>_liblsl.<suffix> alongside. "
+		"Requires a build with LABRECORDER_TRACING (and LSL_TRACING for liblsl).",
+		"filename");
+
 	// Shows potential queries in help text.
 	QString query_examples = "XML query (XPath):\n"
 							 "  Example 1: \"type='EEG'\"\n"
@@ -316,6 +390,15 @@ int main(int argc, char **argv) {
 		// Add chunk interval option.
 		commandParser.addOption(chunk_interval_option);
 
+		// Add gap markers option.
+		commandParser.addOption(gap_markers_option);
+
+		// Add metrics port option.
+		commandParser.addOption(metrics_port_option);
+
+		// Add trace option.
+		commandParser.addOption(trace_option);
+
 		// Add post processing option.
 		commandParser.addOption(post_processing_option);
 
@@ -345,14 +428,18 @@ int main(int argc, char **argv) {
 		QString resolve_timeout_str = commandParser.value(resolve_timeout_option);
 		QString post_processing_str = commandParser.value(post_processing_option);
 		QString chunk_interval_str = commandParser.value(chunk_interval_option);
+		QString metrics_port_str = commandParser.value(metrics_port_option);
+		QString trace_filename = commandParser.value(trace_option);
 
 		double timeout = parse_timeout(timeout_str, timeout_option.names());
 		double resolve_timeout = parse_resolve_timeout(resolve_timeout_str, resolve_timeout_option.names());
 		int post_processing_flag = parse_post_processing(post_processing_str, post_processing_option.names());
 		std::chrono::milliseconds chunk_interval = parse_chunk_interval(chunk_interval_str, chunk_interval_option.names());
+		uint16_t metrics_port = parse_metrics_port(metrics_port_str, metrics_port_option.names());
 
 		bool collect_offsets = commandParser.isSet(collect_offsets_option);
 		bool recording_timestamps = commandParser.isSet(recording_timestamps_option);
+		bool gap_markers = commandParser.isSet(gap_markers_option);
 
 		// Simple validation of filename (must be csv or xdf(z) file).
 		file_type_t filetype;
@@ -367,7 +454,8 @@ int main(int argc, char **argv) {
 			incorrect_usage(commandParser, msg.str());
 		}
 		return execute_record_command(query, filename, filetype, timeout, resolve_timeout,
-			collect_offsets, recording_timestamps, post_processing_flag, chunk_interval);
+			collect_offsets, recording_timestamps, post_processing_flag, chunk_interval, gap_markers,
+			metrics_port, trace_filename);
 	} else if (command == "list") {
 		// Add command description.
 		commandParser.setApplicationDescription("\nList all LSL streams.\n");
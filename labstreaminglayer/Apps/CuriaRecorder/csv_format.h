@@ -0,0 +1,176 @@
+#ifndef CSV_FORMAT_H
+#define CSV_FORMAT_H
+
+/**
+ * The CSV layout of CSV recordings, shared by the recorder (LSLStreamWriter) and the offline
+ * converter (xdftool convert) so that both write the same bytes (but for quotes inside strings,
+ * which only xdftool doubles):
+ * - "<name> - <stream>.data.csv": a header row "lsl_time_stamp,<channel labels>" and one row per
+ *   sample with the time stamp and the values; numbers are formatted like std::to_string() (six
+ *   decimals for floating-point values), strings are quoted;
+ * - "<name> - <stream>.meta.xml": the file header, the stream header and the stream footer.
+ */
+
+#include "rapidxml.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+inline std::string replace_all(std::string str, const std::string &from, const std::string &to) {
+	size_t start_pos = 0;
+	while ((start_pos = str.find(from, start_pos)) != std::string::npos) {
+		str.replace(start_pos, from.length(), to);
+		start_pos += to.length(); // Handles case where 'to' is a substring of 'from'
+	}
+	return str;
+}
+
+/// Replace the characters of a stream name that can cause path name issues.
+inline void clean_stream_name(std::string &stream_name) {
+	const std::string illegal_chars = "\\/:?\"<>|*";
+	for (char &c : stream_name)
+		if (illegal_chars.find(c) != std::string::npos) c = '_';
+}
+
+/**
+ * @brief csv_stream_filename The name of a per-stream file of a CSV recording.
+ * @param filename The file name of the recording (ending in extension).
+ * @param suffix ".data.csv" or ".meta.xml".
+ */
+inline std::string csv_stream_filename(const std::string &filename, std::string stream_name,
+	const std::string &suffix, const std::string &extension = ".csv") {
+	clean_stream_name(stream_name);
+	return replace_all(filename, extension, " - " + stream_name + suffix);
+}
+
+/// The first line of a meta file.
+const char csv_meta_file_header[] = "<?xml version=\"1.0\"?><info><version>1.0</version></info>\n";
+
+/**
+ * @brief csv_header_row The header row of a data file: lsl_time_stamp and the channel labels of
+ * the stream header (channel_1, channel_2, ... if they are missing or incomplete).
+ */
+inline std::string csv_header_row(const std::string &header, int channel_count) {
+	std::string header_row;
+
+	// We need to make a safe copy of the header to let rapidxml parse.
+	std::vector<char> content(header.begin(), header.end());
+	content.push_back('\0'); // Special char that helps rapidxml recognize end of file.
+
+	rapidxml::xml_document<> doc;
+	doc.parse<0>(content.data());
+	rapidxml::xml_node<> *node = doc.first_node("info");
+	if (node) node = node->first_node("desc");
+	if (node) node = node->first_node("channels");
+
+	bool header_set = false;
+	if (node) {
+		int channel_meta_num = 0;
+		for (rapidxml::xml_node<> *channel_node = node->first_node("channel"); channel_node;
+			 channel_node = channel_node->next_sibling()) {
+			if (rapidxml::xml_node<> *label = channel_node->first_node("label"))
+				header_row += label->value();
+			if (channel_node->next_sibling()) header_row += ",";
+			channel_meta_num += 1;
+		}
+		// Final check to see that we got all the channel labels setup nicely.
+		header_set = channel_meta_num == channel_count;
+	}
+	if (!header_set) {
+		header_row = "channel_1";
+		for (int i = 1; i < channel_count; i++) header_row += ",channel_" + std::to_string(i + 1);
+	}
+	return "lsl_time_stamp," + header_row + "\n";
+}
+
+inline void append_csv_value(std::string &out, int64_t value) {
+	char buffer[24], *p = buffer + sizeof(buffer);
+	uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : value;
+	do {
+		*--p = static_cast<char>('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude);
+	if (value < 0) *--p = '-';
+	out.append(p, buffer + sizeof(buffer));
+}
+inline void append_csv_value(std::string &out, char value) {
+	append_csv_value(out, int64_t{value});
+}
+inline void append_csv_value(std::string &out, signed char value) {
+	append_csv_value(out, int64_t{value});
+}
+inline void append_csv_value(std::string &out, int16_t value) {
+	append_csv_value(out, int64_t{value});
+}
+inline void append_csv_value(std::string &out, int32_t value) {
+	append_csv_value(out, int64_t{value});
+}
+
+/**
+ * Append a value formatted like std::to_string(double), i.e. printf's "%f", without going
+ * through printf: |value| * 1e6 is rounded to an integer with the exact rounding error known
+ * from an FMA, and values close to a rounding tie (or too large for this) take the slow path.
+ */
+inline void append_csv_value(std::string &out, double value) {
+	const double magnitude = std::abs(value);
+	if (magnitude < 9e9) { // |value| * 1e6 < 2^53
+		const double scaled = magnitude * 1e6;
+		const double error = std::fma(magnitude, 1e6, -scaled); // |value| * 1e6 - scaled, exactly
+		const double whole = std::floor(scaled);
+		const double fraction = (scaled - whole) + error;
+		if (std::abs(fraction - 0.5) > 1e-6) {
+			uint64_t micros = static_cast<uint64_t>(whole) + (fraction > 0.5 ? 1 : 0);
+			char buffer[32], *p = buffer + sizeof(buffer);
+			for (int digit = 0; digit < 6; digit++, micros /= 10)
+				*--p = static_cast<char>('0' + micros % 10);
+			*--p = '.';
+			do {
+				*--p = static_cast<char>('0' + micros % 10);
+				micros /= 10;
+			} while (micros);
+			if (std::signbit(value)) *--p = '-';
+			out.append(p, buffer + sizeof(buffer));
+			return;
+		}
+	}
+	out += std::to_string(value);
+}
+inline void append_csv_value(std::string &out, float value) {
+	append_csv_value(out, static_cast<double>(value));
+}
+inline void append_csv_value(std::string &out, const std::string &value) {
+	out += '"';
+	out += value;
+	out += '"';
+}
+/// Append a string as a quoted field with its quotes doubled, so that it may contain commas,
+/// quotes and newlines (xdftool; recordings quote strings without escaping them).
+inline void append_csv_escaped(std::string &out, const std::string &value) {
+	out += '"';
+	for (char c : value) {
+		if (c == '"') out += '"';
+		out += c;
+	}
+	out += '"';
+}
+
+/**
+ * @brief append_csv_rows Append the rows of a chunk of samples to a data file's contents.
+ * @param values The values, [sample][channel].
+ */
+template <typename T>
+void append_csv_rows(std::string &out, const double *time_stamps, const T *values,
+	std::size_t n_samples, std::size_t n_channels) {
+	for (std::size_t i = 0; i < n_samples; i++) {
+		append_csv_value(out, time_stamps[i]);
+		for (std::size_t j = 0; j < n_channels; j++) {
+			out += ',';
+			append_csv_value(out, values[i * n_channels + j]);
+		}
+		out += '\n';
+	}
+}
+
+#endif
@@ -1,15 +1,6 @@
 #include "lslstreamwriter.h"
 #include <iostream>
 
-std::string replace_all(std::string str, const std::string &from, const std::string &to) {
-	size_t start_pos = 0;
-	while ((start_pos = str.find(from, start_pos)) != std::string::npos) {
-		str.replace(start_pos, from.length(), to);
-		start_pos += to.length(); // Handles case where 'to' is a substring of 'from'
-	}
-	return str;
-}
-
 void write_timestamp(std::ostream &out, double ts) {
 	// [TimeStampBytes] (0 for no time stamp).
 	if (ts == 0)
@@ -49,6 +40,25 @@ void LSLStreamWriter::_write_chunk(
 	if (filetype_ == file_type_t::xdf) { _write_chunk_header(tag, content.length(), streamid_p); }
 	// [Content].
 	*_get_file(streamid_p, tag) << content;
+	metrics_.bytes_written.add(content.length());
+	metrics_.chunks_written.add(1);
+}
+
+void LSLStreamWriter::_write_samples_chunk(streamid_t streamid, const std::string &content) {
+	const auto wait_start = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock(*_get_write_mutex(&streamid), std::defer_lock);
+	{
+		CURIA_TRACE_SCOPE("lock_wait");
+		lock.lock();
+	}
+	const auto write_start = std::chrono::steady_clock::now();
+	metrics_.lock_wait.observe(
+		std::chrono::duration<double>(write_start - wait_start).count());
+	{
+		CURIA_TRACE_SCOPE("file_write");
+		_write_chunk(chunk_tag_t::samples, content, &streamid);
+	}
+	metrics_.write_latency.observe(seconds_since(write_start));
 }
 
 void LSLStreamWriter::_write_chunk_header(
@@ -80,19 +90,15 @@ void LSLStreamWriter::init_stream_file(streamid_t streamid, std::string stream_n
 
 	// CSV setup.
 	if (filetype_ == file_type_t::csv) {
-		clean_stream_name(stream_name); // Removes invalid path chars.
-		std::string csv_filename =
-			replace_all(filename_, ".csv", " - " + stream_name + ".data.csv");
-		std::string meta_filename =
-			replace_all(filename_, ".csv", " - " + stream_name + ".meta.xml");
+		std::string csv_filename = csv_stream_filename(filename_, stream_name, ".data.csv");
+		std::string meta_filename = csv_stream_filename(filename_, stream_name, ".meta.xml");
 		data_files_[streamid] = outfile_t(csv_filename,
 			std::ios::binary | std::ios::trunc); // Create a data file for each stream.
 		meta_files_[streamid] = outfile_t(meta_filename,
 			std::ios::binary | std::ios::trunc); // Create a meta data file for each stream.
 		file_mutex_.emplace(std::piecewise_construct, std::make_tuple(streamid), 
 			std::make_tuple()); // Create a write lock for each stream.
-		_write_chunk(chunk_tag_t::fileheader,
-			"<?xml version=\"1.0\"?><info><version>1.0</version></info>\n", &streamid);
+		_write_chunk(chunk_tag_t::fileheader, csv_meta_file_header, &streamid);
 	}
 }
 
@@ -101,43 +107,8 @@ void LSLStreamWriter::write_stream_header(streamid_t streamid, const std::string
 	_write_chunk(chunk_tag_t::streamheader, content, &streamid);
 
 	// Write the file header for CSV.
-	if (filetype_ == file_type_t::csv){
-		std::string header_row;
-
-		// We need to make a safe copy of the vector to let rapidxml parse.
-		std::vector<char> content_safe;
-		content_safe.reserve(content.length() + 1);
-		content_safe.assign(content.begin(), content.end());
-		content_safe.push_back('\0'); // Special char that helps rapidxml recognize end of file.
-
-		xml_document<> doc;
-		doc.parse<0>(&content_safe[0]);
-		xml_node<> *root_node = doc.first_node("info")->first_node("desc")->first_node("channels");
-
-		bool header_set = false;
-		if (root_node) {
-			int channel_meta_num = 0;
-			for (xml_node<> *channel_node = root_node->first_node("channel"); channel_node;
-					channel_node = channel_node->next_sibling()) {
-				std::string channel_name(channel_node->first_node("label")->value());
-				header_row += channel_name;
-				if (channel_node->next_sibling()) { header_row += ","; }
-				channel_meta_num += 1;
-			}
-			// Final check to see that we got all the channel labels setup nicely.
-			if (channel_meta_num == channel_count) { header_set = true; }
-		}
-
-		if (!header_set) {
-			header_row += "channel_1";
-			for (int i = 1; i < channel_count; i++) {
-				header_row += ",channel_" + std::to_string(i + 1);
-			}
-		}
-
-		header_row = "lsl_time_stamp," + header_row;
-		header_row += "\n";
-		_write_chunk(chunk_tag_t::samples, header_row, &streamid);
+	if (filetype_ == file_type_t::csv) {
+		_write_chunk(chunk_tag_t::samples, csv_header_row(content, channel_count), &streamid);
 	}
 }
 
@@ -159,6 +130,8 @@ void LSLStreamWriter::write_stream_offset(streamid_t streamid, double now, doubl
 		write_little_endian(*file, now - offset);
 		// [OffsetValue].
 		write_little_endian(*file, offset);
+		metrics_.bytes_written.add(len);
+		metrics_.chunks_written.add(1);
 	}
 }
 
@@ -166,11 +139,16 @@ void LSLStreamWriter::write_boundary_chunk() {
 	// Boundary chunk only required for XDF.
 	if (filetype_ == file_type_t::xdf) {
 		std::lock_guard<std::mutex> lock(*_get_write_mutex(nullptr));
-		// The signature of the boundary chunk (next chunk begins right after this).
-		const uint8_t boundary_uuid[] = {0x43, 0xA5, 0x46, 0xDC, 0xCB, 0xF5, 0x41, 0x0F, 0xB3, 0x0E,
-			0xD5, 0x46, 0x73, 0x83, 0xCB, 0xE4};
 		_write_chunk_header(chunk_tag_t::boundary, sizeof(boundary_uuid));
 		write_sample_values(
 			*_get_file(nullptr, chunk_tag_t::boundary), boundary_uuid, sizeof(boundary_uuid));
 	}
 }
+
+void LSLStreamWriter::flush() {
+	// CSV recordings are only complete after the recording
+	if (filetype_ == file_type_t::xdf) {
+		std::lock_guard<std::mutex> lock(*_get_write_mutex(nullptr));
+		xdf_file_.flush();
+	}
+}
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "conversions.h"
+#include "csv_format.h"
+#include "metrics.h"
+#include "trace.h"
+#include "xdf_format.h"
 
 #include <algorithm>
 #include <cassert>
@@ -24,20 +28,8 @@ using outfile_t = boost::iostreams::filtering_ostream;
 using outfile_t = std::ofstream;
 #endif
 
-using streamid_t = uint32_t;
 using namespace rapidxml;
 
-// the currently defined chunk tags
-enum class chunk_tag_t : uint16_t {
-	fileheader = 1,   // FileHeader chunk
-	streamheader = 2, // StreamHeader chunk
-	samples = 3,	  // Samples chunk
-	clockoffset = 4,  // ClockOffset chunk
-	boundary = 5,	 // Boundary chunk
-	streamfooter = 6, // StreamFooter chunk
-	undefined = 0
-};
-
 // Filetypes, currently support XDF and CSV.
 enum class file_type_t : uint16_t {
 	xdf = 1, // XDF
@@ -55,6 +47,8 @@ private:
 	std::string filename_;
 	file_type_t filetype_;
 
+	writer_metrics metrics_; // live metrics of this writer
+
 	outfile_t *_get_file(const streamid_t *streamid_p, chunk_tag_t tag) {
 		if (filetype_ == file_type_t::xdf) {
 			return &xdf_file_;
@@ -82,7 +76,8 @@ private:
 	void _write_chunk(
 		chunk_tag_t tag, const std::string &content, const streamid_t *streamid_p = nullptr);
 
-	template <typename T> std::string _to_csv_string(T value);
+	// write a samples chunk under the stream's write lock (accounting lock wait and write time)
+	void _write_samples_chunk(streamid_t streamid, const std::string &content);
 
 public:
 	/**
@@ -104,14 +99,6 @@ public:
 	void write_data_chunk_nested(streamid_t streamid, const std::vector<double> &timestamps,
 		const std::vector<std::vector<T>> &chunk);
 
-	void clean_stream_name(std::string &stream_name){ 
-		std::string illegalChars = "\\/:?\"<>|*"; // Remove since they can cause path name issues.
-		for (auto it = stream_name.begin(); it < stream_name.end(); ++it) {
-			bool found = illegalChars.find(*it) != std::string::npos;
-			if (found) { *it = '_'; } // Replace with underscore.
-		}
-	}
-
 	/**
 	 * @brief init_stream Ensures a file is available for the referenced stream.
 	 * For XDF recordings, this can be called multiple times but only one file is created.
@@ -144,6 +131,14 @@ public:
 	 * to recover from errors in XDF files by providing a restart marker.
 	 */
 	void write_boundary_chunk();
+	/**
+	 * @brief flush Hand the buffered chunks to the operating system, so that readers following
+	 * the file while it is being recorded (see xdf_follow.h) see them.
+	 */
+	void flush();
+
+	/// Live metrics of this writer (bytes written, write latency and mutex wait time).
+	const writer_metrics &metrics() const { return metrics_; }
 };
 
 inline void write_ts(std::ostream &out, double ts) {
@@ -158,28 +153,10 @@ inline void write_ts(std::ostream &out, double ts) {
 	}
 }
 
-template <> inline std::string LSLStreamWriter::_to_csv_string(char value) {
-	return std::to_string(value);
-}
-template <> inline std::string LSLStreamWriter::_to_csv_string(int16_t value) {
-	return std::to_string(value);
-}
-template <> inline std::string LSLStreamWriter::_to_csv_string(int32_t value) {
-	return std::to_string(value);
-}
-template <> inline std::string LSLStreamWriter::_to_csv_string(float value) {
-	return std::to_string(value);
-}
-template <> inline std::string LSLStreamWriter::_to_csv_string(double value) {
-	return std::to_string(value);
-}
-template <> inline std::string LSLStreamWriter::_to_csv_string(std::string value) { 
-	return "\"" + value + "\"";
-}
-
 template <typename T>
 void LSLStreamWriter::write_data_chunk(streamid_t streamid, const std::vector<double> &timestamps,
 	const std::vector<T> &chunk, uint32_t n_samples, uint32_t n_channels) {
+	CURIA_TRACE_SCOPE("write_data_chunk");
 
 	/**
 		Samples data chunk: [Tag 3] [VLA ChunkLen] [StreamID] [VLA NumSamples]
@@ -213,24 +190,16 @@ void LSLStreamWriter::write_data_chunk(streamid_t streamid, const std::vector<do
 
 	// CSV formatter.
 	else if (filetype_ == file_type_t::csv) {
-		for (int i = 0; i < timestamps.size(); i++) {
-			outstr += std::to_string(timestamps[i]);
-			for (int j = 0; j < n_channels; j++) {
-				outstr += ",";
-				// Write sample values.
-				outstr += _to_csv_string(chunk[(i * n_channels) + j]);				
-			}
-			outstr += "\n";
-		}
+		append_csv_rows(outstr, timestamps.data(), chunk.data(), n_samples, n_channels);
 	}
 
-	std::lock_guard<std::mutex> lock(*_get_write_mutex(&streamid));
-	_write_chunk(chunk_tag_t::samples, outstr, &streamid);
+	_write_samples_chunk(streamid, outstr);
 }
 
 template <typename T>
 void LSLStreamWriter::write_data_chunk_nested(streamid_t streamid,
 	const std::vector<double> &timestamps, const std::vector<std::vector<T>> &chunk) {
+	CURIA_TRACE_SCOPE("write_data_chunk_nested");
 	if (chunk.size() == 0) return;
 	auto n_samples = timestamps.size();
 	if (timestamps.size() != chunk.size())
@@ -261,17 +230,9 @@ void LSLStreamWriter::write_data_chunk_nested(streamid_t streamid,
 
 	// CSV formatter.
 	else if (filetype_ == file_type_t::csv) {
-		for (int i = 0; i < timestamps.size(); i++) {
-			outstr += std::to_string(timestamps[i]);
-			for (int j = 0; j < n_channels; j++) {
-				outstr += ",";
-				// Write sample values.
-				outstr += _to_csv_string(chunk[(i * n_channels) + j]);
-			}
-			outstr += "\n";
-		}
+		for (std::size_t i = 0; i < n_samples; i++)
+			append_csv_rows(outstr, &timestamps[i], chunk[i].data(), 1, n_channels);
 	}
 
-	std::lock_guard<std::mutex> lock(*_get_write_mutex(&streamid));
-	_write_chunk(chunk_tag_t::samples, outstr, &streamid);
+	_write_samples_chunk(streamid, outstr);
 }
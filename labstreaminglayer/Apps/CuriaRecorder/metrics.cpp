@@ -0,0 +1,231 @@
+#include "metrics.h"
+#include "logger.h"
+#include <sstream>
+#include <stdexcept>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using socklen_t = int;
+#define close_socket closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define close_socket close
+#define INVALID_SOCKET (-1)
+#endif
+
+// a scraper that disconnects mid-response must not raise SIGPIPE (which would end the recording)
+#ifdef MSG_NOSIGNAL
+static const int send_flags = MSG_NOSIGNAL;
+#else
+static const int send_flags = 0;
+#endif
+// maximum time that a scraper may take to send its request or to accept the response, in ms
+static const int client_timeout_ms = 2000;
+
+/// Bound the time that the server thread can be blocked by a client that stalls.
+template <class Socket> static void set_client_options(Socket client) {
+#ifdef _WIN32
+	DWORD timeout = client_timeout_ms;
+#else
+	timeval timeout{client_timeout_ms / 1000, (client_timeout_ms % 1000) * 1000};
+#endif
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&timeout),
+		sizeof(timeout));
+	setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char *>(&timeout),
+		sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+	int nosigpipe = 1;
+	setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, reinterpret_cast<const char *>(&nosigpipe),
+		sizeof(nosigpipe));
+#endif
+}
+
+/// Escape a string for use as a Prometheus label value.
+static std::string label_value(const std::string &value) {
+	std::string result;
+	for (char c : value) {
+		if (c == '\\' || c == '"')
+			result += std::string("\\") + c;
+		else if (c == '\n')
+			result += "\\n";
+		else
+			result += c;
+	}
+	return result;
+}
+
+/// The labels of a stream's series (the name alone is ambiguous, e.g. for two "EEG" amplifiers).
+static std::string stream_labels(const stream_metrics &s) {
+	return "stream=\"" + label_value(s.name) + "\",source_id=\"" + label_value(s.source_id) +
+		   "\",stream_id=\"" + std::to_string(s.id) + "\"";
+}
+
+/// Write a metric's HELP and TYPE lines.
+static void write_family(std::ostream &out, const std::string &name, const std::string &type,
+	const std::string &help) {
+	out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+}
+
+/// Write the bucket, sum and count lines of a histogram (labels must be empty or end with ',').
+template <std::size_t N>
+static void write_histogram(std::ostream &out, const std::string &name, const std::string &labels,
+	const metric_histogram<N> &histogram) {
+	uint64_t cumulative = 0;
+	for (std::size_t k = 0; k <= N; k++) {
+		cumulative += histogram.count(k);
+		out << name << "_bucket{" << labels << "le=\"";
+		if (k < N)
+			out << histogram.bounds()[k];
+		else
+			out << "+Inf";
+		out << "\"} " << cumulative << '\n';
+	}
+	const std::string braced =
+		labels.empty() ? "" : "{" + labels.substr(0, labels.size() - 1) + "}";
+	out << name << "_sum" << braced << ' ' << histogram.sum() << '\n';
+	out << name << "_count" << braced << ' ' << cumulative << '\n';
+}
+
+std::string metrics_registry::render(const writer_metrics *writer) const {
+	std::ostringstream out;
+	out.precision(10);
+	{
+		std::lock_guard<std::mutex> lock(mut_);
+		write_family(out, "curia_stream_samples_total", "counter",
+			"Samples pulled from the stream inlet.");
+		for (const auto &s : streams_)
+			out << "curia_stream_samples_total{" << stream_labels(*s) << "} "
+				<< s->samples.get() << '\n';
+		write_family(out, "curia_stream_bytes_total", "counter",
+			"Sample payload bytes pulled from the stream inlet.");
+		for (const auto &s : streams_)
+			out << "curia_stream_bytes_total{" << stream_labels(*s) << "} "
+				<< s->bytes.get() << '\n';
+		write_family(out, "curia_stream_queue_depth", "gauge",
+			"Samples still buffered in the inlet after the last pull.");
+		for (const auto &s : streams_)
+			out << "curia_stream_queue_depth{" << stream_labels(*s) << "} "
+				<< s->queue_depth.get() << '\n';
+		write_family(out, "curia_stream_clock_offset_seconds", "gauge",
+			"Last measured clock offset of the stream.");
+		for (const auto &s : streams_)
+			out << "curia_stream_clock_offset_seconds{" << stream_labels(*s) << "} "
+				<< s->clock_offset.get() << '\n';
+		write_family(out, "curia_stream_clock_rtt_seconds", "gauge",
+			"Round-trip time of the last clock offset measurement.");
+		for (const auto &s : streams_)
+			out << "curia_stream_clock_rtt_seconds{" << stream_labels(*s) << "} "
+				<< s->clock_rtt.get() << '\n';
+		write_family(out, "curia_stream_chunk_size_samples", "histogram",
+			"Number of samples per pulled chunk.");
+		for (const auto &s : streams_)
+			write_histogram(out, "curia_stream_chunk_size_samples",
+				stream_labels(*s) + ",", s->chunk_size);
+		write_family(out, "curia_stream_pull_latency_seconds", "histogram",
+			"Time spent pulling a chunk from the inlet.");
+		for (const auto &s : streams_)
+			write_histogram(out, "curia_stream_pull_latency_seconds",
+				stream_labels(*s) + ",", s->pull_latency);
+		write_family(out, "curia_stream_write_latency_seconds", "histogram",
+			"Time spent handing a chunk to the file writer.");
+		for (const auto &s : streams_)
+			write_histogram(out, "curia_stream_write_latency_seconds",
+				stream_labels(*s) + ",", s->write_latency);
+	}
+	if (writer) {
+		write_family(
+			out, "curia_writer_bytes_total", "counter", "Bytes handed to the output file(s).");
+		out << "curia_writer_bytes_total " << writer->bytes_written.get() << '\n';
+		write_family(out, "curia_writer_chunks_total", "counter", "Chunks written.");
+		out << "curia_writer_chunks_total " << writer->chunks_written.get() << '\n';
+		write_family(out, "curia_writer_write_latency_seconds", "histogram",
+			"Time spent writing a chunk to the output file.");
+		write_histogram(out, "curia_writer_write_latency_seconds", "", writer->write_latency);
+		write_family(out, "curia_writer_lock_wait_seconds", "histogram",
+			"Time spent waiting for the output file mutex.");
+		write_histogram(out, "curia_writer_lock_wait_seconds", "", writer->lock_wait);
+	}
+	return out.str();
+}
+
+metrics_server::metrics_server(uint16_t port, std::function<std::string()> render)
+	: render_(std::move(render)), shutdown_(false) {
+#ifdef _WIN32
+	WSADATA wsa_data;
+	WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+	auto sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (sock == INVALID_SOCKET)
+		throw std::runtime_error("Could not create the metrics socket");
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	int reuse = 1;
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse),
+		sizeof(reuse));
+	if (bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+		listen(sock, 4) != 0) {
+		close_socket(sock);
+		throw std::runtime_error("Could not listen on metrics port " + std::to_string(port));
+	}
+	listen_socket_ = static_cast<intptr_t>(sock);
+	thread_.reset(new std::thread(&metrics_server::serve, this));
+	Logger::log_info("Serving metrics on http://127.0.0.1:" + std::to_string(port) + "/metrics");
+}
+
+metrics_server::~metrics_server() {
+	shutdown_ = true;
+	if (thread_ && thread_->joinable()) thread_->join();
+	close_socket(listen_socket_);
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+void metrics_server::serve() {
+	const auto sock = static_cast<decltype(socket(0, 0, 0))>(listen_socket_);
+	while (!shutdown_) {
+		// wait for a connection, but wake up regularly to check for shutdown
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(sock, &readable);
+		timeval timeout{0, 200000};
+		if (select(static_cast<int>(sock + 1), &readable, nullptr, nullptr, &timeout) <= 0)
+			continue;
+		auto client = accept(sock, nullptr, nullptr);
+		if (client == INVALID_SOCKET) continue;
+		set_client_options(client);
+		try {
+			// read (and ignore) the request; every path is answered with the metrics
+			// (a client that sends nothing before the timeout is dropped)
+			char request[1024];
+			if (recv(client, request, sizeof(request), 0) <= 0) {
+				close_socket(client);
+				continue;
+			}
+			const std::string body = render_();
+			std::ostringstream response;
+			response << "HTTP/1.0 200 OK\r\n"
+					 << "Content-Type: text/plain; version=0.0.4\r\n"
+					 << "Content-Length: " << body.size() << "\r\n"
+					 << "Connection: close\r\n\r\n"
+					 << body;
+			const std::string data = response.str();
+			std::size_t sent = 0;
+			while (sent < data.size()) {
+				auto n = send(client, data.data() + sent, static_cast<int>(data.size() - sent),
+					send_flags);
+				if (n <= 0) break;
+				sent += n;
+			}
+		} catch (std::exception &e) {
+			Logger::log_error(std::string("Error while serving metrics: ") + e.what());
+		}
+		close_socket(client);
+	}
+}
@@ -0,0 +1,168 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// upper bounds (in seconds) of the latency histogram buckets (pull, write and lock wait times)
+constexpr std::array<double, 12> latency_buckets = {
+	1e-6, 5e-6, 1e-5, 5e-5, 1e-4, 5e-4, 1e-3, 5e-3, 1e-2, 5e-2, 1e-1, 1};
+// upper bounds (in samples) of the chunk size histogram buckets
+constexpr std::array<double, 10> chunk_size_buckets = {1, 2, 4, 8, 16, 64, 256, 1024, 4096, 16384};
+
+/// Seconds elapsed since the given time point (for latency measurements).
+inline double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// A floating-point gauge that can be set and read from any thread without locking.
+class metric_gauge {
+public:
+	void set(double value) { value_.store(value, std::memory_order_relaxed); }
+	double get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<double> value_{0};
+};
+
+/// A monotonic counter that can be incremented from any thread without locking.
+class metric_counter {
+public:
+	void add(uint64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+	uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> value_{0};
+};
+
+/**
+ * A histogram with fixed bucket bounds whose observations are lock-free.
+ * Bucket counts are stored non-cumulatively and only accumulated when rendered.
+ */
+template <std::size_t N> class metric_histogram {
+public:
+	explicit metric_histogram(const std::array<double, N> &bounds) : bounds_(bounds) {}
+
+	void observe(double value) {
+		std::size_t k = 0;
+		while (k < N && value > bounds_[k]) k++;
+		counts_[k].fetch_add(1, std::memory_order_relaxed);
+		double sum = sum_.load(std::memory_order_relaxed);
+		while (!sum_.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {}
+	}
+
+	const std::array<double, N> &bounds() const { return bounds_; }
+	/// the number of observations in bucket k (k == N is the +Inf bucket)
+	uint64_t count(std::size_t k) const { return counts_[k].load(std::memory_order_relaxed); }
+	double sum() const { return sum_.load(std::memory_order_relaxed); }
+
+	/// Estimate the q-quantile (0..1) as the upper bound of the bucket that contains it.
+	double quantile(double q) const {
+		uint64_t total = 0;
+		for (std::size_t k = 0; k <= N; k++) total += count(k);
+		if (!total) return 0;
+		uint64_t cumulative = 0;
+		for (std::size_t k = 0; k < N; k++) {
+			cumulative += count(k);
+			if (cumulative >= q * total) return bounds_[k];
+		}
+		return std::numeric_limits<double>::infinity();
+	}
+
+private:
+	const std::array<double, N> bounds_;
+	std::array<std::atomic<uint64_t>, N + 1> counts_{};
+	std::atomic<double> sum_{0};
+};
+
+using latency_histogram = metric_histogram<latency_buckets.size()>;
+using chunk_size_histogram = metric_histogram<chunk_size_buckets.size()>;
+
+/// Live metrics of a single recorded stream.
+struct stream_metrics {
+	stream_metrics(const std::string &stream_name, const std::string &stream_source_id,
+		uint32_t stream_id)
+		: name(stream_name), source_id(stream_source_id), id(stream_id) {}
+
+	const std::string name;				   // the name of the stream (used as a metric label)
+	const std::string source_id;		   // the source id of the stream (used as a metric label)
+	const uint32_t id;					   // the XDF stream id (a label that tells apart equal names)
+	metric_counter samples;				   // number of samples pulled from the inlet
+	metric_counter bytes;				   // number of sample payload bytes pulled from the inlet
+	metric_gauge queue_depth;			   // number of samples left in the inlet after the last pull
+	metric_gauge clock_offset;			   // the last measured clock offset, in seconds
+	metric_gauge clock_rtt;				   // round-trip time of the last offset measurement
+	chunk_size_histogram chunk_size{chunk_size_buckets}; // samples per pulled chunk
+	latency_histogram pull_latency{latency_buckets};	 // time spent pulling a chunk
+	latency_histogram write_latency{latency_buckets};	 // time spent writing a chunk
+};
+
+/// Live metrics of a LSLStreamWriter.
+struct writer_metrics {
+	metric_counter bytes_written;					 // number of bytes handed to the output file(s)
+	metric_counter chunks_written;					 // number of chunks written
+	latency_histogram write_latency{latency_buckets}; // time spent writing a chunk to the file
+	latency_histogram lock_wait{latency_buckets};	 // time spent waiting for the file mutex
+};
+
+/**
+ * The metrics of a recording.
+ * Streams register once (which takes a lock); all subsequent updates go to the atomics of the
+ * returned stream_metrics and never lock.
+ */
+class metrics_registry {
+public:
+	/// Register a new stream; the returned reference stays valid for the registry's lifetime.
+	stream_metrics &add_stream(const std::string &name, const std::string &source_id, uint32_t id) {
+		std::lock_guard<std::mutex> lock(mut_);
+		streams_.emplace_back(new stream_metrics(name, source_id, id));
+		return *streams_.back();
+	}
+
+	/**
+	 * @brief render Format all metrics in the Prometheus text exposition format.
+	 * @param writer The metrics of the file writer (may be null).
+	 */
+	std::string render(const writer_metrics *writer) const;
+
+private:
+	mutable std::mutex mut_; // a mutex to protect the list of streams (not the metrics themselves)
+	std::list<std::unique_ptr<stream_metrics>> streams_;
+};
+
+/**
+ * A minimal HTTP server that answers every request on a local port with the current metrics
+ * (Prometheus text exposition format), so that a Prometheus instance can scrape the recorder.
+ */
+class metrics_server {
+public:
+	/**
+	 * @brief metrics_server Start serving on the loopback interface.
+	 * @param port The TCP port to listen on.
+	 * @param render Produces the response body (called once per scrape, from the server thread).
+	 */
+	metrics_server(uint16_t port, std::function<std::string()> render);
+
+	/// Stops the server thread and closes the socket.
+	~metrics_server();
+
+private:
+	/// accept and answer scrape requests until shut down
+	void serve();
+
+	std::function<std::string()> render_; // produces the metrics text
+	std::atomic<bool> shutdown_;		  // whether we are trying to shut down
+	intptr_t listen_socket_;			  // the listening socket
+	std::unique_ptr<std::thread> thread_; // the serving thread
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "recording.h"
 #include "logger.h"
+#include "trace.h"
 #include <optional>
 //#include "conversions.h"
 #include <regex>
@@ -14,6 +15,16 @@
 // Thread utilities
 using Clock = std::chrono::high_resolution_clock;
 
+/// Number of sample payload bytes in a chunk (for the throughput metrics).
+template <class T> inline std::size_t chunk_payload_bytes(const std::vector<T> &chunk) {
+	return chunk.size() * sizeof(T);
+}
+inline std::size_t chunk_payload_bytes(const std::vector<std::string> &chunk) {
+	std::size_t bytes = 0;
+	for (const auto &value : chunk) bytes += value.size();
+	return bytes;
+}
+
 /**
  * @brief try_join_once		joins and deconstructs the thread if possible
  * @param thread			unique_ptr to a std::tread. Will be reset on success
@@ -92,7 +103,8 @@ recording::recording(
 	int sync_default,
 	bool collect_offsets,
 	bool recording_timestamps,
-	std::chrono::milliseconds chunk_interval)
+	std::chrono::milliseconds chunk_interval,
+	bool gap_markers)
 	: file_(filename, filetype), 
 	  unsorted_(false), streamid_(0),
 	  shutdown_(false), headers_to_finish_(0),
@@ -101,7 +113,15 @@ recording::recording(
 	  sync_default_(sync_default),
 	  offsets_enabled_(collect_offsets),
 	  recording_timestamps_enabled_(recording_timestamps),
-	  chunk_interval_(chunk_interval) {
+	  chunk_interval_(chunk_interval),
+	  gap_markers_enabled_(gap_markers), gap_marker_streamid_(0), gap_markers_finished_(false) {
+	// set up the gap marker stream before any of the recorded streams write their headers
+	if (gap_markers_enabled_) {
+		gap_marker_streamid_ = fresh_streamid();
+		gap_marker_stats_.name = "CuriaRecorder Gaps";
+		file_.init_stream_file(gap_marker_streamid_, gap_marker_stats_.name);
+		file_.write_stream_header(gap_marker_streamid_, gap_marker_stream_header, 1);
+	}
 	// create a recording thread for each stream
 	for (const auto &stream : streams)
 		stream_threads_.emplace_back(
@@ -125,6 +145,7 @@ recording::~recording() {
 			Logger::log_warning("boundary_thread didn't finish in time!");
 			boundary_thread_->detach();
 		}
+		if (gap_markers_enabled_) finish_gap_markers();
 		Logger::log_info("Closing the file(s).");
 	} catch (std::exception &e) {
 		Logger::log_error("Error while closing the recording: " + std::string(e.what()));
@@ -175,6 +196,7 @@ void recording::record_from_streaminfo(const lsl::stream_info &src, bool phase_l
 
 		inlet_p in;
 		lsl::stream_info info;
+		stream_metrics &metrics = metrics_.add_stream(src.name(), src.source_id(), streamid);
 
 		// --- headers phase
 		try {
@@ -246,6 +268,14 @@ void recording::record_from_streaminfo(const lsl::stream_info &src, bool phase_l
 			file_.write_stream_header(streamid, stream_meta_data, in->get_channel_count() + (recording_timestamps_enabled_ ? 1 : 0));
 			Logger::log_info("Received header for stream " + src.name() + ".");
 
+			{
+				// register the stream for online statistics
+				std::lock_guard<std::mutex> lock(stats_mut_);
+				stream_stats &stats = stream_stats_[streamid];
+				stats.name = info.name();
+				stats.nominal_srate = info.nominal_srate();
+			}
+
 			leave_headers_phase(phase_locked);
 		} catch (std::exception &) {
 			leave_headers_phase(phase_locked);
@@ -266,27 +296,27 @@ void recording::record_from_streaminfo(const lsl::stream_info &src, bool phase_l
 			// now write the actual sample chunks...
 			switch (src.channel_format()) {
 			case lsl::cf_int8:
-				typed_transfer_loop<char>(streamid, info.nominal_srate(), in, first_timestamp,
-					last_timestamp, sample_count);
+				typed_transfer_loop<char>(streamid, info.nominal_srate(), in, metrics,
+					first_timestamp, last_timestamp, sample_count);
 				break;
 			case lsl::cf_int16:
-				typed_transfer_loop<int16_t>(streamid, info.nominal_srate(), in, first_timestamp,
-					last_timestamp, sample_count);
+				typed_transfer_loop<int16_t>(streamid, info.nominal_srate(), in, metrics,
+					first_timestamp, last_timestamp, sample_count);
 				break;
 			case lsl::cf_int32:
-				typed_transfer_loop<int32_t>(streamid, info.nominal_srate(), in, first_timestamp,
-					last_timestamp, sample_count);
+				typed_transfer_loop<int32_t>(streamid, info.nominal_srate(), in, metrics,
+					first_timestamp, last_timestamp, sample_count);
 				break;
 			case lsl::cf_float32:
-				typed_transfer_loop<float>(streamid, info.nominal_srate(), in, first_timestamp,
-					last_timestamp, sample_count);
+				typed_transfer_loop<float>(streamid, info.nominal_srate(), in, metrics,
+					first_timestamp, last_timestamp, sample_count);
 				break;
 			case lsl::cf_double64:
-				typed_transfer_loop<double>(streamid, info.nominal_srate(), in, first_timestamp,
-					last_timestamp, sample_count);
+				typed_transfer_loop<double>(streamid, info.nominal_srate(), in, metrics,
+					first_timestamp, last_timestamp, sample_count);
 				break;
 			case lsl::cf_string:
-				typed_transfer_loop<std::string>(streamid, info.nominal_srate(), in,
+				typed_transfer_loop<std::string>(streamid, info.nominal_srate(), in, metrics,
 					first_timestamp, last_timestamp, sample_count);
 				break;
 			default:
@@ -320,7 +350,12 @@ void recording::record_from_streaminfo(const lsl::stream_info &src, bool phase_l
 					footer << "<offset><time>" << pair.first << "</time><value>" << pair.second
 						   << "</value></offset>";
 				}
-				footer << "</clock_offsets></info>";
+				footer << "</clock_offsets>";
+			}
+			{
+				// ... and the online statistics
+				std::lock_guard<std::mutex> lock(stats_mut_);
+				footer << stream_stats_[streamid].as_xml() << "</info>";
 			}
 			file_.write_stream_footer(streamid, footer.str());
 
@@ -344,14 +379,49 @@ void recording::record_boundaries() {
 				file_.write_boundary_chunk();
 				next_boundary = Clock::now() + boundary_interval;
 			}
+			// keep the file current for live readers (xdftool follow)
+			file_.flush();
 		}
 	} catch (std::exception &e) {
 		Logger::log_error(std::string("Error in the record_boundaries thread: ") + e.what());
 	}
 }
 
-void recording::record_offsets(
-	streamid_t streamid, const inlet_p &in, std::atomic<bool> &offset_shutdown) noexcept {
+void recording::record_gap_markers(
+	const std::string &stream_name, const std::vector<stream_gap> &gaps, double clock_offset) {
+	std::vector<double> timestamps;
+	std::vector<std::string> markers;
+	for (const auto &gap : gaps) {
+		std::ostringstream marker;
+		marker.precision(6);
+		marker << "gap stream=\"" << stream_name << "\" duration=" << gap.duration
+			   << " missing_samples=" << gap.missing_samples;
+		marker.precision(16);
+		marker << " source_time=" << gap.start;
+		timestamps.push_back(gap.start + clock_offset);
+		markers.push_back(marker.str());
+	}
+	std::lock_guard<std::mutex> lock(gap_marker_mut_);
+	// a thread that was detached at shutdown must not append samples after the footer
+	if (gap_markers_finished_) return;
+	file_.write_data_chunk(gap_marker_streamid_, timestamps, markers, 1);
+	gap_marker_stats_.add_samples(timestamps, nullptr);
+}
+
+void recording::finish_gap_markers() {
+	std::lock_guard<std::mutex> lock(gap_marker_mut_);
+	gap_markers_finished_ = true;
+	std::ostringstream footer;
+	footer.precision(16);
+	footer << "<?xml version=\"1.0\"?><info><first_timestamp>" << gap_marker_stats_.first_timestamp
+		   << "</first_timestamp><last_timestamp>" << gap_marker_stats_.last_timestamp
+		   << "</last_timestamp><sample_count>" << gap_marker_stats_.sample_count
+		   << "</sample_count><clock_offsets></clock_offsets></info>";
+	file_.write_stream_footer(gap_marker_streamid_, footer.str());
+}
+
+void recording::record_offsets(streamid_t streamid, const inlet_p &in, stream_metrics &metrics,
+	std::atomic<bool> &offset_shutdown) noexcept {
 	try {
 		while (!shutdown_ && !offset_shutdown) {
 			// Sleep for the interval.
@@ -360,7 +430,10 @@ void recording::record_offsets(
 			double offset = std::numeric_limits<double>::infinity();
 			double now = lsl::local_clock();
 			try {
-				offset = in->time_correction(2.5);
+				double remote_time, rtt;
+				offset = in->time_correction(&remote_time, &rtt, 2.5);
+				metrics.clock_offset.set(offset);
+				metrics.clock_rtt.set(rtt);
 			} catch (lsl::timeout_error &) {
 				Logger::log_warning("Timeout in time correction query for stream " + streamid);
 			}
@@ -419,20 +492,45 @@ void recording::enter_footers_phase(bool phase_locked) {
 
 template <class T>
 void recording::typed_transfer_loop(streamid_t streamid, double srate, const inlet_p &in,
-	double &first_timestamp, double &last_timestamp, uint64_t &sample_count) {
+	stream_metrics &metrics, double &first_timestamp, double &last_timestamp,
+	uint64_t &sample_count) {
 	// optionally start an offset collection thread for this stream
 	std::atomic<bool> offset_shutdown{false};
-	thread_p offset_thread(offsets_enabled_ ? new std::thread(&recording::record_offsets, this,
-												  streamid, in, std::ref(offset_shutdown))
-											: nullptr);
+	thread_p offset_thread(offsets_enabled_
+							   ? new std::thread(&recording::record_offsets, this, streamid, in,
+									 std::ref(metrics), std::ref(offset_shutdown))
+							   : nullptr);
 	try {
 		double sample_interval = srate ? 1.0 / srate : 0;
 
 		// temporary data
 		std::vector<T> chunk;
 		std::vector<double> timestamps;
+		std::vector<stream_gap> new_gaps;
 		int channelCount = 0;
 
+		// Account a chunk in the online statistics and report any gaps in it.
+		auto update_stats = [&]() {
+			std::string stream_name;
+			new_gaps.clear();
+			{
+				std::lock_guard<std::mutex> lock(stats_mut_);
+				stream_stats &stats = stream_stats_[streamid];
+				stats.add_samples(timestamps, &new_gaps);
+				if (!new_gaps.empty()) stream_name = stats.name;
+			}
+			if (new_gaps.empty()) return;
+			double gap_duration = 0;
+			for (const auto &gap : new_gaps) gap_duration += gap.duration;
+			Logger::log_warning("Detected " + std::to_string(new_gaps.size()) + " gap(s) totalling " +
+								std::to_string(gap_duration) + " seconds in stream " + stream_name +
+								".");
+			if (!gap_markers_enabled_) return;
+			// the offset last measured by record_offsets() (0 until the first measurement); a query
+			// here could block the pull loop for seconds while the stream is already lagging
+			record_gap_markers(stream_name, new_gaps, metrics.clock_offset.get());
+		};
+
 		// Pull the first sample.
 		first_timestamp = no_timestamp_val;
 		while (!shutdown_ && first_timestamp == no_timestamp_val) {
@@ -444,6 +542,7 @@ void recording::typed_transfer_loop(streamid_t streamid, double srate, const inl
 		// so check if the sample is valid instead of just for shutdown parameter.
 		if (first_timestamp != no_timestamp_val) {
 			timestamps.push_back(first_timestamp);
+			update_stats();
 			channelCount = in->get_channel_count();
 
 			if (recording_timestamps_enabled_) {
@@ -459,7 +558,16 @@ void recording::typed_transfer_loop(streamid_t streamid, double srate, const inl
 			auto start_time = std::chrono::high_resolution_clock::now();
 
 			// Get a chunk from the stream.
-			in->pull_chunk_multiplexed(chunk, &timestamps, 1e-6);
+			auto pull_start = std::chrono::steady_clock::now();
+			{
+				CURIA_TRACE_SCOPE("pull_chunk");
+				in->pull_chunk_multiplexed(chunk, &timestamps, 1e-6);
+			}
+			metrics.pull_latency.observe(seconds_since(pull_start));
+			metrics.queue_depth.set(static_cast<double>(in->samples_available()));
+			metrics.chunk_size.observe(static_cast<double>(timestamps.size()));
+			metrics.samples.add(timestamps.size());
+			metrics.bytes.add(chunk_payload_bytes(chunk));
 			// For each sample...
 			for (double &ts : timestamps) {
 				// If the time stamp can be deduced from the previous one...
@@ -469,12 +577,19 @@ void recording::typed_transfer_loop(streamid_t streamid, double srate, const inl
 					last_timestamp = ts;
 				}
 			}
+			update_stats();
 			channelCount = in->get_channel_count();
 			if (recording_timestamps_enabled_) {
+				CURIA_TRACE_SCOPE("inject_recording_timestamps");
 				inject_recording_timestamps_(&chunk, channelCount, timestamps.size());
 			}
 			// Write the actual chunk.
-			file_.write_data_chunk(streamid, timestamps, chunk, channelCount);
+			auto write_start = std::chrono::steady_clock::now();
+			{
+				CURIA_TRACE_SCOPE("write_chunk");
+				file_.write_data_chunk(streamid, timestamps, chunk, channelCount);
+			}
+			metrics.write_latency.observe(seconds_since(write_start));
 			sample_count += timestamps.size();
 
 			// Sleep for remainder of chunk interval.
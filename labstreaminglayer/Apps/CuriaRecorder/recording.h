@@ -2,6 +2,8 @@
 #define RECORDING_H
 
 #include "LSLStreamWriter.h"
+#include "metrics.h"
+#include "stream_stats.h"
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -68,6 +70,19 @@ const std::string recording_timestamp_int32_channel_info =
 	"\n\t\t\t</channel>"
 	"\n\t\t</channels>";
 
+// header of the marker stream into which the recorder writes detected gaps
+const std::string gap_marker_stream_header =
+	"<?xml version=\"1.0\"?>"
+	"<info>"
+	"<name>CuriaRecorder Gaps</name>"
+	"<type>Markers</type>"
+	"<channel_count>1</channel_count>"
+	"<nominal_srate>0</nominal_srate>"
+	"<channel_format>string</channel_format>"
+	"<source_id>CuriaRecorder_gap_markers</source_id>"
+	"<desc><channels><channel><label>Gap</label><type>Recorder</type></channel></channels></desc>"
+	"</info>";
+
 // Value for timestamp when no timestamp/sample has been received yet.
 const auto no_timestamp_val = 0.0;
 
@@ -81,6 +96,8 @@ using inlet_p = std::shared_ptr<lsl::stream_inlet>;
 using offset_list = std::list<std::pair<double, double>>;
 // a map from streamid to offset_list
 using offset_lists = std::map<streamid_t, offset_list>;
+// a map from streamid to the online statistics of that stream
+using stream_stats_map = std::map<streamid_t, stream_stats>;
 
 
 /**
@@ -101,6 +118,8 @@ public:
 	 *but is not yet online, or a more generic query (e.g., "record from everything that's out
 	 *there").
 	 * @param collect_offsets Whether to collect time offset measurements periodically.
+	 * @param gap_markers Whether to write a marker into a recorder-owned marker stream whenever a
+	 *gap is detected in one of the recorded streams.
 	 */
 	recording(const std::string &filename, file_type_t file_type,
 		const std::vector<lsl::stream_info> &streams, const std::vector<std::string> &watchfor,
@@ -108,7 +127,8 @@ public:
 		int sync_default = -1, // -1 means don't set sync.
 		bool collect_offsets = true,
 		bool recording_timestamps = true,
-		std::chrono::milliseconds chunk_interval = chunk_interval_default);
+		std::chrono::milliseconds chunk_interval = chunk_interval_default,
+		bool gap_markers = false);
 
 	/** Destructor.
 	 * Stops the recording and closes the file.
@@ -121,6 +141,19 @@ public:
 			.count();
 	}
 
+	/// A snapshot of the online statistics (effective srate, gaps, jitter) of all streams
+	/// currently being recorded, keyed by stream id.
+	stream_stats_map statistics() {
+		std::lock_guard<std::mutex> lock(stats_mut_);
+		return stream_stats_;
+	}
+
+	/// The live metrics of all streams and of the file writer, in the Prometheus text format.
+	std::string metrics_text() const { return metrics_.render(&file_.metrics()); }
+
+	/// The live metrics of the file writer.
+	const writer_metrics &file_metrics() const { return file_.metrics(); }
+
 private:
 	// the file stream
 	LSLStreamWriter file_; // the file output stream
@@ -155,6 +188,19 @@ private:
 		offset_lists_; // the clock offset lists for each stream (to be written into the footer)
 	std::mutex offset_mut_; // a mutex to protect the offset lists
 
+	// online statistics for every stream
+	stream_stats_map stream_stats_; // the statistics for each stream (also written into the footer)
+	std::mutex stats_mut_;			// a mutex to protect the statistics
+
+	// live metrics for every stream (updated lock-free)
+	metrics_registry metrics_;
+
+	// the recorder-owned marker stream for gap markers
+	bool gap_markers_enabled_;		// whether to write a marker for each detected gap
+	streamid_t gap_marker_streamid_; // the stream id of the gap marker stream
+	stream_stats gap_marker_stats_;	 // the sample bookkeeping of the gap marker stream
+	std::mutex gap_marker_mut_;		 // a mutex to protect the gap marker bookkeeping
+	bool gap_markers_finished_;		 // whether the footer is written (later gaps are only logged)
 
 	// data for shutdown / final joining
 	std::list<thread_p> stream_threads_; // the spawned stream handling threads
@@ -198,15 +244,25 @@ private:
 	/// record boundary markers every few seconds
 	void record_boundaries();
 
+	/// write a marker for each of the given gaps into the gap marker stream
+	/// @param clock_offset the offset of the stream's clock to the local clock; the markers are
+	/// time-stamped in the local clock, since the marker stream has no ClockOffset chunks
+	void record_gap_markers(
+		const std::string &stream_name, const std::vector<stream_gap> &gaps, double clock_offset);
+
+	/// write the footer of the gap marker stream (once all recording threads are done with it)
+	void finish_gap_markers();
+
 	// record ClockOffset chunks from a given stream
-	void record_offsets(
-		streamid_t streamid, const inlet_p &in, std::atomic<bool> &offset_shutdown) noexcept;
+	void record_offsets(streamid_t streamid, const inlet_p &in, stream_metrics &metrics,
+		std::atomic<bool> &offset_shutdown) noexcept;
 
 
 	// sample collection loop for a numeric stream
 	template <class T>
 	void typed_transfer_loop(streamid_t streamid, double srate, const inlet_p &in,
-		double &first_timestamp, double &last_timestamp, uint64_t &sample_count);
+		stream_metrics &metrics, double &first_timestamp, double &last_timestamp,
+		uint64_t &sample_count);
 
 	// === phase registration & condition checks ===
 	// writing is coordinated across threads in three phases to keep the file chunks sorted
@@ -0,0 +1,110 @@
+#ifndef STREAM_STATS_H
+#define STREAM_STATS_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// an inter-sample interval longer than this many nominal sample intervals counts as a gap
+const double gap_threshold_intervals = 1.5;
+// number of bins in the inter-sample jitter histogram (the center bin holds on-time samples)
+const int jitter_histogram_bins = 21;
+// width of a jitter histogram bin, as a fraction of the nominal sample interval
+const double jitter_bin_width = 0.05;
+// maximum number of individual gaps that are kept (and written into the footer) per stream
+const std::size_t max_listed_gaps = 1000;
+
+/// A gap in a regularly sampled stream.
+struct stream_gap {
+	double start;			  // time stamp of the last sample before the gap
+	double duration;		  // length of the gap beyond one nominal sample interval, in seconds
+	uint64_t missing_samples; // estimated number of samples that were dropped
+};
+
+/**
+ * Online statistics of a recorded stream (effective sampling rate, gaps and timing jitter).
+ * The statistics are updated chunk by chunk from the transfer loop, so that each time stamp is
+ * only looked at once. Gaps and jitter are only tracked for streams with a nominal sampling rate.
+ */
+struct stream_stats {
+	std::string name;			   // the name of the stream
+	double nominal_srate = 0;	  // the declared sampling rate of the stream (0 if irregular)
+	double first_timestamp = 0;	// time stamp of the first sample seen
+	double last_timestamp = 0;	 // time stamp of the last sample seen
+	uint64_t sample_count = 0;	 // number of samples seen
+	uint64_t gap_count = 0;		   // number of detected gaps
+	uint64_t dropped_samples = 0;  // estimated number of samples lost in gaps
+	uint64_t backward_steps = 0;   // number of time stamps that went backwards
+	double total_gap_duration = 0; // sum of all gap durations, in seconds
+	double max_gap_duration = 0;   // longest gap, in seconds
+	std::vector<stream_gap> gaps;  // the first max_listed_gaps gaps
+	std::array<uint64_t, jitter_histogram_bins> jitter_histogram{}; // inter-sample deviations
+
+	/// The sampling rate measured over all samples seen so far (0 if not yet known).
+	double effective_srate() const {
+		const double duration = last_timestamp - first_timestamp;
+		return (sample_count > 1 && duration > 0) ? (sample_count - 1) / duration : 0;
+	}
+
+	/**
+	 * @brief add_samples Account for a freshly pulled chunk of time stamps.
+	 * @param timestamps The time stamps of the chunk, in the order they were received.
+	 * @param new_gaps If non-null, receives the gaps detected within this chunk.
+	 */
+	void add_samples(const std::vector<double> &timestamps, std::vector<stream_gap> *new_gaps) {
+		if (timestamps.empty()) return;
+		const double interval = nominal_srate ? 1.0 / nominal_srate : 0;
+		std::size_t k = 0;
+		if (sample_count == 0) first_timestamp = last_timestamp = timestamps[k++];
+		for (; k < timestamps.size(); k++) {
+			const double dt = timestamps[k] - last_timestamp;
+			if (dt < 0) backward_steps++;
+			if (interval) {
+				// Bin the deviation from the nominal interval (clamped into the outer bins).
+				const double deviation = (dt - interval) / (interval * jitter_bin_width);
+				int bin = static_cast<int>(std::floor(deviation + 0.5)) + jitter_histogram_bins / 2;
+				if (bin < 0) bin = 0;
+				if (bin >= jitter_histogram_bins) bin = jitter_histogram_bins - 1;
+				jitter_histogram[bin]++;
+				if (dt > gap_threshold_intervals * interval) {
+					stream_gap gap{last_timestamp, dt - interval,
+						static_cast<uint64_t>(std::llround(dt / interval)) - 1};
+					gap_count++;
+					dropped_samples += gap.missing_samples;
+					total_gap_duration += gap.duration;
+					if (gap.duration > max_gap_duration) max_gap_duration = gap.duration;
+					if (gaps.size() < max_listed_gaps) gaps.push_back(gap);
+					if (new_gaps) new_gaps->push_back(gap);
+				}
+			}
+			last_timestamp = timestamps[k];
+		}
+		sample_count += timestamps.size();
+	}
+
+	/// The statistics as an XML fragment, to be embedded into the stream footer.
+	std::string as_xml() const {
+		std::ostringstream out;
+		out.precision(16);
+		out << "<statistics><nominal_srate>" << nominal_srate << "</nominal_srate><effective_srate>"
+			<< effective_srate() << "</effective_srate><gap_count>" << gap_count
+			<< "</gap_count><dropped_samples>" << dropped_samples
+			<< "</dropped_samples><backward_steps>" << backward_steps
+			<< "</backward_steps><total_gap_duration>" << total_gap_duration
+			<< "</total_gap_duration><max_gap_duration>" << max_gap_duration
+			<< "</max_gap_duration><gaps>";
+		for (const auto &gap : gaps)
+			out << "<gap><start>" << gap.start << "</start><duration>" << gap.duration
+				<< "</duration><missing_samples>" << gap.missing_samples
+				<< "</missing_samples></gap>";
+		out << "</gaps><jitter_histogram><bin_width>" << jitter_bin_width << "</bin_width>";
+		for (const auto count : jitter_histogram) out << "<bin>" << count << "</bin>";
+		out << "</jitter_histogram></statistics>";
+		return out.str();
+	}
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "xdf_format.h"
+#include "xdf_reader.h"
+#include "xdf_sort.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Regression test: sorting a file with a damaged chunk length must skip to the next Boundary
+// chunk and report it, instead of silently dropping the rest of the file.
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what) {
+	if (!ok) {
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+}
+
+/// Append a chunk with an 8-byte length field; returns the offset of the length field.
+static std::size_t put_chunk(std::string &file, chunk_tag_t tag, const std::string &content,
+	bool has_streamid = true, streamid_t streamid = 1) {
+	const uint64_t length =
+		sizeof(chunk_tag_t) + (has_streamid ? sizeof(streamid_t) : 0) + content.size();
+	const auto tag_value = static_cast<uint16_t>(tag);
+	file.push_back(8);
+	const std::size_t length_offset = file.size();
+	file.append(reinterpret_cast<const char *>(&length), sizeof(length));
+	file.append(reinterpret_cast<const char *>(&tag_value), sizeof(tag_value));
+	if (has_streamid) file.append(reinterpret_cast<const char *>(&streamid), sizeof(streamid));
+	file += content;
+	return length_offset;
+}
+
+/// The content of a Samples chunk with a single float32 sample.
+static std::string samples_content(double time_stamp, float value) {
+	std::string content;
+	const uint32_t n_samples = 1;
+	content.push_back(4);
+	content.append(reinterpret_cast<const char *>(&n_samples), sizeof(n_samples));
+	content.push_back(8);
+	content.append(reinterpret_cast<const char *>(&time_stamp), sizeof(time_stamp));
+	content.append(reinterpret_cast<const char *>(&value), sizeof(value));
+	return content;
+}
+
+static void put_boundary(std::string &file) {
+	put_chunk(file, chunk_tag_t::boundary,
+		std::string(reinterpret_cast<const char *>(boundary_uuid), sizeof(boundary_uuid)), false);
+}
+
+/// A recording of one stream of 30 samples with a Boundary chunk every 10 samples.
+static std::string make_file(std::size_t &damaged_length_offset) {
+	std::string file = "XDF:";
+	put_chunk(file, chunk_tag_t::fileheader,
+		"<?xml version=\"1.0\"?><info><version>1.0</version></info>", false);
+	put_chunk(file, chunk_tag_t::streamheader,
+		"<?xml version=\"1.0\"?><info><name>Test</name><type>EEG</type>"
+		"<channel_count>1</channel_count><nominal_srate>10</nominal_srate>"
+		"<channel_format>float32</channel_format><source_id>test</source_id></info>");
+	for (int k = 0; k < 30; k++) {
+		if (k % 10 == 0) put_boundary(file);
+		const std::size_t length_offset =
+			put_chunk(file, chunk_tag_t::samples, samples_content(k * 0.1, static_cast<float>(k)));
+		if (k == 13) damaged_length_offset = length_offset;
+	}
+	put_chunk(file, chunk_tag_t::streamfooter,
+		"<?xml version=\"1.0\"?><info><first_timestamp>0</first_timestamp>"
+		"<last_timestamp>2.9</last_timestamp><sample_count>30</sample_count></info>");
+	return file;
+}
+
+static void write_file(const std::string &filename, const std::string &data) {
+	std::ofstream(filename, std::ios::binary | std::ios::trunc).write(data.data(), data.size());
+}
+
+/// Sort the file and check that the damage is reported and the rest of it is kept.
+static void check_sort(
+	const std::string &name, const std::string &data, std::size_t samples, bool footer) {
+	const std::string input = "test_sort_" + name + ".xdf", output = "test_sort_" + name +
+																		".sorted.xdf";
+	write_file(input, data);
+	sort_options opts;
+	const sort_result result = sort_xdf(input, output, std::string(), opts);
+	check(!result.warnings.empty(), name + ": the damage is reported");
+	xdf_reader sorted(output);
+	sorted.decode();
+	check(sorted.warnings().empty(), name + ": the output is intact");
+	check(sorted.streams().size() == 1 && sorted.streams()[0].footer.empty() != footer,
+		name + ": the stream footer is kept");
+	check(sorted.streams().size() == 1 && sorted.streams()[0].sample_count() == samples,
+		name + ": the samples after the damage are kept");
+	std::remove(input.c_str());
+	std::remove(output.c_str());
+}
+
+int main() {
+	std::size_t damaged = 0;
+	const std::string intact = make_file(damaged);
+
+	// an implausible length field: the samples up to the next Boundary chunk (13..19) are lost
+	std::string huge_length = intact;
+	const uint64_t huge = uint64_t(1) << 40;
+	std::memcpy(&huge_length[damaged], &huge, sizeof(huge));
+	check_sort("huge_length", huge_length, 23, true);
+
+	// a plausible length field that extends beyond the end of the file
+	std::string long_length = intact;
+	const uint64_t longer = 100000;
+	std::memcpy(&long_length[damaged], &longer, sizeof(longer));
+	check_sort("long_length", long_length, 23, true);
+
+	// a recording that ends within its last chunk (the footer)
+	check_sort("truncated", intact.substr(0, intact.size() - 10), 30, false);
+
+	if (!failures) std::cout << "All tests passed" << std::endl;
+	return failures ? 1 : 0;
+}
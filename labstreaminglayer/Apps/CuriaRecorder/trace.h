@@ -0,0 +1,133 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/**
+ * Optional hot-path tracing (Chrome trace / Perfetto JSON).
+ * Build with LABRECORDER_TRACING=On to enable; otherwise CURIA_TRACE_SCOPE expands to nothing.
+ * Spans are recorded into per-thread ring buffers (the oldest spans are overwritten) and written
+ * out by trace_dump(), which can be opened in chrome://tracing or ui.perfetto.dev.
+ */
+
+#include <string>
+
+#ifdef CURIA_TRACING
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+
+// number of spans kept per thread
+const std::size_t trace_buffer_capacity = 1 << 16;
+
+/// A completed span.
+struct trace_event {
+	const char *name; // the span name (must be a string literal)
+	int64_t start_ns; // start of the span, in ns since the trace epoch
+	int64_t duration_ns;
+};
+
+/// The spans of a single thread; written by that thread only.
+struct trace_buffer {
+	explicit trace_buffer(uint32_t thread_id) : tid(thread_id) {}
+
+	const uint32_t tid;				   // sequential thread number (Chrome trace "tid")
+	std::atomic<uint64_t> written{0};  // number of spans written so far
+	std::array<trace_event, trace_buffer_capacity> events;
+};
+
+/// The registry of all threads' trace buffers.
+struct trace_registry {
+	std::mutex mut; // a mutex to protect the list of buffers (not the buffers themselves)
+	std::list<std::shared_ptr<trace_buffer>> buffers;
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+inline trace_registry &trace_get_registry() {
+	static trace_registry registry;
+	return registry;
+}
+
+/// The calling thread's trace buffer (registered on first use).
+inline trace_buffer &trace_thread_buffer() {
+	thread_local std::shared_ptr<trace_buffer> buffer;
+	if (!buffer) {
+		trace_registry &registry = trace_get_registry();
+		std::lock_guard<std::mutex> lock(registry.mut);
+		buffer = std::make_shared<trace_buffer>(static_cast<uint32_t>(registry.buffers.size() + 1));
+		registry.buffers.push_back(buffer);
+	}
+	return *buffer;
+}
+
+inline int64_t trace_now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - trace_get_registry().epoch)
+		.count();
+}
+
+/// Records a span from its construction to its destruction.
+class trace_scope {
+public:
+	explicit trace_scope(const char *name) : name_(name), start_ns_(trace_now_ns()) {}
+	~trace_scope() {
+		trace_buffer &buffer = trace_thread_buffer();
+		const uint64_t k = buffer.written.load(std::memory_order_relaxed);
+		buffer.events[k % trace_buffer_capacity] = {name_, start_ns_, trace_now_ns() - start_ns_};
+		buffer.written.store(k + 1, std::memory_order_release);
+	}
+
+private:
+	const char *name_;
+	int64_t start_ns_;
+};
+
+/**
+ * @brief trace_dump Write all recorded spans as Chrome trace JSON.
+ * Spans that are overwritten while dumping (threads still running) may come out garbled.
+ * @param filename The file to write.
+ * @return Whether the trace was written.
+ */
+inline bool trace_dump(const std::string &filename) {
+	std::ofstream out(filename, std::ios::trunc);
+	if (!out) return false;
+	out.precision(3);
+	out << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	trace_registry &registry = trace_get_registry();
+	std::lock_guard<std::mutex> lock(registry.mut);
+	for (const auto &buffer : registry.buffers) {
+		const uint64_t written = buffer->written.load(std::memory_order_acquire);
+		const uint64_t begin =
+			written > trace_buffer_capacity ? written - trace_buffer_capacity : 0;
+		for (uint64_t k = begin; k < written; k++) {
+			const trace_event &e = buffer->events[k % trace_buffer_capacity];
+			out << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name
+				<< "\",\"cat\":\"recorder\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+				<< ",\"ts\":" << e.start_ns / 1000.0 << ",\"dur\":" << e.duration_ns / 1000.0
+				<< '}';
+			first = false;
+		}
+	}
+	out << "\n]}\n";
+	return static_cast<bool>(out);
+}
+
+#define CURIA_TRACE_CONCAT_(a, b) a##b
+#define CURIA_TRACE_CONCAT(a, b) CURIA_TRACE_CONCAT_(a, b)
+/// Trace the enclosing scope under the given name (a string literal).
+#define CURIA_TRACE_SCOPE(name) trace_scope CURIA_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#else
+
+inline bool trace_dump(const std::string &) { return false; }
+
+#define CURIA_TRACE_SCOPE(name)
+
+#endif
+
+#endif
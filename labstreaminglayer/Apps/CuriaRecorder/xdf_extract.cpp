@@ -0,0 +1,80 @@
+#include "xdf_extract.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+double stream_start_time(
+	const xdf_reader &reader, streamid_t streamid, const clock_mapping &mapping) {
+	for (const xdf_chunk &chunk : reader.chunks())
+		if (chunk.tag == chunk_tag_t::samples && chunk.streamid == streamid && chunk.n_samples &&
+			!std::isnan(chunk.first_time_stamp))
+			return mapping(chunk.first_time_stamp);
+	return std::numeric_limits<double>::quiet_NaN();
+}
+
+xdf_slice extract_range(const xdf_reader &reader, streamid_t streamid, double from, double to,
+	const clock_mapping &mapping) {
+	xdf_slice slice;
+	slice.streamid = streamid;
+	const xdf_stream *s = reader.stream(streamid);
+	if (!s || s->format == value_format_t::undefined) return slice;
+
+	// the stream's Samples chunks, and those that start with an explicit time stamp (anchors)
+	std::vector<const xdf_chunk *> chunks;
+	std::vector<std::size_t> anchors;
+	std::vector<double> anchor_times; // the anchors' first time stamps, synchronized
+	for (const xdf_chunk &chunk : reader.chunks()) {
+		if (chunk.tag != chunk_tag_t::samples || chunk.streamid != streamid || !chunk.n_samples)
+			continue;
+		if (!std::isnan(chunk.first_time_stamp)) {
+			anchors.push_back(chunks.size());
+			anchor_times.push_back(mapping(chunk.first_time_stamp));
+		}
+		chunks.push_back(&chunk);
+	}
+
+	// decode from the last anchor at or before from (so that omitted time stamps can be deduced)
+	// up to the first anchor after to
+	std::size_t begin = 0, end = chunks.size();
+	if (std::is_sorted(anchor_times.begin(), anchor_times.end())) {
+		const auto first = std::upper_bound(anchor_times.begin(), anchor_times.end(), from);
+		if (first != anchor_times.begin()) begin = anchors[first - anchor_times.begin() - 1];
+		const auto last = std::upper_bound(anchor_times.begin(), anchor_times.end(), to);
+		if (last != anchor_times.end()) end = anchors[last - anchor_times.begin()];
+	}
+
+	const std::size_t n_channels = s->channel_count;
+	const std::size_t sample_bytes = n_channels * s->value_size;
+	const bool strings = s->format == value_format_t::string;
+	const double tdiff = s->nominal_srate > 0 ? 1.0 / s->nominal_srate : 0.0;
+	double last = 0;
+	xdf_samples samples;
+	for (std::size_t k = begin; k < end; k++) {
+		if (!reader.decode_chunk(*chunks[k], samples)) {
+			slice.warnings.push_back("Damaged samples chunk at offset " +
+									 std::to_string(chunks[k]->offset) + " dropped");
+			continue;
+		}
+		slice.decoded_chunks++;
+		slice.decoded_bytes += chunks[k]->content_length;
+		for (std::size_t i = 0; i < samples.time_stamps.size(); i++) {
+			double &ts = samples.time_stamps[i];
+			if (std::isnan(ts)) ts = last + tdiff;
+			last = ts;
+			const double synced = mapping(ts);
+			if (synced < from || synced > to) continue;
+			slice.samples.time_stamps.push_back(ts);
+			slice.time_stamps.push_back(synced);
+			if (strings) {
+				const auto first = samples.strings.begin() + i * n_channels;
+				slice.samples.strings.insert(slice.samples.strings.end(),
+					std::make_move_iterator(first), std::make_move_iterator(first + n_channels));
+			} else {
+				const auto first = samples.values.begin() + i * sample_bytes;
+				slice.samples.values.insert(
+					slice.samples.values.end(), first, first + sample_bytes);
+			}
+		}
+	}
+	return slice;
+}
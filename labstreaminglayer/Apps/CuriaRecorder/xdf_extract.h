@@ -0,0 +1,50 @@
+#ifndef XDF_EXTRACT_H
+#define XDF_EXTRACT_H
+
+/**
+ * Extraction of a time range of a stream without decoding the rest of the stream: the Samples
+ * chunks that can hold samples of the range are found by a binary search over the time stamps of
+ * their first samples (read by the reader's index, see xdf_chunk::first_time_stamp), and only
+ * those chunks are decoded, so the cost grows with the length of the range, not of the file.
+ * Time ranges refer to synchronized time stamps, i.e. the recorded time stamps mapped by the
+ * stream's clock_mapping (pass an empty mapping for the recorded time stamps).
+ */
+
+#include "xdf_reader.h"
+#include "xdf_sync.h"
+#include <string>
+#include <vector>
+
+/// The samples of a stream within a time range.
+struct xdf_slice {
+	streamid_t streamid = 0;
+	xdf_samples samples;			 // the samples, with the recorded (or deduced) time stamps
+	std::vector<double> time_stamps; // the synchronized time stamps of the samples
+	std::size_t decoded_chunks = 0;	 // number of Samples chunks that were decoded
+	uint64_t decoded_bytes = 0;		 // number of sample data bytes that were decoded
+	std::vector<std::string> warnings; // damaged chunks that were dropped
+
+	/// The number of samples in the range.
+	std::size_t sample_count() const { return time_stamps.size(); }
+};
+
+/**
+ * @brief stream_start_time The synchronized time stamp of the first sample of a stream (the
+ * first one that was recorded with an explicit time stamp), without decoding.
+ * @return The time stamp (NaN if the stream has no such sample).
+ */
+double stream_start_time(
+	const xdf_reader &reader, streamid_t streamid, const clock_mapping &mapping);
+
+/**
+ * @brief extract_range Decode the samples of a stream whose synchronized time stamps are in
+ * [from, to].
+ * Omitted time stamps are deduced as by xdf_reader::decode(), starting from the last chunk at or
+ * before the range that begins with an explicit time stamp. If the chunks' first time stamps do
+ * not increase through the file, all chunks of the stream are decoded.
+ * @param mapping The clock mapping of the stream (see fit_clock()).
+ */
+xdf_slice extract_range(const xdf_reader &reader, streamid_t streamid, double from, double to,
+	const clock_mapping &mapping);
+
+#endif
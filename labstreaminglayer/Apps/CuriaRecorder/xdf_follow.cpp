@@ -0,0 +1,269 @@
+#include "xdf_follow.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/// The most bytes that are read (and parsed) at a time, so that starting to follow a large file
+/// does not read all of it into memory.
+const uint64_t max_read_size = 64 << 20;
+/// The longest chunk that is accepted; a longer length field is taken to be damaged (instead of
+/// buffering ever more of the file while waiting for the chunk to be complete).
+const uint64_t max_chunk_length = 256 << 20;
+
+xdf_follower::xdf_follower(const std::string &filename, bool following)
+	: file_(filename, std::ios::binary), filename_(filename), following_(following) {
+	if (!file_) throw std::runtime_error("Could not open " + filename);
+#ifdef __linux__
+	inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_ >= 0 &&
+		inotify_add_watch(inotify_, filename.c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+		close(inotify_);
+		inotify_ = -1;
+	}
+#endif
+}
+
+xdf_follower::~xdf_follower() {
+#ifdef __linux__
+	if (inotify_ >= 0) close(inotify_);
+#endif
+}
+
+uint64_t xdf_follower::file_size() {
+	file_.clear();
+	file_.seekg(0, std::ios::end);
+	const std::streamoff end = file_.tellg();
+	return end < 0 ? size_ : static_cast<uint64_t>(end);
+}
+
+uint64_t xdf_follower::update(const block_callback &on_block, const chunk_callback &on_chunk) {
+	const uint64_t size = file_size(), start = size_;
+	while (size_ < size) {
+		// read the appended bytes behind what is left of the last read (a partial chunk)
+		const uint64_t n = std::min(size - size_, max_read_size);
+		const std::size_t kept = buffer_.size();
+		buffer_.resize(kept + n);
+		file_.seekg(static_cast<std::streamoff>(size_));
+		file_.read(buffer_.data() + kept, static_cast<std::streamsize>(n));
+		const auto got = static_cast<uint64_t>(std::max<std::streamsize>(file_.gcount(), 0));
+		buffer_.resize(kept + got);
+		size_ += got;
+		if (!got) break;
+		// [MagicCode]
+		if (parsed_ == 0) {
+			if (buffer_.size() < 4) continue;
+			if (std::memcmp(buffer_.data(), "XDF:", 4) != 0)
+				throw std::runtime_error("Not a valid XDF file: " + filename_);
+			buffer_.erase(buffer_.begin(), buffer_.begin() + 4);
+			parsed_ = 4;
+		}
+		parse(static_cast<bool>(on_block), on_chunk, size);
+		for (auto &block : pending_) {
+			xdf_samples &samples = block.second;
+			if (samples.time_stamps.empty()) continue;
+			on_block(streams_[stream_index_.at(block.first)], samples);
+			samples.time_stamps.clear();
+			samples.values.clear();
+			samples.strings.clear();
+		}
+	}
+	// a complete file that ends in the middle of a chunk has lost its end
+	if (!following_ && size_ >= size && !buffer_.empty() && parsed_) {
+		if (!resync_)
+			warnings_.push_back("Incomplete chunk at offset " + std::to_string(parsed_) + " (" +
+								std::to_string(buffer_.size()) +
+								" bytes) at the end of the file dropped");
+		parsed_ += buffer_.size();
+		buffer_.clear();
+	}
+	return size_ - start;
+}
+
+void xdf_follower::parse(bool decode, const chunk_callback &on_chunk, uint64_t file_size) {
+	const char *begin = buffer_.data(), *end = begin + buffer_.size(), *p = begin;
+	auto skip = [&](const std::string &problem) {
+		warnings_.push_back(problem + " at offset " +
+							std::to_string(parsed_ + static_cast<uint64_t>(p - begin)) +
+							", skipped to the next boundary chunk");
+		resync_ = true;
+		p++;
+	};
+	while (p < end) {
+		if (resync_) {
+			const auto *uuid = reinterpret_cast<const char *>(boundary_uuid);
+			const char *next = std::search(p, end, uuid, uuid + sizeof(boundary_uuid));
+			if (next == end) {
+				// keep the bytes that can be the start of a signature
+				p = std::max(p, end - (sizeof(boundary_uuid) - 1));
+				break;
+			}
+			p = next + sizeof(boundary_uuid);
+			resync_ = false;
+			continue;
+		}
+		// [NumLengthBytes], [Length], [Tag]; anything short of the whole chunk has not been
+		// written yet (or, if the file is complete, is reported once the end has been read)
+		const auto nbytes = static_cast<uint8_t>(*p);
+		if (nbytes != 1 && nbytes != 4 && nbytes != 8) {
+			skip("Invalid chunk");
+			continue;
+		}
+		const auto available = static_cast<uint64_t>(end - p);
+		if (available < 1u + nbytes + sizeof(chunk_tag_t)) break;
+		uint64_t length = 0;
+		std::memcpy(&length, p + 1, nbytes);
+		if (length < sizeof(chunk_tag_t)) {
+			skip("Invalid chunk");
+			continue;
+		}
+		if (length > max_chunk_length ||
+			(!following_ && parsed_ + static_cast<uint64_t>(p - begin) + 1 + nbytes + length >
+								file_size)) {
+			skip("Invalid chunk length");
+			continue;
+		}
+		if (length > available - 1 - nbytes) break;
+		const char *content = p + 1 + nbytes;
+		xdf_chunk chunk{};
+		chunk.offset = parsed_ + static_cast<uint64_t>(p - begin);
+		uint16_t tag;
+		std::memcpy(&tag, content, sizeof(tag));
+		chunk.tag = static_cast<chunk_tag_t>(tag);
+		content += sizeof(chunk_tag_t);
+		chunk.content_length = length - sizeof(chunk_tag_t);
+		// [StreamId]
+		if (chunk.tag == chunk_tag_t::streamheader || chunk.tag == chunk_tag_t::samples ||
+			chunk.tag == chunk_tag_t::clockoffset || chunk.tag == chunk_tag_t::streamfooter) {
+			if (chunk.content_length < sizeof(streamid_t)) {
+				skip("Chunk without stream id");
+				continue;
+			}
+			std::memcpy(&chunk.streamid, content, sizeof(streamid_t));
+			content += sizeof(streamid_t);
+			chunk.content_length -= sizeof(streamid_t);
+		}
+		chunk.content_offset = parsed_ + static_cast<uint64_t>(content - begin);
+		if (on_chunk) on_chunk(chunk, content);
+		read_chunk(chunk, content, decode);
+		p = content + chunk.content_length;
+	}
+	const auto consumed = static_cast<std::size_t>(p - begin);
+	parsed_ += consumed;
+	buffer_.erase(buffer_.begin(), buffer_.begin() + consumed);
+}
+
+void xdf_follower::read_chunk(const xdf_chunk &chunk, const char *content, bool decode) {
+	const streamid_t streamid = chunk.streamid;
+	const uint64_t length = chunk.content_length, offset = chunk.offset;
+	const auto index = stream_index_.find(streamid);
+	xdf_stream *s = index == stream_index_.end() ? nullptr : &streams_[index->second];
+	switch (chunk.tag) {
+	case chunk_tag_t::fileheader: file_header_.assign(content, length); break;
+	case chunk_tag_t::streamheader: {
+		if (s) {
+			warnings_.push_back("Duplicate header of stream " + std::to_string(streamid) +
+								" at offset " + std::to_string(offset) + " ignored");
+			break;
+		}
+		xdf_stream stream{};
+		stream.id = streamid;
+		stream.header.assign(content, length);
+		std::string error;
+		if (!parse_stream_header(stream, error))
+			warnings_.push_back("Stream header of stream " + std::to_string(streamid) +
+								" could not be parsed (" + error + ")");
+		if (stream.format == value_format_t::undefined)
+			warnings_.push_back("Stream " + std::to_string(streamid) +
+								" has an unsupported channel format '" + stream.channel_format +
+								"', its samples will be skipped");
+		stream_index_[streamid] = streams_.size();
+		streams_.push_back(std::move(stream));
+		last_timestamp_[streamid] = 0;
+		break;
+	}
+	case chunk_tag_t::samples: {
+		if (!s) {
+			warnings_.push_back("Samples chunk of unknown stream " + std::to_string(streamid) +
+								" at offset " + std::to_string(offset) + " skipped");
+			break;
+		}
+		if (!decode || s->format == value_format_t::undefined) break;
+		if (!decode_samples_content(content, length, *s, chunk_samples_)) {
+			warnings_.push_back(
+				"Damaged samples chunk at offset " + std::to_string(offset) + " dropped");
+			break;
+		}
+		// deduce the omitted time stamps as xdf_reader::decode() does
+		const double tdiff = s->nominal_srate > 0 ? 1.0 / s->nominal_srate : 0.0;
+		double &last = last_timestamp_[streamid];
+		for (double &ts : chunk_samples_.time_stamps) {
+			if (std::isnan(ts)) ts = last + tdiff;
+			last = ts;
+		}
+		xdf_samples &block = pending_[streamid];
+		block.time_stamps.insert(block.time_stamps.end(), chunk_samples_.time_stamps.begin(),
+			chunk_samples_.time_stamps.end());
+		block.values.insert(
+			block.values.end(), chunk_samples_.values.begin(), chunk_samples_.values.end());
+		block.strings.insert(block.strings.end(),
+			std::make_move_iterator(chunk_samples_.strings.begin()),
+			std::make_move_iterator(chunk_samples_.strings.end()));
+		break;
+	}
+	case chunk_tag_t::clockoffset:
+		if (!s || length < 2 * sizeof(double)) {
+			warnings_.push_back(
+				"Invalid clock offset chunk at offset " + std::to_string(offset) + " skipped");
+			break;
+		}
+		// [CollectionTime], [OffsetValue]
+		double values[2];
+		std::memcpy(values, content, sizeof(values));
+		s->clock_times.push_back(values[0]);
+		s->clock_values.push_back(values[1]);
+		break;
+	case chunk_tag_t::streamfooter:
+		if (s)
+			s->footer.assign(content, length);
+		else
+			warnings_.push_back("Footer of unknown stream " + std::to_string(streamid) +
+								" at offset " + std::to_string(offset) + " skipped");
+		break;
+	default: break; // Boundary chunks and unknown chunks carry nothing to follow
+	}
+}
+
+bool xdf_follower::wait(double timeout) {
+	if (file_size() > size_) return true;
+#ifdef __linux__
+	if (inotify_ >= 0) {
+		pollfd fd{inotify_, POLLIN, 0};
+		if (poll(&fd, 1, static_cast<int>(std::ceil(timeout * 1000))) <= 0) return false;
+		// drain the events
+		char events[4096];
+		while (read(inotify_, events, sizeof(events)) > 0) {}
+		return true;
+	}
+#endif
+	// poll the file size
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+	while (file_size() <= size_) {
+		if (std::chrono::steady_clock::now() >= deadline) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+	return true;
+}
+
+bool xdf_follower::finished() const {
+	return !streams_.empty() && std::all_of(streams_.begin(), streams_.end(),
+									[](const xdf_stream &s) { return !s.footer.empty(); });
+}
@@ -0,0 +1,101 @@
+#ifndef XDF_FOLLOW_H
+#define XDF_FOLLOW_H
+
+/**
+ * Incremental reading of an XDF file that is still being written, e.g. by a running recording
+ * (a live view of the data without opening more inlets on the devices):
+ * every update() reads only the bytes that were appended since the previous one, parses the
+ * chunks that are complete and keeps a partially written last chunk until the rest of it
+ * arrives. The new samples are delivered per stream through a callback.
+ * A file that is complete can be scanned the same way (without following); then a chunk that
+ * extends beyond the end of the file is damage rather than a chunk still being written.
+ */
+
+#include "xdf_reader.h"
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+class xdf_follower {
+public:
+	/// Receives the new samples of a stream (with the omitted time stamps deduced).
+	using block_callback =
+		std::function<void(const xdf_stream &stream, const xdf_samples &samples)>;
+
+	/**
+	 * @brief xdf_follower Open a file for following; nothing is read before the first update().
+	 * @param following Whether the file may still be written to. If not, chunks that extend beyond
+	 * the end of the file are skipped as damaged, and a partial chunk at the end is reported.
+	 * @throws std::runtime_error If the file cannot be opened.
+	 */
+	explicit xdf_follower(const std::string &filename, bool following = true);
+
+	~xdf_follower();
+
+	xdf_follower(const xdf_follower &) = delete;
+	xdf_follower &operator=(const xdf_follower &) = delete;
+
+	/// Receives every complete chunk with its content (n_samples and first_sample are not set).
+	using chunk_callback = std::function<void(const xdf_chunk &chunk, const char *content)>;
+
+	/**
+	 * @brief update Parse the chunks that were appended since the last update and deliver their
+	 * samples, one block per stream with new samples.
+	 * @param on_block Receives the samples (if empty, Samples chunks are not decoded).
+	 * @param on_chunk Receives every chunk before it is handled (optional; e.g. for scanning a
+	 * file sequentially with bounded memory).
+	 * @return The number of new bytes that were read.
+	 * @throws std::runtime_error If the file turns out not to be an XDF file.
+	 */
+	uint64_t update(const block_callback &on_block, const chunk_callback &on_chunk = nullptr);
+
+	/**
+	 * @brief wait Wait until the file has been written to (notified by inotify on Linux, polled
+	 * elsewhere) or the timeout expires.
+	 * @return false if the timeout expired.
+	 */
+	bool wait(double timeout);
+
+	/// Whether all streams have their footers, i.e. the recording has been stopped.
+	bool finished() const;
+
+	/// The FileHeader XML (empty until it has been read).
+	const std::string &file_header() const { return file_header_; }
+	/// The streams whose headers have been read (without sample arrays).
+	const std::vector<xdf_stream> &streams() const { return streams_; }
+	/// Problems found while reading (damaged chunks that were skipped etc.).
+	const std::vector<std::string> &warnings() const { return warnings_; }
+	/// The number of bytes that have been read.
+	uint64_t size() const { return size_; }
+
+private:
+	/// parse the complete chunks at the start of buffer_ and drop them from it (file_size: the
+	/// size of the file when it was last read)
+	void parse(bool decode, const chunk_callback &on_chunk, uint64_t file_size);
+	/// handle a complete chunk
+	void read_chunk(const xdf_chunk &chunk, const char *content, bool decode);
+	/// the file size, as far as it has been written
+	uint64_t file_size();
+
+	std::ifstream file_;		// the file
+	std::string filename_;		// its name
+	bool following_;			// whether the file may still grow
+	uint64_t size_ = 0;			// number of bytes read
+	uint64_t parsed_ = 0;		// number of bytes parsed (the file offset of buffer_[0])
+	std::vector<char> buffer_;	// bytes read but not parsed yet
+	bool resync_ = false;		// whether to skip to the next Boundary chunk
+#ifdef __linux__
+	int inotify_ = -1; // inotify instance watching the file (-1: polling)
+#endif
+	std::string file_header_;						 // the FileHeader XML
+	std::vector<xdf_stream> streams_;				 // all streams, in order of appearance
+	std::map<streamid_t, std::size_t> stream_index_; // stream id -> index in streams_
+	std::map<streamid_t, xdf_samples> pending_;		 // undelivered samples per stream
+	xdf_samples chunk_samples_;						 // the samples of the current chunk
+	std::map<streamid_t, double> last_timestamp_;	 // for deducing omitted time stamps
+	std::vector<std::string> warnings_;				 // problems found while reading
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef XDF_FORMAT_H
+#define XDF_FORMAT_H
+
+// Definitions of the XDF container format shared by the writer and the reader
+// (kept free of liblsl so that the reader can be used on its own).
+
+#include <cstdint>
+
+using streamid_t = uint32_t;
+
+// the currently defined chunk tags
+enum class chunk_tag_t : uint16_t {
+	fileheader = 1,   // FileHeader chunk
+	streamheader = 2, // StreamHeader chunk
+	samples = 3,	  // Samples chunk
+	clockoffset = 4,  // ClockOffset chunk
+	boundary = 5,	 // Boundary chunk
+	streamfooter = 6, // StreamFooter chunk
+	undefined = 0
+};
+
+// The signature of the boundary chunk (next chunk begins right after this).
+const uint8_t boundary_uuid[] = {0x43, 0xA5, 0x46, 0xDC, 0xCB, 0xF5, 0x41, 0x0F, 0xB3, 0x0E, 0xD5,
+	0x46, 0x73, 0x83, 0xCB, 0xE4};
+
+#endif
@@ -0,0 +1,261 @@
+/**
+ * CPython extension module _xdf, a thin binding of xdf_reader that xdf.py's load_xdf() uses when
+ * it is importable (build with LABRECORDER_PYTHON=On and put the module next to xdf.py).
+ *
+ * read_xdf(filename, threads=0, ...) maps, indexes and decodes the file without holding the GIL
+ * and returns a dict with the file header, the streams, the samples chunks and the reader
+ * warnings. With synchronize_clocks and/or dejitter_timestamps (and the load_xdf() keyword
+ * arguments that tune them), the time stamps are post-processed natively (see xdf_sync.h) and
+ * every stream gets its effective_srate.
+ * Time stamps, clock offsets and numeric sample values are returned as buffer objects (PEP 3118)
+ * that view the decoder's arrays, so numpy.asarray() wraps them without copying; every buffer
+ * keeps the decoded file alive. Only string samples become Python objects.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "xdf_reader.h"
+#include "xdf_sync.h"
+#include <memory>
+
+/// A (writable, C-contiguous) view of a decoded array.
+struct decoded_buffer {
+	PyObject_HEAD
+	PyObject *owner;	   // the capsule that owns the xdf_reader
+	char *data;			   // the first element
+	int ndim;			   // 1 or 2
+	Py_ssize_t shape[2];   // number of elements per dimension
+	Py_ssize_t strides[2]; // bytes per step in each dimension
+	Py_ssize_t itemsize;   // bytes per element
+	const char *format;	   // struct module format of an element
+};
+
+static int decoded_buffer_get(PyObject *self, Py_buffer *view, int flags) {
+	auto *buffer = reinterpret_cast<decoded_buffer *>(self);
+	static char empty[8]; // a valid address for zero-sized buffers
+	view->buf = buffer->data ? buffer->data : empty;
+	view->obj = self;
+	Py_INCREF(self);
+	view->len = buffer->itemsize;
+	for (int d = 0; d < buffer->ndim; d++) view->len *= buffer->shape[d];
+	view->readonly = 0;
+	view->itemsize = buffer->itemsize;
+	view->format = (flags & PyBUF_FORMAT) ? const_cast<char *>(buffer->format) : nullptr;
+	view->ndim = buffer->ndim;
+	view->shape = (flags & PyBUF_ND) ? buffer->shape : nullptr;
+	view->strides = (flags & PyBUF_STRIDES) ? buffer->strides : nullptr;
+	view->suboffsets = nullptr;
+	view->internal = nullptr;
+	return 0;
+}
+
+static void decoded_buffer_dealloc(PyObject *self) {
+	Py_XDECREF(reinterpret_cast<decoded_buffer *>(self)->owner);
+	Py_TYPE(self)->tp_free(self);
+}
+
+static PyBufferProcs decoded_buffer_procs = {decoded_buffer_get, nullptr};
+
+static PyTypeObject decoded_buffer_type = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+/// Wrap a decoded array (the new buffer holds a reference to owner).
+static PyObject *new_buffer(PyObject *owner, const void *data, const char *format,
+	Py_ssize_t itemsize, Py_ssize_t rows, Py_ssize_t columns = -1) {
+	auto *buffer = PyObject_New(decoded_buffer, &decoded_buffer_type);
+	if (!buffer) return nullptr;
+	Py_INCREF(owner);
+	buffer->owner = owner;
+	buffer->data = static_cast<char *>(const_cast<void *>(data));
+	buffer->ndim = columns < 0 ? 1 : 2;
+	buffer->shape[0] = rows;
+	buffer->shape[1] = columns;
+	buffer->strides[0] = columns < 0 ? itemsize : columns * itemsize;
+	buffer->strides[1] = itemsize;
+	buffer->itemsize = itemsize;
+	buffer->format = format;
+	return reinterpret_cast<PyObject *>(buffer);
+}
+
+static PyObject *new_string(const std::string &s) {
+	return PyUnicode_DecodeUTF8(s.data(), static_cast<Py_ssize_t>(s.size()), "replace");
+}
+
+/// Set a dict item, taking over the value reference; false if anything failed.
+static bool set_item(PyObject *dict, const char *key, PyObject *value) {
+	if (!value) return false;
+	const int result = PyDict_SetItemString(dict, key, value);
+	Py_DECREF(value);
+	return result == 0;
+}
+
+static const char *struct_format(value_format_t format) {
+	switch (format) {
+	case value_format_t::int8: return "b";
+	case value_format_t::int16: return "h";
+	case value_format_t::int32: return "i";
+	case value_format_t::int64: return "q";
+	case value_format_t::float32: return "f";
+	case value_format_t::double64: return "d";
+	default: return "B";
+	}
+}
+
+/// The string samples of a stream as a list (samples) of lists (channels) of str.
+static PyObject *string_samples(const xdf_stream &s) {
+	PyObject *samples = PyList_New(static_cast<Py_ssize_t>(s.sample_count()));
+	if (!samples) return nullptr;
+	for (std::size_t k = 0; k < s.sample_count(); k++) {
+		PyObject *sample = PyList_New(s.channel_count);
+		if (!sample) {
+			Py_DECREF(samples);
+			return nullptr;
+		}
+		PyList_SET_ITEM(samples, k, sample);
+		for (uint32_t c = 0; c < s.channel_count; c++) {
+			PyObject *value = new_string(s.strings[k * s.channel_count + c]);
+			if (!value) {
+				Py_DECREF(samples);
+				return nullptr;
+			}
+			PyList_SET_ITEM(sample, c, value);
+		}
+	}
+	return samples;
+}
+
+static PyObject *stream_dict(PyObject *owner, const xdf_stream &s, const sync_result *synced) {
+	PyObject *dict = PyDict_New();
+	if (!dict) return nullptr;
+	const auto n = static_cast<Py_ssize_t>(s.sample_count());
+	const auto n_offsets = static_cast<Py_ssize_t>(s.clock_times.size());
+	const char *keys[] = {"stream_id", "header", "footer", "time_series", "time_stamps",
+		"clock_times", "clock_values"};
+	PyObject *values[] = {PyLong_FromUnsignedLong(s.id), new_string(s.header),
+		s.footer.empty() ? (Py_INCREF(Py_None), Py_None) : new_string(s.footer),
+		s.format == value_format_t::string
+			? string_samples(s)
+			: new_buffer(owner, s.values.data(), struct_format(s.format),
+				  static_cast<Py_ssize_t>(s.value_size), n, s.channel_count),
+		new_buffer(owner, s.time_stamps.data(), "d", sizeof(double), n),
+		new_buffer(owner, s.clock_times.data(), "d", sizeof(double), n_offsets),
+		new_buffer(owner, s.clock_values.data(), "d", sizeof(double), n_offsets)};
+	bool ok = true;
+	for (std::size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+		ok = ok && values[k] && PyDict_SetItemString(dict, keys[k], values[k]) == 0;
+		Py_XDECREF(values[k]);
+	}
+	if (ok && synced)
+		ok = set_item(dict, "effective_srate", PyFloat_FromDouble(synced->effective_srate));
+	if (!ok) {
+		Py_DECREF(dict);
+		return nullptr;
+	}
+	return dict;
+}
+
+static void destroy_reader(PyObject *capsule) {
+	delete static_cast<xdf_reader *>(PyCapsule_GetPointer(capsule, "xdf_reader"));
+}
+
+static PyObject *read_xdf(PyObject *, PyObject *args, PyObject *kwargs) {
+	const char *filename;
+	unsigned int threads = 0;
+	int synchronize_clocks = 0, dejitter_timestamps = 0, handle_clock_resets = 1;
+	sync_options opts;
+	static const char *keywords[] = {"filename", "threads", "synchronize_clocks",
+		"dejitter_timestamps", "handle_clock_resets", "clock_reset_threshold_stds",
+		"clock_reset_threshold_seconds", "clock_reset_threshold_offset_stds",
+		"clock_reset_threshold_offset_seconds", "winsor_threshold", "robust_fit_iterations",
+		"jitter_break_threshold_seconds", "jitter_break_threshold_samples", nullptr};
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|I$pppdddddidd",
+			const_cast<char **>(keywords), &filename, &threads, &synchronize_clocks,
+			&dejitter_timestamps, &handle_clock_resets, &opts.clock_reset_threshold_stds,
+			&opts.clock_reset_threshold_seconds, &opts.clock_reset_threshold_offset_stds,
+			&opts.clock_reset_threshold_offset_seconds, &opts.winsor_threshold,
+			&opts.robust_fit_iterations, &opts.jitter_break_threshold_seconds,
+			&opts.jitter_break_threshold_samples))
+		return nullptr;
+	opts.handle_clock_resets = handle_clock_resets != 0;
+	const bool sync = synchronize_clocks || dejitter_timestamps;
+
+	xdf_reader *reader = nullptr;
+	std::vector<sync_result> synced;
+	std::string error;
+	Py_BEGIN_ALLOW_THREADS
+	try {
+		std::unique_ptr<xdf_reader> decoded(new xdf_reader(filename));
+		decoded->decode(threads);
+		if (sync)
+			synced = synchronize_streams(
+				*decoded, synchronize_clocks != 0, dejitter_timestamps != 0, opts, threads);
+		reader = decoded.release();
+	} catch (std::exception &e) { error = e.what(); }
+	Py_END_ALLOW_THREADS
+	if (!reader) {
+		PyErr_SetString(PyExc_IOError, error.c_str());
+		return nullptr;
+	}
+	PyObject *owner = PyCapsule_New(reader, "xdf_reader", destroy_reader);
+	if (!owner) {
+		delete reader;
+		return nullptr;
+	}
+
+	PyObject *result = PyDict_New(), *streams = PyList_New(0), *chunks = PyList_New(0),
+			 *warnings = PyList_New(0);
+	bool ok = result && streams && chunks && warnings;
+	for (std::size_t k = 0; ok && k < reader->streams().size(); k++) {
+		PyObject *stream = stream_dict(owner, reader->streams()[k], sync ? &synced[k] : nullptr);
+		ok = stream && PyList_Append(streams, stream) == 0;
+		Py_XDECREF(stream);
+	}
+	for (const xdf_chunk &chunk : reader->chunks()) {
+		if (!ok) break;
+		if (chunk.tag != chunk_tag_t::samples || !chunk.n_samples) continue;
+		PyObject *entry = Py_BuildValue("(kKK)", static_cast<unsigned long>(chunk.streamid),
+			static_cast<unsigned long long>(chunk.first_sample),
+			static_cast<unsigned long long>(chunk.n_samples));
+		ok = entry && PyList_Append(chunks, entry) == 0;
+		Py_XDECREF(entry);
+	}
+	for (const std::string &warning : reader->warnings()) {
+		if (!ok) break;
+		PyObject *entry = new_string(warning);
+		ok = entry && PyList_Append(warnings, entry) == 0;
+		Py_XDECREF(entry);
+	}
+	ok = ok && set_item(result, "fileheader", new_string(reader->file_header())) &&
+		 PyDict_SetItemString(result, "streams", streams) == 0 &&
+		 PyDict_SetItemString(result, "chunks", chunks) == 0 &&
+		 PyDict_SetItemString(result, "warnings", warnings) == 0;
+	Py_DECREF(owner); // the buffers keep the reader alive from here on
+	Py_XDECREF(streams);
+	Py_XDECREF(chunks);
+	Py_XDECREF(warnings);
+	if (!ok) {
+		Py_XDECREF(result);
+		return nullptr;
+	}
+	return result;
+}
+
+static PyMethodDef xdf_methods[] = {
+	{"read_xdf", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(read_xdf)),
+		METH_VARARGS | METH_KEYWORDS,
+		"read_xdf(filename, threads=0, *, synchronize_clocks=False, dejitter_timestamps=False, "
+		"...) -> dict\n\nRead and decode all streams of an XDF file."},
+	{nullptr, nullptr, 0, nullptr}};
+
+static PyModuleDef xdf_module = {
+	PyModuleDef_HEAD_INIT, "_xdf", "Native XDF reader.", -1, xdf_methods};
+
+PyMODINIT_FUNC PyInit__xdf() {
+	decoded_buffer_type.tp_name = "_xdf.DecodedBuffer";
+	decoded_buffer_type.tp_basicsize = sizeof(decoded_buffer);
+	decoded_buffer_type.tp_flags = Py_TPFLAGS_DEFAULT;
+	decoded_buffer_type.tp_doc = "A view of an array decoded from an XDF file.";
+	decoded_buffer_type.tp_dealloc = decoded_buffer_dealloc;
+	decoded_buffer_type.tp_as_buffer = &decoded_buffer_procs;
+	if (PyType_Ready(&decoded_buffer_type) < 0) return nullptr;
+	return PyModule_Create(&xdf_module);
+}
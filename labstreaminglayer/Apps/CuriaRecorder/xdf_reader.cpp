@@ -0,0 +1,512 @@
+#include "xdf_reader.h"
+#include "rapidxml.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XDF_READER_SSE2
+#endif
+#ifdef _WIN32
+#include <Windows.h>
+#include <intrin.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef XDF_READER_SSE2
+static unsigned count_trailing_zeros(unsigned mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+/**
+ * The first occurrence of the boundary chunk signature in [p, end) (end if there is none).
+ * With SSE2, 16 candidate positions are tested at a time for the first and the last byte of the
+ * signature, and only the (rare) positions that match both are compared in full.
+ */
+static const char *find_boundary_uuid(const char *p, const char *end) {
+	const auto *uuid = reinterpret_cast<const char *>(boundary_uuid);
+	const std::size_t n = sizeof(boundary_uuid);
+	if (static_cast<std::size_t>(end - p) < n) return end;
+#ifdef XDF_READER_SSE2
+	const __m128i first = _mm_set1_epi8(uuid[0]), last = _mm_set1_epi8(uuid[n - 1]);
+	for (; static_cast<std::size_t>(end - p) >= 16 + n - 1; p += 16) {
+		const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + n - 1));
+		auto mask = static_cast<unsigned>(_mm_movemask_epi8(
+			_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))));
+		for (; mask; mask &= mask - 1) {
+			const char *candidate = p + count_trailing_zeros(mask);
+			if (std::memcmp(candidate + 1, uuid + 1, n - 2) == 0) return candidate;
+		}
+	}
+#endif
+	// the rest (or everything without SSE2)
+	for (const char *stop = end - n + 1; p < stop; p++) {
+		p = static_cast<const char *>(std::memchr(p, uuid[0], static_cast<std::size_t>(stop - p)));
+		if (!p) return end;
+		if (std::memcmp(p, uuid, n) == 0) return p;
+	}
+	return end;
+}
+
+/// Read a variable-length integer ([NumLengthBytes] [Length]); false if it is invalid.
+static bool read_varlen_int(const char *&p, const char *end, uint64_t &value) {
+	if (p >= end) return false;
+	const auto nbytes = static_cast<uint8_t>(*p);
+	if ((nbytes != 1 && nbytes != 4 && nbytes != 8) || end - p < 1 + nbytes) return false;
+	value = 0;
+	std::memcpy(&value, p + 1, nbytes);
+	p += 1 + nbytes;
+	return true;
+}
+
+template <class T> static T read_little_endian(const char *p) {
+	T value;
+	std::memcpy(&value, p, sizeof(T));
+	return value;
+}
+
+static value_format_t parse_value_format(const std::string &format, std::size_t &value_size) {
+	const std::map<std::string, std::pair<value_format_t, std::size_t>> formats = {
+		{"int8", {value_format_t::int8, 1}}, {"int16", {value_format_t::int16, 2}},
+		{"int32", {value_format_t::int32, 4}}, {"int64", {value_format_t::int64, 8}},
+		{"float32", {value_format_t::float32, 4}}, {"double64", {value_format_t::double64, 8}},
+		{"string", {value_format_t::string, 0}}};
+	auto it = formats.find(format);
+	value_size = it == formats.end() ? 0 : it->second.second;
+	return it == formats.end() ? value_format_t::undefined : it->second.first;
+}
+
+/// The text of a child of the header's <info> node (empty if there is no such node).
+static std::string info_value(rapidxml::xml_node<> *info, const char *name) {
+	rapidxml::xml_node<> *node = info ? info->first_node(name) : nullptr;
+	return node ? std::string(node->value(), node->value_size()) : std::string();
+}
+
+bool parse_stream_header(xdf_stream &stream, std::string &error) {
+	// rapidxml parses in place, so give it a terminated copy
+	std::vector<char> xml(stream.header.begin(), stream.header.end());
+	xml.push_back('\0');
+	rapidxml::xml_document<> doc;
+	bool parsed = true;
+	try {
+		doc.parse<0>(xml.data());
+	} catch (rapidxml::parse_error &e) {
+		error = e.what();
+		parsed = false;
+	}
+	rapidxml::xml_node<> *info = doc.first_node("info");
+	stream.name = info_value(info, "name");
+	stream.type = info_value(info, "type");
+	stream.source_id = info_value(info, "source_id");
+	stream.uid = info_value(info, "uid");
+	stream.channel_format = info_value(info, "channel_format");
+	stream.format = parse_value_format(stream.channel_format, stream.value_size);
+	stream.channel_count =
+		static_cast<uint32_t>(std::atoi(info_value(info, "channel_count").c_str()));
+	stream.nominal_srate = std::atof(info_value(info, "nominal_srate").c_str());
+	return parsed;
+}
+
+/// The smallest possible size of a sample: a [TimeStampBytes] byte and one byte per channel.
+static uint64_t min_sample_size(const xdf_stream &stream) {
+	return 1 + static_cast<uint64_t>(stream.channel_count) *
+				   std::max<std::size_t>(stream.value_size, 1);
+}
+
+/// Decode n_samples samples of a Samples chunk at p; false if the data is damaged.
+static bool decode_sample_data(const char *p, const char *end, uint64_t n_samples,
+	const xdf_stream &stream, double *time_stamps, char *values, std::string *strings) {
+	const std::size_t n_channels = stream.channel_count;
+	const std::size_t sample_bytes = n_channels * stream.value_size;
+	for (uint64_t k = 0; k < n_samples; k++) {
+		// [TimeStampBytes], [TimeStamp] (omitted time stamps are deduced later)
+		if (p >= end) return false;
+		const auto ts_bytes = static_cast<uint8_t>(*p++);
+		if (ts_bytes == 8) {
+			if (end - p < 8) return false;
+			time_stamps[k] = read_little_endian<double>(p);
+			p += 8;
+		} else if (ts_bytes == 0)
+			time_stamps[k] = std::numeric_limits<double>::quiet_NaN();
+		else
+			return false;
+		// [Sample]
+		if (stream.format == value_format_t::string) {
+			for (std::size_t c = 0; c < n_channels; c++) {
+				uint64_t len;
+				if (!read_varlen_int(p, end, len) || len > static_cast<uint64_t>(end - p))
+					return false;
+				strings[k * n_channels + c].assign(p, len);
+				p += len;
+			}
+		} else {
+			if (static_cast<std::size_t>(end - p) < sample_bytes) return false;
+			std::memcpy(&values[k * sample_bytes], p, sample_bytes);
+			p += sample_bytes;
+		}
+	}
+	return true;
+}
+
+bool decode_samples_content(
+	const char *content, uint64_t length, const xdf_stream &stream, xdf_samples &samples) {
+	const char *p = content, *end = content + length;
+	uint64_t n_samples;
+	// [NumSampleBytes], [NumSamples]
+	if (stream.format == value_format_t::undefined || !read_varlen_int(p, end, n_samples) ||
+		n_samples > static_cast<uint64_t>(end - p) / min_sample_size(stream))
+		return false;
+	samples.time_stamps.resize(n_samples);
+	if (stream.format == value_format_t::string) {
+		samples.strings.resize(n_samples * stream.channel_count);
+		samples.values.clear();
+	} else {
+		samples.values.resize(n_samples * stream.channel_count * stream.value_size);
+		samples.strings.clear();
+	}
+	return decode_sample_data(p, end, n_samples, stream, samples.time_stamps.data(),
+		samples.values.data(), samples.strings.data());
+}
+
+xdf_reader::xdf_reader(const std::string &filename) {
+#ifdef _WIN32
+	file_handle_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file_handle_ == INVALID_HANDLE_VALUE) {
+		file_handle_ = nullptr;
+		throw std::runtime_error("Could not open " + filename);
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(file_handle_, &size);
+	size_ = static_cast<uint64_t>(size.QuadPart);
+	if (size_) {
+		mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_handle_)
+			data_ = static_cast<const char *>(
+				MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+		if (!data_) {
+			if (mapping_handle_) CloseHandle(mapping_handle_);
+			CloseHandle(file_handle_);
+			throw std::runtime_error("Could not map " + filename);
+		}
+	}
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) throw std::runtime_error("Could not open " + filename);
+	struct stat st;
+	fstat(fd, &st);
+	size_ = static_cast<uint64_t>(st.st_size);
+	if (size_) {
+		void *mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Could not map " + filename);
+		}
+		data_ = static_cast<const char *>(mapped);
+	}
+	close(fd);
+#endif
+	if (size_ < 4 || std::memcmp(data_, "XDF:", 4) != 0) {
+		unmap();
+		throw std::runtime_error("Not a valid XDF file: " + filename);
+	}
+	index();
+}
+
+xdf_reader::~xdf_reader() { unmap(); }
+
+void xdf_reader::unmap() {
+#ifdef _WIN32
+	if (data_) UnmapViewOfFile(data_);
+	if (mapping_handle_) CloseHandle(mapping_handle_);
+	if (file_handle_) CloseHandle(file_handle_);
+	mapping_handle_ = file_handle_ = nullptr;
+#else
+	if (data_) munmap(const_cast<char *>(data_), size_);
+#endif
+	data_ = nullptr;
+}
+
+void xdf_reader::release(uint64_t offset, uint64_t length) const {
+	offset = std::min(offset, size_);
+	length = std::min(length, size_ - offset);
+#ifdef _WIN32
+	// unlocking pages that are not locked removes them from the working set
+	if (length) VirtualUnlock(const_cast<char *>(data_) + offset, length);
+#else
+	// only whole pages within the range
+	const auto page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+	const uint64_t begin = (offset + page - 1) / page * page, end = (offset + length) / page * page;
+	if (begin < end) madvise(const_cast<char *>(data_) + begin, end - begin, MADV_DONTNEED);
+#endif
+}
+
+xdf_stream *xdf_reader::stream(streamid_t streamid) {
+	auto it = stream_index_.find(streamid);
+	return it == stream_index_.end() ? nullptr : &streams_[it->second];
+}
+
+const xdf_stream *xdf_reader::stream(streamid_t streamid) const {
+	auto it = stream_index_.find(streamid);
+	return it == stream_index_.end() ? nullptr : &streams_[it->second];
+}
+
+uint64_t xdf_reader::scan_forward(uint64_t offset) const {
+	const char *end = data_ + size_;
+	const char *match = find_boundary_uuid(data_ + std::min(offset, size_), end);
+	return match == end ? size_ : static_cast<uint64_t>(match - data_) + sizeof(boundary_uuid);
+}
+
+std::vector<uint64_t> xdf_reader::find_boundaries() const {
+	std::vector<uint64_t> offsets;
+	const char *end = data_ + size_;
+	for (const char *p = data_; (p = find_boundary_uuid(p, end)) != end; p += sizeof(boundary_uuid))
+		offsets.push_back(static_cast<uint64_t>(p - data_));
+	return offsets;
+}
+
+void xdf_reader::index() {
+	const char *end = data_ + size_;
+	uint64_t offset = 4; // after the [MagicCode]
+	// the pages that have been indexed are dropped as we go, so that indexing a large file does
+	// not keep all of it in memory
+	const uint64_t release_interval = 64 << 20;
+	uint64_t released = 0;
+	while (offset < size_) {
+		if (offset - released >= release_interval) {
+			release(released, offset - released);
+			released = offset;
+		}
+		// [NumLengthBytes], [Length], [Tag]
+		const char *p = data_ + offset;
+		uint64_t length;
+		if (!read_varlen_int(p, end, length) || length < sizeof(chunk_tag_t) ||
+			length > static_cast<uint64_t>(end - p)) {
+			const uint64_t next = scan_forward(offset + 1);
+			warnings_.push_back("Invalid chunk at offset " + std::to_string(offset) +
+								(next < size_ ? ", skipped to the next boundary chunk at offset " +
+													std::to_string(next)
+											  : ", skipped the rest of the file"));
+			offset = next;
+			continue;
+		}
+		xdf_chunk chunk{};
+		chunk.offset = offset;
+		chunk.tag = static_cast<chunk_tag_t>(read_little_endian<uint16_t>(p));
+		p += sizeof(chunk_tag_t);
+		chunk.content_length = length - sizeof(chunk_tag_t);
+		offset = static_cast<uint64_t>(p - data_) + chunk.content_length;
+		// [StreamId]
+		const bool has_streamid = chunk.tag == chunk_tag_t::streamheader ||
+								  chunk.tag == chunk_tag_t::samples ||
+								  chunk.tag == chunk_tag_t::clockoffset ||
+								  chunk.tag == chunk_tag_t::streamfooter;
+		if (has_streamid) {
+			if (chunk.content_length < sizeof(streamid_t)) {
+				warnings_.push_back("Chunk without stream id at offset " +
+									std::to_string(chunk.offset) + " skipped");
+				continue;
+			}
+			chunk.streamid = read_little_endian<streamid_t>(p);
+			p += sizeof(streamid_t);
+			chunk.content_length -= sizeof(streamid_t);
+		}
+		chunk.content_offset = static_cast<uint64_t>(p - data_);
+		read_chunk(chunk);
+	}
+}
+
+void xdf_reader::read_chunk(xdf_chunk &chunk) {
+	const char *content = data_ + chunk.content_offset;
+	const char *end = content + chunk.content_length;
+	switch (chunk.tag) {
+	case chunk_tag_t::fileheader: file_header_.assign(content, end); break;
+	case chunk_tag_t::streamheader: {
+		if (stream_index_.count(chunk.streamid)) {
+			warnings_.push_back("Duplicate header of stream " + std::to_string(chunk.streamid) +
+								" at offset " + std::to_string(chunk.offset) + " ignored");
+			return;
+		}
+		xdf_stream s{};
+		s.id = chunk.streamid;
+		s.header.assign(content, end);
+		std::string error;
+		if (!parse_stream_header(s, error))
+			warnings_.push_back("Stream header of stream " + std::to_string(chunk.streamid) +
+								" could not be parsed (" + error + ")");
+		if (s.format == value_format_t::undefined)
+			warnings_.push_back("Stream " + std::to_string(chunk.streamid) +
+								" has an unsupported channel format '" + s.channel_format +
+								"', its samples will be skipped");
+		stream_index_[s.id] = streams_.size();
+		streams_.push_back(std::move(s));
+		break;
+	}
+	case chunk_tag_t::samples: {
+		xdf_stream *s = stream(chunk.streamid);
+		if (!s || s->format == value_format_t::undefined) {
+			if (!s)
+				warnings_.push_back("Samples chunk of unknown stream " +
+									std::to_string(chunk.streamid) + " at offset " +
+									std::to_string(chunk.offset) + " skipped");
+			return;
+		}
+		// [NumSampleBytes], [NumSamples]
+		const char *p = content;
+		if (!read_varlen_int(p, end, chunk.n_samples) ||
+			chunk.n_samples > static_cast<uint64_t>(end - p) / min_sample_size(*s)) {
+			warnings_.push_back("Damaged samples chunk at offset " + std::to_string(chunk.offset) +
+								" skipped");
+			return;
+		}
+		chunk.first_sample = s->indexed_samples;
+		s->indexed_samples += chunk.n_samples;
+		// the first [TimeStampBytes], [TimeStamp], so that time ranges can be found without
+		// decoding
+		chunk.first_time_stamp = chunk.n_samples && *p == 8 && end - p > 8
+									 ? read_little_endian<double>(p + 1)
+									 : std::numeric_limits<double>::quiet_NaN();
+		break;
+	}
+	case chunk_tag_t::clockoffset: {
+		xdf_stream *s = stream(chunk.streamid);
+		if (!s || chunk.content_length < 2 * sizeof(double)) {
+			warnings_.push_back("Invalid clock offset chunk at offset " +
+								std::to_string(chunk.offset) + " skipped");
+			return;
+		}
+		// [CollectionTime], [OffsetValue]
+		s->clock_times.push_back(read_little_endian<double>(content));
+		s->clock_values.push_back(read_little_endian<double>(content + sizeof(double)));
+		break;
+	}
+	case chunk_tag_t::boundary:
+		if (chunk.content_length != sizeof(boundary_uuid) ||
+			std::memcmp(content, boundary_uuid, sizeof(boundary_uuid)) != 0)
+			warnings_.push_back("Boundary chunk with an invalid signature at offset " +
+								std::to_string(chunk.offset));
+		break;
+	case chunk_tag_t::streamfooter:
+		if (xdf_stream *s = stream(chunk.streamid))
+			s->footer.assign(content, end);
+		else
+			warnings_.push_back("Footer of unknown stream " + std::to_string(chunk.streamid) +
+								" at offset " + std::to_string(chunk.offset) + " skipped");
+		break;
+	default: break; // other chunk types are only indexed
+	}
+	chunks_.push_back(chunk);
+}
+
+bool xdf_reader::decode_samples(const xdf_chunk &chunk, const xdf_stream &stream,
+	double *time_stamps, char *values, std::string *strings) const {
+	const char *p = data_ + chunk.content_offset;
+	const char *end = p + chunk.content_length;
+	uint64_t n_samples;
+	read_varlen_int(p, end, n_samples); // already validated by index()
+	return decode_sample_data(p, end, n_samples, stream, time_stamps, values, strings);
+}
+
+bool xdf_reader::decode_chunk(const xdf_chunk &chunk, xdf_samples &samples) const {
+	const xdf_stream *s = stream(chunk.streamid);
+	if (chunk.tag != chunk_tag_t::samples || !s) return false;
+	return decode_samples_content(data_ + chunk.content_offset, chunk.content_length, *s, samples);
+}
+
+void xdf_reader::decode(unsigned threads) {
+	if (decoded_) return;
+	decoded_ = true;
+	// allocate the per-stream arrays; every samples chunk knows where its samples go
+	for (xdf_stream &s : streams_) {
+		s.time_stamps.assign(s.indexed_samples, 0.0);
+		if (s.format == value_format_t::string)
+			s.strings.assign(s.indexed_samples * s.channel_count, std::string());
+		else
+			s.values.assign(s.indexed_samples * s.channel_count * s.value_size, 0);
+	}
+	std::vector<std::size_t> samples_chunks;
+	for (std::size_t k = 0; k < chunks_.size(); k++)
+		if (chunks_[k].tag == chunk_tag_t::samples) samples_chunks.push_back(k);
+
+	// decode the chunks in parallel, each worker taking the next undecoded chunk
+	std::unique_ptr<std::atomic<bool>[]> valid(new std::atomic<bool>[chunks_.size()]);
+	std::atomic<std::size_t> next{0};
+	auto worker = [&]() {
+		for (std::size_t k; (k = next++) < samples_chunks.size();) {
+			const xdf_chunk &chunk = chunks_[samples_chunks[k]];
+			xdf_stream &s = streams_[stream_index_.at(chunk.streamid)];
+			const uint64_t first = chunk.first_sample;
+			const bool strings = s.format == value_format_t::string;
+			valid[samples_chunks[k]] = decode_samples(chunk, s, s.time_stamps.data() + first,
+				strings ? nullptr : s.values.data() + first * s.channel_count * s.value_size,
+				strings ? s.strings.data() + first * s.channel_count : nullptr);
+		}
+	};
+	if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = static_cast<unsigned>(std::min<std::size_t>(threads, samples_chunks.size()));
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+	worker();
+	for (auto &t : pool) t.join();
+
+	// drop damaged chunks and deduce the omitted time stamps, stream by stream in file order
+	std::vector<uint64_t> kept(streams_.size(), 0);
+	std::vector<double> last_timestamp(streams_.size(), 0.0);
+	for (std::size_t k : samples_chunks) {
+		xdf_chunk &chunk = chunks_[k];
+		const std::size_t index = stream_index_.at(chunk.streamid);
+		xdf_stream &s = streams_[index];
+		if (!valid[k]) {
+			warnings_.push_back("Damaged samples chunk at offset " + std::to_string(chunk.offset) +
+								" dropped");
+			chunk.n_samples = 0;
+			continue;
+		}
+		const uint64_t to = kept[index];
+		if (to != chunk.first_sample) {
+			const std::size_t n_values = chunk.n_samples * s.channel_count;
+			std::copy_n(&s.time_stamps[chunk.first_sample], chunk.n_samples, &s.time_stamps[to]);
+			if (s.format == value_format_t::string)
+				std::move(&s.strings[chunk.first_sample * s.channel_count],
+					&s.strings[chunk.first_sample * s.channel_count] + n_values,
+					&s.strings[to * s.channel_count]);
+			else
+				std::memmove(&s.values[to * s.channel_count * s.value_size],
+					&s.values[chunk.first_sample * s.channel_count * s.value_size],
+					n_values * s.value_size);
+		}
+		const double tdiff = s.nominal_srate > 0 ? 1.0 / s.nominal_srate : 0.0;
+		double &last = last_timestamp[index];
+		for (uint64_t i = to; i < to + chunk.n_samples; i++) {
+			if (std::isnan(s.time_stamps[i])) s.time_stamps[i] = last + tdiff;
+			last = s.time_stamps[i];
+		}
+		chunk.first_sample = to;
+		kept[index] += chunk.n_samples;
+	}
+	for (std::size_t index = 0; index < streams_.size(); index++) {
+		xdf_stream &s = streams_[index];
+		s.time_stamps.resize(kept[index]);
+		if (s.format == value_format_t::string)
+			s.strings.resize(kept[index] * s.channel_count);
+		else
+			s.values.resize(kept[index] * s.channel_count * s.value_size);
+	}
+}
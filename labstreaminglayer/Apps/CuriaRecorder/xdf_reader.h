@@ -0,0 +1,186 @@
+#ifndef XDF_READER_H
+#define XDF_READER_H
+
+#include "xdf_format.h"
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+/// The value format of a stream (the channel_format of its header).
+enum class value_format_t { int8, int16, int32, int64, float32, double64, string, undefined };
+
+/// The location of a chunk in the file.
+struct xdf_chunk {
+	uint64_t offset;		 // file offset of the chunk (its [NumLengthBytes])
+	uint64_t content_offset; // file offset of the content (after the tag and the stream id)
+	uint64_t content_length; // number of content bytes
+	chunk_tag_t tag;		 // the chunk tag (may be a tag that is not defined by chunk_tag_t)
+	streamid_t streamid;	 // the stream id (0 for chunks without one)
+	uint64_t n_samples;		 // number of samples (samples chunks only; 0 if dropped by decode())
+	uint64_t first_sample;	 // index of the chunk's first sample in its stream's arrays
+	double first_time_stamp; // time stamp of the first sample (samples chunks; NaN if omitted)
+};
+
+/// A stream of an XDF file; the sample arrays are filled by xdf_reader::decode().
+struct xdf_stream {
+	streamid_t id;			 // the stream id
+	std::string header;		 // the StreamHeader XML
+	std::string footer;		 // the StreamFooter XML (empty if the recording was cut short)
+	std::string name;		 // info/name
+	std::string type;		 // info/type
+	std::string source_id;	 // info/source_id (empty if the source has none)
+	std::string uid;		 // info/uid
+	std::string channel_format; // info/channel_format
+	value_format_t format;		// the parsed channel format
+	uint32_t channel_count;		// info/channel_count
+	double nominal_srate;		// info/nominal_srate (0 for irregular streams)
+	std::size_t value_size;		// bytes per value (0 for strings)
+	uint64_t indexed_samples;	// number of samples in the indexed samples chunks
+
+	std::vector<double> time_stamps; // one per sample, as recorded (not synchronized)
+	std::vector<char> values;		 // numeric values, [sample][channel], little-endian
+	std::vector<std::string> strings; // string values, [sample][channel]
+	std::vector<double> clock_times;  // collection times of the ClockOffset chunks
+	std::vector<double> clock_values; // offset values of the ClockOffset chunks
+
+	/// The number of decoded samples.
+	std::size_t sample_count() const { return time_stamps.size(); }
+
+	/// The numeric values as an array of the stream's value type.
+	template <class T> const T *values_as() const {
+		return reinterpret_cast<const T *>(values.data());
+	}
+};
+
+/// The samples of a single Samples chunk, decoded by xdf_reader::decode_chunk().
+struct xdf_samples {
+	std::vector<double> time_stamps;  // one per sample (NaN where the writer omitted it)
+	std::vector<char> values;		  // numeric values, [sample][channel], little-endian
+	std::vector<std::string> strings; // string values, [sample][channel]
+
+	/// The numeric values as an array of the stream's value type.
+	template <class T> const T *values_as() const {
+		return reinterpret_cast<const T *>(values.data());
+	}
+};
+
+/**
+ * @brief parse_stream_header Fill in the fields of a stream that come from its header XML
+ * (stream.header): name, type, source id, uid, channel format, channel count and nominal
+ * sampling rate.
+ * @param error Receives the parser's message if the XML is malformed.
+ * @return false if the XML is malformed (the fields are then filled as far as it was parsed).
+ */
+bool parse_stream_header(xdf_stream &stream, std::string &error);
+
+/**
+ * @brief decode_samples_content Decode the content of a Samples chunk (after the stream id).
+ * Omitted time stamps are left to the caller, see xdf_samples::time_stamps.
+ * @param samples Receives the samples (the buffers are reused).
+ * @return false if the content is damaged or the stream's format is not supported.
+ */
+bool decode_samples_content(
+	const char *content, uint64_t length, const xdf_stream &stream, xdf_samples &samples);
+
+/**
+ * A reader for XDF files.
+ * The file is memory-mapped and indexed chunk by chunk on construction; stream headers, footers
+ * and clock offsets are read right away, while the (typically much larger) sample data is only
+ * decoded on request, with the Samples chunks of all streams being decoded in parallel into
+ * contiguous per-stream arrays.
+ * Damaged parts of a file are skipped up to the next Boundary chunk (the same recovery as the
+ * reference importer); what was skipped is reported in warnings().
+ * Numeric values are copied as stored, so the host is assumed to be little-endian with IEC559
+ * floats (as required by the writer without EXOTIC_ARCH_SUPPORT).
+ */
+class xdf_reader {
+public:
+	/**
+	 * @brief xdf_reader Map and index an XDF file.
+	 * @param filename The file to read.
+	 * @throws std::runtime_error If the file cannot be mapped or is not an XDF file.
+	 */
+	explicit xdf_reader(const std::string &filename);
+
+	/// Unmaps the file.
+	~xdf_reader();
+
+	xdf_reader(const xdf_reader &) = delete;
+	xdf_reader &operator=(const xdf_reader &) = delete;
+
+	/**
+	 * @brief decode Decode all Samples chunks into the per-stream sample arrays.
+	 * Time stamps that were omitted by the writer are deduced from the previous time stamp and
+	 * the nominal sampling rate; chunks that turn out to be damaged are dropped with a warning.
+	 * Afterwards, the chunks' first_sample and n_samples refer to the decoded arrays.
+	 * Only the first call has an effect.
+	 * @param threads The number of decoding threads (0 for one per hardware thread).
+	 */
+	void decode(unsigned threads = 0);
+
+	/**
+	 * @brief decode_chunk Decode a single Samples chunk, without touching the stream's arrays
+	 * (for processing a file chunk by chunk with bounded memory; thread-safe).
+	 * Omitted time stamps are left to the caller, see xdf_samples::time_stamps.
+	 * @param chunk A Samples chunk of chunks().
+	 * @param samples Receives the samples (the buffers are reused).
+	 * @return false if the chunk is damaged.
+	 */
+	bool decode_chunk(const xdf_chunk &chunk, xdf_samples &samples) const;
+
+	/// The FileHeader XML.
+	const std::string &file_header() const { return file_header_; }
+	/// All chunks, in file order.
+	const std::vector<xdf_chunk> &chunks() const { return chunks_; }
+	/// All streams, in order of their headers.
+	std::vector<xdf_stream> &streams() { return streams_; }
+	const std::vector<xdf_stream> &streams() const { return streams_; }
+	/// The stream with the given id (nullptr if there is none).
+	xdf_stream *stream(streamid_t streamid);
+	const xdf_stream *stream(streamid_t streamid) const;
+	/// Problems found while reading (damaged chunks that were skipped etc.).
+	const std::vector<std::string> &warnings() const { return warnings_; }
+	/// The mapped file contents.
+	const char *data() const { return data_; }
+	/// The file size, in bytes.
+	uint64_t size() const { return size_; }
+
+	/// The file offsets of all occurrences of the Boundary chunk signature, in file order.
+	std::vector<uint64_t> find_boundaries() const;
+
+	/**
+	 * @brief release Drop the mapped pages of a processed part of the file from memory (they are
+	 * read again if the range is accessed later).
+	 */
+	void release(uint64_t offset, uint64_t length) const;
+
+private:
+	/// release the file mapping
+	void unmap();
+	/// read the chunk structure of the file
+	void index();
+	/// read a chunk's content that is not sample data
+	void read_chunk(xdf_chunk &chunk);
+	/// decode the samples of a chunk into the given arrays; false if the chunk is damaged
+	bool decode_samples(const xdf_chunk &chunk, const xdf_stream &stream, double *time_stamps,
+		char *values, std::string *strings) const;
+	/// the offset of the first chunk after the next Boundary chunk (size_ if there is none)
+	uint64_t scan_forward(uint64_t offset) const;
+
+	const char *data_ = nullptr; // the mapped file
+	uint64_t size_ = 0;			 // the file size
+#ifdef _WIN32
+	void *file_handle_ = nullptr;	 // the file
+	void *mapping_handle_ = nullptr; // the file mapping
+#endif
+	std::string file_header_;						 // the FileHeader XML
+	std::vector<xdf_chunk> chunks_;					 // all chunks, in file order
+	std::vector<xdf_stream> streams_;				 // all streams, in order of appearance
+	std::map<streamid_t, std::size_t> stream_index_; // stream id -> index in streams_
+	std::vector<std::string> warnings_;				 // problems found while reading
+	bool decoded_ = false;							 // whether decode() has been called
+};
+
+#endif
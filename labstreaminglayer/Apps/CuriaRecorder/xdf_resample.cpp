@@ -0,0 +1,211 @@
+#include "xdf_resample.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XDF_RESAMPLE_SSE2
+#endif
+
+/// The values of a numeric stream as doubles, [sample][channel].
+template <class T> static void convert_values(const xdf_stream &s, std::vector<double> &out) {
+	const T *values = s.values_as<T>();
+	out.assign(values, values + s.sample_count() * s.channel_count);
+}
+
+static bool to_double(const xdf_stream &s, std::vector<double> &out) {
+	switch (s.format) {
+	case value_format_t::int8: convert_values<int8_t>(s, out); return true;
+	case value_format_t::int16: convert_values<int16_t>(s, out); return true;
+	case value_format_t::int32: convert_values<int32_t>(s, out); return true;
+	case value_format_t::int64: convert_values<int64_t>(s, out); return true;
+	case value_format_t::float32: convert_values<float>(s, out); return true;
+	case value_format_t::double64: convert_values<double>(s, out); return true;
+	default: return false;
+	}
+}
+
+/**
+ * The polyphase table of a windowed-sinc kernel: row p holds the weights of the samples
+ * j - taps / 2 + 1 ... j + taps / 2 for a time at the fraction p / phases between sample j and
+ * sample j + 1; the rows are normalized to a sum of 1.
+ * @param cutoff The cutoff frequency as a fraction of the Nyquist frequency of the samples.
+ */
+static std::vector<double> sinc_table(
+	double cutoff, unsigned zero_crossings, unsigned phases, std::size_t &taps) {
+	const double pi = 3.14159265358979323846;
+	const double width = zero_crossings / cutoff; // half the kernel support, in samples
+	const auto half = static_cast<std::size_t>(std::ceil(width));
+	taps = 2 * half;
+	std::vector<double> table((phases + 1) * taps);
+	for (unsigned p = 0; p <= phases; p++) {
+		double *row = &table[p * taps], sum = 0;
+		for (std::size_t k = 0; k < taps; k++) {
+			// the distance of the time from the sample
+			const double u = static_cast<double>(p) / phases -
+							 (static_cast<double>(k) - static_cast<double>(half) + 1);
+			if (std::abs(u) >= width) continue;
+			const double x = pi * cutoff * u;
+			const double sinc = x == 0 ? 1 : std::sin(x) / x;
+			const double window = 0.42 + 0.5 * std::cos(pi * u / width) +
+								  0.08 * std::cos(2 * pi * u / width);
+			row[k] = sinc * window;
+			sum += row[k];
+		}
+		for (std::size_t k = 0; k < taps; k++) row[k] /= sum;
+	}
+	return table;
+}
+
+/// y[c] = x0[c] + frac * (x1[c] - x0[c]) for all channels.
+static void interpolate_linear(
+	double *y, const double *x0, const double *x1, double frac, std::size_t channels) {
+	std::size_t c = 0;
+#ifdef XDF_RESAMPLE_SSE2
+	const __m128d f = _mm_set1_pd(frac);
+	for (; c + 2 <= channels; c += 2) {
+		const __m128d a = _mm_loadu_pd(x0 + c), b = _mm_loadu_pd(x1 + c);
+		_mm_storeu_pd(y + c, _mm_add_pd(a, _mm_mul_pd(f, _mm_sub_pd(b, a))));
+	}
+#endif
+	for (; c < channels; c++) y[c] = x0[c] + frac * (x1[c] - x0[c]);
+}
+
+/**
+ * y[c] = the sum of w[k] * rows[k][c] over the taps, for all channels. With SSE2, four channels
+ * are summed at a time in registers (the sums are taken in the same order as in the scalar loop,
+ * so both give the same results).
+ */
+static void interpolate_taps(double *y, const double *const *rows, const double *w,
+	std::size_t taps, std::size_t channels) {
+	std::size_t c = 0;
+#ifdef XDF_RESAMPLE_SSE2
+	for (; c + 4 <= channels; c += 4) {
+		__m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+		for (std::size_t k = 0; k < taps; k++) {
+			const __m128d wk = _mm_set1_pd(w[k]);
+			sum0 = _mm_add_pd(sum0, _mm_mul_pd(wk, _mm_loadu_pd(rows[k] + c)));
+			sum1 = _mm_add_pd(sum1, _mm_mul_pd(wk, _mm_loadu_pd(rows[k] + c + 2)));
+		}
+		_mm_storeu_pd(y + c, sum0);
+		_mm_storeu_pd(y + c + 2, sum1);
+	}
+	for (; c + 2 <= channels; c += 2) {
+		__m128d sum = _mm_setzero_pd();
+		for (std::size_t k = 0; k < taps; k++)
+			sum = _mm_add_pd(sum, _mm_mul_pd(_mm_set1_pd(w[k]), _mm_loadu_pd(rows[k] + c)));
+		_mm_storeu_pd(y + c, sum);
+	}
+#endif
+	for (; c < channels; c++) {
+		double sum = 0;
+		for (std::size_t k = 0; k < taps; k++) sum += w[k] * rows[k][c];
+		y[c] = sum;
+	}
+}
+
+/// Interpolate a regularly sampled stream at the grid times.
+static void interpolate(const xdf_stream &s, const std::vector<double> &x,
+	const resampled_grid &grid, const resample_options &opts, resampled_stream &out) {
+	const std::size_t channels = s.channel_count, n = s.sample_count();
+	const std::vector<double> &ts = s.time_stamps;
+	out.values.assign(grid.length * channels, std::numeric_limits<double>::quiet_NaN());
+
+	std::size_t taps = 0, half = 0;
+	std::vector<double> table;
+	if (opts.method == interpolation_t::sinc) {
+		const double cutoff = std::min(1.0, grid.srate / s.nominal_srate);
+		table = sinc_table(cutoff, opts.sinc_zero_crossings, opts.sinc_phases, taps);
+		half = taps / 2;
+	}
+	std::vector<const double *> rows(taps); // the samples under the sinc kernel
+	const double max_gap = opts.max_gap / s.nominal_srate;
+
+	// the segments between gaps, [a, b]
+	for (std::size_t a = 0, b; a < n; a = b + 1) {
+		for (b = a; b + 1 < n && ts[b + 1] > ts[b] && ts[b + 1] - ts[b] <= max_gap; b++) {}
+		if (b == a) continue;
+		const double first = std::ceil((ts[a] - grid.start) * grid.srate);
+		const double last = std::floor((ts[b] - grid.start) * grid.srate);
+		if (last < 0 || first >= static_cast<double>(grid.length)) continue;
+		const auto i_first = static_cast<std::size_t>(std::max(first, 0.0));
+		const auto i_last = std::min(static_cast<std::size_t>(last), grid.length - 1);
+		std::size_t j = a;
+		for (std::size_t i = i_first; i <= i_last; i++) {
+			const double t = grid.time(i);
+			while (j + 1 < b && ts[j + 1] <= t) j++;
+			const double frac = std::min(1.0, std::max(0.0, (t - ts[j]) / (ts[j + 1] - ts[j])));
+			double *y = &out.values[i * channels];
+			const double *x0 = &x[j * channels];
+			if (opts.method == interpolation_t::linear) {
+				interpolate_linear(y, x0, x0 + channels, frac, channels);
+				continue;
+			}
+			const auto phase = static_cast<std::size_t>(frac * opts.sinc_phases + 0.5);
+			for (std::size_t k = 0; k < taps; k++) {
+				// the samples beyond the segment's ends are its edge samples
+				const auto offset = static_cast<std::ptrdiff_t>(j + k) -
+									static_cast<std::ptrdiff_t>(half - 1);
+				const auto index = static_cast<std::size_t>(std::min<std::ptrdiff_t>(
+					std::max<std::ptrdiff_t>(offset, static_cast<std::ptrdiff_t>(a)),
+					static_cast<std::ptrdiff_t>(b)));
+				rows[k] = &x[index * channels];
+			}
+			interpolate_taps(y, rows.data(), &table[phase * taps], taps, channels);
+		}
+	}
+}
+
+resampled_grid resample_streams(const xdf_reader &reader, const resample_options &opts) {
+	if (!(opts.srate > 0))
+		throw std::invalid_argument("The sampling rate of the grid must be positive");
+	const std::vector<xdf_stream> &streams = reader.streams();
+	resampled_grid grid;
+	grid.srate = opts.srate;
+	grid.start = opts.start;
+	double end = opts.end;
+	for (const xdf_stream &s : streams) {
+		if (s.time_stamps.empty()) continue;
+		const auto range = std::minmax_element(s.time_stamps.begin(), s.time_stamps.end());
+		if (std::isnan(opts.start))
+			grid.start = std::isnan(grid.start) ? *range.first : std::min(grid.start, *range.first);
+		if (std::isnan(opts.end))
+			end = std::isnan(end) ? *range.second : std::max(end, *range.second);
+	}
+	if (!std::isnan(grid.start) && end >= grid.start)
+		grid.length = static_cast<std::size_t>(std::floor((end - grid.start) * grid.srate)) + 1;
+	else if (std::isnan(grid.start))
+		grid.start = 0;
+
+	grid.streams.resize(streams.size());
+	std::atomic<std::size_t> next{0};
+	auto worker = [&]() {
+		std::vector<double> values;
+		for (std::size_t k; (k = next++) < streams.size();) {
+			const xdf_stream &s = streams[k];
+			resampled_stream &out = grid.streams[k];
+			out.streamid = s.id;
+			out.channel_count = s.channel_count;
+			out.marker = !(s.nominal_srate > 0) || !to_double(s, values);
+			if (!out.marker) {
+				interpolate(s, values, grid, opts, out);
+				continue;
+			}
+			for (std::size_t i = 0; i < s.sample_count(); i++) {
+				const double index = std::round((s.time_stamps[i] - grid.start) * grid.srate);
+				if (index < 0 || index >= static_cast<double>(grid.length)) continue;
+				out.grid_index.push_back(static_cast<std::size_t>(index));
+				out.sample_index.push_back(i);
+			}
+		}
+	};
+	unsigned threads = opts.threads;
+	if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = static_cast<unsigned>(std::min<std::size_t>(threads, streams.size()));
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+	worker();
+	for (auto &t : pool) t.join();
+	return grid;
+}
@@ -0,0 +1,74 @@
+#ifndef XDF_RESAMPLE_H
+#define XDF_RESAMPLE_H
+
+/**
+ * Resampling of decoded streams onto a common time grid (e.g. for training models on all
+ * streams of a recording at once): the samples of regularly sampled streams are interpolated at
+ * the grid times, those of irregular streams (markers) are assigned to the nearest grid point.
+ * The time stamps are taken as they are, so the streams should have been synchronized before
+ * (see synchronize_streams()) to put them on one clock.
+ *
+ * Two interpolations are offered:
+ * - linear: between the two samples around a grid time;
+ * - sinc: a windowed-sinc (Blackman window) band-limited interpolation, with the cutoff at the
+ *   lower of the two Nyquist frequencies so that downsampling does not alias. The kernel is
+ *   tabulated for sinc_phases fractional positions between two samples (a polyphase filter
+ *   bank), so a grid point costs one multiply-add per tap and channel.
+ * Both work on all channels of a sample at once, with SSE2 two channels per instruction (other
+ * targets get plain loops over the channels and leave any vectorization to the compiler); the
+ * streams are resampled in parallel.
+ * The streams are split at gaps (see resample_options::max_gap) and at time stamps that do not
+ * increase; the sinc kernel does not reach across such breaks (the edge samples are repeated),
+ * and grid points in a gap or outside of a stream are NaN.
+ */
+
+#include "xdf_reader.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/// The interpolation of regularly sampled streams.
+enum class interpolation_t { linear, sinc };
+
+/// The parameters of resample_streams().
+struct resample_options {
+	double srate = 0; // the grid's sampling rate
+	/// The first and the last grid time (NaN: the first and the last time stamp of all streams).
+	double start = std::numeric_limits<double>::quiet_NaN();
+	double end = std::numeric_limits<double>::quiet_NaN();
+	interpolation_t method = interpolation_t::linear;
+	unsigned sinc_zero_crossings = 16; // zero crossings of the sinc kernel on either side
+	unsigned sinc_phases = 256;		   // number of tabulated kernel phases
+	double max_gap = 2;	  // the longest interval between two samples that is interpolated
+						  // across, in nominal sample periods
+	unsigned threads = 0; // number of threads (0 for one per hardware thread)
+};
+
+/// A stream on the grid.
+struct resampled_stream {
+	streamid_t streamid = 0;
+	bool marker = false;		   // irregular (or string) stream: samples assigned to grid points
+	std::size_t channel_count = 0; // number of channels
+	std::vector<double> values;	   // regular streams: the values, [grid point][channel]
+	std::vector<std::size_t> grid_index;   // markers: the grid point of each sample on the grid
+	std::vector<std::size_t> sample_index; // markers: the index of each sample in the stream
+};
+
+/// The common time grid and the streams on it.
+struct resampled_grid {
+	double start = 0;		// the time of the first grid point
+	double srate = 0;		// the grid's sampling rate
+	std::size_t length = 0; // the number of grid points
+	std::vector<resampled_stream> streams; // in the order of xdf_reader::streams()
+
+	/// The time of a grid point.
+	double time(std::size_t i) const { return start + static_cast<double>(i) / srate; }
+};
+
+/**
+ * @brief resample_streams Resample all decoded streams of a reader onto a common grid.
+ * @throws std::invalid_argument If the grid's sampling rate is not positive.
+ */
+resampled_grid resample_streams(const xdf_reader &reader, const resample_options &opts);
+
+#endif
@@ -0,0 +1,404 @@
+#include "xdf_sort.h"
+#include "xdf_follow.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+/// A data chunk in a run.
+struct run_record {
+	double time;	 // Samples: the first time stamp (NaN if omitted); ClockOffset: the local time
+	uint64_t offset; // file offset of the chunk
+	uint64_t length; // number of bytes of the chunk
+	uint32_t tag;	 // the chunk tag
+	uint32_t input;	 // the input file of the chunk
+};
+
+/// A run of the Samples or the ClockOffset chunks of a stream, in input and file order: written
+/// during the scan, read back record by record during the merge. The file is removed with the run.
+struct run_t {
+	std::string filename;
+	std::fstream file;
+	std::vector<run_record> buffer; // records not yet written / read but not merged yet
+	std::size_t next = 0;			// the next record to merge in buffer
+	const clock_mapping *mapping;	// the stream's clock mapping
+	double time = -HUGE_VAL;		// the merge time of the current record
+
+	explicit run_t(const std::string &name) : filename(name) {
+		file.open(filename, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+		if (!file) throw std::runtime_error("Could not create " + filename);
+	}
+	~run_t() {
+		file.close();
+		std::remove(filename.c_str());
+	}
+	/// Append a record.
+	void push(const run_record &record) {
+		buffer.push_back(record);
+		if (buffer.size() == 4096) flush();
+	}
+	/// Write the buffered records.
+	void flush() {
+		file.write(reinterpret_cast<const char *>(buffer.data()),
+			static_cast<std::streamsize>(buffer.size() * sizeof(run_record)));
+		buffer.clear();
+	}
+	/// Read the next record into current(); false at the end of the run.
+	bool advance() {
+		if (++next < buffer.size()) return true;
+		buffer.resize(4096);
+		file.read(reinterpret_cast<char *>(buffer.data()),
+			static_cast<std::streamsize>(buffer.size() * sizeof(run_record)));
+		buffer.resize(static_cast<std::size_t>(file.gcount()) / sizeof(run_record));
+		next = 0;
+		return !buffer.empty();
+	}
+	const run_record &current() const { return buffer[next]; }
+};
+
+/// The location of a chunk that is copied as a whole.
+struct chunk_location {
+	uint32_t input;			 // the input file
+	uint64_t offset, length; // file offset and number of bytes of the chunk
+};
+
+/// A stream of the output: the streams of all inputs with the same uid or source id.
+struct merged_stream {
+	streamid_t id;						 // the stream id in the output
+	value_format_t format;				 // the value format of the stream
+	uint32_t channel_count;				 // the channel count of the stream
+	chunk_location header;				 // the header (of the first input with the stream)
+	std::vector<chunk_location> footers; // the footers in all inputs
+	std::size_t inputs = 0;				 // number of inputs with the stream
+	std::vector<double> clock_times;	 // collection times of the ClockOffset chunks of all inputs
+	std::vector<double> clock_values;	 // offset values of the ClockOffset chunks of all inputs
+	clock_mapping mapping;				 // the clock mapping of the merge times
+	uint64_t sample_count = 0;			 // number of samples in all inputs
+	double first_timestamp = HUGE_VAL;	 // the first time stamp in all inputs
+	double last_timestamp = -HUGE_VAL;	 // the last time stamp in all inputs
+	std::unique_ptr<run_t> samples;		 // the run of the Samples chunks
+	std::unique_ptr<run_t> offsets;		 // the run of the ClockOffset chunks
+};
+
+/// The inputs, each open while it has data chunks left to copy.
+class input_files {
+public:
+	explicit input_files(const std::vector<std::string> &names)
+		: names_(names), files_(names.size()), data_chunks_(names.size(), 0) {}
+
+	/// Count a data chunk that is to be copied from an input.
+	void add_data_chunk(uint32_t input) { data_chunks_[input]++; }
+
+	/// Copy a chunk to out, with its stream id replaced by *streamid (if not null).
+	void copy(const chunk_location &chunk, std::ofstream &out, const streamid_t *streamid,
+		bool data_chunk = false) {
+		std::unique_ptr<std::ifstream> &in = files_[chunk.input];
+		if (!in) {
+			in.reset(new std::ifstream(names_[chunk.input], std::ios::binary));
+			if (!*in) throw std::runtime_error("Could not open " + names_[chunk.input]);
+		}
+		buffer_.resize(chunk.length);
+		in->seekg(static_cast<std::streamoff>(chunk.offset));
+		in->read(buffer_.data(), static_cast<std::streamsize>(chunk.length));
+		if (!*in)
+			throw std::runtime_error("Could not read the chunk at offset " +
+									 std::to_string(chunk.offset) + " of " + names_[chunk.input]);
+		// [NumLengthBytes], [Length], [Tag], [StreamId]
+		if (streamid)
+			std::memcpy(&buffer_[1 + static_cast<uint8_t>(buffer_[0]) + sizeof(chunk_tag_t)],
+				streamid, sizeof(streamid_t));
+		out.write(buffer_.data(), static_cast<std::streamsize>(chunk.length));
+		if (data_chunk && !--data_chunks_[chunk.input]) in.reset();
+	}
+
+private:
+	const std::vector<std::string> &names_;				// the file names
+	std::vector<std::unique_ptr<std::ifstream>> files_; // the open inputs
+	std::vector<uint64_t> data_chunks_;					// data chunks left to copy per input
+	std::vector<char> buffer_;							// the chunk being copied
+};
+
+/// The footer of a stream that was merged from several inputs, as the recorder writes it.
+static std::string merged_footer(const merged_stream &s) {
+	std::ostringstream footer;
+	footer.precision(16);
+	footer << "<?xml version=\"1.0\"?><info>";
+	if (s.sample_count)
+		footer << "<first_timestamp>" << s.first_timestamp << "</first_timestamp><last_timestamp>"
+			   << s.last_timestamp << "</last_timestamp>";
+	footer << "<sample_count>" << s.sample_count << "</sample_count><clock_offsets>";
+	for (std::size_t k = 0; k < s.clock_times.size(); k++)
+		footer << "<offset><time>" << s.clock_times[k] << "</time><value>" << s.clock_values[k]
+			   << "</value></offset>";
+	footer << "</clock_offsets></info>";
+	return footer.str();
+}
+
+/// Write a StreamFooter chunk: [NumLengthBytes], [Length], [Tag], [StreamId], [Content].
+static void write_footer(std::ofstream &out, streamid_t streamid, const std::string &content) {
+	const uint64_t length = sizeof(chunk_tag_t) + sizeof(streamid_t) + content.size();
+	const auto tag = static_cast<uint16_t>(chunk_tag_t::streamfooter);
+	out.put(8);
+	out.write(reinterpret_cast<const char *>(&length), sizeof(length));
+	out.write(reinterpret_cast<const char *>(&tag), sizeof(tag));
+	out.write(reinterpret_cast<const char *>(&streamid), sizeof(streamid));
+	out << content;
+}
+
+sort_result merge_xdf(const std::vector<std::string> &inputs, const std::string &output,
+	const std::string &index, const sort_options &opts) {
+	sort_result result;
+	std::string temp_dir = opts.temp_dir;
+	std::string basename = output;
+	const std::size_t slash = output.find_last_of("/\\");
+	if (slash != std::string::npos) {
+		basename = output.substr(slash + 1);
+		if (temp_dir.empty()) temp_dir = output.substr(0, slash);
+	}
+	if (temp_dir.empty()) temp_dir = ".";
+	const bool merging = inputs.size() > 1;
+
+	// scan the inputs one after the other: the header and footer chunks are kept, the data
+	// chunks go to their stream's runs
+	input_files files(inputs);
+	std::vector<std::unique_ptr<merged_stream>> streams;
+	// the streams of the previous inputs by uid, and by source_id, name and type
+	std::map<std::string, merged_stream *> by_uid, by_source_id;
+	std::set<streamid_t> used_ids;
+	chunk_location file_header{0, 0, 0};
+	std::vector<chunk_location> others;
+	for (uint32_t input = 0; input < inputs.size(); input++) {
+		xdf_follower scanner(inputs[input], false);
+		std::map<streamid_t, merged_stream *> merged_of; // the input's stream ids
+		// the keys of the input's streams, added to by_uid and by_source_id once it is scanned
+		std::map<std::string, merged_stream *> input_uids, input_source_ids;
+		auto on_chunk = [&](const xdf_chunk &chunk, const char *content) {
+			const chunk_location location{
+				input, chunk.offset, chunk.content_offset + chunk.content_length - chunk.offset};
+			const auto found = merged_of.find(chunk.streamid);
+			merged_stream *s = found == merged_of.end() ? nullptr : found->second;
+			switch (chunk.tag) {
+			case chunk_tag_t::fileheader:
+				if (!file_header.length) file_header = location;
+				break;
+			case chunk_tag_t::streamheader: {
+				if (s) break; // a duplicate, ignored by the scanner as well
+				xdf_stream info{};
+				info.header.assign(content, chunk.content_length);
+				std::string error;
+				parse_stream_header(info, error);
+				// the stream of a previous input with the same uid, or else with the same source
+				// id, name and type (but never one that has a stream of this input already)
+				const std::string source_key =
+					info.source_id.empty() ? std::string()
+										   : info.source_id + '\n' + info.name + '\n' + info.type;
+				auto joinable = [&](const std::map<std::string, merged_stream *> &keys,
+									const std::string &key) -> merged_stream * {
+					const auto found = keys.find(key);
+					if (key.empty() || found == keys.end()) return nullptr;
+					for (const auto &other : merged_of)
+						if (other.second == found->second) return nullptr;
+					return found->second;
+				};
+				s = joinable(by_uid, info.uid);
+				const bool by_source = !s && (s = joinable(by_source_id, source_key));
+				if (s && (s->format != info.format || s->channel_count != info.channel_count)) {
+					result.warnings.push_back(inputs[input] + ": stream " +
+											  std::to_string(chunk.streamid) +
+											  " differs in format from the stream of a previous "
+											  "input with its " +
+											  (by_source ? "source id" : "uid") +
+											  " and is kept separate");
+					s = nullptr;
+				} else if (by_source)
+					result.warnings.push_back(inputs[input] + ": stream " +
+											  std::to_string(chunk.streamid) +
+											  " was merged with a stream of a previous input by "
+											  "its source id, name and type rather than its uid");
+				if (!s) {
+					streams.emplace_back(new merged_stream());
+					s = streams.back().get();
+					// the stream keeps its id unless another one has it already
+					s->id = used_ids.count(chunk.streamid) ? *used_ids.rbegin() + 1
+														   : chunk.streamid;
+					used_ids.insert(s->id);
+					s->format = info.format;
+					s->channel_count = info.channel_count;
+					s->header = location;
+					const std::string run =
+						temp_dir + "/" + basename + ".run" + std::to_string(streams.size());
+					s->samples.reset(new run_t(run + "s"));
+					s->offsets.reset(new run_t(run + "c"));
+				}
+				if (!info.uid.empty()) input_uids[info.uid] = s;
+				if (!source_key.empty()) input_source_ids[source_key] = s;
+				s->inputs++;
+				merged_of[chunk.streamid] = s;
+				break;
+			}
+			case chunk_tag_t::samples:
+			case chunk_tag_t::clockoffset: {
+				if (!s) break; // of an unknown stream, reported by the scanner
+				run_record record{std::numeric_limits<double>::quiet_NaN(), location.offset,
+					location.length, static_cast<uint32_t>(chunk.tag), input};
+				const char *end = content + chunk.content_length;
+				if (chunk.tag == chunk_tag_t::clockoffset) {
+					// [CollectionTime], [OffsetValue]
+					if (chunk.content_length < 2 * sizeof(double)) break;
+					double values[2];
+					std::memcpy(values, content, sizeof(values));
+					s->clock_times.push_back(values[0]);
+					s->clock_values.push_back(values[1]);
+					record.time = values[0] + values[1];
+					s->offsets->push(record);
+				} else {
+					if (chunk.content_length > 1) {
+						// [NumSampleBytes], [NumSamples], then the first [TimeStampBytes],
+						// [TimeStamp]
+						const char *ts = content + 1 + static_cast<uint8_t>(content[0]);
+						if (ts + 9 <= end && *ts == 8)
+							std::memcpy(&record.time, ts + 1, sizeof(double));
+					}
+					s->samples->push(record);
+				}
+				files.add_data_chunk(input);
+				result.data_chunks++;
+				break;
+			}
+			case chunk_tag_t::streamfooter:
+				if (s) s->footers.push_back(location);
+				break;
+			case chunk_tag_t::boundary: break; // new ones are written
+			default: others.push_back(location); break;
+			}
+		};
+		// the footers of streams from several inputs are rewritten from their samples
+		auto on_block = [&](const xdf_stream &stream, const xdf_samples &samples) {
+			merged_stream &s = *merged_of.at(stream.id);
+			s.sample_count += samples.time_stamps.size();
+			s.first_timestamp = std::min(s.first_timestamp, samples.time_stamps.front());
+			s.last_timestamp = std::max(s.last_timestamp, samples.time_stamps.back());
+		};
+		while (scanner.update(merging ? on_block : xdf_follower::block_callback(), on_chunk)) {}
+		std::ifstream input_file(inputs[input], std::ios::binary | std::ios::ate);
+		if (!input_file || scanner.size() != static_cast<uint64_t>(input_file.tellg()))
+			throw std::runtime_error("Could not read all of " + inputs[input]);
+		for (const auto &key : input_uids) by_uid[key.first] = key.second;
+		for (const auto &key : input_source_ids) by_source_id[key.first] = key.second;
+		for (const std::string &warning : scanner.warnings())
+			result.warnings.push_back(merging ? inputs[input] + ": " + warning : warning);
+	}
+	result.streams = streams.size();
+
+	// merge: the next chunk is the earliest current one of all runs
+	std::vector<run_t *> runs;
+	std::vector<streamid_t> run_streamid; // the output stream id of each run
+	for (auto &s : streams) {
+		s->mapping = fit_clock(s->clock_times, s->clock_values, opts.clock);
+		for (run_t *r : {s->samples.get(), s->offsets.get()}) {
+			r->flush();
+			r->file.seekg(0);
+			if (!r->file) throw std::runtime_error("Could not write " + r->filename);
+			r->mapping = &s->mapping;
+			runs.push_back(r);
+			run_streamid.push_back(s->id);
+		}
+	}
+	// chunks without a time stamp of their own stay right behind the previous chunk of their
+	// stream
+	auto merge_time = [](run_t &r) {
+		const run_record &record = r.current();
+		if (!std::isnan(record.time))
+			r.time = record.tag == static_cast<uint32_t>(chunk_tag_t::samples)
+						 ? (*r.mapping)(record.time)
+						 : record.time;
+		return r.time;
+	};
+	using entry_t = std::pair<double, std::size_t>; // merge time, run
+	std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> heap;
+	for (std::size_t k = 0; k < runs.size(); k++) {
+		run_t &r = *runs[k];
+		r.next = static_cast<std::size_t>(-1);
+		if (r.advance()) heap.emplace(merge_time(r), k);
+	}
+
+	std::ofstream out(output, std::ios::binary | std::ios::trunc);
+	std::ofstream index_file;
+	if (!index.empty()) {
+		index_file.open(index, std::ios::binary | std::ios::trunc);
+		index_file.precision(16);
+		index_file << "time,offset\n";
+	}
+	if (!out) throw std::runtime_error("Could not open " + output);
+	out << "XDF:";
+	if (file_header.length)
+		files.copy(file_header, out, nullptr);
+	else {
+		// a replacement for a lost file header (as LSLStreamWriter writes it)
+		result.warnings.push_back("The file header is missing, a default one was written");
+		const std::string header = "<?xml version=\"1.0\"?><info><version>1.0</version></info>";
+		const auto length = static_cast<uint8_t>(header.size() + sizeof(chunk_tag_t));
+		const char tag[] = {static_cast<char>(chunk_tag_t::fileheader), 0};
+		out.put(1);
+		out.put(static_cast<char>(length));
+		out.write(tag, sizeof(tag));
+		out << header;
+	}
+	for (auto &s : streams) files.copy(s->header, out, &s->id);
+
+	// [NumLengthBytes], [Length], [Tag] of a Boundary chunk
+	const char boundary_head[] = {1,
+		static_cast<char>(sizeof(chunk_tag_t) + sizeof(boundary_uuid)),
+		static_cast<char>(chunk_tag_t::boundary), 0};
+	uint64_t since_boundary = opts.boundary_interval;
+	std::pair<uint32_t, uint64_t> last_position{0, 0}; // input, offset of the last data chunk
+	while (!heap.empty()) {
+		const entry_t next = heap.top();
+		heap.pop();
+		run_t &r = *runs[next.second];
+		const run_record &record = r.current();
+		if (since_boundary >= opts.boundary_interval) {
+			if (index_file.is_open()) index_file << next.first << ',' << out.tellp() << '\n';
+			out.write(boundary_head, sizeof(boundary_head));
+			out.write(reinterpret_cast<const char *>(boundary_uuid), sizeof(boundary_uuid));
+			result.index_entries++;
+			since_boundary = 0;
+		}
+		files.copy({record.input, record.offset, record.length}, out, &run_streamid[next.second],
+			true);
+		since_boundary += record.length;
+		const std::pair<uint32_t, uint64_t> position{record.input, record.offset};
+		if (position < last_position) result.reordered_chunks++;
+		last_position = position;
+		if (r.advance()) heap.emplace(merge_time(r), next.second);
+	}
+	for (const chunk_location &other : others) files.copy(other, out, nullptr);
+	for (auto &s : streams) {
+		if (s->inputs > 1)
+			write_footer(out, s->id, merged_footer(*s));
+		else
+			for (const chunk_location &footer : s->footers) files.copy(footer, out, &s->id);
+	}
+	result.bytes = static_cast<uint64_t>(out.tellp());
+	out.close();
+	if (!out) throw std::runtime_error("Could not write " + output);
+	if (index_file.is_open()) {
+		index_file.close();
+		if (!index_file) throw std::runtime_error("Could not write " + index);
+	}
+	return result;
+}
+
+sort_result sort_xdf(const std::string &input, const std::string &output,
+	const std::string &index, const sort_options &opts) {
+	return merge_xdf({input}, output, index, opts);
+}
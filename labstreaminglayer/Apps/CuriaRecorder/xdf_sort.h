@@ -0,0 +1,76 @@
+#ifndef XDF_SORT_H
+#define XDF_SORT_H
+
+/**
+ * Rewriting of an XDF file into canonical order: the FileHeader, all StreamHeaders, the Samples
+ * and ClockOffset chunks of all streams interleaved by time, and all StreamFooters. Recordings
+ * are out of this order when streams join late (their headers then follow data of other streams,
+ * see recording::unsorted_).
+ *
+ * The sort is an external k-way merge whose memory use does not grow with the file size:
+ * a sequential scan of the file (see xdf_follower; damaged chunks are skipped to the next
+ * Boundary chunk and reported) writes, for every stream, runs of the times and locations of its
+ * Samples and of its ClockOffset chunks to temporary files; the runs are
+ * merged by time (keeping the order of each run, so that omitted time stamps can still be
+ * deduced) and the chunks are copied to the output in merged order.
+ * Times are on the recording computer's clock: the first time stamp of a Samples chunk is mapped
+ * with the stream's clock offsets (see fit_clock()), and a ClockOffset chunk is placed at its
+ * collection time plus its offset.
+ *
+ * The seek index comes as a by-product: a Boundary chunk is written before the first data chunk
+ * and then every boundary_interval bytes of data, and the index lists each one's offset with the
+ * time of the chunk that follows it.
+ *
+ * Merging several files (rotated or split recordings) is the same merge over the runs of all
+ * inputs: streams of different inputs with the same uid, or else the same source_id, name and
+ * type (which is reported), become one stream of the output (streams of the same input are never
+ * joined), whose runs hold the chunks of all those inputs in input order, and whose
+ * clock offsets are those of all inputs. Streams keep their ids unless an id is taken by another
+ * stream of an earlier input; the stream ids of the copied chunks are rewritten accordingly.
+ */
+
+#include "xdf_sync.h"
+#include <string>
+#include <vector>
+
+/// The parameters of sort_xdf() and merge_xdf().
+struct sort_options {
+	std::string temp_dir;				  // directory for the runs (default: the output's one)
+	uint64_t boundary_interval = 1 << 20; // bytes of data between two Boundary chunks
+	sync_options clock;					  // the clock synchronization of the chunk times
+};
+
+/// What sort_xdf() or merge_xdf() did.
+struct sort_result {
+	std::size_t streams = 0;		   // number of streams
+	uint64_t data_chunks = 0;		   // number of Samples and ClockOffset chunks
+	uint64_t reordered_chunks = 0;	   // number of data chunks written right after one that
+									   // came after them in the input
+	uint64_t bytes = 0;				   // size of the output
+	std::size_t index_entries = 0;	   // number of entries of the seek index
+	std::vector<std::string> warnings; // damaged parts of the input that were skipped etc.
+};
+
+/**
+ * @brief sort_xdf Write an XDF file in canonical order, and its seek index.
+ * @param index The file name of the seek index, a CSV file with a header row "time,offset" and
+ * a row per Boundary chunk of the output (empty: do not write an index).
+ * @throws std::runtime_error If a file cannot be read or written.
+ */
+sort_result sort_xdf(const std::string &input, const std::string &output,
+	const std::string &index, const sort_options &opts);
+
+/**
+ * @brief merge_xdf Merge XDF files into one in canonical order, and write its seek index.
+ * The FileHeader is that of the first input. A stream that occurs in a single input keeps its
+ * StreamHeader and StreamFooter; a stream that occurs in several inputs has the header of the
+ * first one, and a new footer with the sample count and time stamp range of all of them and all
+ * their clock offsets.
+ * @param inputs The files, in order (e.g. in order of recording).
+ * @param index See sort_xdf().
+ * @throws std::runtime_error If a file cannot be read or written.
+ */
+sort_result merge_xdf(const std::vector<std::string> &inputs, const std::string &output,
+	const std::string &index, const sort_options &opts);
+
+#endif
@@ -0,0 +1,223 @@
+#include "xdf_sync.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <utility>
+
+// The kernels below keep four independent accumulators so that the compiler can vectorize the
+// reductions without reassociating floating-point additions.
+const std::size_t lanes = 4;
+
+/// Sum of f(i) for i in [begin, end).
+template <class F> static double lane_sum(std::size_t begin, std::size_t end, F f) {
+	double acc[lanes] = {0, 0, 0, 0};
+	std::size_t i = begin;
+	for (; i + lanes <= end; i += lanes)
+		for (std::size_t l = 0; l < lanes; l++) acc[l] += f(i + l);
+	for (; i < end; i++) acc[0] += f(i);
+	return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+static double median(std::vector<double> values) {
+	const std::size_t n = values.size(), mid = n / 2;
+	std::nth_element(values.begin(), values.begin() + mid, values.end());
+	if (n % 2) return values[mid];
+	const double upper = values[mid];
+	return (*std::max_element(values.begin(), values.begin() + mid) + upper) / 2;
+}
+
+/**
+ * Robust linear regression v = intercept + slope * t with the Huber loss, solved by ADMM (as in
+ * xdf.py's _robust_fit with rho = 1). Residuals are divided by scale, i.e. the Huber threshold is
+ * scale in the units of v.
+ */
+static std::pair<double, double> robust_fit(
+	const double *t, const double *v, std::size_t n, double scale, int iterations) {
+	const double rho = 1, inv = 1 / scale;
+	// A = [1 t] / scale, y = v / scale: A'A and A'y
+	const double a00 = n * inv * inv;
+	const double a01 = lane_sum(0, n, [t](std::size_t i) { return t[i]; }) * inv * inv;
+	const double a11 = lane_sum(0, n, [t](std::size_t i) { return t[i] * t[i]; }) * inv * inv;
+	const double aty0 = lane_sum(0, n, [v](std::size_t i) { return v[i]; }) * inv * inv;
+	const double aty1 = lane_sum(0, n, [t, v](std::size_t i) { return t[i] * v[i]; }) * inv * inv;
+	// Cholesky factor L of A'A
+	const double l00 = std::sqrt(a00), l10 = a01 / l00, l11 = std::sqrt(a11 - l10 * l10);
+
+	std::vector<double> u(n, 0.0);
+	double x0 = 0, x1 = 0, r0 = 0, r1 = 0; // r = A'(z - u)
+	for (int it = 0; it < iterations; it++) {
+		// x = (A'A)^-1 (A'y + A'(z - u)) = L'^-1 L^-1 (...)
+		const double c0 = (aty0 + r0) / l00, c1 = (aty1 + r1 - l10 * c0) / l11;
+		x1 = c1 / l11;
+		x0 = (c0 - l10 * x1) / l00;
+		// d = Ax - y + u; z = Huber proximal step of d; u = d - z; and A'(z - u) for the next step
+		double acc0[lanes] = {0, 0, 0, 0}, acc1[lanes] = {0, 0, 0, 0};
+		auto step = [&](std::size_t i, double &sum0, double &sum1) {
+			const double d = (x0 + x1 * t[i]) * inv - v[i] * inv + u[i];
+			const double shrink = std::max(0.0, 1 - (1 + 1 / rho) / std::abs(d));
+			const double z = rho / (1 + rho) * d + 1 / (1 + rho) * shrink * d;
+			u[i] = d - z;
+			sum0 += z - u[i];
+			sum1 += t[i] * (z - u[i]);
+		};
+		std::size_t i = 0;
+		for (; i + lanes <= n; i += lanes)
+			for (std::size_t l = 0; l < lanes; l++) step(i + l, acc0[l], acc1[l]);
+		for (; i < n; i++) step(i, acc0[0], acc1[0]);
+		r0 = ((acc0[0] + acc0[1]) + (acc0[2] + acc0[3])) * inv;
+		r1 = ((acc1[0] + acc1[1]) + (acc1[2] + acc1[3])) * inv;
+	}
+	return {x0, x1};
+}
+
+double clock_mapping::operator()(double time_stamp) const {
+	if (coef.empty()) return time_stamp;
+	const auto r = std::upper_bound(edges.begin(), edges.end(), time_stamp) - edges.begin();
+	return time_stamp + coef[r].first + coef[r].second * time_stamp;
+}
+
+void clock_mapping::apply(std::vector<double> &time_stamps) const {
+	if (coef.size() == 1) {
+		const double c0 = coef[0].first, c1 = coef[0].second;
+		double *ts = time_stamps.data();
+		for (std::size_t i = 0; i < time_stamps.size(); i++) ts[i] += c0 + c1 * ts[i];
+	} else if (!coef.empty()) {
+		// after a reset, the time stamps from the first measurement of a segment on belong to it
+		for (double &ts : time_stamps) ts = (*this)(ts);
+	}
+}
+
+clock_mapping fit_clock(const std::vector<double> &clock_times,
+	const std::vector<double> &clock_values, const sync_options &opts) {
+	clock_mapping mapping;
+	const std::size_t n = std::min(clock_times.size(), clock_values.size());
+	if (!n) return mapping;
+
+	// Split the offset measurements at clock resets (e.g. a computer restart during the
+	// recording): a reset shows as a glitch both in the timing of successive measurements and in
+	// the successive offset values.
+	std::vector<std::pair<std::size_t, std::size_t>> ranges; // [first, last] measurement
+	std::size_t begin = 0;
+	if (opts.handle_clock_resets && n > 1) {
+		std::vector<double> time_diff(n - 1), value_diff(n - 1);
+		for (std::size_t i = 0; i + 1 < n; i++) {
+			time_diff[i] = clock_times[i + 1] - clock_times[i];
+			value_diff[i] = std::abs(clock_values[i + 1] - clock_values[i]);
+		}
+		const double eps = std::numeric_limits<double>::epsilon();
+		const double median_ival = median(time_diff), median_slope = median(value_diff);
+		std::vector<double> deviation(n - 1);
+		for (std::size_t i = 0; i + 1 < n; i++)
+			deviation[i] = std::abs(time_diff[i] - median_ival);
+		const double time_mad = median(deviation) + eps;
+		for (std::size_t i = 0; i + 1 < n; i++)
+			deviation[i] = std::abs(value_diff[i] - median_slope);
+		const double value_mad = median(deviation) + eps;
+		for (std::size_t i = 0; i + 1 < n; i++) {
+			const double dt = time_diff[i] - median_ival, dv = value_diff[i] - median_slope;
+			const bool time_glitch = time_diff[i] < 0 ||
+									 (dt / time_mad > opts.clock_reset_threshold_stds &&
+										 dt > opts.clock_reset_threshold_seconds);
+			const bool value_glitch = value_diff[i] < 0 ||
+									  (dv / value_mad > opts.clock_reset_threshold_offset_stds &&
+										  dv > opts.clock_reset_threshold_offset_seconds);
+			if (time_glitch && value_glitch) {
+				ranges.emplace_back(begin, i);
+				begin = i + 1;
+			}
+		}
+	}
+	ranges.emplace_back(begin, n - 1);
+
+	// a clock offset mapping for each range
+	for (const auto &range : ranges) {
+		if (range.first != range.second)
+			mapping.coef.push_back(robust_fit(&clock_times[range.first],
+				&clock_values[range.first], range.second - range.first + 1, opts.winsor_threshold,
+				opts.robust_fit_iterations));
+		else
+			mapping.coef.emplace_back(clock_values[range.first], 0.0);
+		if (range.first) mapping.edges.push_back(clock_times[range.first]);
+	}
+	return mapping;
+}
+
+std::size_t synchronize_clock(std::vector<double> &time_stamps,
+	const std::vector<double> &clock_times, const std::vector<double> &clock_values,
+	const sync_options &opts) {
+	const clock_mapping mapping = fit_clock(clock_times, clock_values, opts);
+	mapping.apply(time_stamps);
+	return mapping.segments();
+}
+
+double dejitter(std::vector<double> &time_stamps, double nominal_srate, const sync_options &opts,
+	std::size_t *segments) {
+	if (segments) *segments = 0;
+	const std::size_t n = time_stamps.size();
+	if (!n || nominal_srate <= 0) return 0;
+	double *ts = time_stamps.data();
+
+	// split at breaks in the data
+	const double threshold = std::max(
+		opts.jitter_break_threshold_seconds, opts.jitter_break_threshold_samples / nominal_srate);
+	std::vector<std::pair<std::size_t, std::size_t>> ranges; // [first, last] sample
+	std::size_t begin = 0;
+	for (std::size_t i = 0; i + 1 < n; i++) {
+		if (ts[i + 1] - ts[i] > threshold) {
+			ranges.emplace_back(begin, i);
+			begin = i + 1;
+		}
+	}
+	ranges.emplace_back(begin, n - 1);
+
+	// replace the time stamps of each segment by a least-squares line over the sample index
+	double weighted_srate = 0, total_samples = 0;
+	for (const auto &range : ranges) {
+		const std::size_t first = range.first, last = range.second;
+		if (last <= first) continue;
+		const double count = static_cast<double>(last - first + 1);
+		weighted_srate += count / (ts[last] - ts[first]) * count;
+		total_samples += count;
+		if (segments) (*segments)++;
+		const double index_mean = (first + last) / 2.0;
+		const double ts_mean =
+			lane_sum(first, last + 1, [ts](std::size_t i) { return ts[i]; }) / count;
+		const double sxy = lane_sum(first, last + 1,
+			[=](std::size_t i) { return (i - index_mean) * (ts[i] - ts_mean); });
+		const double sxx = count * (count * count - 1) / 12;
+		const double slope = sxy / sxx, intercept = ts_mean - slope * index_mean;
+		for (std::size_t i = first; i <= last; i++) ts[i] = intercept + slope * i;
+	}
+	return total_samples ? weighted_srate / total_samples : 0;
+}
+
+std::vector<sync_result> synchronize_streams(xdf_reader &reader, bool synchronize_clocks,
+	bool dejitter_timestamps, const sync_options &opts, unsigned threads) {
+	std::vector<xdf_stream> &streams = reader.streams();
+	std::vector<sync_result> results(streams.size());
+	std::atomic<std::size_t> next{0};
+	auto worker = [&]() {
+		for (std::size_t k; (k = next++) < streams.size();) {
+			xdf_stream &s = streams[k];
+			if (s.time_stamps.empty()) continue;
+			if (synchronize_clocks)
+				results[k].clock_segments =
+					synchronize_clock(s.time_stamps, s.clock_times, s.clock_values, opts);
+			if (dejitter_timestamps)
+				results[k].effective_srate =
+					dejitter(s.time_stamps, s.nominal_srate, opts, &results[k].jitter_segments);
+			else
+				results[k].effective_srate =
+					s.time_stamps.size() / (s.time_stamps.back() - s.time_stamps.front());
+		}
+	};
+	if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = static_cast<unsigned>(std::min<std::size_t>(threads, streams.size()));
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+	worker();
+	for (auto &t : pool) t.join();
+	return results;
+}
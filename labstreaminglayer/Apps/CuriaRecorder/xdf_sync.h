@@ -0,0 +1,93 @@
+#ifndef XDF_SYNC_H
+#define XDF_SYNC_H
+
+/**
+ * Offline clock synchronization and jitter removal of decoded XDF streams, with the semantics of
+ * load_xdf() (synchronize_clocks and dejitter_timestamps):
+ * - the ClockOffset measurements of a stream are split at detected clock resets, a robust
+ *   (Huber loss, ADMM) linear fit of offset over time is made for every segment and the time
+ *   stamps of each segment are corrected with it;
+ * - the time stamps of regularly sampled streams are split at breaks and replaced by a linear
+ *   fit over the sample index for every segment.
+ */
+
+#include "xdf_reader.h"
+#include <utility>
+#include <vector>
+
+/// The parameters of the synchronization (the load_xdf() keyword arguments of the same names).
+struct sync_options {
+	bool handle_clock_resets = true;
+	double clock_reset_threshold_stds = 5;
+	double clock_reset_threshold_seconds = 5;
+	double clock_reset_threshold_offset_stds = 10;
+	double clock_reset_threshold_offset_seconds = 1;
+	double winsor_threshold = 0.0001;
+	int robust_fit_iterations = 1000;
+	double jitter_break_threshold_seconds = 1;
+	double jitter_break_threshold_samples = 500;
+};
+
+/// What was done to a stream.
+struct sync_result {
+	std::size_t clock_segments = 0;  // number of clock segments (0: no ClockOffset chunks)
+	std::size_t jitter_segments = 0; // number of dejittered segments
+	double effective_srate = 0;		 // the measured sampling rate (0 for irregular streams)
+};
+
+/// A mapping of a stream's time stamps to the recording computer's clock (see fit_clock()).
+struct clock_mapping {
+	std::vector<double> edges; // the first collection time of every clock segment but the first
+	std::vector<std::pair<double, double>> coef; // intercept and slope of the offset per segment
+
+	/// The number of clock segments (0 for the identity mapping).
+	std::size_t segments() const { return coef.size(); }
+	/// Map a single time stamp.
+	double operator()(double time_stamp) const;
+	/// Map time stamps in place.
+	void apply(std::vector<double> &time_stamps) const;
+};
+
+/**
+ * @brief fit_clock Fit the clock offsets of a stream, one robust linear fit per segment between
+ * detected clock resets.
+ * @param clock_times The collection times of the stream's ClockOffset chunks.
+ * @param clock_values The offset values of the stream's ClockOffset chunks.
+ * @return The mapping (the identity if there are no offsets).
+ */
+clock_mapping fit_clock(const std::vector<double> &clock_times,
+	const std::vector<double> &clock_values, const sync_options &opts);
+
+/**
+ * @brief synchronize_clock Map time stamps to the recording computer's clock.
+ * @param time_stamps The time stamps to correct (in place).
+ * @param clock_times The collection times of the stream's ClockOffset chunks.
+ * @param clock_values The offset values of the stream's ClockOffset chunks.
+ * @return The number of clock segments (0 if there are no offsets, leaving the time stamps as
+ * they are).
+ */
+std::size_t synchronize_clock(std::vector<double> &time_stamps,
+	const std::vector<double> &clock_times, const std::vector<double> &clock_values,
+	const sync_options &opts);
+
+/**
+ * @brief dejitter Replace the time stamps of a regularly sampled stream by a linear fit per
+ * segment between breaks.
+ * @param time_stamps The time stamps to dejitter (in place).
+ * @param nominal_srate The nominal sampling rate (nothing is done for irregular streams).
+ * @param segments Receives the number of dejittered segments (if not null).
+ * @return The effective sampling rate (the sample-weighted mean over the segments).
+ */
+double dejitter(std::vector<double> &time_stamps, double nominal_srate, const sync_options &opts,
+	std::size_t *segments = nullptr);
+
+/**
+ * @brief synchronize_streams Synchronize and/or dejitter all decoded streams, in parallel.
+ * Without dejittering, the effective sampling rate is the sample count over the time span.
+ * @param threads The number of threads (0 for one per hardware thread).
+ * @return The results, in the order of reader.streams().
+ */
+std::vector<sync_result> synchronize_streams(xdf_reader &reader, bool synchronize_clocks,
+	bool dejitter_timestamps, const sync_options &opts, unsigned threads = 0);
+
+#endif
@@ -0,0 +1,1023 @@
+/**
+ * Offline XDF tools.
+ *
+ * Usage: xdftool <command> file.xdf [options]
+ *
+ * Commands:
+ *   sync     Decode the file, synchronize the clocks and dejitter the time stamps of all streams
+ *            (as load_xdf() does) and report the result per stream as JSON.
+ *   convert  Convert the file to the CSV files of a CSV recording (see csv_format.h). The file is
+ *            processed in batches of chunks that are decoded and formatted in parallel, so the
+ *            memory use does not grow with the file size.
+ *   fsck     Check the chunk structure and the content of all Samples chunks and report the
+ *            damaged parts of the file; with --repair, write a clean copy that consists of the
+ *            intact chunks. The exit status is 4 if the file is damaged.
+ *   extract  Extract a time range of some streams (by default in seconds since the start of the
+ *            recording, in synchronized time) to a new XDF file, to CSV files or to binary files
+ *            of fixed-size records. Only the Samples chunks that overlap the range are decoded.
+ *   follow   Follow a file that is being recorded and print a JSON line for every block of new
+ *            samples, until the recording is stopped (or nothing was written for --timeout
+ *            seconds); then print a summary.
+ *   sort     Rewrite the file in canonical order (headers, data interleaved by time, footers)
+ *            with an external merge of bounded memory, and write a seek index (see xdf_sort.h).
+ *   merge    Merge the file with further files (--inputs) into one file in canonical order, with
+ *            the streams of the same device (by uid or source_id) joined into one stream.
+ *   resample Synchronize the streams and resample them onto a common time grid (see
+ *            xdf_resample.h), written as a single CSV file with a row per grid point.
+ */
+#include "conversions.h"
+#include "csv_format.h"
+#include "xdf_extract.h"
+#include "xdf_follow.h"
+#include "xdf_resample.h"
+#include "xdf_sort.h"
+#include "xdf_reader.h"
+#include "xdf_sync.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+/// The options of a command (--name value pairs after the file name).
+using options_t = std::map<std::string, std::string>;
+
+static std::string json_string(const std::string &s) {
+	std::string out = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out += escaped;
+		} else
+			out += c;
+	}
+	return out + "\"";
+}
+
+/// Run f(0) ... f(n - 1) on up to threads threads (0 for one per hardware thread).
+static void parallel_for(
+	std::size_t n, unsigned threads, const std::function<void(std::size_t)> &f) {
+	std::atomic<std::size_t> next{0};
+	auto worker = [&]() {
+		for (std::size_t k; (k = next++) < n;) f(k);
+	};
+	if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = static_cast<unsigned>(std::min<std::size_t>(threads, n));
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+	worker();
+	for (auto &t : pool) t.join();
+}
+
+/// Take an option out of opts (so unknown options can be reported afterwards).
+static std::string take(options_t &opts, const std::string &name, const std::string &fallback) {
+	auto it = opts.find(name);
+	if (it == opts.end()) return fallback;
+	std::string value = it->second;
+	opts.erase(it);
+	return value;
+}
+
+static double take(options_t &opts, const std::string &name, double fallback) {
+	const std::string value = take(opts, name, std::string());
+	return value.empty() ? fallback : std::stod(value);
+}
+
+/// Take the options of the clock synchronization (the sync_options of the same names).
+static sync_options take_clock_options(options_t &opts) {
+	sync_options sync;
+	sync.handle_clock_resets = take(opts, "--handle-clock-resets", "on") != "off";
+	sync.clock_reset_threshold_stds =
+		take(opts, "--clock-reset-threshold-stds", sync.clock_reset_threshold_stds);
+	sync.clock_reset_threshold_seconds =
+		take(opts, "--clock-reset-threshold-seconds", sync.clock_reset_threshold_seconds);
+	sync.clock_reset_threshold_offset_stds =
+		take(opts, "--clock-reset-threshold-offset-stds", sync.clock_reset_threshold_offset_stds);
+	sync.clock_reset_threshold_offset_seconds = take(opts,
+		"--clock-reset-threshold-offset-seconds", sync.clock_reset_threshold_offset_seconds);
+	sync.winsor_threshold = take(opts, "--winsor-threshold", sync.winsor_threshold);
+	sync.robust_fit_iterations = static_cast<int>(
+		take(opts, "--robust-fit-iterations", static_cast<double>(sync.robust_fit_iterations)));
+	return sync;
+}
+
+static int sync_command(const std::string &filename, options_t &opts) {
+	const auto threads = static_cast<unsigned>(take(opts, "--threads", 0.0));
+	const bool clock_sync = take(opts, "--clock-sync", "on") != "off";
+	const bool dejitter_timestamps = take(opts, "--dejitter", "on") != "off";
+	sync_options sync = take_clock_options(opts);
+	sync.jitter_break_threshold_seconds =
+		take(opts, "--jitter-break-threshold-seconds", sync.jitter_break_threshold_seconds);
+	sync.jitter_break_threshold_samples =
+		take(opts, "--jitter-break-threshold-samples", sync.jitter_break_threshold_samples);
+	if (!opts.empty()) {
+		std::cerr << "Unknown option " << opts.begin()->first << std::endl;
+		return 2;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	xdf_reader reader(filename);
+	reader.decode(threads);
+	const auto decoded = std::chrono::steady_clock::now();
+	const auto results =
+		synchronize_streams(reader, clock_sync, dejitter_timestamps, sync, threads);
+	const auto synced = std::chrono::steady_clock::now();
+
+	std::ostringstream out;
+	out.precision(15);
+	out << "{\n  \"file\": " << json_string(filename) << ",\n"
+		<< "  \"decode_seconds\": " << std::chrono::duration<double>(decoded - start).count()
+		<< ",\n"
+		<< "  \"sync_seconds\": " << std::chrono::duration<double>(synced - decoded).count()
+		<< ",\n"
+		<< "  \"streams\": [";
+	for (std::size_t k = 0; k < results.size(); k++) {
+		const xdf_stream &s = reader.streams()[k];
+		out << (k ? "," : "") << "\n    {\"stream_id\": " << s.id
+			<< ", \"name\": " << json_string(s.name) << ", \"samples\": " << s.sample_count()
+			<< ", \"clock_offsets\": " << s.clock_times.size()
+			<< ", \"clock_segments\": " << results[k].clock_segments
+			<< ", \"jitter_segments\": " << results[k].jitter_segments
+			<< ", \"effective_srate\": " << results[k].effective_srate;
+		if (!s.time_stamps.empty())
+			out << ", \"first_timestamp\": " << s.time_stamps.front()
+				<< ", \"last_timestamp\": " << s.time_stamps.back();
+		out << "}";
+	}
+	out << "\n  ],\n  \"warnings\": [";
+	for (std::size_t k = 0; k < reader.warnings().size(); k++)
+		out << (k ? ", " : "") << json_string(reader.warnings()[k]);
+	out << "]\n}";
+	std::cout << out.str() << std::endl;
+	return 0;
+}
+
+/// Append the CSV rows of decoded samples, with the time stamps ts.
+static void format_rows(
+	std::string &out, const xdf_stream &s, const double *ts, const xdf_samples &samples) {
+	const std::size_t n = samples.time_stamps.size(), channels = s.channel_count;
+	switch (s.format) {
+	case value_format_t::int8:
+		append_csv_rows(out, ts, samples.values_as<int8_t>(), n, channels);
+		break;
+	case value_format_t::int16:
+		append_csv_rows(out, ts, samples.values_as<int16_t>(), n, channels);
+		break;
+	case value_format_t::int32:
+		append_csv_rows(out, ts, samples.values_as<int32_t>(), n, channels);
+		break;
+	case value_format_t::int64:
+		append_csv_rows(out, ts, samples.values_as<int64_t>(), n, channels);
+		break;
+	case value_format_t::float32:
+		append_csv_rows(out, ts, samples.values_as<float>(), n, channels);
+		break;
+	case value_format_t::double64:
+		append_csv_rows(out, ts, samples.values_as<double>(), n, channels);
+		break;
+	case value_format_t::string:
+		for (std::size_t i = 0; i < n; i++) {
+			append_csv_value(out, ts[i]);
+			for (std::size_t j = 0; j < channels; j++) {
+				out += ',';
+				append_csv_escaped(out, samples.strings[i * channels + j]);
+			}
+			out += '\n';
+		}
+		break;
+	default: break;
+	}
+}
+
+static int convert_command(const std::string &filename, options_t &opts) {
+	const auto threads = static_cast<unsigned>(take(opts, "--threads", 0.0));
+	std::string output = take(opts, "--output", std::string());
+	const auto batch_bytes = static_cast<uint64_t>(take(opts, "--batch-mb", 16.0) * 1e6);
+	if (!opts.empty()) {
+		std::cerr << "Unknown option " << opts.begin()->first << std::endl;
+		return 2;
+	}
+	if (output.empty()) {
+		const std::size_t dot = filename.rfind(".xdf");
+		output = (dot == std::string::npos ? filename : filename.substr(0, dot)) + ".csv";
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	xdf_reader reader(filename);
+	std::vector<std::string> warnings = reader.warnings();
+
+	// the files of every stream; the meta files are complete right away
+	std::map<streamid_t, std::unique_ptr<std::ofstream>> data_files;
+	std::map<streamid_t, double> last_timestamp;
+	for (const xdf_stream &s : reader.streams()) {
+		std::ofstream meta(csv_stream_filename(output, s.name, ".meta.xml"),
+			std::ios::binary | std::ios::trunc);
+		meta << csv_meta_file_header << s.header << s.footer;
+		const std::string data_filename = csv_stream_filename(output, s.name, ".data.csv");
+		std::unique_ptr<std::ofstream> data(
+			new std::ofstream(data_filename, std::ios::binary | std::ios::trunc));
+		*data << csv_header_row(s.header, static_cast<int>(s.channel_count));
+		if (!meta || !*data) throw std::runtime_error("Could not write " + data_filename);
+		data_files[s.id] = std::move(data);
+		last_timestamp[s.id] = 0;
+	}
+
+	// a batch of Samples chunks in file order, with their samples and rows
+	struct job_t {
+		const xdf_chunk *chunk;
+		xdf_samples samples;
+		std::string rows;
+		bool valid;
+	};
+	std::vector<job_t> jobs;
+	std::size_t n_jobs = 0;
+	uint64_t batch_size = 0, samples_written = 0, processed = 0;
+	auto flush = [&]() {
+		parallel_for(n_jobs, threads, [&](std::size_t k) {
+			jobs[k].valid = reader.decode_chunk(*jobs[k].chunk, jobs[k].samples);
+		});
+		// omitted time stamps follow from the previous ones, stream by stream
+		for (std::size_t k = 0; k < n_jobs; k++) {
+			if (!jobs[k].valid) {
+				warnings.push_back("Damaged samples chunk at offset " +
+								   std::to_string(jobs[k].chunk->offset) + " dropped");
+				continue;
+			}
+			const xdf_stream &s = *reader.stream(jobs[k].chunk->streamid);
+			const double tdiff = s.nominal_srate > 0 ? 1.0 / s.nominal_srate : 0.0;
+			double &last = last_timestamp[s.id];
+			for (double &ts : jobs[k].samples.time_stamps) {
+				if (std::isnan(ts)) ts = last + tdiff;
+				last = ts;
+			}
+		}
+		parallel_for(n_jobs, threads, [&](std::size_t k) {
+			jobs[k].rows.clear();
+			if (jobs[k].valid)
+				format_rows(jobs[k].rows, *reader.stream(jobs[k].chunk->streamid),
+					jobs[k].samples.time_stamps.data(), jobs[k].samples);
+		});
+		for (std::size_t k = 0; k < n_jobs; k++) {
+			if (!jobs[k].valid) continue;
+			data_files.at(jobs[k].chunk->streamid)->write(jobs[k].rows.data(),
+				static_cast<std::streamsize>(jobs[k].rows.size()));
+			samples_written += jobs[k].samples.time_stamps.size();
+		}
+		if (n_jobs) {
+			const xdf_chunk &last = *jobs[n_jobs - 1].chunk;
+			reader.release(processed, last.content_offset + last.content_length - processed);
+			processed = last.content_offset + last.content_length;
+		}
+		n_jobs = 0;
+		batch_size = 0;
+	};
+	for (const xdf_chunk &chunk : reader.chunks()) {
+		if (chunk.tag != chunk_tag_t::samples || !chunk.n_samples) continue;
+		if (n_jobs == jobs.size()) jobs.emplace_back();
+		jobs[n_jobs++].chunk = &chunk;
+		batch_size += chunk.content_length;
+		if (batch_size >= batch_bytes) flush();
+	}
+	flush();
+	for (auto &file : data_files) {
+		file.second->close();
+		if (!*file.second) throw std::runtime_error("Could not write the CSV files of " + output);
+	}
+	const double seconds =
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::ostringstream out;
+	out.precision(6);
+	out << "{\n  \"file\": " << json_string(filename) << ",\n"
+		<< "  \"output\": " << json_string(output) << ",\n"
+		<< "  \"streams\": " << reader.streams().size() << ",\n"
+		<< "  \"samples\": " << samples_written << ",\n"
+		<< "  \"seconds\": " << seconds << ",\n"
+		<< "  \"mb_per_second\": " << reader.size() / seconds / 1e6 << ",\n"
+		<< "  \"warnings\": [";
+	for (std::size_t k = 0; k < warnings.size(); k++)
+		out << (k ? ", " : "") << json_string(warnings[k]);
+	out << "]\n}";
+	std::cout << out.str() << std::endl;
+	return 0;
+}
+
+static int fsck_command(const std::string &filename, options_t &opts) {
+	const auto threads = static_cast<unsigned>(take(opts, "--threads", 0.0));
+	const std::string repaired = take(opts, "--repair", std::string());
+	if (!opts.empty()) {
+		std::cerr << "Unknown option " << opts.begin()->first << std::endl;
+		return 2;
+	}
+
+	// indexing checks the chunk structure (and skips to the next boundary after damage)
+	const auto start = std::chrono::steady_clock::now();
+	xdf_reader reader(filename);
+	const std::vector<uint64_t> signatures = reader.find_boundaries();
+	const std::vector<xdf_chunk> &chunks = reader.chunks();
+	std::vector<std::string> warnings = reader.warnings();
+
+	// the content of the Samples chunks is checked by decoding them
+	std::unique_ptr<std::atomic<bool>[]> valid(new std::atomic<bool>[chunks.size()]);
+	parallel_for(chunks.size(), threads, [&](std::size_t k) {
+		thread_local xdf_samples samples;
+		valid[k] = chunks[k].tag != chunk_tag_t::samples || reader.decode_chunk(chunks[k], samples);
+	});
+
+	// everything that is not covered by an intact chunk is lost
+	std::vector<std::pair<uint64_t, uint64_t>> damaged; // [begin, end) file ranges
+	std::map<chunk_tag_t, uint64_t> tag_counts;
+	uint64_t expected = 4, boundary_chunks = 0;
+	for (std::size_t k = 0; k < chunks.size(); k++) {
+		if (!valid[k]) {
+			warnings.push_back("Damaged samples chunk at offset " +
+							   std::to_string(chunks[k].offset) + " dropped");
+			continue;
+		}
+		if (chunks[k].offset > expected) damaged.emplace_back(expected, chunks[k].offset);
+		expected = chunks[k].content_offset + chunks[k].content_length;
+		tag_counts[chunks[k].tag]++;
+		if (chunks[k].tag == chunk_tag_t::boundary) boundary_chunks++;
+	}
+	if (expected < reader.size()) damaged.emplace_back(expected, reader.size());
+	uint64_t lost_bytes = 0;
+	for (const auto &range : damaged) lost_bytes += range.second - range.first;
+
+	// the repaired file: the intact chunks, copied in runs of adjacent ones
+	uint64_t repaired_bytes = 0;
+	if (!repaired.empty()) {
+		std::ofstream out(repaired, std::ios::binary | std::ios::trunc);
+		out.write(reader.data(), 4); // [MagicCode]
+		std::size_t first = 0;
+		while (first < chunks.size() && !valid[first]) first++;
+		if (first == chunks.size() || chunks[first].tag != chunk_tag_t::fileheader) {
+			// a replacement for a lost file header (as LSLStreamWriter writes it)
+			const std::string header = "<?xml version=\"1.0\"?><info><version>1.0</version></info>";
+			const auto length = static_cast<uint8_t>(header.size() + sizeof(chunk_tag_t));
+			const char tag[] = {static_cast<char>(chunk_tag_t::fileheader), 0};
+			out.put(1);
+			out.put(static_cast<char>(length));
+			out.write(tag, sizeof(tag));
+			out << header;
+		}
+		uint64_t run_begin = 0, run_end = 0;
+		for (std::size_t k = 0; k <= chunks.size(); k++) {
+			if (k < chunks.size() && !valid[k]) continue;
+			if (k == chunks.size() || chunks[k].offset != run_end) {
+				out.write(
+					reader.data() + run_begin, static_cast<std::streamsize>(run_end - run_begin));
+				if (k == chunks.size()) break;
+				run_begin = chunks[k].offset;
+			}
+			run_end = chunks[k].content_offset + chunks[k].content_length;
+		}
+		repaired_bytes = static_cast<uint64_t>(out.tellp());
+		out.close();
+		if (!out) throw std::runtime_error("Could not write " + repaired);
+	}
+	const double seconds =
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const std::map<chunk_tag_t, const char *> tag_names = {
+		{chunk_tag_t::fileheader, "fileheader"}, {chunk_tag_t::streamheader, "streamheader"},
+		{chunk_tag_t::samples, "samples"}, {chunk_tag_t::clockoffset, "clockoffset"},
+		{chunk_tag_t::boundary, "boundary"}, {chunk_tag_t::streamfooter, "streamfooter"}};
+	std::ostringstream out;
+	out.precision(6);
+	out << "{\n  \"file\": " << json_string(filename) << ",\n"
+		<< "  \"file_bytes\": " << reader.size() << ",\n"
+		<< "  \"intact\": " << (damaged.empty() ? "true" : "false") << ",\n"
+		<< "  \"chunks\": {";
+	bool first_tag = true;
+	for (const auto &count : tag_counts) {
+		auto name = tag_names.find(count.first);
+		out << (first_tag ? "" : ", ")
+			<< json_string(name != tag_names.end() ? name->second
+												   : std::to_string(static_cast<int>(count.first)))
+			<< ": " << count.second;
+		first_tag = false;
+	}
+	out << "},\n"
+		<< "  \"streams\": " << reader.streams().size() << ",\n"
+		<< "  \"boundary_signatures\": " << signatures.size() << ",\n"
+		<< "  \"boundary_chunks\": " << boundary_chunks << ",\n"
+		<< "  \"damaged\": [";
+	for (std::size_t k = 0; k < damaged.size(); k++)
+		out << (k ? ", " : "") << "{\"offset\": " << damaged[k].first
+			<< ", \"bytes\": " << damaged[k].second - damaged[k].first << "}";
+	out << "],\n"
+		<< "  \"lost_bytes\": " << lost_bytes << ",\n";
+	if (!repaired.empty())
+		out << "  \"repaired\": " << json_string(repaired) << ",\n"
+			<< "  \"repaired_bytes\": " << repaired_bytes << ",\n";
+	out << "  \"seconds\": " << seconds << ",\n"
+		<< "  \"gb_per_second\": " << reader.size() / seconds / 1e9 << ",\n"
+		<< "  \"warnings\": [";
+	for (std::size_t k = 0; k < warnings.size(); k++)
+		out << (k ? ", " : "") << json_string(warnings[k]);
+	out << "]\n}";
+	std::cout << out.str() << std::endl;
+	return damaged.empty() ? 0 : 4;
+}
+
+/// The streams matching a comma-separated list of stream names, types or ids.
+static std::vector<const xdf_stream *> select_streams(
+	const xdf_reader &reader, const std::string &list) {
+	std::vector<std::string> keys;
+	std::istringstream in(list);
+	for (std::string key; std::getline(in, key, ',');) keys.push_back(key);
+	std::vector<const xdf_stream *> selected;
+	for (const xdf_stream &s : reader.streams())
+		for (const std::string &key : keys)
+			if (key == s.name || key == s.type || key == std::to_string(s.id)) {
+				selected.push_back(&s);
+				break;
+			}
+	return selected;
+}
+
+/// The StreamFooter of an extracted stream, in the recorder's format.
+static std::string slice_footer(const xdf_stream &s, const xdf_slice &slice) {
+	std::ostringstream footer;
+	footer.precision(16);
+	footer << "<?xml version=\"1.0\"?><info>";
+	if (slice.sample_count())
+		footer << "<first_timestamp>" << slice.samples.time_stamps.front()
+			   << "</first_timestamp><last_timestamp>" << slice.samples.time_stamps.back()
+			   << "</last_timestamp>";
+	footer << "<sample_count>" << slice.sample_count() << "</sample_count><clock_offsets>";
+	for (std::size_t k = 0; k < s.clock_times.size(); k++)
+		footer << "<offset><time>" << s.clock_times[k] << "</time><value>" << s.clock_values[k]
+			   << "</value></offset>";
+	footer << "</clock_offsets></info>";
+	return footer.str();
+}
+
+/// Write a chunk: [Length], [Tag], [StreamId] (if given), [Content].
+static void write_xdf_chunk(std::ostream &out, chunk_tag_t tag, const std::string &content,
+	const streamid_t *streamid = nullptr) {
+	write_varlen_int(out,
+		sizeof(chunk_tag_t) + (streamid ? sizeof(streamid_t) : 0) + content.size());
+	write_little_endian(out, static_cast<uint16_t>(tag));
+	if (streamid) write_little_endian(out, *streamid);
+	out << content;
+}
+
+/// Write a stream of an extracted XDF file: the header, the clock offsets, the samples (with the
+/// recorded time stamps, so that importers synchronize them the same way) and the footer.
+static void write_xdf_stream(std::ostream &out, const xdf_stream &s, const xdf_slice &slice) {
+	const std::size_t samples_per_chunk = 4096, n_channels = s.channel_count;
+	const std::size_t sample_bytes = n_channels * s.value_size;
+	const std::string boundary(
+		reinterpret_cast<const char *>(boundary_uuid), sizeof(boundary_uuid));
+	write_xdf_chunk(out, chunk_tag_t::streamheader, s.header, &s.id);
+	for (std::size_t k = 0; k < s.clock_times.size(); k++) {
+		std::ostringstream content;
+		write_little_endian(content, s.clock_times[k]);
+		write_little_endian(content, s.clock_values[k]);
+		write_xdf_chunk(out, chunk_tag_t::clockoffset, content.str(), &s.id);
+	}
+	for (std::size_t first = 0; first < slice.sample_count(); first += samples_per_chunk) {
+		const std::size_t n = std::min(samples_per_chunk, slice.sample_count() - first);
+		std::ostringstream content;
+		// [NumSampleBytes], [NumSamples]
+		write_fixlen_int(content, static_cast<uint32_t>(n));
+		for (std::size_t i = first; i < first + n; i++) {
+			// [TimeStampBytes], [TimeStamp], [Sample]
+			content.put(8);
+			write_little_endian(content, slice.samples.time_stamps[i]);
+			if (s.format == value_format_t::string)
+				write_sample_values(content, &slice.samples.strings[i * n_channels], n_channels);
+			else
+				content.write(&slice.samples.values[i * sample_bytes],
+					static_cast<std::streamsize>(sample_bytes));
+		}
+		write_xdf_chunk(out, chunk_tag_t::boundary, boundary);
+		write_xdf_chunk(out, chunk_tag_t::samples, content.str(), &s.id);
+	}
+	write_xdf_chunk(out, chunk_tag_t::streamfooter, slice_footer(s, slice), &s.id);
+}
+
+/// The Python struct format of a record of a binary file (empty for string streams).
+static std::string record_format(const xdf_stream &s) {
+	const std::map<value_format_t, char> codes = {{value_format_t::int8, 'b'},
+		{value_format_t::int16, 'h'}, {value_format_t::int32, 'i'}, {value_format_t::int64, 'q'},
+		{value_format_t::float32, 'f'}, {value_format_t::double64, 'd'}};
+	const auto code = codes.find(s.format);
+	if (code == codes.end()) return std::string();
+	return "<d" + std::to_string(s.channel_count) + code->second;
+}
+
+static int extract_command(const std::string &filename, options_t &opts) {
+	const std::string stream_list = take(opts, "--stream", std::string());
+	const bool absolute = take(opts, "--absolute", "off") == "on";
+	double from = take(opts, "--from", -HUGE_VAL), to = take(opts, "--to", HUGE_VAL);
+	const std::string format = take(opts, "--format", "xdf");
+	std::string output = take(opts, "--output", std::string());
+	const bool clock_sync = take(opts, "--clock-sync", "on") != "off";
+	const sync_options sync = take_clock_options(opts);
+	if (!opts.empty()) {
+		std::cerr << "Unknown option " << opts.begin()->first << std::endl;
+		return 2;
+	}
+	if (stream_list.empty() || (format != "xdf" && format != "csv" && format != "binary")) {
+		std::cerr << "extract needs --stream and a --format of xdf, csv or binary" << std::endl;
+		return 2;
+	}
+	const std::string extension = format == "binary" ? ".bin" : "." + format;
+	if (output.empty()) {
+		const std::size_t dot = filename.rfind(".xdf");
+		output = (dot == std::string::npos ? filename : filename.substr(0, dot)) + ".extract" +
+				 extension;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	xdf_reader reader(filename);
+	std::vector<std::string> warnings = reader.warnings();
+	const std::vector<const xdf_stream *> selected = select_streams(reader, stream_list);
+	if (selected.empty()) {
+		std::cerr << "No stream matches " << stream_list << std::endl;
+		return 2;
+	}
+	std::map<streamid_t, clock_mapping> mappings;
+	for (const xdf_stream &s : reader.streams())
+		if (clock_sync) mappings[s.id] = fit_clock(s.clock_times, s.clock_values, sync);
+
+	// relative times count from the first time stamp of the recording
+	double recording_start = HUGE_VAL;
+	for (const xdf_stream &s : reader.streams()) {
+		const double first = stream_start_time(reader, s.id, mappings[s.id]);
+		if (!std::isnan(first)) recording_start = std::min(recording_start, first);
+	}
+	if (!absolute && recording_start < HUGE_VAL) {
+		from += recording_start;
+		to += recording_start;
+	}
+
+	std::vector<xdf_slice> slices;
+	for (const xdf_stream *s : selected) {
+		slices.push_back(extract_range(reader, s->id, from, to, mappings[s->id]));
+		warnings.insert(warnings.end(), slices.back().warnings.begin(),
+			slices.back().warnings.end());
+	}
+
+	std::vector<std::string> files;
+	if (format == "xdf") {
+		std::ofstream out(output, std::ios::binary | std::ios::trunc);
+		out << "XDF:";
+		write_xdf_chunk(out, chunk_tag_t::fileheader,
+			reader.file_header().empty()
+				? "<?xml version=\"1.0\"?><info><version>1.0</version></info>"
+				: reader.file_header());
+		for (std::size_t k = 0; k < selected.size(); k++)
+			write_xdf_stream(out, *selected[k], slices[k]);
+		out.close();
+		if (!out) throw std::runtime_error("Could not write " + output);
+		files.push_back(output);
+	} else {
+		for (std::size_t k = 0; k < selected.size(); k++) {
+			const xdf_stream &s = *selected[k];
+			const xdf_slice &slice = slices[k];
+			if (format == "binary" && s.format == value_format_t::string) {
+				warnings.push_back("String stream " + s.name + " skipped (binary format)");
+				files.emplace_back();
+				continue;
+			}
+			std::ofstream meta(csv_stream_filename(output, s.name, ".meta.xml", extension),
+				std::ios::binary | std::ios::trunc);
+			meta << csv_meta_file_header << s.header << slice_footer(s, slice);
+			const std::string data_filename = csv_stream_filename(
+				output, s.name, format == "binary" ? ".data.bin" : ".data.csv", extension);
+			std::ofstream data(data_filename, std::ios::binary | std::ios::trunc);
+			if (format == "csv") {
+				std::string rows = csv_header_row(s.header, static_cast<int>(s.channel_count));
+				format_rows(rows, s, slice.time_stamps.data(), slice.samples);
+				data << rows;
+			} else {
+				// records of the time stamp and the values
+				const std::size_t sample_bytes = s.channel_count * s.value_size;
+				for (std::size_t i = 0; i < slice.sample_count(); i++) {
+					write_little_endian(data, slice.time_stamps[i]);
+					data.write(&slice.samples.values[i * sample_bytes],
+						static_cast<std::streamsize>(sample_bytes));
+				}
+			}
+			data.close();
+			if (!meta || !data) throw std::runtime_error("Could not write " + data_filename);
+			files.push_back(data_filename);
+		}
+	}
+	const double seconds =
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::ostringstream out;
+	out.precision(15);
+	out << "{\n  \"file\": " << json_string(filename) << ",\n"
+		<< "  \"output\": " << json_string(output) << ",\n"
+		<< "  \"format\": " << json_string(format) << ",\n";
+	if (recording_start < HUGE_VAL) out << "  \"recording_start\": " << recording_start << ",\n";
+	if (std::isfinite(from)) out << "  \"from\": " << from << ",\n";
+	if (std::isfinite(to)) out << "  \"to\": " << to << ",\n";
+	out << "  \"streams\": [";
+	for (std::size_t k = 0; k < selected.size(); k++) {
+		const xdf_stream &s = *selected[k];
+		const xdf_slice &slice = slices[k];
+		out << (k ? "," : "") << "\n    {\"stream_id\": " << s.id
+			<< ", \"name\": " << json_string(s.name) << ", \"samples\": " << slice.sample_count()
+			<< ", \"decoded_chunks\": " << slice.decoded_chunks
+			<< ", \"decoded_bytes\": " << slice.decoded_bytes;
+		if (slice.sample_count())
+			out << ", \"first_timestamp\": " << slice.time_stamps.front()
+				<< ", \"last_timestamp\": " << slice.time_stamps.back();
+		if (format != "xdf") out << ", \"data_file\": " << json_string(files[k]);
+		if (format == "binary") out << ", \"record_format\": " << json_string(record_format(s));
+		out << "}";
+	}
+	out << "\n  ],\n"
+		<< "  \"seconds\": " << seconds << ",\n"
+		<< "  \"warnings\": [";
+	for (std::size_t k = 0; k < warnings.size(); k++)
+		out << (k ? ", " : "") << json_string(warnings[k]);
+	out << "]\n}";
+	std::cout << out.str() << std::endl;
+	return 0;
+}
+
+static int follow_command(const std::string &filename, options_t &opts) {
+	const double timeout = take(opts, "--timeout", HUGE_VAL);
+	if (!opts.empty()) {
+		std::cerr << "Unknown option " << opts.begin()->first << std::endl;
+		return 2;
+	}
+
+	// one JSON line per block of new samples, until the recording has been stopped or nothing
+	// was written for the timeout
+	xdf_follower follower(filename);
+	std::map<streamid_t, uint64_t> samples;
+	auto print_block = [&](const xdf_stream &s, const xdf_samples &block) {
+		samples[s.id] += block.time_stamps.size();
+		std::ostringstream out;
+		out.precision(15);
+		out << "{\"stream_id\": " << s.id << ", \"name\": " << json_string(s.name)
+			<< ", \"samples\": " << block.time_stamps.size()
+			<< ", \"first_timestamp\": " << block.time_stamps.front()
+			<< ", \"last_timestamp\": " << block.time_stamps.back() << "}";
+		std::cout << out.str() << std::endl;
+	};
+	auto idle_since = std::chrono::steady_clock::now();
+	for (;;) {
+		if (follower.update(print_block)) idle_since = std::chrono::steady_clock::now();
+		if (follower.finished()) break;
+		const double idle = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - idle_since).count();
+		if (idle >= timeout) break;
+		follower.wait(std::min(timeout - idle, 1.0));
+	}
+
+	std::ostringstream out;
+	out << "{\"file\": " << json_string(filename) << ", \"bytes\": " << follower.size()
+		<< ", \"finished\": " << (follower.finished() ? "true" : "false") << ", \"streams\": [";
+	for (std::size_t k = 0; k < follower.streams().size(); k++) {
+		const xdf_stream &s = follower.streams()[k];
+		out << (k ? ", " : "") << "{\"stream_id\": " << s.id
+			<< ", \"name\": " << json_string(s.name) << ", \"samples\": " << samples[s.id]
+			<< "}";
+	}
+	out << "], \"warnings\": [";
+	for (std::size_t k = 0; k < follower.warnings().size(); k++)
+		out << (k ? ", " : "") << json_string(follower.warnings()[k]);
+	out << "]}";
+	std::cout << out.str() << std::endl;
+	return 0;
+}
+
+/// The sort and merge commands: merge_xdf() of the inputs, the first one being the file.
+static int merge_files(
+	const std::vector<std::string> &inputs, const char *suffix, options_t &opts) {
+	const std::string &filename = inputs.front();
+	const std::size_t dot = filename.rfind(".xdf");
+	const std::string base = dot == std::string::npos ? filename : filename.substr(0, dot);
+	const std::string output = take(opts, "--output", base + suffix);
+	const std::size_t output_dot = output.rfind(".xdf");
+	std::string index = take(opts, "--index",
+		(output_dot == std::string::npos ? output : output.substr(0, output_dot)) + ".index.csv");
+	if (index == "none") index.clear();
+	sort_options sort;
+	sort.temp_dir = take(opts, "--temp-dir", std::string());
+	sort.boundary_interval = static_cast<uint64_t>(take(opts, "--boundary-mb", 1.0) * 1e6);
+	sort.clock = take_clock_options(opts);
+	if (!opts.empty()) {
+		std::cerr << "Unknown option " << opts.begin()->first << std::endl;
+		return 2;
+	}
+	for (const std::string &input : inputs)
+		if (output == input) {
+			std::cerr << "The output must be a new file" << std::endl;
+			return 2;
+		}
+
+	const auto start = std::chrono::steady_clock::now();
+	const sort_result result = merge_xdf(inputs, output, index, sort);
+	const double seconds =
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::ostringstream out;
+	out.precision(6);
+	if (inputs.size() == 1)
+		out << "{\n  \"file\": " << json_string(filename) << ",\n";
+	else {
+		out << "{\n  \"files\": [";
+		for (std::size_t k = 0; k < inputs.size(); k++)
+			out << (k ? ", " : "") << json_string(inputs[k]);
+		out << "],\n";
+	}
+	out << "  \"output\": " << json_string(output) << ",\n";
+	if (!index.empty())
+		out << "  \"index\": " << json_string(index) << ",\n"
+			<< "  \"index_entries\": " << result.index_entries << ",\n";
+	out << "  \"streams\": " << result.streams << ",\n"
+		<< "  \"data_chunks\": " << result.data_chunks << ",\n"
+		<< "  \"reordered_chunks\": " << result.reordered_chunks << ",\n"
+		<< "  \"bytes\": " << result.bytes << ",\n"
+		<< "  \"seconds\": " << seconds << ",\n"
+		<< "  \"mb_per_second\": " << result.bytes / seconds / 1e6 << ",\n"
+		<< "  \"warnings\": [";
+	for (std::size_t k = 0; k < result.warnings.size(); k++)
+		out << (k ? ", " : "") << json_string(result.warnings[k]);
+	out << "]\n}";
+	std::cout << out.str() << std::endl;
+	return 0;
+}
+
+static int sort_command(const std::string &filename, options_t &opts) {
+	return merge_files({filename}, ".sorted.xdf", opts);
+}
+
+static int merge_command(const std::string &filename, options_t &opts) {
+	std::vector<std::string> inputs{filename};
+	std::istringstream more(take(opts, "--inputs", std::string()));
+	for (std::string input; std::getline(more, input, ',');)
+		if (!input.empty()) inputs.push_back(input);
+	if (inputs.size() == 1) {
+		std::cerr << "Nothing to merge, --inputs is missing" << std::endl;
+		return 2;
+	}
+	return merge_files(inputs, ".merged.xdf", opts);
+}
+
+/// Append the values of a sample, separated by semicolons (a cell of a marker column).
+static void append_sample(std::string &out, const xdf_stream &s, std::size_t i) {
+	for (std::size_t c = 0; c < s.channel_count; c++) {
+		const std::size_t k = i * s.channel_count + c;
+		if (c) out += ';';
+		switch (s.format) {
+		case value_format_t::int8: append_csv_value(out, int64_t{s.values_as<int8_t>()[k]}); break;
+		case value_format_t::int16: append_csv_value(out, s.values_as<int16_t>()[k]); break;
+		case value_format_t::int32: append_csv_value(out, s.values_as<int32_t>()[k]); break;
+		case value_format_t::int64: append_csv_value(out, s.values_as<int64_t>()[k]); break;
+		case value_format_t::float32: append_csv_value(out, s.values_as<float>()[k]); break;
+		case value_format_t::double64: append_csv_value(out, s.values_as<double>()[k]); break;
+		case value_format_t::string: out += s.strings[k]; break;
+		default: break;
+		}
+	}
+}
+
+static int resample_command(const std::string &filename, options_t &opts) {
+	resample_options resample;
+	resample.threads = static_cast<unsigned>(take(opts, "--threads", 0.0));
+	resample.srate = take(opts, "--srate", 0.0);
+	const std::string method = take(opts, "--method", "linear");
+	resample.sinc_zero_crossings = static_cast<unsigned>(
+		take(opts, "--zero-crossings", static_cast<double>(resample.sinc_zero_crossings)));
+	resample.max_gap = take(opts, "--max-gap", resample.max_gap);
+	const bool absolute = take(opts, "--absolute", "off") == "on";
+	double from = take(opts, "--from", std::numeric_limits<double>::quiet_NaN());
+	double to = take(opts, "--to", std::numeric_limits<double>::quiet_NaN());
+	std::string output = take(opts, "--output", std::string());
+	const bool clock_sync = take(opts, "--clock-sync", "on") != "off";
+	const bool dejitter_timestamps = take(opts, "--dejitter", "on") != "off";
+	sync_options sync = take_clock_options(opts);
+	sync.jitter_break_threshold_seconds =
+		take(opts, "--jitter-break-threshold-seconds", sync.jitter_break_threshold_seconds);
+	sync.jitter_break_threshold_samples =
+		take(opts, "--jitter-break-threshold-samples", sync.jitter_break_threshold_samples);
+	if (!opts.empty()) {
+		std::cerr << "Unknown option " << opts.begin()->first << std::endl;
+		return 2;
+	}
+	if (!(resample.srate > 0) || (method != "linear" && method != "sinc") ||
+		!resample.sinc_zero_crossings) {
+		std::cerr << "resample needs a positive --srate and a --method of linear or sinc"
+				  << std::endl;
+		return 2;
+	}
+	resample.method = method == "sinc" ? interpolation_t::sinc : interpolation_t::linear;
+	if (output.empty()) {
+		const std::size_t dot = filename.rfind(".xdf");
+		output = (dot == std::string::npos ? filename : filename.substr(0, dot)) + ".resampled.csv";
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	xdf_reader reader(filename);
+	reader.decode(resample.threads);
+	synchronize_streams(reader, clock_sync, dejitter_timestamps, sync, resample.threads);
+	// relative times count from the first time stamp of the recording
+	double recording_start = HUGE_VAL;
+	for (const xdf_stream &s : reader.streams())
+		if (!s.time_stamps.empty())
+			recording_start = std::min(recording_start, s.time_stamps.front());
+	if (!absolute && recording_start < HUGE_VAL) {
+		from += recording_start;
+		to += recording_start;
+	}
+	resample.start = from;
+	resample.end = to;
+	const resampled_grid grid = resample_streams(reader, resample);
+	const auto resampled = std::chrono::steady_clock::now();
+
+	// the header row: the time, a column per channel of the regular streams, a column per marker
+	// stream (the markers at a grid point, separated by '|')
+	const std::vector<xdf_stream> &streams = reader.streams();
+	std::string header = "time";
+	for (std::size_t k = 0; k < streams.size(); k++) {
+		const xdf_stream &s = streams[k];
+		if (grid.streams[k].marker) {
+			header += "," + s.name;
+			continue;
+		}
+		std::istringstream labels(csv_header_row(s.header, static_cast<int>(s.channel_count)));
+		std::string label;
+		std::getline(labels, label, ','); // lsl_time_stamp
+		while (std::getline(labels, label, ',')) {
+			if (!label.empty() && label.back() == '\n') label.pop_back();
+			header += "," + s.name + ":" + label;
+		}
+	}
+	// the markers of each marker stream in order of their grid points
+	std::vector<std::vector<std::size_t>> markers(streams.size());
+	for (std::size_t k = 0; k < streams.size(); k++) {
+		const resampled_stream &r = grid.streams[k];
+		std::vector<std::size_t> &order = markers[k];
+		for (std::size_t m = 0; m < r.grid_index.size(); m++) order.push_back(m);
+		std::stable_sort(order.begin(), order.end(),
+			[&](std::size_t a, std::size_t b) { return r.grid_index[a] < r.grid_index[b]; });
+	}
+
+	// the rows are formatted in parallel, in blocks
+	const std::size_t block_rows = 4096;
+	std::vector<std::string> blocks((grid.length + block_rows - 1) / block_rows);
+	parallel_for(blocks.size(), resample.threads, [&](std::size_t b) {
+		std::string &rows = blocks[b];
+		const std::size_t first = b * block_rows;
+		const std::size_t last = std::min(first + block_rows, grid.length);
+		std::vector<std::size_t> next(streams.size()); // the next marker of each stream
+		for (std::size_t k = 0; k < streams.size(); k++) {
+			const resampled_stream &r = grid.streams[k];
+			next[k] = static_cast<std::size_t>(
+				std::lower_bound(markers[k].begin(), markers[k].end(), first,
+					[&](std::size_t m, std::size_t i) { return r.grid_index[m] < i; }) -
+				markers[k].begin());
+		}
+		for (std::size_t i = first; i < last; i++) {
+			append_csv_value(rows, grid.time(i));
+			for (std::size_t k = 0; k < streams.size(); k++) {
+				const resampled_stream &r = grid.streams[k];
+				if (!r.marker) {
+					for (std::size_t c = 0; c < r.channel_count; c++) {
+						const double value = r.values[i * r.channel_count + c];
+						rows += ',';
+						if (!std::isnan(value)) append_csv_value(rows, value);
+					}
+					continue;
+				}
+				rows += ',';
+				const std::vector<std::size_t> &order = markers[k];
+				if (next[k] == order.size() || r.grid_index[order[next[k]]] != i) continue;
+				// the markers are quoted as one field, so that their strings cannot break the row
+				std::string cell;
+				for (bool first_marker = true;
+					 next[k] < order.size() && r.grid_index[order[next[k]]] == i; next[k]++) {
+					if (!first_marker) cell += '|';
+					append_sample(cell, streams[k], r.sample_index[order[next[k]]]);
+					first_marker = false;
+				}
+				append_csv_escaped(rows, cell);
+			}
+			rows += '\n';
+		}
+	});
+	std::ofstream out_file(output, std::ios::binary | std::ios::trunc);
+	out_file << header << '\n';
+	for (std::string &rows : blocks) {
+		out_file << rows;
+		std::string().swap(rows);
+	}
+	out_file.close();
+	if (!out_file) throw std::runtime_error("Could not write " + output);
+	const auto written = std::chrono::steady_clock::now();
+
+	std::ostringstream out;
+	out.precision(15);
+	out << "{\n  \"file\": " << json_string(filename) << ",\n"
+		<< "  \"output\": " << json_string(output) << ",\n"
+		<< "  \"method\": " << json_string(method) << ",\n"
+		<< "  \"srate\": " << grid.srate << ",\n"
+		<< "  \"start\": " << grid.start << ",\n"
+		<< "  \"grid_points\": " << grid.length << ",\n"
+		<< "  \"resample_seconds\": " << std::chrono::duration<double>(resampled - start).count()
+		<< ",\n"
+		<< "  \"write_seconds\": " << std::chrono::duration<double>(written - resampled).count()
+		<< ",\n"
+		<< "  \"streams\": [";
+	for (std::size_t k = 0; k < streams.size(); k++) {
+		const resampled_stream &r = grid.streams[k];
+		out << (k ? "," : "") << "\n    {\"stream_id\": " << r.streamid
+			<< ", \"name\": " << json_string(streams[k].name)
+			<< ", \"samples\": " << streams[k].sample_count();
+		if (r.marker)
+			out << ", \"markers\": " << r.grid_index.size();
+		else
+			out << ", \"channels\": " << r.channel_count;
+		out << "}";
+	}
+	out << "\n  ],\n  \"warnings\": [";
+	for (std::size_t k = 0; k < reader.warnings().size(); k++)
+		out << (k ? ", " : "") << json_string(reader.warnings()[k]);
+	out << "]\n}";
+	std::cout << out.str() << std::endl;
+	return 0;
+}
+
+struct command_t {
+	std::function<int(const std::string &, options_t &)> run;
+	const char *usage;
+};
+
+static const std::map<std::string, command_t> commands = {
+	{"convert", {convert_command, "[--output name.csv] [--threads N] [--batch-mb N]"}},
+	{"extract", {extract_command,
+					"--stream name|type|id[,...] [--from seconds] [--to seconds]\n"
+					"      [--absolute on|off] [--format xdf|csv|binary] [--output name]\n"
+					"      [--clock-sync on|off] [--handle-clock-resets on|off] ..."}},
+	{"follow", {follow_command, "[--timeout seconds]"}},
+	{"fsck", {fsck_command, "[--repair repaired.xdf] [--threads N]"}},
+	{"merge", {merge_command,
+				  "--inputs second.xdf[,...] [--output merged.xdf]\n"
+				  "      [--index merged.index.csv|none] [--temp-dir dir] [--boundary-mb N] ..."}},
+	{"resample", {resample_command,
+					 "--srate N [--method linear|sinc] [--from seconds] [--to seconds]\n"
+					 "      [--absolute on|off] [--output name.csv] [--zero-crossings N]\n"
+					 "      [--max-gap periods] [--threads N] [--clock-sync on|off]\n"
+					 "      [--dejitter on|off] [--handle-clock-resets on|off] ..."}},
+	{"sort", {sort_command,
+				 "[--output sorted.xdf] [--index sorted.index.csv|none] [--temp-dir dir]\n"
+				 "      [--boundary-mb N] [--handle-clock-resets on|off] ..."}},
+	{"sync", {sync_command,
+				 "[--threads N] [--clock-sync on|off] [--dejitter on|off]\n"
+				 "      [--handle-clock-resets on|off] [--clock-reset-threshold-stds X]\n"
+				 "      [--clock-reset-threshold-seconds X]\n"
+				 "      [--clock-reset-threshold-offset-stds X]\n"
+				 "      [--clock-reset-threshold-offset-seconds X] [--winsor-threshold X]\n"
+				 "      [--robust-fit-iterations N] [--jitter-break-threshold-seconds X]\n"
+				 "      [--jitter-break-threshold-samples N]"}},
+};
+
+static int usage(const char *program) {
+	std::cerr << "Usage: " << program << " <command> file.xdf [options]\n";
+	for (const auto &command : commands)
+		std::cerr << "  " << command.first << " file.xdf " << command.second.usage << "\n";
+	return 2;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3) return usage(argv[0]);
+	const auto command = commands.find(argv[1]);
+	if (command == commands.end()) return usage(argv[0]);
+	options_t opts;
+	for (int i = 3; i < argc; i += 2) {
+		if (i + 1 == argc) {
+			std::cerr << "Missing value for " << argv[i] << std::endl;
+			return 2;
+		}
+		opts[argv[i]] = argv[i + 1];
+	}
+	try {
+		return command->second.run(argv[2], opts);
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
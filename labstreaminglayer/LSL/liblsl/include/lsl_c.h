@@ -230,6 +230,15 @@ extern LIBLSL_C_API int32_t lsl_library_version();
 * version is used. */
 extern LIBLSL_C_API const char* lsl_library_info();
 
+/**
+* Write the hot-path trace spans recorded so far as Chrome trace JSON (for chrome://tracing or Perfetto).
+* Spans are only recorded by libraries built with LSL_TRACING; they are also written to the TraceFile
+* ([tuning] section of lsl_api.cfg) when the library is unloaded.
+* @param filename The file to (over)write.
+* @return 1 if the file was written, 0 otherwise (including in builds without tracing).
+*/
+extern LIBLSL_C_API int32_t lsl_dump_trace(const char *filename);
+
 /**
 * Obtain a local system time stamp in seconds. The resolution is better than a millisecond.
 * This reading can be used to assign time stamps to samples as they are being acquired. 
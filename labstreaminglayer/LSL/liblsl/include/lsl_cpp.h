@@ -103,6 +103,13 @@ namespace lsl {
 	* version is used. */
 	inline const char* library_info() { return lsl_library_info(); }
 
+	/**
+	* Write the hot-path trace spans recorded so far as Chrome trace JSON (for chrome://tracing or Perfetto).
+	* Spans are only recorded by libraries built with LSL_TRACING.
+	* @return Whether the file was written (false in builds without tracing).
+	*/
+	inline bool dump_trace(const std::string &filename) { return lsl_dump_trace(filename.c_str()) != 0; }
+
     /**
     * Obtain a local system time stamp in seconds. The resolution is better than a millisecond.
     * This reading can be used to assign time stamps to samples as they are being acquired. 
@@ -179,12 +179,20 @@ void api_config::load_from_file(const std::string &filename) {
 		time_probe_count_ = pt.get("tuning.TimeProbeCount",8);
 		time_probe_interval_ = pt.get("tuning.TimeProbeInterval",0.064);
 		time_probe_max_rtt_ = pt.get("tuning.TimeProbeMaxRTT",0.128);
-		outlet_buffer_reserve_ms_ = pt.get("tuning.OutletBufferReserveMs",5000);
-		outlet_buffer_reserve_samples_ = pt.get("tuning.OutletBufferReserveSamples",128);
+		// (OutletBufferReserveMs and OutletBufferReserveSamples are ignored: outlets do not
+		// preallocate samples any more)
 		inlet_buffer_reserve_ms_ = pt.get("tuning.InletBufferReserveMs",5000);
 		inlet_buffer_reserve_samples_ = pt.get("tuning.InletBufferReserveSamples",128);
 		smoothing_halftime_ = pt.get("tuning.SmoothingHalftime",90.0f);
 		force_default_timestamps_ = pt.get("tuning.ForceDefaultTimestamps", false);
+		trace_file_ = pt.get("tuning.TraceFile","lsl_trace.json");
+		outlet_io_threads_ = pt.get("tuning.OutletIOThreads",2);
+		inlet_io_threads_ = pt.get("tuning.InletIOThreads",0);
+		shared_memory_transport_ = pt.get("tuning.SharedMemoryTransport",false);
+		shared_memory_bytes_ = pt.get("tuning.SharedMemoryBytes",16*1024*1024);
+		feed_compression_ = pt.get("tuning.FeedCompression","off");
+		if (feed_compression_ != "off" && feed_compression_ != "auto" && feed_compression_ != "always")
+			throw std::runtime_error("Unsupported setting for the FeedCompression parameter.");
 
 	} catch(std::exception &e) {
 		std::cerr << "Error parsing config file " << filename << " (" << e.what() << "). Rolling back to defaults." << std::endl;
@@ -157,10 +157,6 @@ namespace lsl {
 		double time_probe_interval() const { return time_probe_interval_; }
 		/// Maximum assumed RTT of a time probe (= extra waiting time).
 		double time_probe_max_rtt() const { return time_probe_max_rtt_; }
-		/// Default pre-allocated buffer size for the outlet, in ms (regular streams).
-		int outlet_buffer_reserve_ms() const { return outlet_buffer_reserve_ms_; }
-		/// Default pre-allocated buffer size for the outlet, in samples (irregular streams).
-		int outlet_buffer_reserve_samples() const { return outlet_buffer_reserve_samples_; }
 		/// Default pre-allocated buffer size for the inlet, in ms (regular streams).
 		int inlet_buffer_reserve_ms() const { return inlet_buffer_reserve_ms_; }
 		/// Default pre-allocated buffer size for the inlet, in samples (irregular streams).
@@ -169,6 +165,19 @@ namespace lsl {
 		float smoothing_halftime() const { return smoothing_halftime_; }
 		/// Override timestamps with lsl clock if True
 		bool force_default_timestamps() const { return force_default_timestamps_; }
+		/// File that the trace spans are written to at exit (only in builds with LSL_TRACING).
+		const std::string &trace_file() const { return trace_file_; }
+		/// Number of threads that serve the data connections of all outlets of the process.
+		int outlet_io_threads() const { return outlet_io_threads_; }
+		/// Number of threads that serve the connections of all inlets of the process (0 = each inlet runs its own threads).
+		int inlet_io_threads() const { return inlet_io_threads_; }
+		/// Whether outlets and inlets on the same host exchange numeric samples through shared memory (instead of TCP) when both support it (off by default).
+		bool shared_memory_transport() const { return shared_memory_transport_; }
+		/// Size of the shared-memory segment of an outlet, in bytes (determines how far behind a local inlet can fall before it loses samples).
+		int shared_memory_bytes() const { return shared_memory_bytes_; }
+		/// Whether inlets ask for a compressed data feed from remote outlets: "off", "auto" (while the link cannot keep up) or "always".
+		/// Only inlets that run their own threads ask for one; those served by the shared I/O threads (InletIOThreads > 0) always get an uncompressed feed.
+		const std::string &feed_compression() const { return feed_compression_; }
 
 	private:
 		// Thread-safe initialization logic (boilerplate).
@@ -216,12 +225,16 @@ namespace lsl {
 		int time_probe_count_;
 		double time_probe_interval_;
 		double time_probe_max_rtt_;
-		int outlet_buffer_reserve_ms_;
-		int outlet_buffer_reserve_samples_;
 		int inlet_buffer_reserve_ms_;
 		int inlet_buffer_reserve_samples_;
 		float smoothing_halftime_;
 		bool force_default_timestamps_;
+		std::string trace_file_;
+		int outlet_io_threads_;
+		int inlet_io_threads_;
+		bool shared_memory_transport_;
+		int shared_memory_bytes_;
+		std::string feed_compression_;
 	};
 }
 
@@ -21,6 +21,8 @@
 
 #include "cancellation.h"
 #include <streambuf>
+#include <algorithm>
+#include <cstring>
 #include <exception>
 #include <set>
 #include <boost/asio/detail/config.hpp>
@@ -113,6 +115,32 @@ namespace lslboost {
 			*/
 			const lslboost::system::error_code& puberror() const { return error(); }
 
+			/// Read up to max bytes, waiting only until some are available.
+			/**
+			* Unlike sgetn(), which blocks until all of the requested bytes have arrived,
+			* this returns the bytes that are buffered, or else receives whatever the
+			* socket has straight into the destination (bypassing the small get buffer).
+			*
+			* @return The number of bytes read; 0 if the connection was closed or failed
+			* (see puberror()).
+			*/
+			std::size_t read_some(char *dst, std::size_t max) {
+				if (gptr() != egptr()) {
+					std::size_t count = std::min((std::size_t)(egptr() - gptr()), max);
+					memcpy(dst, gptr(), count);
+					gbump((int)count);
+					return count;
+				}
+				io_handler handler = { this };
+				this->get_service().async_receive(this->get_implementation(),
+					lslboost::asio::buffer(dst, max), 0, handler);
+				ec_ = lslboost::asio::error::would_block;
+				protected_reset();
+				do this->get_service().get_io_service().run_one();
+				while (ec_ == lslboost::asio::error::would_block);
+				return ec_ ? 0 : bytes_transferred_;
+			}
+
 		protected:
 			/// Close the socket if it's open.
 			void close_if_open() {
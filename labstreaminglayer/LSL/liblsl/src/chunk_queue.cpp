@@ -0,0 +1,87 @@
+#include "chunk_queue.h"
+#include "send_buffer.h"
+#include <iostream>
+
+// === implementation of the chunk_queue class ===
+
+using namespace lsl;
+
+/**
+* Create a new queue with a given capacity and register it with a send buffer.
+* @param max_samples The maximum number of samples that can be held by the queue. Beyond that, the oldest chunks are dropped.
+* @param registry The send buffer that dispatches chunks to this queue.
+* @param listener The function that is called (from the pushing thread) when a chunk arrives after notify_when_nonempty().
+*/
+chunk_queue::chunk_queue(std::size_t max_samples, send_buffer_p registry, const lslboost::function<void()> &listener): registry_(registry), listener_(listener), max_samples_(max_samples), buffered_(0), notify_(false) {
+	registry_->register_consumer(this);
+}
+
+/**
+* Destructor.
+* Unregisters from the send buffer.
+*/
+chunk_queue::~chunk_queue() {
+	try {
+		registry_->unregister_consumer(this);
+	} catch(std::exception &e) {
+		std::cerr << "Unexpected error while trying to unregister a chunk queue from its registry:" << e.what() << std::endl;
+	}
+}
+
+/**
+* Push a new chunk onto the queue.
+* An empty chunk pointer is delivered as a wakeup notification.
+*/
+void chunk_queue::push_chunk(const sample_chunk_p &chunk) {
+	bool notify;
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(mut_);
+		chunks_.push_back(chunk);
+		if (chunk)
+			buffered_ += chunk->size();
+		// drop the oldest chunks if the capacity is exceeded
+		while (buffered_ > max_samples_ && chunks_.size() > 1) {
+			if (chunks_.front())
+				buffered_ -= chunks_.front()->size();
+			chunks_.pop_front();
+		}
+		notify = notify_;
+		notify_ = false;
+	}
+	if (notify)
+		listener_();
+}
+
+/**
+* Pop a chunk from the queue, if there is one.
+* Does not block.
+* @param chunk Receives the chunk (which may be an empty pointer, for wakeup notifications).
+* @return Whether a chunk was popped.
+*/
+bool chunk_queue::pop_chunk(sample_chunk_p &chunk) {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	if (chunks_.empty())
+		return false;
+	chunk.swap(chunks_.front());
+	chunks_.pop_front();
+	if (chunk)
+		buffered_ -= chunk->size();
+	return true;
+}
+
+/**
+* Request that the listener be called once when the next chunk is pushed.
+* @return False (and no request is made) if the queue is not empty.
+*/
+bool chunk_queue::notify_when_nonempty() {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	if (!chunks_.empty())
+		return false;
+	notify_ = true;
+	return true;
+}
+
+bool chunk_queue::empty() {
+	lslboost::lock_guard<lslboost::mutex> lock(mut_);
+	return chunks_.empty();
+}
@@ -0,0 +1,78 @@
+#ifndef CHUNK_QUEUE_H
+#define CHUNK_QUEUE_H
+
+#include <deque>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include "sample_chunk.h"
+
+namespace lsl {
+	/// shared pointer to a chunk queue
+	typedef lslboost::shared_ptr<class chunk_queue> chunk_queue_p;
+	/// shared pointer to a send buffer
+	typedef lslboost::shared_ptr<class send_buffer> send_buffer_p;
+
+	/**
+	* A thread-safe producer-consumer queue of unsent sample chunks (one per consumer of a send_buffer).
+	* The chunks are shared between all queues, so pushing a chunk costs one reference per consumer
+	* regardless of the number of samples in it.
+	* The capacity is measured in samples: if it is exceeded, the oldest chunks are erased as a whole
+	* (but never the most recent one).
+	* The consumer does not block on the queue; instead, it can request that a listener be called when the
+	* next chunk arrives (e.g., to schedule a handler on an io_service).
+	*/
+	class chunk_queue: private lslboost::noncopyable {
+	public:
+		/**
+		* Create a new queue with a given capacity and register it with a send buffer.
+		* @param max_samples The maximum number of samples that can be held by the queue. Beyond that, the oldest chunks are dropped.
+		* @param registry The send buffer that dispatches chunks to this queue.
+		* @param listener The function that is called (from the pushing thread) when a chunk arrives after notify_when_nonempty().
+		*/
+		chunk_queue(std::size_t max_samples, send_buffer_p registry, const lslboost::function<void()> &listener);
+
+		/**
+		* Destructor.
+		* Unregisters from the send buffer.
+		*/
+		~chunk_queue();
+
+		/**
+		* Push a new chunk onto the queue.
+		* An empty chunk pointer is delivered as a wakeup notification.
+		*/
+		void push_chunk(const sample_chunk_p &chunk);
+
+		/**
+		* Pop a chunk from the queue, if there is one.
+		* Does not block.
+		* @param chunk Receives the chunk (which may be an empty pointer, for wakeup notifications).
+		* @return Whether a chunk was popped.
+		*/
+		bool pop_chunk(sample_chunk_p &chunk);
+
+		/**
+		* Request that the listener be called once when the next chunk is pushed.
+		* @return False (and no request is made) if the queue is not empty.
+		*/
+		bool notify_when_nonempty();
+
+		/**
+		* Check whether the queue is empty.
+		*/
+		bool empty();
+
+	private:
+		send_buffer_p registry_;				// the consumer registry
+		lslboost::function<void()> listener_;	// the function to call when a requested notification is due
+		std::size_t max_samples_;				// maximum number of buffered samples
+		std::size_t buffered_;					// number of samples currently buffered
+		bool notify_;							// whether the listener shall be called upon the next push
+		std::deque<sample_chunk_p> chunks_;		// the buffered chunks
+		lslboost::mutex mut_;					// mutex protecting the buffer and the notification request
+	};
+
+}
+
+#endif
+
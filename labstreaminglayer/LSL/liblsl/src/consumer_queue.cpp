@@ -1,46 +1,71 @@
 #include "consumer_queue.h"
-#include "send_buffer.h"
 #include "common.h"
-#include <iostream>
+#include <algorithm>
 #include <boost/date_time/time_duration.hpp>
+#include <boost/thread/thread.hpp>
 
 // === implementation of the consumer_queue class ===
 
 using namespace lsl;
 
+// number of samples that are moved through the buffer at a time
+const std::size_t batch_size = 256;
+
 /**
 * Create a new queue with a given capacity.
 * @param max_capacity The maximum number of samples that can be held by the queue. Beyond that, the oldest samples are dropped.
-* @param registry Optionally a pointer to a registration facility, to dispatch samples to all consumers.
 */
-consumer_queue::consumer_queue(std::size_t max_capacity, send_buffer_p registry): registry_(registry), buffer_(max_capacity)  {
-	if (registry_)
-		registry_->register_consumer(this);
-}
+consumer_queue::consumer_queue(std::size_t max_capacity): buffer_(max_capacity) {}
 
 /**
 * Destructor.
-* Unregisters from the send buffer, if any.
+* Releases the samples that were not consumed.
 */
 consumer_queue::~consumer_queue() {
-	try {
-		if (registry_)
-			registry_->unregister_consumer(this);
-	} catch(std::exception &e) {
-		std::cerr << "Unexpected error while trying to unregister a consumer queue from its registry:" << e.what() << std::endl;
-	}
+	// release the samples that were not consumed
+	while (!buffer_.empty())
+		drop_samples(batch_size);
 }
 
 /**
 * Push a new sample onto the queue.
 */
 void consumer_queue::push_sample(const sample_p &sample) {
-	while (!buffer_.push(sample)) {
-		sample_p dummy;
-		buffer_.pop(dummy);
+	push_samples(&sample, 1);
+}
+
+/**
+* Push a number of samples onto the queue, with one index update per batch.
+*/
+void consumer_queue::push_samples(const sample_p *samples, std::size_t n) {
+	sample *batch[batch_size];
+	while (n) {
+		// the queue takes a reference to each sample
+		const std::size_t count = std::min(n, batch_size);
+		for (std::size_t k = 0; k < count; k++)
+			if ((batch[k] = samples[k].get()))
+				intrusive_ptr_add_ref(batch[k]);
+		for (std::size_t pushed = 0; pushed < count; ) {
+			pushed += buffer_.push(batch + pushed, count - pushed);
+			if (pushed < count)
+				drop_samples(count - pushed);
+		}
+		samples += count;
+		n -= count;
 	}
 }
 
+/**
+* Drop up to n of the oldest samples (to make room for new ones).
+*/
+void consumer_queue::drop_samples(std::size_t n) {
+	sample *batch[batch_size];
+	const std::size_t count = buffer_.pop(batch, std::min(n, batch_size));
+	for (std::size_t k = 0; k < count; k++)
+		if (batch[k])
+			intrusive_ptr_release(batch[k]);
+}
+
 /**
 * Pop a sample from the queue.
 * Blocks if empty.
@@ -48,22 +73,45 @@ void consumer_queue::push_sample(const sample_p &sample) {
 */
 sample_p consumer_queue::pop_sample(double timeout) {
 	sample_p result;
-	if (timeout <= 0.0) {
-		buffer_.pop(result);
-	} else {
-		if (!buffer_.pop(result)) {
-			// turn timeout into the point in time at which we give up
-			timeout += lsl::lsl_clock();
-			do {
-				if (lsl::lsl_clock() >= timeout)
-					break;
-				lslboost::this_thread::sleep(lslboost::posix_time::milliseconds(1));
-			} while (!buffer_.pop(result));
-		}
-	}
+	pop_samples(&result, 1, timeout);
 	return result;
 }
 
+/**
+* Pop up to max_samples samples from the queue, with one index update per batch.
+* Blocks until at least one sample is available.
+* @param samples The array that receives the samples.
+* @param timeout Timeout for the blocking, in seconds. If expired, no sample is popped.
+* @return The number of samples popped.
+*/
+std::size_t consumer_queue::pop_samples(sample_p *samples, std::size_t max_samples, double timeout) {
+	sample *batch[batch_size];
+	std::size_t popped = 0;
+	if (timeout > 0.0 && max_samples && !buffer_.read_available()) {
+		// turn timeout into the point in time at which we give up
+		timeout += lsl::lsl_clock();
+		do {
+			if (lsl::lsl_clock() >= timeout)
+				return 0;
+			lslboost::this_thread::sleep(lslboost::posix_time::milliseconds(1));
+		} while (!buffer_.read_available());
+	}
+	while (popped < max_samples) {
+		const std::size_t count = buffer_.pop(batch, std::min(max_samples - popped, batch_size));
+		if (!count)
+			break;
+		// hand the queue's references over to the consumer
+		for (std::size_t k = 0; k < count; k++)
+			samples[popped + k] = sample_p(batch[k], false);
+		popped += count;
+	}
+	return popped;
+}
+
 bool consumer_queue::empty() {
 	return buffer_.empty();
 }
+
+std::size_t consumer_queue::size() {
+	return buffer_.read_available();
+}
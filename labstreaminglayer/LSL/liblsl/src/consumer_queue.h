@@ -7,26 +7,26 @@
 namespace lsl {
 	/// shared pointer to a consumer queue
 	typedef lslboost::shared_ptr<class consumer_queue> consumer_queue_p;
-	/// shared pointer to a send buffer
-	typedef lslboost::shared_ptr<class send_buffer> send_buffer_p;
 
 	/**
 	* A thread-safe producer-consumer queue of unread samples.
 	* Erases the oldest samples if max capacity is exceeded. Implemented as a circular buffer.
+	* The buffer holds raw pointers that own one reference each: pushing a sample takes one
+	* reference, popping hands it over to the consumer without touching the reference count.
+	* The batch operations move many samples per update of the buffer's read or write index.
 	*/
 	class consumer_queue: private lslboost::noncopyable {
-		typedef lslboost::lockfree::spsc_queue<sample_p> buffer_type;
+		typedef lslboost::lockfree::spsc_queue<sample*> buffer_type;
 	public:
 		/**
 		* Create a new queue with a given capacity.
 		* @param max_capacity The maximum number of samples that can be held by the queue. Beyond that, the oldest samples are dropped.
-		* @param registry Optionally a pointer to a registration facility, for multiple-reader arrangements.
 		*/
-		consumer_queue(std::size_t max_capacity, send_buffer_p registry=send_buffer_p());
+		consumer_queue(std::size_t max_capacity);
 
 		/**
 		* Destructor.
-		* Unregisters from the send buffer, if any.
+		* Releases the samples that were not consumed.
 		*/
 		~consumer_queue();
 
@@ -35,6 +35,11 @@ namespace lsl {
 		*/
 		void push_sample(const sample_p &sample);
 
+		/**
+		* Push a number of samples onto the queue, with one index update per batch.
+		*/
+		void push_samples(const sample_p *samples, std::size_t n);
+
 		/**
 		* Pop a sample from the queue. 
 		* Blocks if empty.
@@ -42,13 +47,29 @@ namespace lsl {
 		*/
 		sample_p pop_sample(double timeout=FOREVER);
 
+		/**
+		* Pop up to max_samples samples from the queue, with one index update per batch.
+		* Blocks until at least one sample is available.
+		* @param samples The array that receives the samples.
+		* @param timeout Timeout for the blocking, in seconds. If expired, no sample is popped.
+		* @return The number of samples popped.
+		*/
+		std::size_t pop_samples(sample_p *samples, std::size_t max_samples, double timeout=FOREVER);
+
 		/**
 		* Check whether the buffer is empty.
 		*/ 
 		bool empty();
 
+		/**
+		* The number of samples in the buffer (only to be called by the consumer).
+		*/
+		std::size_t size();
+
 	private:
-		send_buffer_p registry_;				// optional consumer registry
+		/// Drop up to n of the oldest samples (to make room for new ones).
+		void drop_samples(std::size_t n);
+
 		buffer_type buffer_;					// the sample buffer
 	};
 
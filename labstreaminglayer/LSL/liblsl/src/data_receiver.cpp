@@ -4,7 +4,9 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/algorithm/string.hpp>
 #include "data_receiver.h"
+#include "feed_codec.h"
 #include "socket_utils.h"
+#include "trace.h"
 
 // a convention that applies when including portable_oarchive.h in multiple .cpp files.
 // otherwise, the templates are instantiated in this file and sample.cpp which leads
@@ -17,6 +19,7 @@
 
 using namespace lsl;
 using namespace lslboost::algorithm;
+using namespace lslboost::asio;
 
 /**
 * Construct a new data receiver from an info connection.
@@ -26,13 +29,29 @@ using namespace lslboost::algorithm;
 * @param max_chunklen Optionally the maximum size, in samples, at which chunks are transmitted (the default corresponds to the chunk sizes used by the sender).
 *					  Recording applications can use a generous size here (leaving it to the network how to pack things), while real-time applications may want a finer (perhaps 1-sample) granularity.
 */
-data_receiver::data_receiver(inlet_connection &conn, int max_buflen, int max_chunklen): conn_(conn), check_thread_start_(true), closing_stream_(false), connected_(false), sample_queue_(max_buflen), 
-	sample_factory_(new sample::factory(conn.type_info().channel_format(),conn.type_info().channel_count(),conn.type_info().nominal_srate()?conn.type_info().nominal_srate()*api_config::get_instance()->inlet_buffer_reserve_ms()/1000:api_config::get_instance()->inlet_buffer_reserve_samples())), max_buflen_(max_buflen), max_chunklen_(max_chunklen) 
+data_receiver::data_receiver(inlet_connection &conn, int max_buflen, int max_chunklen): conn_(conn), check_thread_start_(true), closing_stream_(false), connected_(false), sample_queue_(conn.type_info().channel_format()==cf_string?max_buflen:1), 
+	sample_factory_(new sample::factory(conn.type_info().channel_format(),conn.type_info().channel_count(),conn.type_info().nominal_srate()?conn.type_info().nominal_srate()*api_config::get_instance()->inlet_buffer_reserve_ms()/1000:api_config::get_instance()->inlet_buffer_reserve_samples())), max_buflen_(max_buflen), max_chunklen_(max_chunklen), shared_memory_(false), async_started_(false), canceller_(*this), recv_have_(0) 
 {
 	if (max_buflen < 0)
 		throw std::invalid_argument("The max_buflen argument must not be smaller than 0.");
 	if (max_chunklen < 0)
 		throw std::invalid_argument("The max_chunklen argument must not be smaller than 0.");
+	// numeric samples are buffered in a ring that the data thread deserializes into
+	if (conn.type_info().channel_format() != cf_string)
+		ring_.reset(new sample_ring(conn.type_info().channel_format(),conn.type_info().channel_count(),max_buflen));
+	// if the inlets share an I/O pool, the samples are received there rather than by a data thread (as far as they can be parsed in bulk)
+	if (ring_ && std::min(api_config::get_instance()->use_protocol_version(),conn.type_info().version()) >= 110 && (io_ = io_pool::inlet_service())) {
+		strand_.reset(new io_service::strand(*io_));
+		recvbuf_.resize(std::max(bulk_read_bytes,4*(1+sizeof(double)+ring_->sample_bytes())));
+		canceller_.register_at(&conn_);
+		canceller_.register_at(this);
+	}
+	// a data thread that receives numeric samples from the same host asks for the shared-memory transport
+	if (ring_ && !io_ && api_config::get_instance()->shared_memory_transport() && shm_ring::supported()) {
+		try {
+			shared_memory_ = conn.type_info().hostname() == ip::host_name();
+		} catch(std::exception &) { }
+	}
 	conn_.register_onlost(this,&connected_upd_);
 }
 
@@ -42,6 +61,14 @@ data_receiver::~data_receiver() {
 		conn_.unregister_onlost(this);
 		if (data_thread_.joinable())
 			data_thread_.join();
+		if (io_) {
+			// the reception ends once the connection is shut down: wait for its handlers and its recovery thread
+			canceller_.unregister_from_all();
+			pending_.wait();
+			if (recovery_thread_.joinable())
+				recovery_thread_.join();
+			pending_.wait();
+		}
 	}
 	catch(std::exception &e) {
 		std::cerr << "Unexpected error during destruction of a data_receiver: " << e.what() << std::endl;
@@ -67,10 +94,8 @@ void data_receiver::open_stream(double timeout) {
 	lslboost::unique_lock<lslboost::mutex> lock(connected_mut_);
 	if (!connection_completed()) {
 		// start thread if not yet running
-		if (check_thread_start_ && !data_thread_.joinable()) {
-			data_thread_ = lslboost::thread(&data_receiver::data_thread,this);
-			check_thread_start_ = false;
-		}
+		if (check_thread_start_)
+			start_data_thread();
 		// wait until the connection attempt completes (or we time out)
 		if (timeout >= FOREVER)
 			connected_upd_.wait(lock, lslboost::bind(&data_receiver::connection_completed,this));
@@ -108,9 +133,20 @@ double data_receiver::pull_sample_untyped(void *buffer, int buffer_bytes, double
 	if (conn_.lost())
 		throw lost_error("The stream read by this inlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
 	// start data thread implicitly if necessary
-	if (check_thread_start_ && !data_thread_.joinable()) {
-		data_thread_ = lslboost::thread(&data_receiver::data_thread,this);
-		check_thread_start_ = false;
+	if (check_thread_start_)
+		start_data_thread();
+	if (ring_) {
+		// get the sample straight from the ring
+		double timestamp = 0.0;
+		if (ring_->wait(timeout)) {
+			if (buffer_bytes != conn_.type_info().sample_bytes())
+				throw std::range_error("The size of the provided buffer does not match the number of bytes in the sample.");
+			if (ring_->pop_samples_untyped(buffer, &timestamp, 1))
+				return timestamp;
+		}
+		if (conn_.lost())
+			throw lost_error("The stream read by this inlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
+		return 0.0;
 	}
 	// get the sample with timeout
 	if (sample_p s = sample_queue_.pop_sample(timeout)) {
@@ -128,6 +164,20 @@ double data_receiver::pull_sample_untyped(void *buffer, int buffer_bytes, double
 
 // === internal processing ===
 
+/// Start the data thread (or the reception on the shared I/O pool) unless it has been started before.
+void data_receiver::start_data_thread() {
+	if (data_thread_.joinable() || async_started_)
+		return;
+	if (io_) {
+		async_started_ = true;
+		conn_.acquire_watchdog();
+		pending_.begin();
+		io_->post(strand_->wrap(lslboost::bind(&data_receiver::connect_async,this)));
+	} else
+		data_thread_ = lslboost::thread(&data_receiver::data_thread,this);
+	check_thread_start_ = false;
+}
+
 /// The data reader thread.
 void data_receiver::data_thread() {
 	conn_.acquire_watchdog();
@@ -154,73 +204,18 @@ void data_receiver::data_thread() {
 				int use_byte_order = 0;				// which byte order we shall use (0=portable byte order)
 				int data_protocol_version = 100;	// which protocol version we shall use for data transmission (100=version 1.00)
 				bool suppress_subnormals = false;	// whether we shall suppress subnormal numbers
+				bool shared_memory = false;			// whether the samples shall be read from the outlet's shared-memory ring
+				uint64_t shared_start = 0;			// the index of the first sample to read from that ring
+				bool compressed = false;			// whether the feed is compressed
 
 				// propose to use the highest protocol version supported by both parties
 				int proposed_protocol_version = std::min(api_config::get_instance()->use_protocol_version(),conn_.type_info().version());
 				if (proposed_protocol_version >= 110) {
-					// request line LSL:streamfeed/[ProtocolVersion] [UID]\r\n
-					server_stream << "LSL:streamfeed/" << proposed_protocol_version << " " << conn_.current_uid() << "\r\n";
-					// transmit request parameters
-					server_stream << "Native-Byte-Order: " << BOOST_BYTE_ORDER << "\r\n";
-					server_stream << "Endian-Performance: " << std::floor(measure_endian_performance()) << "\r\n";
-					server_stream << "Has-IEEE754-Floats: " << (format_ieee754[cf_float32] && format_ieee754[cf_double64]) << "\r\n";
-					server_stream << "Supports-Subnormals: " << format_subnormal[conn_.type_info().channel_format()] << "\r\n";
-					server_stream << "Value-Size: " << conn_.type_info().channel_bytes() << "\r\n"; // 0 for strings
-					server_stream << "Data-Protocol-Version: " << proposed_protocol_version << "\r\n";
-					server_stream << "Max-Buffer-Length: " << max_buflen_ << "\r\n";
-					server_stream << "Max-Chunk-Length: " << max_chunklen_ << "\r\n";
-					server_stream << "Hostname: " << conn_.type_info().hostname() << "\r\n";
-					server_stream << "Source-Id: " << conn_.type_info().source_id() << "\r\n";
-					server_stream << "Session-Id: " << conn_.type_info().session_id() << "\r\n";
-					server_stream << "\r\n" << std::flush;
-
-					// check server response line (LSL/[Version] [StatusCode] [Message])
-					char buf[16384] = {0};
-					if (!server_stream.getline(buf,sizeof(buf)))
-						throw lost_error("Connection lost.");
-					std::vector<std::string> parts; split(parts,buf,is_any_of(" \t"));
-					if (parts.size() < 3 || !starts_with(parts[0],"LSL/"))
-						throw std::runtime_error("Received a malformed response.");
-					if (lslboost::lexical_cast<int>(parts[0].substr(4))/100 > api_config::get_instance()->use_protocol_version()/100)
-						throw std::runtime_error("The other party's protocol version is too new for this client; please upgrade your LSL library.");
-					int status_code = lslboost::lexical_cast<int>(parts[1]);
-					if (status_code == 404)
-						throw lost_error("The given address does not serve the resolved stream (likely outdated).");
-					if (status_code >= 400)
-						throw std::runtime_error("The other party sent an error: " + std::string(buf));
-					if (status_code >= 300)
-						throw lost_error("The other party requested a redirect.");
-
-					// receive response parameters
-					while (server_stream.getline(buf,sizeof(buf)) && (buf[0] != '\r')) {
-						std::string hdrline(buf);
-						std::size_t colon = hdrline.find_first_of(':');
-						if (colon != std::string::npos) {
-							// extract key & value
-							std::string type = to_lower_copy(trim_copy(hdrline.substr(0,colon))), rest = to_lower_copy(trim_copy(hdrline.substr(colon+1)));
-							// strip off comments
-							std::size_t semicolon = rest.find_first_of(';');
-							if (semicolon != std::string::npos)
-								rest = rest.substr(0,semicolon);
-							// get the header information
-							if (type == "byte-order") {
-								use_byte_order = lslboost::lexical_cast<int>(rest);
-								if (use_byte_order==2134 && BOOST_BYTE_ORDER!=2134 && format_sizes[conn_.type_info().channel_format()]>=8)
-									throw std::runtime_error("The byte order conversion requested by the other party is not supported.");
-							}
-							if (type == "suppress-subnormals") 
-								suppress_subnormals = lslboost::lexical_cast<bool>(rest);
-							if (type == "uid" && rest != conn_.current_uid())
-								throw lost_error("The received UID does not match the current connection's UID.");
-							if (type == "data-protocol-version") {
-								data_protocol_version = lslboost::lexical_cast<int>(rest);
-								if (data_protocol_version > api_config::get_instance()->use_protocol_version())
-									throw std::runtime_error("The protocol version requested by the other party is not supported by this client.");
-							}
-						}
-					}
-					if (!server_stream)
-						throw lost_error("Server connection lost.");
+					// (a compressed feed is only of use for numeric samples that come over the network)
+					const std::string &compression = api_config::get_instance()->feed_compression();
+					send_feed_request(server_stream,proposed_protocol_version,shared_memory_,ring_ && !shared_memory_ ? compression : "off");
+					server_stream << std::flush;
+					read_feed_response(server_stream,use_byte_order,data_protocol_version,suppress_subnormals,shared_memory,shared_start,compressed);
 				} else {
 					// version 1.00: send request line and feed parameters
 					server_stream << "LSL:streamfeed\r\n";
@@ -238,25 +233,21 @@ void data_receiver::data_thread() {
 						throw lost_error("The received UID does not match the current connection's UID.");
 				}
 
-				// --- format validation ---
-				{
-					// receive and parse two subsequent test-pattern samples and check if they are formatted as expected
-					lslboost::scoped_ptr<sample> temp[4]; 
-					for (int k=0; k<4; temp[k++].reset(sample::factory::new_sample_unmanaged(conn_.type_info().channel_format(),conn_.type_info().channel_count(),0.0,false)));
-					temp[0]->assign_test_pattern(4);
-					if (data_protocol_version >= 110)
-						temp[1]->load_streambuf(buffer, data_protocol_version, use_byte_order, suppress_subnormals);
-					else
-						*inarch >> *temp[1];
-					temp[2]->assign_test_pattern(2);
-					if (data_protocol_version >= 110)
-						temp[3]->load_streambuf(buffer, data_protocol_version, use_byte_order, suppress_subnormals);
-					else
-						*inarch >> *temp[3];
-					if (!(*temp[0].get() == *temp[1].get()) || !(*temp[2].get() == *temp[3].get()))
-						throw std::runtime_error("The received test-pattern samples do not match the specification. The protocol formats are likely incompatible.");
+				shm_ring_p shared;
+				if (shared_memory) {
+					try {
+						shared = shm_ring::open(conn_.current_uid(),conn_.type_info().channel_format(),conn_.type_info().channel_count());
+					} catch(std::exception &e) {
+						// (e.g., if the outlet is on another host by the same name): reconnect without asking for it
+						std::cerr << "Could not open the shared-memory segment of the outlet (" << e.what() << "); falling back to TCP." << std::endl;
+						shared_memory_ = false;
+						continue;
+					}
 				}
 
+				// --- format validation ---
+				check_test_patterns(buffer,inarch.get(),data_protocol_version,use_byte_order,suppress_subnormals);
+
                 // signal to accessor functions on other threads that the protocol negotiation has been successful,
                 // so we're now connected (and remain to be even if we later recover silently)
                 {
@@ -267,12 +258,35 @@ void data_receiver::data_thread() {
 
                 // --- transmission loop ---
 
+                if (shared) {
+                    receive_samples_shared(*shared,shared_start);
+                    continue;
+                }
+                if (compressed) {
+                    receive_samples_compressed(buffer,suppress_subnormals);
+                    continue;
+                }
+                if (ring_ && data_protocol_version >= 110) {
+                    receive_samples_bulk(buffer,use_byte_order,suppress_subnormals);
+                    continue;
+                }
                 double last_timestamp = 0.0;
                 double srate = conn_.current_srate();
+                // the samples are queued in batches of those that arrived together: the batch is
+                // handed over before a read could block (or when it is full)
+                std::vector<sample_p> pending;
+                pending.reserve(push_batch_size);
+                // numeric samples are copied into the ring (protocol 1.00 has no raw layout to parse in bulk)
+                sample_p samp;
+                std::size_t uncommitted = 0;
                 for (int k=0;!conn_.lost() && !conn_.shutdown() && !closing_stream_;k++) {
-                    // allocate and fetch a new sample						
-                    sample_p samp(factory->new_sample(0.0,false));
-					if (data_protocol_version >= 110) samp->load_streambuf(buffer,data_protocol_version,use_byte_order,suppress_subnormals); else *inarch >> *samp;
+                    // allocate and fetch a new sample (the ring needs just one)
+                    if (!ring_ || !samp)
+                        samp = factory->new_sample(0.0,false);
+					{
+						LSL_TRACE_SCOPE("load_sample");
+						if (data_protocol_version >= 110) samp->load_streambuf(buffer,data_protocol_version,use_byte_order,suppress_subnormals); else *inarch >> *samp;
+					}
                     // deduce timestamp if necessary
                     if (samp->timestamp == DEDUCED_TIMESTAMP) {
                         samp->timestamp = last_timestamp;
@@ -280,12 +294,33 @@ void data_receiver::data_thread() {
                             samp->timestamp += 1.0/srate;
                     }
                     last_timestamp = samp->timestamp;
-                    // push it into the sample queue
-                    sample_queue_.push_sample(samp);
+                    if (ring_) {
+                        double *timestamp;
+                        samp->retrieve_untyped(ring_->next_slot(timestamp));
+                        *timestamp = samp->timestamp;
+                        ring_->push_slot();
+                        if (++uncommitted == push_batch_size || buffer.in_avail() <= 0) {
+                            LSL_TRACE_SCOPE("queue_sample");
+                            ring_->commit();
+                            uncommitted = 0;
+                        }
+                    } else {
+                        // push it into the sample queue
+                        pending.push_back(samp);
+                        if (pending.size() == push_batch_size || buffer.in_avail() <= 0) {
+                            LSL_TRACE_SCOPE("queue_sample");
+                            sample_queue_.push_samples(&pending[0], pending.size());
+                            pending.clear();
+                        }
+                    }
                     // periodically update the last receive time to keep the watchdog happy
 					if (srate<=16 || (k & 0xF) == 0)
 						conn_.update_receive_time(lsl_clock());
                 }
+                if (!pending.empty())
+                    sample_queue_.push_samples(&pending[0], pending.size());
+                if (ring_)
+                    ring_->commit();
 			}
 			catch(error_code &) {
 				// connection-level error: closed, reset, refused, etc.
@@ -312,8 +347,376 @@ void data_receiver::data_thread() {
 	catch(lost_error &) {
 		// the connection was irrecoverably lost: since the pull_sample() function may
 		// be waiting for the next sample we need to wake it up by passing a sentinel
-		sample_queue_.push_sample(sample_p());
+		if (ring_)
+			ring_->interrupt();
+		else
+			sample_queue_.push_sample(sample_p());
 	}
 	conn_.release_watchdog();
 }
 
+
+/// Send the request of a data feed (protocol 1.10 or later), including the header that ends it.
+void data_receiver::send_feed_request(std::ostream &os, int proposed_protocol_version, bool shared_memory, const std::string &compression) {
+	// request line LSL:streamfeed/[ProtocolVersion] [UID]\r\n
+	os << "LSL:streamfeed/" << proposed_protocol_version << " " << conn_.current_uid() << "\r\n";
+	// transmit request parameters
+	os << "Native-Byte-Order: " << BOOST_BYTE_ORDER << "\r\n";
+	os << "Endian-Performance: " << std::floor(measure_endian_performance()) << "\r\n";
+	os << "Has-IEEE754-Floats: " << (format_ieee754[cf_float32] && format_ieee754[cf_double64]) << "\r\n";
+	os << "Supports-Subnormals: " << format_subnormal[conn_.type_info().channel_format()] << "\r\n";
+	os << "Value-Size: " << conn_.type_info().channel_bytes() << "\r\n"; // 0 for strings
+	os << "Data-Protocol-Version: " << proposed_protocol_version << "\r\n";
+	os << "Max-Buffer-Length: " << max_buflen_ << "\r\n";
+	os << "Max-Chunk-Length: " << max_chunklen_ << "\r\n";
+	os << "Hostname: " << conn_.type_info().hostname() << "\r\n";
+	os << "Source-Id: " << conn_.type_info().source_id() << "\r\n";
+	os << "Session-Id: " << conn_.type_info().session_id() << "\r\n";
+	if (shared_memory)
+		os << "Shared-Memory: 1\r\n";
+	if (compression != "off") {
+		os << "Compression: delta-bitpack\r\n";
+		os << "Compression-Mode: " << compression << "\r\n";
+	}
+	os << "\r\n";
+}
+
+/**
+* Read the response to a data feed request (protocol 1.10 or later) up to the end of its header, and extract the feed parameters.
+* @throws lost_error if the stream is not served (anymore) at the address, or another exception if the response is not acceptable.
+*/
+void data_receiver::read_feed_response(std::istream &is, int &use_byte_order, int &data_protocol_version, bool &suppress_subnormals, bool &shared_memory, uint64_t &shared_start, bool &compressed) {
+	// check server response line (LSL/[Version] [StatusCode] [Message])
+	char buf[16384] = {0};
+	if (!is.getline(buf,sizeof(buf)))
+		throw lost_error("Connection lost.");
+	std::vector<std::string> parts; split(parts,buf,is_any_of(" \t"));
+	if (parts.size() < 3 || !starts_with(parts[0],"LSL/"))
+		throw std::runtime_error("Received a malformed response.");
+	if (lslboost::lexical_cast<int>(parts[0].substr(4))/100 > api_config::get_instance()->use_protocol_version()/100)
+		throw std::runtime_error("The other party's protocol version is too new for this client; please upgrade your LSL library.");
+	int status_code = lslboost::lexical_cast<int>(parts[1]);
+	if (status_code == 404)
+		throw lost_error("The given address does not serve the resolved stream (likely outdated).");
+	if (status_code >= 400)
+		throw std::runtime_error("The other party sent an error: " + std::string(buf));
+	if (status_code >= 300)
+		throw lost_error("The other party requested a redirect.");
+
+	// receive response parameters
+	while (is.getline(buf,sizeof(buf)) && (buf[0] != '\r')) {
+		std::string hdrline(buf);
+		std::size_t colon = hdrline.find_first_of(':');
+		if (colon != std::string::npos) {
+			// extract key & value
+			std::string type = to_lower_copy(trim_copy(hdrline.substr(0,colon))), rest = to_lower_copy(trim_copy(hdrline.substr(colon+1)));
+			// strip off comments
+			std::size_t semicolon = rest.find_first_of(';');
+			if (semicolon != std::string::npos)
+				rest = rest.substr(0,semicolon);
+			// get the header information
+			if (type == "byte-order") {
+				use_byte_order = lslboost::lexical_cast<int>(rest);
+				if (use_byte_order==2134 && BOOST_BYTE_ORDER!=2134 && format_sizes[conn_.type_info().channel_format()]>=8)
+					throw std::runtime_error("The byte order conversion requested by the other party is not supported.");
+			}
+			if (type == "suppress-subnormals") 
+				suppress_subnormals = lslboost::lexical_cast<bool>(rest);
+			if (type == "uid" && rest != conn_.current_uid())
+				throw lost_error("The received UID does not match the current connection's UID.");
+			if (type == "data-protocol-version") {
+				data_protocol_version = lslboost::lexical_cast<int>(rest);
+				if (data_protocol_version > api_config::get_instance()->use_protocol_version())
+					throw std::runtime_error("The protocol version requested by the other party is not supported by this client.");
+			}
+			if (type == "shared-memory") {
+				shared_memory = true;
+				shared_start = lslboost::lexical_cast<uint64_t>(rest);
+			}
+			if (type == "compression") {
+				if (rest != "delta-bitpack" || !ring_)
+					throw std::runtime_error("The feed compression chosen by the other party is not supported.");
+				compressed = true;
+			}
+		}
+	}
+	if (!is)
+		throw lost_error("Server connection lost.");
+}
+
+/// Receive and parse two subsequent test-pattern samples and check if they are formatted as expected.
+void data_receiver::check_test_patterns(std::streambuf &buffer, eos::portable_iarchive *inarch, int data_protocol_version, int use_byte_order, bool suppress_subnormals) {
+	lslboost::scoped_ptr<sample> temp[4]; 
+	for (int k=0; k<4; temp[k++].reset(sample::factory::new_sample_unmanaged(conn_.type_info().channel_format(),conn_.type_info().channel_count(),0.0,false)));
+	temp[0]->assign_test_pattern(4);
+	if (data_protocol_version >= 110)
+		temp[1]->load_streambuf(buffer, data_protocol_version, use_byte_order, suppress_subnormals);
+	else
+		*inarch >> *temp[1];
+	temp[2]->assign_test_pattern(2);
+	if (data_protocol_version >= 110)
+		temp[3]->load_streambuf(buffer, data_protocol_version, use_byte_order, suppress_subnormals);
+	else
+		*inarch >> *temp[3];
+	if (!(*temp[0].get() == *temp[1].get()) || !(*temp[2].get() == *temp[3].get()))
+		throw std::runtime_error("The received test-pattern samples do not match the specification. The protocol formats are likely incompatible.");
+}
+
+/**
+* The transmission loop of the data thread for numeric samples (protocol 1.10 or later).
+* On the wire, such a sample is a tag byte, the time stamp (unless it is to be deduced) and the channel values, so runs of samples
+* can be parsed from a large read buffer in a tight loop rather than with a few streambuf calls per sample.
+*/
+void data_receiver::receive_samples_bulk(lslboost::asio::cancellable_streambuf<tcp> &buffer, int use_byte_order, bool suppress_subnormals) {
+	const double srate = conn_.current_srate();
+	std::vector<char> data(std::max(bulk_read_bytes,4*(1+sizeof(double)+ring_->sample_bytes())));
+	std::size_t have = 0;	// bytes of data that are not parsed yet
+	double last_timestamp = 0.0;
+	while (!conn_.lost() && !conn_.shutdown() && !closing_stream_) {
+		std::size_t count = buffer.read_some(&data[have],data.size()-have);
+		if (!count)
+			throw std::runtime_error("Input stream error.");
+		have += count;
+		// keep the incomplete sample at the end for the next read
+		std::size_t parsed = load_samples_bulk(&data[0],have,use_byte_order,suppress_subnormals,srate,last_timestamp);
+		have -= parsed;
+		memmove(&data[0],&data[parsed],have);
+		conn_.update_receive_time(lsl_clock());
+	}
+}
+
+/**
+* The transmission loop of the data thread for samples that are read from the shared-memory ring of an outlet on the same host.
+* The TCP connection stays open (it tells the outlet that we are still attached) but carries no more data.
+* @param cursor The index of the first sample to read (as assigned by the outlet when it attached us).
+*/
+void data_receiver::receive_samples_shared(shm_ring &shared, uint64_t cursor) {
+	for (int idle=0; !conn_.lost() && !conn_.shutdown() && !closing_stream_; ) {
+		if (shared.read(*ring_,cursor)) {
+			conn_.update_receive_time(lsl_clock());
+			idle = 0;
+			continue;
+		}
+		if (shared.closed())
+			throw lost_error("The outlet has closed its shared-memory segment.");
+		// (the process of the outlet is checked once per second without new samples)
+		if (++idle % 1000 == 0 && !shared.writer_alive())
+			throw lost_error("The process of the outlet has terminated.");
+		lslboost::this_thread::sleep(lslboost::posix_time::milliseconds(1));
+	}
+}
+
+/**
+* The transmission loop of the data thread for a compressed feed (see feed_encoder).
+* Each frame is decoded into the ring and published as a whole.
+*/
+void data_receiver::receive_samples_compressed(std::streambuf &buffer, bool suppress_subnormals) {
+	feed_decoder decoder(conn_.type_info().channel_format(),conn_.type_info().channel_count());
+	const double srate = conn_.current_srate();
+	double last_timestamp = 0.0;
+	while (!conn_.lost() && !conn_.shutdown() && !closing_stream_) {
+		decoder.decode(buffer,*ring_,srate,last_timestamp,suppress_subnormals);
+		conn_.update_receive_time(lsl_clock());
+	}
+}
+
+/**
+* Parse all complete samples at the beginning of a buffer into the ring and publish them.
+* @param last_timestamp The time stamp of the previous sample (updated).
+* @return The number of bytes parsed.
+*/
+std::size_t data_receiver::load_samples_bulk(const char *data, std::size_t size, int use_byte_order, bool suppress_subnormals, double srate, double &last_timestamp) {
+	LSL_TRACE_SCOPE("load_samples");
+	return ring_->load_samples(data,size,use_byte_order,suppress_subnormals,srate,last_timestamp);
+}
+
+
+// === reception on the shared I/O pool ===
+
+/// Cancel the current connection of the reception on the I/O pool.
+void data_receiver::cancel_async() {
+	pending_.begin();
+	io_->post(strand_->wrap(lslboost::bind(&data_receiver::close_async,this)));
+}
+
+/// Close the socket of the current connection (which fails its pending operation).
+void data_receiver::close_async() {
+	pending_operations::scope done(pending_);
+	if (sock_) {
+		error_code ec;
+		sock_->close(ec);
+	}
+}
+
+/// Connect to the stream (the start of each connection of the reception on the I/O pool).
+void data_receiver::connect_async() {
+	pending_operations::scope done(pending_);
+	if (conn_.lost() || conn_.shutdown() || closing_stream_)
+		return end_async();
+	try {
+		sock_.reset(new tcp::socket(*io_));
+		feedbuf_.consume(feedbuf_.size());
+		tcp::endpoint endpoint(conn_.get_tcp_endpoint());
+		pending_.begin();
+		sock_->async_connect(endpoint,strand_->wrap(lslboost::bind(&data_receiver::handle_connect_outcome,this,placeholders::error)));
+	} catch(...) {
+		async_error();
+	}
+}
+
+/// Handler that gets called when the connection has been established: send the feed request.
+void data_receiver::handle_connect_outcome(error_code err) {
+	pending_operations::scope done(pending_);
+	try {
+		if (err)
+			throw err;
+		std::ostringstream request;
+		// (the asynchronous parser only reads the uncompressed format, so FeedCompression does not apply to pooled inlets)
+		send_feed_request(request,std::min(api_config::get_instance()->use_protocol_version(),conn_.type_info().version()),false,"off");
+		request_ = request.str();
+		pending_.begin();
+		async_write(*sock_,buffer(request_),strand_->wrap(lslboost::bind(&data_receiver::handle_request_outcome,this,placeholders::error)));
+	} catch(...) {
+		async_error();
+	}
+}
+
+/// Handler that gets called when the feed request has been sent: receive the response header.
+void data_receiver::handle_request_outcome(error_code err) {
+	pending_operations::scope done(pending_);
+	try {
+		if (err)
+			throw err;
+		pending_.begin();
+		async_read_until(*sock_,feedbuf_,"\r\n\r\n",strand_->wrap(lslboost::bind(&data_receiver::handle_response_outcome,this,placeholders::error)));
+	} catch(...) {
+		async_error();
+	}
+}
+
+/// Handler that gets called when the response header has been received: receive the test patterns.
+void data_receiver::handle_response_outcome(error_code err) {
+	pending_operations::scope done(pending_);
+	try {
+		if (err)
+			throw err;
+		std::istream response(&feedbuf_);
+		int data_protocol_version = 100;
+		use_byte_order_ = 0;
+		suppress_subnormals_ = false;
+		bool shared_memory = false, compressed = false;	// (not asked for)
+		uint64_t shared_start = 0;
+		read_feed_response(response,use_byte_order_,data_protocol_version,suppress_subnormals_,shared_memory,shared_start,compressed);
+		if (data_protocol_version < 110)
+			throw std::runtime_error("The other party requested a data protocol version that this inlet can only receive with its own data thread.");
+		// the test patterns are two samples with transmitted time stamps
+		const std::size_t pattern_bytes = 2*(1+sizeof(double)+ring_->sample_bytes());
+		pending_.begin();
+		if (feedbuf_.size() >= pattern_bytes)
+			io_->post(strand_->wrap(lslboost::bind(&data_receiver::handle_test_patterns_outcome,this,error_code())));
+		else
+			async_read(*sock_,feedbuf_,transfer_at_least(pattern_bytes-feedbuf_.size()),strand_->wrap(lslboost::bind(&data_receiver::handle_test_patterns_outcome,this,placeholders::error)));
+	} catch(...) {
+		async_error();
+	}
+}
+
+/// Handler that gets called when the test patterns have been received: check them and start receiving samples.
+void data_receiver::handle_test_patterns_outcome(error_code err) {
+	pending_operations::scope done(pending_);
+	try {
+		if (err)
+			throw err;
+		check_test_patterns(feedbuf_,NULL,110,use_byte_order_,suppress_subnormals_);
+		{
+			lslboost::lock_guard<lslboost::mutex> lock(connected_mut_);
+			connected_ = true;
+		}
+		connected_upd_.notify_all();
+		// parse the samples that arrived along with the test patterns
+		srate_ = conn_.current_srate();
+		last_timestamp_ = 0.0;
+		recv_have_ = feedbuf_.size();
+		if (recvbuf_.size() < recv_have_)
+			recvbuf_.resize(recv_have_);
+		feedbuf_.sgetn(&recvbuf_[0],recv_have_);
+		pending_.begin();
+		handle_data_outcome(error_code(),0);
+	} catch(...) {
+		async_error();
+	}
+}
+
+/// Handler that gets called when data has been received: parse the complete samples and read on.
+void data_receiver::handle_data_outcome(error_code err, std::size_t len) {
+	pending_operations::scope done(pending_);
+	try {
+		if (err)
+			throw err;
+		if (conn_.lost() || conn_.shutdown() || closing_stream_)
+			throw lost_error("The connection is shut down.");
+		recv_have_ += len;
+		// keep the incomplete sample at the end for the next read
+		std::size_t parsed = load_samples_bulk(&recvbuf_[0],recv_have_,use_byte_order_,suppress_subnormals_,srate_,last_timestamp_);
+		recv_have_ -= parsed;
+		memmove(&recvbuf_[0],&recvbuf_[parsed],recv_have_);
+		conn_.update_receive_time(lsl_clock());
+		pending_.begin();
+		sock_->async_read_some(buffer(&recvbuf_[recv_have_],recvbuf_.size()-recv_have_),
+			strand_->wrap(lslboost::bind(&data_receiver::handle_data_outcome,this,placeholders::error,placeholders::bytes_transferred)));
+	} catch(...) {
+		async_error();
+	}
+}
+
+/**
+* Handle an error of the reception on the I/O pool (called from within a catch block) like the data thread does:
+* the connection is recovered in a thread of its own (since that blocks), which then reconnects.
+*/
+void data_receiver::async_error() {
+	try {
+		throw;
+	} catch(error_code &) {
+		// connection-level error: closed, reset, refused, etc.
+	} catch(lost_error &) {
+		// another type of connection error
+	} catch(std::exception &e) {
+		// some perhaps more serious transmission or parsing error (could be indicative of a protocol issue)
+		if (!conn_.shutdown() && !closing_stream_)
+			std::cerr << "Stream transmission broke off (" << e.what() << "); re-connecting..." << std::endl;
+	} catch(...) {
+		std::cerr << "Stream transmission broke off with an unknown error; re-connecting..." << std::endl;
+	}
+	if (sock_) {
+		error_code ec;
+		sock_->close(ec);
+	}
+	if (conn_.lost() || conn_.shutdown() || closing_stream_)
+		return end_async();
+	// (the previous recovery thread has finished its work: it scheduled the connection that failed)
+	if (recovery_thread_.joinable())
+		recovery_thread_.join();
+	recovery_thread_ = lslboost::thread(&data_receiver::recover_async,this);
+}
+
+/// Recover the connection after an error and schedule the next connection attempt (runs in the recovery thread).
+void data_receiver::recover_async() {
+	try {
+		conn_.try_recover_from_error();
+		// wait for a few msec so as to not spam the provider with reconnects
+		lslboost::this_thread::sleep(lslboost::posix_time::millisec(500));
+	} catch(std::exception &) {
+		// the connection has been lost irrecoverably, which connect_async() will find
+	}
+	pending_.begin();
+	io_->post(strand_->wrap(lslboost::bind(&data_receiver::connect_async,this)));
+}
+
+/// End the reception on the I/O pool.
+void data_receiver::end_async() {
+	sock_.reset();
+	// since the pull functions may be waiting for the next sample, we need to wake them up if the connection is gone
+	if (conn_.lost() || conn_.shutdown())
+		ring_->interrupt();
+	conn_.release_watchdog();
+}
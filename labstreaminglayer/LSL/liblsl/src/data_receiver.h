@@ -2,7 +2,12 @@
 #define DATA_RECEIVER_H
 
 #include <boost/thread/thread.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/streambuf.hpp>
 #include "consumer_queue.h"
+#include "sample_ring.h"
+#include "shm_ring.h"
 #include "inlet_connection.h"
 #include "cancellable_streambuf.h"
 
@@ -10,12 +15,20 @@
 
 using lslboost::asio::ip::tcp;
 
+namespace eos {
+	class portable_iarchive;
+}
+
 namespace lsl {
 
 	/// Internal class of an inlet that is responsible for retrieving the data (the samples) of the inlet.
 	/// The actual communication runs in an internal background thread, while the public functions (pull_sample_typed/untyped, open_stream, close_stream) wait for the thread to finish.
 	/// The public functions have an optional timeout after which they give up, while the background thread continues to do its job (so the next public-function call may succeed within the timeout).
 	/// The background thread terminates only if the data_receiver is destroyed or the underlying connection is lost or shut down.
+	/// If the inlets share an I/O pool (tuning.InletIOThreads), numeric streams (protocol 1.10 or later) are received by asynchronous
+	/// operations on that pool instead, and only the recovery of a broken connection gets a thread of its own while it runs.
+	/// A data thread that receives a numeric stream from an outlet on the same host asks for the shared-memory transport,
+	/// in which case it copies the samples from the outlet's shared-memory ring rather than from the socket.
 	class data_receiver: public cancellable_registry {
 	public:
 		/**
@@ -54,9 +67,20 @@ namespace lsl {
 			if (conn_.lost())
 				throw lost_error("The stream read by this outlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
 			// start data thread implicitly if necessary
-			if (check_thread_start_ && !data_thread_.joinable()) {
-				data_thread_ = lslboost::thread(&data_receiver::data_thread,this);
-				check_thread_start_ = false;
+			if (check_thread_start_)
+				start_data_thread();
+			if (ring_) {
+				// get the sample straight from the ring
+				double timestamp = 0.0;
+				if (ring_->wait(timeout)) {
+					if (buffer_elements != conn_.type_info().channel_count())
+						throw std::range_error("The number of buffer elements provided does not match the number of channels in the sample.");
+					if (ring_->pop_samples(buffer, &timestamp, 1))
+						return timestamp;
+				}
+				if (conn_.lost())
+					throw lost_error("The stream read by this inlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
+				return 0.0;
 			}
 			// get the sample with timeout
 			if (sample_p s = sample_queue_.pop_sample(timeout)) {
@@ -71,16 +95,136 @@ namespace lsl {
 			}
 		}
 
+		/**
+		* Retrieve up to max_samples samples from the sample queue into a typed buffer (the channel
+		* values of one sample after another) and their time stamps.
+		* The samples are taken from the queue in batches rather than one at a time, or, for numeric
+		* streams, copied out of the sample ring in contiguous pieces.
+		* @param timeout The time to wait for the buffer to fill up; the default of 0.0 retrieves
+		*				  only the samples available for immediate pickup.
+		* @return The number of samples retrieved.
+		*/
+		template<class T> std::size_t pull_chunk_typed(T *buffer, double *timestamps, std::size_t max_samples, double timeout=0.0) {
+			if (conn_.lost())
+				throw lost_error("The stream read by this outlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
+			// start data thread implicitly if necessary
+			if (check_thread_start_)
+				start_data_thread();
+			const std::size_t num_chans = conn_.type_info().channel_count();
+			const double end_time = timeout ? lsl_clock()+timeout : 0.0;
+			if (ring_) {
+				std::size_t samples_written = 0;
+				while (samples_written < max_samples && ring_->wait(timeout?end_time-lsl_clock():0.0))
+					samples_written += ring_->pop_samples(&buffer[samples_written*num_chans], &timestamps[samples_written], max_samples-samples_written);
+				if (!samples_written && conn_.lost())
+					throw lost_error("The stream read by this inlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
+				return samples_written;
+			}
+			sample_p batch[pull_batch_size];
+			std::size_t samples_written = 0;
+			while (samples_written < max_samples) {
+				std::size_t popped = sample_queue_.pop_samples(batch, std::min(pull_batch_size, max_samples-samples_written), timeout?end_time-lsl_clock():0.0);
+				for (std::size_t k=0; k<popped; k++) {
+					if (!batch[k]) {
+						// a wakeup sentinel of the data thread
+						if (conn_.lost())
+							throw lost_error("The stream read by this inlet has been lost. To recover, you need to re-resolve the source and re-create the inlet.");
+						return samples_written;
+					}
+					batch[k]->retrieve_typed(&buffer[samples_written*num_chans]);
+					timestamps[samples_written++] = batch[k]->timestamp;
+				}
+				if (!popped)
+					break;
+			}
+			return samples_written;
+		}
+
 		/// Read sample from the inlet and read it into a pointer to raw data.
 		double pull_sample_untyped(void *buffer, int buffer_bytes, double timeout=FOREVER);
 
 		/// Check whether the underlying buffer is empty. This value may be inaccurate.
-		bool empty() { return sample_queue_.empty(); };
+		bool empty() { return ring_ ? ring_->empty() : sample_queue_.empty(); };
+
+		/// The number of samples in the underlying buffer. This value may be inaccurate.
+		std::size_t size() { return ring_ ? ring_->size() : sample_queue_.size(); };
 
 	private:
+		/// number of samples that pull_chunk_typed() takes from the queue at a time
+		static const std::size_t pull_batch_size = 256;
+		/// number of received samples that the data thread queues at a time, at most
+		static const std::size_t push_batch_size = 256;
+		/// number of bytes that the data thread reads from the socket at a time, at most (numeric streams, protocol 1.10)
+		static const std::size_t bulk_read_bytes = 65536;
+
+		/// Start the data thread (or the reception on the shared I/O pool) unless it has been started before.
+		void start_data_thread();
+
 		/// The data reader thread.
 		void data_thread();
 
+		/// Send the request of a data feed (protocol 1.10 or later), including the header that ends it.
+		void send_feed_request(std::ostream &os, int proposed_protocol_version, bool shared_memory, const std::string &compression);
+
+		/// Read the response to a data feed request (protocol 1.10 or later) up to the end of its header, and extract the feed parameters.
+		void read_feed_response(std::istream &is, int &use_byte_order, int &data_protocol_version, bool &suppress_subnormals, bool &shared_memory, uint64_t &shared_start, bool &compressed);
+
+		/// Receive and parse two subsequent test-pattern samples and check if they are formatted as expected.
+		void check_test_patterns(std::streambuf &buffer, eos::portable_iarchive *inarch, int data_protocol_version, int use_byte_order, bool suppress_subnormals);
+
+		/**
+		* The transmission loop of the data thread for numeric samples (protocol 1.10 or later).
+		* Reads whatever the socket has, parses all complete samples of it straight into the ring
+		* (converting the channel values of consecutive slots in one pass) and publishes them at once.
+		*/
+		void receive_samples_bulk(lslboost::asio::cancellable_streambuf<tcp> &buffer, int use_byte_order, bool suppress_subnormals);
+
+		/**
+		* The transmission loop of the data thread for samples that are read from the shared-memory ring of an outlet on the same host.
+		* Copies the new samples into the ring, or polls again after a millisecond if there are none.
+		*/
+		void receive_samples_shared(shm_ring &shared, uint64_t cursor);
+
+		/// The transmission loop of the data thread for a compressed feed (see feed_encoder); decodes one frame after another into the ring.
+		void receive_samples_compressed(std::streambuf &buffer, bool suppress_subnormals);
+
+		/// Parse all complete samples at the beginning of a buffer into the ring and publish them; returns the number of bytes parsed.
+		std::size_t load_samples_bulk(const char *data, std::size_t size, int use_byte_order, bool suppress_subnormals, double srate, double &last_timestamp);
+
+		// === reception on the shared I/O pool (a chain of handlers per connection) ===
+
+		/// Cancels the current connection of the reception on the I/O pool (the counterpart of the data thread's cancellable stream buffer).
+		class async_canceller: public cancellable_obj {
+		public:
+			explicit async_canceller(data_receiver &receiver): receiver_(receiver) {}
+			virtual void cancel() { receiver_.cancel_async(); }
+		private:
+			data_receiver &receiver_;
+		};
+
+		/// Cancel the current connection of the reception on the I/O pool.
+		void cancel_async();
+		/// Close the socket of the current connection (which fails its pending operation).
+		void close_async();
+		/// Connect to the stream (the start of each connection).
+		void connect_async();
+		/// Handler that gets called when the connection has been established: send the feed request.
+		void handle_connect_outcome(error_code err);
+		/// Handler that gets called when the feed request has been sent: receive the response header.
+		void handle_request_outcome(error_code err);
+		/// Handler that gets called when the response header has been received: receive the test patterns.
+		void handle_response_outcome(error_code err);
+		/// Handler that gets called when the test patterns have been received: check them and start receiving samples.
+		void handle_test_patterns_outcome(error_code err);
+		/// Handler that gets called when data has been received: parse the complete samples and read on.
+		void handle_data_outcome(error_code err, std::size_t len);
+		/// Handle an error of the reception (called from within a catch block) like the data thread does.
+		void async_error();
+		/// Recover the connection after an error and schedule the next connection attempt (runs in the recovery thread).
+		void recover_async();
+		/// End the reception on the I/O pool.
+		void end_async();
+
 		/// Function that is polled by the condition variable
 		bool connection_completed() { return connected_ || conn_.lost(); }
 
@@ -94,12 +238,31 @@ namespace lsl {
 		bool closing_stream_;						// indicates to the data thread that it a close has been requested
 		bool connected_;							// whether the stream has been connected / opened
 		consumer_queue sample_queue_;				// queue of samples ready to be picked up (populated by the data thread)
+		lslboost::scoped_ptr<sample_ring> ring_;		// used instead of the queue for numeric streams
 		lslboost::mutex connected_mut_;				// mutex to protect the connected state
 		lslboost::condition_variable connected_upd_;	// condition variable to indicate that an update for the connected state is available
 
 		// internal data used by the reader thread
 		int max_buflen_;							// the maximum number of samples to be buffered for this inlet
 		int max_chunklen_;							// the desired maximum chunklen for received samples
+		bool shared_memory_;						// whether the data thread asks for the shared-memory transport
+
+		// fields related to the reception on the shared I/O pool (used instead of the data thread if enabled)
+		io_service_p io_;							// the shared io_service of the inlets (empty if the data thread is used)
+		lslboost::scoped_ptr<lslboost::asio::io_service::strand> strand_;	// serializes the handlers of the reception
+		bool async_started_;						// whether the reception has been started
+		async_canceller canceller_;					// registered at the inlet connection and at this receiver
+		lslboost::scoped_ptr<tcp::socket> sock_;		// the socket of the current connection
+		std::string request_;						// the feed request being sent
+		lslboost::asio::streambuf feedbuf_;			// receives the response header and the test patterns
+		std::vector<char> recvbuf_;					// receives the samples
+		std::size_t recv_have_;						// bytes of recvbuf_ that are not parsed yet
+		int use_byte_order_;						// the byte order of the current connection
+		bool suppress_subnormals_;					// whether the current connection suppresses subnormal numbers
+		double srate_;								// the nominal sampling rate at the time of connection
+		double last_timestamp_;						// the time stamp of the last received sample (to deduce the next one)
+		pending_operations pending_;				// the pending handlers (waited for at destruction)
+		lslboost::thread recovery_thread_;			// recovers the connection after an error
 	};
 
 }
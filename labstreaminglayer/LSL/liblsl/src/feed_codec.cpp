@@ -0,0 +1,297 @@
+#include "feed_codec.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "trace.h"
+
+
+// === implementation of the feed_encoder and feed_decoder classes ===
+
+using namespace lsl;
+
+/// bytes of a frame header (payload bytes, number of samples, encoding)
+static const std::size_t frame_header_bytes = 9;
+/// number of residuals per bit-packed block
+static const std::size_t block_size = 32;
+
+/// Load a channel value as a 64-bit pattern (sign-extended for integers).
+static inline uint64_t load_value(const char *p, int bytes, bool sign_extend) {
+	switch (bytes) {
+		case 1: { uint8_t x; memcpy(&x,p,1); return sign_extend ? (uint64_t)(int64_t)(int8_t)x : x; }
+		case 2: { uint16_t x; memcpy(&x,p,2); return sign_extend ? (uint64_t)(int64_t)(int16_t)x : x; }
+		case 4: { uint32_t x; memcpy(&x,p,4); return sign_extend ? (uint64_t)(int64_t)(int32_t)x : x; }
+		default: { uint64_t x; memcpy(&x,p,8); return x; }
+	}
+}
+
+/// Store the low bytes of a 64-bit pattern as a channel value.
+static inline void store_value(char *p, int bytes, uint64_t v) {
+	switch (bytes) {
+		case 1: { uint8_t x = (uint8_t)v; memcpy(p,&x,1); break; }
+		case 2: { uint16_t x = (uint16_t)v; memcpy(p,&x,2); break; }
+		case 4: { uint32_t x = (uint32_t)v; memcpy(p,&x,4); break; }
+		default: memcpy(p,&v,8);
+	}
+}
+
+/// Map a difference (two's complement) to an unsigned number that is small if the difference is small in magnitude.
+static inline uint64_t zigzag(uint64_t d) { return (d << 1) ^ (0 - (d >> 63)); }
+static inline uint64_t unzigzag(uint64_t z) { return (z >> 1) ^ (0 - (z & 1)); }
+
+/// The number of bits needed to hold a number.
+static inline int bit_width(uint64_t x) {
+#if defined(__GNUC__)
+	return x ? 64 - __builtin_clzll(x) : 0;
+#else
+	int w = 0;
+	for (; x; x >>= 1, w++);
+	return w;
+#endif
+}
+
+/// A mask of the low w bits.
+static inline uint64_t low_bits(int w) { return w >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << w) - 1; }
+
+/// Appends bit fields to a byte vector (least significant bit first).
+class bit_writer {
+public:
+	explicit bit_writer(std::vector<char> &out): out_(out), acc_(0), nbits_(0) {}
+
+	/// Append the low w bits of a value.
+	void put(uint64_t v, int w) {
+		if (!w)
+			return;
+		acc_ |= v << nbits_;
+		if (nbits_ + w >= 64) {
+			write_bytes(8);
+			acc_ = nbits_ ? v >> (64 - nbits_) : 0;
+			nbits_ = nbits_ + w - 64;
+		} else
+			nbits_ += w;
+	}
+
+	/// Append the remaining bits, padded to a whole byte.
+	void flush() {
+		write_bytes((nbits_ + 7)/8);
+		acc_ = 0;
+		nbits_ = 0;
+	}
+
+private:
+	void write_bytes(int n) {
+		for (int k=0; k<n; k++)
+			out_.push_back((char)(uint8_t)(acc_ >> (8*k)));
+	}
+
+	std::vector<char> &out_;
+	uint64_t acc_;
+	int nbits_;
+};
+
+/// Reads bit fields from a byte range (least significant bit first).
+class bit_reader {
+public:
+	bit_reader(const char *begin, const char *end): p_((const uint8_t*)begin), end_((const uint8_t*)end), acc_(0), nbits_(0) {}
+
+	/// Read a field of w bits.
+	uint64_t get(int w) {
+		if (!w)
+			return 0;
+		if (nbits_ >= w) {
+			uint64_t result = acc_ & low_bits(w);
+			acc_ = w < 64 ? acc_ >> w : 0;
+			nbits_ -= w;
+			return result;
+		}
+		// take the remaining bits, then refill
+		uint64_t result = acc_;
+		const int have = nbits_, need = w - have;
+		acc_ = 0;
+		for (nbits_=0; nbits_ < 64 && p_ < end_; nbits_ += 8)
+			acc_ |= (uint64_t)*p_++ << nbits_;
+		if (nbits_ < need)
+			throw std::runtime_error("Malformed frame in the compressed data feed.");
+		result |= (acc_ & low_bits(need)) << have;
+		acc_ = need < 64 ? acc_ >> need : 0;
+		nbits_ -= need;
+		return result;
+	}
+
+private:
+	const uint8_t *p_, *end_;
+	uint64_t acc_;
+	int nbits_;
+};
+
+/// The number of payload bytes that a frame of n samples may have, at most.
+static std::size_t max_payload_bytes(std::size_t n, std::size_t sample_bytes, int num_channels) {
+	// tags, time stamps, and values (a residual can have one bit more than the value it encodes) plus the block widths
+	return n*(1 + sizeof(double) + sample_bytes + (num_channels+7)/8) + num_channels*((n+block_size-1)/block_size);
+}
+
+
+/// Create an encoder for a stream with the given format (must not be cf_string) and channel count.
+feed_encoder::feed_encoder(channel_format_t fmt, int num_channels): format_(fmt), num_channels_(num_channels), sample_bytes_(format_sizes[fmt]*num_channels) {
+	if (fmt == cf_string)
+		throw std::invalid_argument("String-formatted streams cannot be compressed.");
+}
+
+/**
+* Append the samples [begin,end) of a chunk to a stream buffer (in frames of at most max_frame_bytes of channel values).
+* @return The number of bytes appended.
+*/
+std::size_t feed_encoder::encode(const sample_chunk &chunk, std::size_t begin, std::size_t end, bool compress, std::streambuf &sb) {
+	const std::size_t frame_samples = std::max<std::size_t>(max_frame_bytes/sample_bytes_, 1);
+	std::size_t bytes = 0;
+	for (std::size_t k=begin; k<end; k+=frame_samples)
+		bytes += encode_frame(chunk, k, std::min(end, k+frame_samples), compress, sb);
+	return bytes;
+}
+
+/// Append one frame with the samples [begin,end) of a chunk.
+std::size_t feed_encoder::encode_frame(const sample_chunk &chunk, std::size_t begin, std::size_t end, bool compress, std::streambuf &sb) {
+	const std::size_t n = end - begin;
+	const double *timestamps = chunk.timestamps() + begin;
+	const char *values = chunk.values() + begin*sample_bytes_;
+	frame_.resize(frame_header_bytes);
+	// the tags and the transmitted time stamps
+	for (std::size_t k=0; k<n; k++)
+		frame_.push_back((char)(timestamps[k] == DEDUCED_TIMESTAMP ? TAG_DEDUCED_TIMESTAMP : TAG_TRANSMITTED_TIMESTAMP));
+	for (std::size_t k=0; k<n; k++)
+		if (timestamps[k] != DEDUCED_TIMESTAMP)
+			frame_.insert(frame_.end(), (const char*)&timestamps[k], (const char*)&timestamps[k] + sizeof(double));
+	// the channel values
+	const std::size_t values_at = frame_.size();
+	uint8_t encoding = feed_raw;
+	if (compress) {
+		const int value_bytes = format_sizes[format_];
+		const bool is_float = format_float[format_];
+		uint64_t residuals[block_size];
+		bit_writer out(frame_);
+		for (int c=0; c<num_channels_; c++) {
+			const char *p = values + c*value_bytes;
+			uint64_t prev = 0;
+			for (std::size_t k0=0; k0<n; k0+=block_size) {
+				const std::size_t m = std::min(block_size, n-k0);
+				uint64_t all = 0;
+				for (std::size_t j=0; j<m; j++, p+=sample_bytes_) {
+					const uint64_t v = load_value(p, value_bytes, !is_float);
+					residuals[j] = is_float ? v ^ prev : zigzag(v - prev);
+					all |= residuals[j];
+					prev = v;
+				}
+				const int width = bit_width(all);
+				frame_.push_back((char)width);
+				for (std::size_t j=0; j<m; j++)
+					out.put(residuals[j], width);
+				out.flush();
+			}
+		}
+		if (frame_.size() - values_at < n*sample_bytes_)
+			encoding = feed_delta_bitpack;
+		else
+			frame_.resize(values_at);
+	}
+	if (encoding == feed_raw)
+		frame_.insert(frame_.end(), values, values + n*sample_bytes_);
+	// the header
+	const uint32_t payload_bytes = (uint32_t)(frame_.size() - frame_header_bytes), num_samples = (uint32_t)n;
+	memcpy(&frame_[0], &payload_bytes, 4);
+	memcpy(&frame_[4], &num_samples, 4);
+	frame_[8] = (char)encoding;
+	sb.sputn(&frame_[0], (std::streamsize)frame_.size());
+	return frame_.size();
+}
+
+
+/// Create a decoder for a stream with the given format (must not be cf_string) and channel count.
+feed_decoder::feed_decoder(channel_format_t fmt, int num_channels): format_(fmt), num_channels_(num_channels), sample_bytes_(format_sizes[fmt]*num_channels) {
+	if (fmt == cf_string)
+		throw std::invalid_argument("String-formatted streams cannot be compressed.");
+}
+
+/**
+* Read the next frame from a stream buffer and append its samples to a ring (publishing them).
+* @return The number of samples appended.
+*/
+std::size_t feed_decoder::decode(std::streambuf &sb, sample_ring &ring, double srate, double &last_timestamp, bool suppress_subnormals) {
+	// read the header and the payload
+	char header[frame_header_bytes];
+	if (sb.sgetn(header, (std::streamsize)frame_header_bytes) != (std::streamsize)frame_header_bytes)
+		throw std::runtime_error("Input stream error.");
+	uint32_t payload_bytes, num_samples;
+	memcpy(&payload_bytes, &header[0], 4);
+	memcpy(&num_samples, &header[4], 4);
+	const uint8_t encoding = (uint8_t)header[8];
+	const std::size_t n = num_samples;
+	if (!n || (n > 1 && n*sample_bytes_ > feed_encoder::max_frame_bytes) || encoding > feed_delta_bitpack || payload_bytes > max_payload_bytes(n, sample_bytes_, num_channels_))
+		throw std::runtime_error("Malformed frame header in the compressed data feed.");
+	frame_.resize(payload_bytes);
+	if (payload_bytes && sb.sgetn(&frame_[0], (std::streamsize)payload_bytes) != (std::streamsize)payload_bytes)
+		throw std::runtime_error("Input stream error.");
+	LSL_TRACE_SCOPE("decode_frame");
+	const char *p = payload_bytes ? &frame_[0] : NULL, *end = p + payload_bytes;
+
+	// the tags and time stamps
+	if ((std::size_t)(end-p) < n)
+		throw std::runtime_error("Malformed frame in the compressed data feed.");
+	const char *tags = p;
+	p += n;
+	timestamps_.resize(n);
+	for (std::size_t k=0; k<n; k++) {
+		if ((uint8_t)tags[k] == TAG_DEDUCED_TIMESTAMP) {
+			timestamps_[k] = last_timestamp;
+			if (srate != IRREGULAR_RATE)
+				timestamps_[k] += 1.0/srate;
+		} else {
+			if ((std::size_t)(end-p) < sizeof(double))
+				throw std::runtime_error("Malformed frame in the compressed data feed.");
+			memcpy(&timestamps_[k], p, sizeof(double));
+			p += sizeof(double);
+		}
+		last_timestamp = timestamps_[k];
+	}
+
+	// the channel values
+	values_.resize(n*sample_bytes_);
+	if (encoding == feed_raw) {
+		if ((std::size_t)(end-p) != n*sample_bytes_)
+			throw std::runtime_error("Malformed frame in the compressed data feed.");
+		memcpy(&values_[0], p, n*sample_bytes_);
+	} else {
+		const int value_bytes = format_sizes[format_];
+		const bool is_float = format_float[format_];
+		for (int c=0; c<num_channels_; c++) {
+			char *q = &values_[c*value_bytes];
+			uint64_t prev = 0;
+			for (std::size_t k0=0; k0<n; k0+=block_size) {
+				const std::size_t m = std::min(block_size, n-k0);
+				if (p >= end || (uint8_t)*p > 64)
+					throw std::runtime_error("Malformed frame in the compressed data feed.");
+				const int width = (uint8_t)*p++;
+				const std::size_t block_bytes = (m*width + 7)/8;
+				if ((std::size_t)(end-p) < block_bytes)
+					throw std::runtime_error("Malformed frame in the compressed data feed.");
+				bit_reader in(p, p + block_bytes);
+				for (std::size_t j=0; j<m; j++, q+=sample_bytes_) {
+					const uint64_t r = in.get(width);
+					prev = is_float ? prev ^ r : prev + unzigzag(r);
+					store_value(q, value_bytes, prev);
+				}
+				p += block_bytes;
+			}
+		}
+	}
+	if (suppress_subnormals && format_float[format_])
+		sample::convert_channels_raw(&values_[0], format_, (int)(n*num_channels_), BOOST_BYTE_ORDER, true);
+
+	// append the samples to the ring
+	for (std::size_t k=0; k<n; k++) {
+		double *timestamp;
+		memcpy(ring.next_slot(timestamp), &values_[k*sample_bytes_], sample_bytes_);
+		*timestamp = timestamps_[k];
+		ring.push_slot();
+	}
+	ring.commit();
+	return n;
+}
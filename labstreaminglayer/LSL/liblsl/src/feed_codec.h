@@ -0,0 +1,79 @@
+#ifndef FEED_CODEC_H
+#define FEED_CODEC_H
+
+#include <streambuf>
+#include <vector>
+#include "sample_chunk.h"
+#include "sample_ring.h"
+
+namespace lsl {
+
+	/// The encodings of the channel values of a frame of a compressed feed.
+	enum feed_encoding {
+		feed_raw = 0,					// the channel values of one sample after another
+		feed_delta_bitpack = 1			// per-channel residuals, bit-packed in blocks
+	};
+
+	/**
+	* Encoder of the compressed data feed ("Compression: delta-bitpack", numeric streams in protocol 1.10 whose parties share a byte order).
+	* A compressed feed is a sequence of frames, each holding a run of samples:
+	* - the number of payload bytes (uint32), the number of samples (uint32) and the encoding (uint8), in native byte order;
+	* - one tag byte per sample (as in protocol 1.10), then the transmitted time stamps, then the channel values.
+	* In the delta-bitpack encoding, each channel's values become residuals against the channel's previous value in the frame
+	* (the zigzag-coded difference for integers, the XOR of the bit patterns for floating-point numbers), which are bit-packed
+	* in blocks of 32 with the bit width of the largest residual of the block (one byte ahead of the block). Slowly changing signals
+	* thus need only a few bits per value. A frame falls back to raw values if these would be smaller.
+	*/
+	class feed_encoder {
+	public:
+		/// Create an encoder for a stream with the given format (must not be cf_string) and channel count.
+		feed_encoder(channel_format_t fmt, int num_channels);
+
+		/**
+		* Append the samples [begin,end) of a chunk to a stream buffer (in frames of at most max_frame_bytes of channel values).
+		* @param compress Whether to delta-bitpack the channel values (otherwise they are sent raw).
+		* @return The number of bytes appended.
+		*/
+		std::size_t encode(const sample_chunk &chunk, std::size_t begin, std::size_t end, bool compress, std::streambuf &sb);
+
+		/// bytes of channel values that a frame holds at most (unless a single sample is larger)
+		static const std::size_t max_frame_bytes = 1 << 20;
+
+	private:
+		/// Append one frame with the samples [begin,end) of a chunk.
+		std::size_t encode_frame(const sample_chunk &chunk, std::size_t begin, std::size_t end, bool compress, std::streambuf &sb);
+
+		channel_format_t format_;					// the channel format
+		int num_channels_;							// number of channels
+		std::size_t sample_bytes_;					// bytes of the channel values of a sample
+		std::vector<char> frame_;					// the frame being encoded
+	};
+
+	/// Decoder of the compressed data feed (see feed_encoder).
+	class feed_decoder {
+	public:
+		/// Create a decoder for a stream with the given format (must not be cf_string) and channel count.
+		feed_decoder(channel_format_t fmt, int num_channels);
+
+		/**
+		* Read the next frame from a stream buffer and append its samples to a ring (publishing them).
+		* @param srate The nominal sampling rate (to deduce time stamps).
+		* @param last_timestamp The time stamp of the previous sample (updated).
+		* @param suppress_subnormals Whether subnormal values shall be flushed to zero.
+		* @return The number of samples appended.
+		* @throws std::runtime_error if the stream breaks off or the frame is malformed.
+		*/
+		std::size_t decode(std::streambuf &sb, sample_ring &ring, double srate, double &last_timestamp, bool suppress_subnormals);
+
+	private:
+		channel_format_t format_;					// the channel format
+		int num_channels_;							// number of channels
+		std::size_t sample_bytes_;					// bytes of the channel values of a sample
+		std::vector<char> frame_;					// the payload of the frame being decoded
+		std::vector<char> values_;					// the decoded channel values of the frame
+		std::vector<double> timestamps_;			// the time stamps of the frame
+	};
+
+}
+
+#endif
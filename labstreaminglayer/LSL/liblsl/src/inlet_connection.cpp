@@ -3,6 +3,7 @@
 #include <boost/lexical_cast.hpp>
 #include "inlet_connection.h"
 #include "api_config.h"
+#include "socket_utils.h"
 
 
 // === implementation of the inlet_connection class ===
@@ -83,8 +84,15 @@ inlet_connection::inlet_connection(const stream_info_impl &info, bool recover):
 
 /// Engage the connection and its recovery watchdog thread.
 void inlet_connection::engage() {
-	if (recovery_enabled_)
-		watchdog_thread_ = lslboost::thread(&inlet_connection::watchdog_thread,this);
+	if (recovery_enabled_) {
+		if ((io_ = io_pool::inlet_service())) {
+			// the watchdog is a timer on the shared I/O pool of the inlets
+			strand_.reset(new io_service::strand(*io_));
+			watchdog_timer_.reset(new deadline_timer(*io_));
+			schedule_watchdog();
+		} else
+			watchdog_thread_ = lslboost::thread(&inlet_connection::watchdog_thread,this);
+	}
 }
 
 /// Disengage the connection and all its resolver capabilities (including the watchdog).
@@ -99,8 +107,16 @@ void inlet_connection::disengage() {
 	resolver_.cancel();
 	cancel_and_shutdown();
 	// and wait for the watchdog to finish
-	if (recovery_enabled_)
-		watchdog_thread_.join();
+	if (recovery_enabled_) {
+		if (io_) {
+			watchdog_ops_.begin();
+			io_->post(strand_->wrap(lslboost::bind(&inlet_connection::cancel_watchdog,this)));
+			watchdog_ops_.wait();
+			if (recovery_thread_.joinable())
+				recovery_thread_.join();
+		} else
+			watchdog_thread_.join();
+	}
 }
 
 
@@ -274,6 +290,38 @@ void inlet_connection::watchdog_thread() {
 	}
 }
 
+/// Schedule the next check of the watchdog timer.
+void inlet_connection::schedule_watchdog() {
+	watchdog_ops_.begin();
+	watchdog_timer_->expires_from_now(timeout_sec(api_config::get_instance()->watchdog_check_interval()));
+	watchdog_timer_->async_wait(strand_->wrap(lslboost::bind(&inlet_connection::watchdog_check,this,placeholders::error)));
+}
+
+/// Handler of the watchdog timer that checks whether the connection should be recovered (same criteria as the watchdog thread).
+void inlet_connection::watchdog_check(error_code err) {
+	pending_operations::scope done(watchdog_ops_);
+	if (err == error::operation_aborted || lost_ || shutdown_)
+		return;
+	try {
+		lslboost::lock_guard<lslboost::mutex> lock(client_status_mut_);
+		if ((active_transmissions_ > 0) && (lsl_clock() - last_receive_time_ > api_config::get_instance()->watchdog_time_threshold())) {
+			// the recovery blocks while it resolves, so it must not hold up the I/O pool; skip if the previous one is still running
+			if (!recovery_thread_.joinable() || recovery_thread_.try_join_for(lslboost::chrono::milliseconds(0)))
+				recovery_thread_ = lslboost::thread(&inlet_connection::try_recover,this);
+		}
+	} catch(std::exception &e) {
+		std::cerr << "Unexpected hiccup in the watchdog timer: " << e.what() << std::endl;
+	}
+	schedule_watchdog();
+}
+
+/// Cancel the watchdog timer.
+void inlet_connection::cancel_watchdog() {
+	pending_operations::scope done(watchdog_ops_);
+	error_code ec;
+	watchdog_timer_->cancel(ec);
+}
+
 /// Issue a recovery attempt if a connection loss was detected.
 void inlet_connection::try_recover_from_error() {
 	if (!shutdown_) {
@@ -4,11 +4,15 @@
 #include <map>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/thread.hpp>
 #include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "common.h"
 #include "resolver_impl.h"
 #include "cancellation.h"
+#include "io_pool.h"
 
 
 using lslboost::asio::ip::tcp;
@@ -25,6 +29,8 @@ namespace lsl {
 	* Since in some cases a client might not be able to detect a connection loss and so would stall forever, the inlet_connection 
 	* maintains a watchdog thread that periodically checks and recovers the connection state. Internally the recovery works by 
 	* using the resolver to find the desired stream on the network again and updating the endpoint information if it has changed.
+	* If the inlets share an I/O pool (tuning.InletIOThreads), the watchdog is a timer on that pool instead, and only the
+	* (blocking) recovery itself gets a thread of its own while it runs.
 	*/
 	class inlet_connection: public cancellable_registry {
 	public:
@@ -126,6 +132,15 @@ namespace lsl {
         /// A thread that periodically checks whether the connection should be recovered.
         void watchdog_thread();
 
+		/// Schedule the next check of the watchdog timer (if the inlets share an I/O pool).
+		void schedule_watchdog();
+
+		/// Handler of the watchdog timer that checks whether the connection should be recovered.
+		void watchdog_check(error_code err);
+
+		/// Cancel the watchdog timer (runs on the I/O pool).
+		void cancel_watchdog();
+
         /// A (potentially speculative) resolve-and-recover operation.
         void try_recover();
 
@@ -141,6 +156,13 @@ namespace lsl {
 		// internal watchdog thread (to detect dead connections)
 		lslboost::thread watchdog_thread_;				// re-resolves the current connection speculatively
 
+		// alternatively, the watchdog timer on the shared inlet I/O pool
+		io_service_p io_;							// the shared io_service of the inlets (if enabled)
+		lslboost::scoped_ptr<lslboost::asio::io_service::strand> strand_;	// serializes the watchdog handlers
+		lslboost::scoped_ptr<lslboost::asio::deadline_timer> watchdog_timer_;	// schedules the next check
+		pending_operations watchdog_ops_;			// the pending watchdog handlers (waited for at disengage)
+		lslboost::thread recovery_thread_;			// performs a recovery that was found necessary by the watchdog timer
+
 		// things related to the shutdown condition
 		bool shutdown_;								// indicates to threads that we're shutting down
 		lslboost::mutex shutdown_mut_;					// a mutex to protect the shutdown state
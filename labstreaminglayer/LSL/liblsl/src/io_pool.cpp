@@ -0,0 +1,61 @@
+#include "io_pool.h"
+#include "api_config.h"
+#include <algorithm>
+#include <iostream>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+
+// === implementation of the io_pool class ===
+
+using namespace lsl;
+
+/// Get the shared io_service of the outlets' TCP data servers (run by tuning.OutletIOThreads threads).
+io_service_p io_pool::outlet_service() {
+	lslboost::call_once(&create_outlet_service,outlet_once_flag);
+	return *outlet_service_;
+}
+
+void io_pool::create_outlet_service() {
+	// (deliberately never deleted, see class documentation)
+	outlet_service_ = new io_service_p(start_service(api_config::get_instance()->outlet_io_threads()));
+}
+
+/// Get the shared io_service of the inlets (run by tuning.InletIOThreads threads), or an empty pointer if the inlets shall run their own threads.
+io_service_p io_pool::inlet_service() {
+	lslboost::call_once(&create_inlet_service,inlet_once_flag);
+	return *inlet_service_;
+}
+
+void io_pool::create_inlet_service() {
+	// (deliberately never deleted, see class documentation)
+	int num_threads = api_config::get_instance()->inlet_io_threads();
+	inlet_service_ = new io_service_p(num_threads > 0 ? start_service(num_threads) : io_service_p());
+}
+
+/// Create a new io_service that is run by the given number of threads (at least one).
+io_service_p io_pool::start_service(int num_threads) {
+	io_service_p io(new lslboost::asio::io_service());
+	// the service shall keep running even while it has no handlers (the work object is never released)
+	new lslboost::asio::io_service::work(*io);
+	for (int k=0; k<std::max(num_threads,1); k++)
+		lslboost::thread(lslboost::bind(&io_pool::run,io)).detach();
+	return io;
+}
+
+/// Run an io_service until it is stopped (errors in handlers are logged).
+void io_pool::run(io_service_p io) {
+	while (true) {
+		try {
+			io->run();
+			return;
+		} catch(std::exception &e) {
+			std::cerr << "Error during io_service processing (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
+		}
+	}
+}
+
+lslboost::once_flag io_pool::outlet_once_flag = BOOST_ONCE_INIT;
+io_service_p *io_pool::outlet_service_ = NULL;
+lslboost::once_flag io_pool::inlet_once_flag = BOOST_ONCE_INIT;
+io_service_p *io_pool::inlet_service_ = NULL;
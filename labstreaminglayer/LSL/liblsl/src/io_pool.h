@@ -0,0 +1,97 @@
+#ifndef IO_POOL_H
+#define IO_POOL_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/once.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace lsl {
+
+	/// pointer to an io_service
+	typedef lslboost::shared_ptr<lslboost::asio::io_service> io_service_p;
+
+	/**
+	* Process-wide pools of I/O threads that run a shared io_service.
+	* The TCP data servers of all outlets run their connections on one such service, so the number of threads
+	* does not grow with the number of outlets or connected inlets. If enabled in the config, the inlets share
+	* another one for their data connections, time probes and watchdog timers.
+	* A pool is created on first use and lives until the process exits; its threads are detached rather than
+	* joined, since handlers of other singletons may still be pending at static destruction time.
+	*/
+	class io_pool {
+	public:
+		/// Get the shared io_service of the outlets' TCP data servers (run by tuning.OutletIOThreads threads).
+		static io_service_p outlet_service();
+
+		/// Get the shared io_service of the inlets (run by tuning.InletIOThreads threads), or an empty pointer if the inlets shall run their own threads.
+		static io_service_p inlet_service();
+
+	private:
+		/// Create a new io_service that is run by the given number of threads (at least one).
+		static io_service_p start_service(int num_threads);
+
+		/// Run an io_service until it is stopped (errors in handlers are logged).
+		static void run(io_service_p io);
+
+		// Thread-safe initialization logic (boilerplate).
+		static lslboost::once_flag outlet_once_flag;
+		static io_service_p *outlet_service_;
+		static void create_outlet_service();
+		static lslboost::once_flag inlet_once_flag;
+		static io_service_p *inlet_service_;
+		static void create_inlet_service();
+	};
+
+
+	/**
+	* Counts the asynchronous operations that an object has pending on a shared io_service, so that it can
+	* wait for their handlers to finish before it is destroyed (the handlers refer to the object by a plain pointer).
+	* An operation is registered with begin() before it is initiated; its handler declares a pending_operations::scope
+	* that marks it as completed once the handler returns (after any follow-up operations have been registered).
+	*/
+	class pending_operations {
+	public:
+		pending_operations(): count_(0) {}
+
+		/// Register an operation that is about to be initiated.
+		void begin() {
+			lslboost::lock_guard<lslboost::mutex> lock(mut_);
+			count_++;
+		}
+
+		/// Mark an operation as completed.
+		void end() {
+			lslboost::lock_guard<lslboost::mutex> lock(mut_);
+			if (!--count_)
+				idle_.notify_all();
+		}
+
+		/// Block until no operation is pending anymore.
+		void wait() {
+			lslboost::unique_lock<lslboost::mutex> lock(mut_);
+			while (count_)
+				idle_.wait(lock);
+		}
+
+		/// Marks the operation of the running handler as completed when it goes out of scope.
+		class scope {
+		public:
+			explicit scope(pending_operations &ops): ops_(ops) {}
+			~scope() { ops_.end(); }
+		private:
+			pending_operations &ops_;
+		};
+
+	private:
+		int count_;									// number of pending operations
+		lslboost::mutex mut_;						// protects the count
+		lslboost::condition_variable idle_;			// notified when the count drops to zero
+	};
+
+}
+
+#endif
+
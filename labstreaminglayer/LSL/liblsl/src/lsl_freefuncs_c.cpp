@@ -1,6 +1,7 @@
 #include "../include/lsl_c.h"
 #include "common.h"
 #include "resolver_impl.h"
+#include "trace.h"
 #include <boost/chrono/system_clocks.hpp>
 
 
@@ -30,6 +31,18 @@ LIBLSL_C_API const char* lsl_library_info() {
 #endif
 }
 
+/**
+* Write the hot-path trace spans recorded so far as Chrome trace JSON (builds with LSL_TRACING only).
+*/
+LIBLSL_C_API int32_t lsl_dump_trace(const char *filename) {
+#ifdef LSL_TRACING
+	return dump_trace(filename) ? 1 : 0;
+#else
+	(void)filename;
+	return 0;
+#endif
+}
+
 /**
 * Obtain a local system time stamp in seconds. The resolution is better than a millisecond.
 * This reading can be used to assign time stamps to samples as they are being acquired. 
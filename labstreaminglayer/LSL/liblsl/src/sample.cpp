@@ -66,39 +66,46 @@ void sample::save_streambuf(std::streambuf& sb, int protocol_version, int use_by
 		save_value(sb,timestamp,use_byte_order);
 	}
 	// write channel data
-	if (format_ == cf_string) {
-		for (std::string *p=(std::string*)&data_,*e=p+num_channels_; p<e; p++) {
-			// write string length as variable-length integer
-			if (p->size() <= 0xFF) {
-				save_value(sb,(uint8_t)sizeof(uint8_t),use_byte_order);
-				save_value(sb,(uint8_t)p->size(),use_byte_order);
+	if (format_ == cf_string)
+		save_strings_raw(sb,(const std::string*)&data_,num_channels_,use_byte_order);
+	else
+		save_channels_raw(sb,format_,num_channels_,&data_,use_byte_order,scratchpad);
+}
+
+void sample::save_strings_raw(std::streambuf &sb, const std::string *strings, int num_channels, int use_byte_order) {
+	for (const std::string *p=strings,*e=p+num_channels; p<e; p++) {
+		// write string length as variable-length integer
+		if (p->size() <= 0xFF) {
+			save_value(sb,(uint8_t)sizeof(uint8_t),use_byte_order);
+			save_value(sb,(uint8_t)p->size(),use_byte_order);
+		} else {
+			if (p->size() <= 0xFFFFFFFF) {
+				save_value(sb,(uint8_t)sizeof(uint32_t),use_byte_order);
+				save_value(sb,(uint32_t)p->size(),use_byte_order);
 			} else {
-				if (p->size() <= 0xFFFFFFFF) {
-					save_value(sb,(uint8_t)sizeof(uint32_t),use_byte_order);
-					save_value(sb,(uint32_t)p->size(),use_byte_order);
-				} else {
 #ifndef BOOST_NO_INT64_T
-					save_value(sb,(uint8_t)sizeof(uint64_t),use_byte_order);
-					save_value(sb,(uint64_t)p->size(),use_byte_order);
+				save_value(sb,(uint8_t)sizeof(uint64_t),use_byte_order);
+				save_value(sb,(uint64_t)p->size(),use_byte_order);
 #else
-					save_value(sb,(uint8_t)sizeof(std::size_t),use_byte_order);
-					save_value(sb,(std::size_t)p->size(),use_byte_order);
+				save_value(sb,(uint8_t)sizeof(std::size_t),use_byte_order);
+				save_value(sb,(std::size_t)p->size(),use_byte_order);
 #endif
-				}
 			}
-			// write string contents
-			if (!p->empty())
-				save_raw(sb,p->data(),p->size());
 		}
+		// write string contents
+		if (!p->empty())
+			save_raw(sb,p->data(),p->size());
+	}
+}
+
+void sample::save_channels_raw(std::streambuf &sb, channel_format_t fmt, int num_channels, const void *data, int use_byte_order, void *scratchpad) {
+	// write numeric data in binary
+	if (use_byte_order == BOOST_BYTE_ORDER || format_sizes[fmt]==1) {
+		save_raw(sb,data,format_sizes[fmt]*num_channels);
 	} else {
-		// write numeric data in binary
-		if (use_byte_order == BOOST_BYTE_ORDER || format_sizes[format_]==1) {
-			save_raw(sb,&data_,format_sizes[format_]*num_channels_);
-		} else {
-			memcpy(scratchpad,&data_,format_sizes[format_]*num_channels_);
-			convert_endian(scratchpad);
-			save_raw(sb,scratchpad,format_sizes[format_]*num_channels_);
-		}
+		memcpy(scratchpad,data,format_sizes[fmt]*num_channels);
+		convert_endian(scratchpad,fmt,num_channels);
+		save_raw(sb,scratchpad,format_sizes[fmt]*num_channels);
 	}
 }
 
@@ -155,26 +162,22 @@ void sample::load_streambuf(std::streambuf& sb, int protocol_version, int use_by
 		}
 	} else {
 		// read numeric channel data
-		load_raw(sb, &data_, format_sizes[format_] * num_channels_);
-		if (use_byte_order != BOOST_BYTE_ORDER && format_sizes[format_] > 1) convert_endian(&data_);
-		if (suppress_subnormals && format_float[format_]) {
-			if (format_ == cf_float32) {
-				for (uint32_t *p = (uint32_t*)&data_, *e = p + num_channels_;
-				     p < e; p++)
-					if (*p && ((*p & UINT32_C(0x7fffffff)) <= UINT32_C(0x007fffff)))
-						*p &= UINT32_C(0x80000000);
-			} else {
-#ifndef BOOST_NO_INT64_T
-				for (uint64_t *p = (uint64_t*)&data_, *e = p + num_channels_;
-				     p < e; p++)
-					if (*p && ((*p & UINT64_C(0x7fffffffffffffff)) <= UINT64_C(0x000fffffffffffff)))
-						*p &= UINT64_C(0x8000000000000000);
-#endif
-			}
-		}
+		load_channels_raw(sb, format_, num_channels_, &data_, use_byte_order, suppress_subnormals);
 	}
 }
 
+void sample::load_channels_raw(std::streambuf& sb, channel_format_t fmt, int num_channels, void* data,
+                               int use_byte_order, bool suppress_subnormals) {
+	load_raw(sb, data, format_sizes[fmt] * num_channels);
+	convert_channels_raw(data, fmt, num_channels, use_byte_order, suppress_subnormals);
+}
+
+void sample::convert_channels_raw(void* data, channel_format_t fmt, int num_values, int use_byte_order,
+                                  bool suppress_subnormals) {
+	if (use_byte_order != BOOST_BYTE_ORDER && format_sizes[fmt] > 1) convert_endian(data, fmt, num_values);
+	if (suppress_subnormals && format_float[fmt]) flush_subnormals(data, format_sizes[fmt], num_values);
+}
+
 template<class Archive>
 void sample::serialize_channels(Archive& ar, const uint32_t archive_version)
 {
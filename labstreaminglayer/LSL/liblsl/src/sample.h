@@ -12,6 +12,7 @@
 #include <boost/serialization/split_member.hpp>
 #include "endian/conversion.hpp"
 #include "common.h"
+#include "simd_kernels.h"
 
 namespace eos {
 class portable_iarchive;
@@ -227,25 +228,44 @@ namespace lsl {
 		}
 
 		/// Load a value from a stream buffer; specialization of the above.
-		void load_value(std::streambuf &sb, uint8_t &v, int use_byte_order) { load_raw(sb,&v,sizeof(v)); }
+		static void load_value(std::streambuf &sb, uint8_t &v, int use_byte_order) { load_raw(sb,&v,sizeof(v)); }
 
 		/// Serialize a sample to a stream buffer (protocol 1.10).
 		void save_streambuf(std::streambuf &sb, int protocol_version, int use_byte_order, void *scratchpad=NULL) const;
 
+		/**
+		* Serialize the string channel data of a sample to a stream buffer (protocol 1.10), as save_streambuf() does.
+		* For buffers that hold samples outside of sample objects.
+		*/
+		static void save_strings_raw(std::streambuf &sb, const std::string *strings, int num_channels, int use_byte_order);
+
+		/**
+		* Serialize the numeric channel data of a sample from raw memory to a stream buffer (protocol 1.10), as save_streambuf() does.
+		* @param scratchpad Scratch memory of at least format_sizes[fmt]*num_channels bytes (used if the byte order needs to be converted).
+		*/
+		static void save_channels_raw(std::streambuf &sb, channel_format_t fmt, int num_channels, const void *data, int use_byte_order, void *scratchpad);
+
 		/// Deserialize a sample from a stream buffer (protocol 1.10).
 		void load_streambuf(std::streambuf &sb, int protocol_version, int use_byte_order, bool suppress_subnormals);
 
+		/**
+		* Deserialize the numeric channel data of a sample from a stream buffer (protocol 1.10) into raw memory, as load_streambuf() does.
+		* For buffers that hold samples outside of sample objects.
+		* @param data Receives the channel values (format_sizes[fmt]*num_channels bytes).
+		*/
+		static void load_channels_raw(std::streambuf &sb, channel_format_t fmt, int num_channels, void *data, int use_byte_order, bool suppress_subnormals);
+
+		/// Convert received numeric channel data in-place: the byte order, and subnormal numbers if they shall be suppressed (for any number of consecutive values).
+		static void convert_channels_raw(void *data, channel_format_t fmt, int num_values, int use_byte_order, bool suppress_subnormals);
+
 		/// Convert the endianness of channel data in-place.
-		void convert_endian(void *data) const {
-			switch (format_sizes[format_]) {
+		void convert_endian(void *data) const { convert_endian(data,format_,num_channels_); }
+
+		/// Convert the endianness of the channel data of a sample of the given format in-place (vectorized where the CPU supports it).
+		static void convert_endian(void *data, channel_format_t fmt, int num_channels) {
+			switch (format_sizes[fmt]) {
 				case 1: break;
-				case sizeof(int16_t): for (int16_t *p=(int16_t*)data,*e=p+num_channels_; p<e; lslboost::endian::reverse(*p++)); break;
-				case sizeof(int32_t): for (int32_t *p=(int32_t*)data,*e=p+num_channels_; p<e; lslboost::endian::reverse(*p++)); break;
-#ifndef BOOST_NO_INT64_T
-				case sizeof(int64_t): for (int64_t *p=(int64_t*)data,*e=p+num_channels_; p<e; lslboost::endian::reverse(*p++)); break;
-#else
-				case sizeof(double): for (double *p=(double*)data,*e=p+num_channels_; p<e; lslboost::endian::reverse(*p++)); break;
-#endif
+				case 2: case 4: case 8: reverse_bytes(data,format_sizes[fmt],num_channels); break;
 				default: throw std::runtime_error("Unsupported channel format for endian conversion.");
 			}
 		}
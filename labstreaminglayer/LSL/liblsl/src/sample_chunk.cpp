@@ -0,0 +1,130 @@
+#include "sample_chunk.h"
+#include <boost/thread/lock_guard.hpp>
+
+
+// === implementation of the sample_chunk class ===
+
+using namespace lsl;
+
+/**
+* Create a new chunk with uninitialized time stamps and (numeric) channel values.
+* The object, the time stamps and the channel values are placed in a single memory block.
+*/
+sample_chunk_p sample_chunk::create(channel_format_t fmt, int num_channels, std::size_t num_samples, bool pushthrough) {
+	char *block = new char[header_size() + sizeof(double)*num_samples + format_sizes[fmt]*num_channels*num_samples];
+	try {
+#pragma warning(suppress: 4291)
+		return sample_chunk_p(new (block) sample_chunk(fmt,num_channels,num_samples,pushthrough));
+	} catch(...) {
+		delete[] block;
+		throw;
+	}
+}
+
+/// Construct a new chunk in a memory block that holds its data after the object.
+sample_chunk::sample_chunk(channel_format_t fmt, int num_channels, std::size_t num_samples, bool pushthrough): pushthrough(pushthrough), format_(fmt), num_channels_(num_channels),
+	num_samples_(num_samples), sample_bytes_(format_sizes[fmt]*num_channels), refcount_(0) {
+	serialized_[0] = serialized_[1] = NULL;
+	timestamps_ = (double*)((char*)this + header_size());
+	values_ = (char*)(timestamps_ + num_samples);
+	if (format_ == cf_string)
+		for (std::string *p=(std::string*)values_,*e=p+num_channels_*num_samples_; p<e; new(p++)std::string());
+}
+
+/// Assign the channel values of all samples from strings.
+sample_chunk &sample_chunk::assign_typed(const std::string *s) {
+	const std::size_t n = num_channels_*num_samples_;
+	switch (format_) {
+		case cf_string:   for (std::string    *p=(std::string*)   values_,*e=p+n; p<e; *p++ = *s++); break;
+		case cf_float32:  for (float          *p=(float*)         values_,*e=p+n; p<e; *p++ = lslboost::lexical_cast<float>(*s++)); break;
+		case cf_double64: for (double         *p=(double*)        values_,*e=p+n; p<e; *p++ = lslboost::lexical_cast<double>(*s++)); break;
+		case cf_int8:     for (int8_t  *p=(int8_t*) values_,*e=p+n; p<e; *p++ = lslboost::lexical_cast<int8_t>(*s++)); break;
+		case cf_int16:    for (int16_t *p=(int16_t*)values_,*e=p+n; p<e; *p++ = lslboost::lexical_cast<int16_t>(*s++)); break;
+		case cf_int32:    for (int32_t *p=(int32_t*)values_,*e=p+n; p<e; *p++ = lslboost::lexical_cast<int32_t>(*s++)); break;
+#ifndef BOOST_NO_INT64_T
+		case cf_int64:    for (int64_t *p=(int64_t*)values_,*e=p+n; p<e; *p++ = lslboost::lexical_cast<int64_t>(*s++)); break;
+#endif
+		default: throw std::invalid_argument("Unsupported channel format.");
+	}
+	return *this;
+}
+
+/**
+* Serialize the samples [begin,end) of the chunk to a stream buffer (protocol 1.10).
+* The result is the same as that of sample::save_streambuf() for each of the samples.
+*/
+void sample_chunk::save_streambuf(std::streambuf &sb, int use_byte_order, void *scratchpad, std::size_t begin, std::size_t end) const {
+	for (std::size_t k=begin; k<end; k++) {
+		// write sample header
+		if (timestamps_[k] == DEDUCED_TIMESTAMP) {
+			sample::save_value(sb,TAG_DEDUCED_TIMESTAMP,use_byte_order);
+		} else {
+			sample::save_value(sb,TAG_TRANSMITTED_TIMESTAMP,use_byte_order);
+			sample::save_value(sb,timestamps_[k],use_byte_order);
+		}
+		// write channel data
+		if (format_ == cf_string)
+			sample::save_strings_raw(sb,(const std::string*)values_ + k*num_channels_,(int)num_channels_,use_byte_order);
+		else
+			sample::save_channels_raw(sb,format_,(int)num_channels_,values_ + k*sample_bytes_,use_byte_order,scratchpad);
+	}
+}
+
+namespace {
+	/// A stream buffer that appends to a vector.
+	class vector_streambuf: public std::streambuf {
+	public:
+		vector_streambuf(std::vector<char> &v): v_(v) {}
+	protected:
+		std::streamsize xsputn(const char *s, std::streamsize n) { v_.insert(v_.end(),s,s+n); return n; }
+		int_type overflow(int_type c) {
+			if (!traits_type::eq_int_type(c,traits_type::eof()))
+				v_.push_back(traits_type::to_char_type(c));
+			return traits_type::not_eof(c);
+		}
+	private:
+		std::vector<char> &v_;
+	};
+}
+
+/**
+* Get the serialization of the chunk in a given byte order (protocol 1.10), computing it if this is the first request for that byte order.
+* Thread-safe; the result is immutable and remains valid as long as a reference to the chunk is held.
+*/
+const sample_chunk::serialized_chunk &sample_chunk::serialized(int use_byte_order) const {
+	lslboost::atomic<serialized_chunk*> &slot = serialized_[use_byte_order == BOOST_BYTE_ORDER ? 0 : 1];
+	if (serialized_chunk *result = slot.load(lslboost::memory_order_acquire))
+		return *result;
+	lslboost::lock_guard<lslboost::mutex> lock(serialize_mut_);
+	if (serialized_chunk *result = slot.load(lslboost::memory_order_relaxed))
+		return *result;
+	serialized_chunk *result = new serialized_chunk();
+	try {
+		// numeric samples take at most a tag, a time stamp and the channel values
+		if (format_ != cf_string)
+			result->data.reserve(num_samples_*(1+sizeof(double)+sample_bytes_));
+		result->offsets.reserve(num_samples_+1);
+		std::vector<char> scratch(format_ != cf_string ? sample_bytes_ : 0);
+		vector_streambuf sb(result->data);
+		for (std::size_t k=0; k<num_samples_; k++) {
+			result->offsets.push_back(result->data.size());
+			save_streambuf(sb,use_byte_order,scratch.empty() ? NULL : &scratch[0],k,k+1);
+		}
+		result->offsets.push_back(result->data.size());
+	} catch(...) {
+		delete result;
+		throw;
+	}
+	slot.store(result,lslboost::memory_order_release);
+	return *result;
+}
+
+/// Copy the k'th sample of the chunk into a sample of the same format (e.g., for serialization in protocol 1.00).
+void sample_chunk::retrieve_sample(std::size_t k, sample &s) const {
+	s.timestamp = timestamps_[k];
+	s.pushthrough = pushthrough && k+1 == num_samples_;
+	if (format_ == cf_string)
+		s.assign_typed((const std::string*)values_ + k*num_channels_);
+	else
+		s.assign_untyped(values_ + k*sample_bytes_);
+}
@@ -0,0 +1,149 @@
+#ifndef SAMPLE_CHUNK_H
+#define SAMPLE_CHUNK_H
+
+#include <boost/thread/mutex.hpp>
+#include "sample.h"
+
+namespace lsl {
+
+	/// smart pointer to a sample chunk
+	typedef lslboost::intrusive_ptr<class sample_chunk> sample_chunk_p;
+
+	/**
+	* A chunk of successive samples of a stream, as pushed into an outlet by a single call.
+	* The time stamps and the channel values of all samples are held contiguously in a single allocation,
+	* so that a whole chunk travels through the send buffer as one element and gets serialized in one pass.
+	* A chunk is shared by all consumers of the send buffer and must not be modified once it has been pushed.
+	* Its serialization (protocol 1.10) can be computed once per byte order and shared by all sessions that use that
+	* byte order; it lives as long as the chunk (subnormal suppression happens on the receiving end, so it does
+	* not need to be distinguished).
+	*/
+	class sample_chunk {
+	public:
+		bool pushthrough;				// whether the chunk shall be pushed through after its last sample
+
+		/// The serialization of all samples of a chunk in a given byte order (protocol 1.10).
+		struct serialized_chunk {
+			std::vector<char> data;				// the serialized samples
+			std::vector<std::size_t> offsets;	// the offset of each sample in data, followed by data.size()
+		};
+
+		/**
+		* Create a new chunk with uninitialized time stamps and (numeric) channel values.
+		* @param fmt The channel format.
+		* @param num_channels The number of channels per sample.
+		* @param num_samples The number of samples in the chunk.
+		* @param pushthrough Whether the chunk shall be pushed through to the receivers.
+		*/
+		static sample_chunk_p create(channel_format_t fmt, int num_channels, std::size_t num_samples, bool pushthrough);
+
+		/// Destructor for a chunk.
+		~sample_chunk() {
+			delete serialized_[0].load(lslboost::memory_order_relaxed);
+			delete serialized_[1].load(lslboost::memory_order_relaxed);
+			if (format_ == cf_string)
+				for (std::string *p=(std::string*)values_,*e=p+num_channels_*num_samples_; p<e; (p++)->~basic_string<char>());
+		}
+
+		/// Delete a chunk.
+		void operator delete(void *x) { delete[] (char*)x; }
+
+		/// The number of samples in the chunk.
+		std::size_t size() const { return num_samples_; }
+
+		/// The time stamps of the samples (DEDUCED_TIMESTAMP for those that shall be deduced by the receiver).
+		double *timestamps() { return timestamps_; }
+		const double *timestamps() const { return timestamps_; }
+
+		/// The raw channel values of all samples, one sample after another (numeric formats only).
+		const char *values() const { return values_; }
+
+		// === type-safe accessors ===
+
+		/// Assign the channel values of all samples, one sample after another (with type conversions).
+		template<class T> sample_chunk &assign_typed(const T *s) {
+			const std::size_t n = num_channels_*num_samples_;
+			if ((sizeof(T) == format_sizes[format_]) && ((lslboost::is_integral<T>::value && format_integral[format_]) || (lslboost::is_floating_point<T>::value && format_float[format_]))) {
+				memcpy(values_,s,format_sizes[format_]*n);
+			} else {
+				switch (format_) {
+					case cf_float32:  for (float          *p=(float*)         values_,*e=p+n; p<e; *p++ = (float)*s++); break;
+					case cf_double64: for (double         *p=(double*)        values_,*e=p+n; p<e; *p++ = (double)*s++); break;
+					case cf_int8:     for (int8_t  *p=(int8_t*) values_,*e=p+n; p<e; *p++ = (int8_t)*s++); break;
+					case cf_int16:    for (int16_t *p=(int16_t*)values_,*e=p+n; p<e; *p++ = (int16_t)*s++); break;
+					case cf_int32:    for (int32_t *p=(int32_t*)values_,*e=p+n; p<e; *p++ = (int32_t)*s++); break;
+#ifndef BOOST_NO_INT64_T
+					case cf_int64:    for (int64_t *p=(int64_t*)values_,*e=p+n; p<e; *p++ = (int64_t)*s++); break;
+#endif
+					case cf_string:   for (std::string    *p=(std::string*)   values_,*e=p+n; p<e; *p++ = lslboost::lexical_cast<std::string>(*s++)); break;
+					default: throw std::invalid_argument("Unsupported channel format.");
+				}
+			}
+			return *this;
+		}
+
+		/// Assign the channel values of all samples from strings.
+		sample_chunk &assign_typed(const std::string *s);
+
+		/// Assign the numeric channel values of all samples.
+		sample_chunk &assign_untyped(const void *newdata) {
+			if (format_ != cf_string)
+				memcpy(values_,newdata,format_sizes[format_]*num_channels_*num_samples_);
+			else
+				throw std::invalid_argument("Cannot assign untyped data to a string-formatted chunk.");
+			return *this;
+		}
+
+		// === serialization functions ===
+
+		/**
+		* Serialize the samples [begin,end) of the chunk to a stream buffer (protocol 1.10).
+		* The result is the same as that of sample::save_streambuf() for each of the samples.
+		* @param scratchpad Scratch memory of the size of a sample's channel values (used if the byte order needs to be converted).
+		*/
+		void save_streambuf(std::streambuf &sb, int use_byte_order, void *scratchpad, std::size_t begin, std::size_t end) const;
+
+		/**
+		* Get the serialization of the chunk in a given byte order (protocol 1.10), computing it if this is the first request for that byte order.
+		* Thread-safe; the result is immutable and remains valid as long as a reference to the chunk is held.
+		*/
+		const serialized_chunk &serialized(int use_byte_order) const;
+
+		/// Copy the k'th sample of the chunk into a sample of the same format (e.g., for serialization in protocol 1.00).
+		void retrieve_sample(std::size_t k, sample &s) const;
+
+	private:
+		/// Construct a new chunk in a memory block that holds its data after the object.
+		sample_chunk(channel_format_t fmt, int num_channels, std::size_t num_samples, bool pushthrough);
+
+		/// The size of the object, padded so that the data that follows it is aligned.
+		static std::size_t header_size() { return (sizeof(sample_chunk)+15) & ~(std::size_t)15; }
+
+		/// Increment ref count.
+		friend void intrusive_ptr_add_ref(sample_chunk *c) {
+			c->refcount_.fetch_add(1,lslboost::memory_order_relaxed);
+		}
+
+		/// Decrement ref count and delete if unreferenced.
+		friend void intrusive_ptr_release(sample_chunk *c) {
+			if (c->refcount_.fetch_sub(1,lslboost::memory_order_release) == 1) {
+				lslboost::atomic_thread_fence(lslboost::memory_order_acquire);
+				delete c;
+			}
+		}
+
+		channel_format_t format_;		// the channel format
+		std::size_t num_channels_;		// number of channels
+		std::size_t num_samples_;		// number of samples
+		std::size_t sample_bytes_;		// bytes of the channel values of a sample
+		lslboost::atomic<int> refcount_;	// reference count used by sample_chunk_p
+		double *timestamps_;			// the time stamps (these and the values reside in the same allocation as the object)
+		char *values_;					// the channel values of one sample after another
+		mutable lslboost::atomic<serialized_chunk*> serialized_[2];	// the serializations in native and in reversed byte order, once computed
+		mutable lslboost::mutex serialize_mut_;	// mutex that ensures that each serialization is computed only once
+	};
+
+}
+
+#endif
+
@@ -0,0 +1,152 @@
+#include "sample_ring.h"
+#include <algorithm>
+#include <cstring>
+#include <boost/thread/thread.hpp>
+
+// === implementation of the sample_ring class ===
+
+using namespace lsl;
+
+// the size of a block of slots that is allocated at a time (in bytes, roughly)
+const std::size_t block_bytes = 1<<20;
+
+/**
+* Create a new ring with a given capacity.
+* @param fmt The channel format (must not be cf_string).
+* @param num_channels The number of channels per sample.
+* @param max_capacity The maximum number of samples that can be held by the ring. Beyond that, the oldest samples are dropped.
+*/
+sample_ring::sample_ring(channel_format_t fmt, int num_channels, std::size_t max_capacity): format_(fmt), num_channels_(num_channels),
+	sample_bytes_(format_sizes[fmt]*num_channels), capacity_(std::max<std::size_t>(max_capacity,1)),
+	block_slots_(std::min(capacity_, std::max<std::size_t>(block_bytes/(sizeof(double)+sample_bytes_),1))),
+	blocks_(new lslboost::scoped_array<char>[(capacity_+block_slots_-1)/block_slots_]), read_(0), write_(0), pending_(0), interrupted_(false)
+{
+	if (fmt == cf_string)
+		throw std::invalid_argument("A sample ring cannot hold string-formatted samples.");
+}
+
+/**
+* Get the slot of the next sample to write, dropping the oldest sample if the ring is full.
+* @param timestamp Receives a pointer to the time stamp of the slot.
+* @return A pointer to the channel values of the slot.
+*/
+char *sample_ring::next_slot(double *&timestamp) {
+	uint64_t read = read_.load(lslboost::memory_order_acquire);
+	// the consumer may free slots concurrently, in which case the exchange fails and nothing needs to be dropped
+	while (pending_ - read >= capacity_ && !read_.compare_exchange_weak(read, pending_ - capacity_ + 1, lslboost::memory_order_acq_rel));
+	const std::size_t slot = (std::size_t)(pending_ % capacity_);
+	// allocate the block of the slot when it is first reached (the consumer only sees it after the next commit)
+	lslboost::scoped_array<char> &block = blocks_[slot/block_slots_];
+	if (!block)
+		block.reset(new char[block_slots_*sizeof(double) + std::min(block_slots_, capacity_-slot)*sample_bytes_]);
+	timestamp = slot_timestamp(slot);
+	return slot_values(slot);
+}
+
+/**
+* Parse all complete samples at the beginning of a buffer in the raw protocol 1.10 layout into the ring and publish them.
+* @param last_timestamp The time stamp of the previous sample (updated).
+* @return The number of bytes parsed.
+*/
+std::size_t sample_ring::load_samples(const char *data, std::size_t size, int use_byte_order, bool suppress_subnormals, double srate, double &last_timestamp) {
+	const std::size_t max_sample_bytes = 1+sizeof(double)+sample_bytes_;
+	const bool convert = (use_byte_order != BOOST_BYTE_ORDER && format_sizes[format_] > 1) || (suppress_subnormals && format_float[format_]);
+	const char *p = data, *end = data+size;
+	char *run = NULL;		// the values of the consecutive slots that still need to be converted
+	int run_length = 0;
+	while (p < end) {
+		const bool deduced = (uint8_t)*p == TAG_DEDUCED_TIMESTAMP;
+		const std::size_t sample_size = deduced ? 1+sample_bytes_ : max_sample_bytes;
+		if ((std::size_t)(end-p) < sample_size)
+			break;
+		double *timestamp;
+		char *values = next_slot(timestamp);
+		if (deduced) {
+			*timestamp = last_timestamp;
+			if (srate != IRREGULAR_RATE)
+				*timestamp += 1.0/srate;
+		} else {
+			memcpy(timestamp,p+1,sizeof(double));
+			if (use_byte_order != BOOST_BYTE_ORDER)
+				lslboost::endian::reverse(*timestamp);
+		}
+		last_timestamp = *timestamp;
+		if (convert) {
+			// the slots are consecutive up to the end of a block or of the ring; the run must be converted before the slot is
+			// written, since a wrap-around within one buffer may land on a slot of the run
+			if (run_length && values != run+run_length*sample_bytes_) {
+				sample::convert_channels_raw(run,format_,run_length*(int)num_channels_,use_byte_order,suppress_subnormals);
+				run_length = 0;
+			}
+			if (!run_length++)
+				run = values;
+		}
+		memcpy(values,p+sample_size-sample_bytes_,sample_bytes_);
+		push_slot();
+		p += sample_size;
+	}
+	if (run_length)
+		sample::convert_channels_raw(run,format_,run_length*(int)num_channels_,use_byte_order,suppress_subnormals);
+	commit();
+	return p-data;
+}
+
+/**
+* Wait until samples are available.
+* @param timeout Timeout for the blocking, in seconds.
+* @return Whether samples are available (false if the timeout expired or the ring was interrupted).
+*/
+bool sample_ring::wait(double timeout) {
+	if (!empty())
+		return true;
+	if (timeout <= 0.0)
+		return false;
+	// turn timeout into the point in time at which we give up
+	timeout += lsl::lsl_clock();
+	do {
+		if (interrupted_ || lsl::lsl_clock() >= timeout)
+			return false;
+		lslboost::this_thread::sleep(lslboost::posix_time::milliseconds(1));
+	} while (empty());
+	return true;
+}
+
+/**
+* Pop up to max_samples samples into a raw buffer (sample_bytes() per sample) and their time stamps.
+* Does not block.
+* @return The number of samples popped.
+*/
+std::size_t sample_ring::pop_samples_untyped(void *buffer, double *timestamps, std::size_t max_samples) {
+	for (;;) {
+		uint64_t read = read_.load(lslboost::memory_order_acquire), write = write_.load(lslboost::memory_order_acquire);
+		if (write <= read || !max_samples)
+			return 0;
+		const std::size_t n = (std::size_t)std::min<uint64_t>(write-read, max_samples);
+		// copy the samples block by block (wrapping around at the end of the ring)
+		for (std::size_t k=0, slot=(std::size_t)(read % capacity_); k<n; ) {
+			const std::size_t piece = std::min(n-k, std::min(capacity_-slot, block_slots_-slot%block_slots_));
+			memcpy((char*)buffer+k*sample_bytes_, slot_values(slot), piece*sample_bytes_);
+			if (timestamps)
+				memcpy(timestamps+k, slot_timestamp(slot), piece*sizeof(double));
+			k += piece;
+			slot = (slot+piece) % capacity_;
+		}
+		if (read_.compare_exchange_strong(read, read+n, lslboost::memory_order_acq_rel))
+			return n;
+	}
+}
+
+/// Conversion to strings (not a numeric cast).
+void sample_ring::convert_values(const char *src, std::string *d) const {
+	switch (format_) {
+		case cf_float32:  for (const float   *p=(const float*)  src,*e=p+num_channels_; p<e; *d++ = lslboost::lexical_cast<std::string>(*p++)); break;
+		case cf_double64: for (const double  *p=(const double*) src,*e=p+num_channels_; p<e; *d++ = lslboost::lexical_cast<std::string>(*p++)); break;
+		case cf_int8:     for (const int8_t  *p=(const int8_t*) src,*e=p+num_channels_; p<e; *d++ = lslboost::lexical_cast<std::string>(*p++)); break;
+		case cf_int16:    for (const int16_t *p=(const int16_t*)src,*e=p+num_channels_; p<e; *d++ = lslboost::lexical_cast<std::string>(*p++)); break;
+		case cf_int32:    for (const int32_t *p=(const int32_t*)src,*e=p+num_channels_; p<e; *d++ = lslboost::lexical_cast<std::string>(*p++)); break;
+#ifndef BOOST_NO_INT64_T
+		case cf_int64:    for (const int64_t *p=(const int64_t*)src,*e=p+num_channels_; p<e; *d++ = lslboost::lexical_cast<std::string>(*p++)); break;
+#endif
+		default: throw std::invalid_argument("Unsupported channel format.");
+	}
+}
@@ -0,0 +1,153 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include "sample.h"
+
+namespace lsl {
+
+	/**
+	* A thread-safe producer-consumer ring of unread samples of a numeric stream.
+	* Unlike the consumer_queue, it holds no sample objects: the time stamps and the channel values of
+	* the buffered samples are stored contiguously in blocks of slots, so that the data thread can
+	* deserialize straight into the ring and a chunk can be retrieved with one memcpy per block.
+	* The blocks are allocated by the producer when it first reaches them, so an inlet whose consumer keeps
+	* up only ever holds the first few blocks, however large its max capacity.
+	* Erases the oldest samples if max capacity is exceeded: the producer then advances the read index
+	* itself. A consumer copies the samples first and only afterwards claims them by advancing the read
+	* index from the value it started with; if the producer dropped samples in the meantime (which it may
+	* have overwritten during the copy), the claim fails and the copy is repeated.
+	*/
+	class sample_ring: private lslboost::noncopyable {
+	public:
+		/**
+		* Create a new ring with a given capacity.
+		* The memory of the slots is allocated block by block as the ring fills up.
+		* @param fmt The channel format (must not be cf_string).
+		* @param num_channels The number of channels per sample.
+		* @param max_capacity The maximum number of samples that can be held by the ring. Beyond that, the oldest samples are dropped.
+		*/
+		sample_ring(channel_format_t fmt, int num_channels, std::size_t max_capacity);
+
+		// === producer side ===
+
+		/**
+		* Get the slot of the next sample to write, dropping the oldest sample if the ring is full.
+		* @param timestamp Receives a pointer to the time stamp of the slot.
+		* @return A pointer to the channel values of the slot.
+		*/
+		char *next_slot(double *&timestamp);
+
+		/**
+		* Parse all complete samples at the beginning of a buffer in the raw protocol 1.10 layout into the ring and publish them.
+		* @param use_byte_order The byte order of the data in the buffer.
+		* @param suppress_subnormals Whether subnormal numbers shall be flushed to zero.
+		* @param srate The nominal sampling rate (for the deduction of time stamps).
+		* @param last_timestamp The time stamp of the previous sample (updated).
+		* @return The number of bytes parsed.
+		*/
+		std::size_t load_samples(const char *data, std::size_t size, int use_byte_order, bool suppress_subnormals, double srate, double &last_timestamp);
+
+		/// Append the sample written into the slot of next_slot(); it becomes visible to the consumer with the next commit().
+		void push_slot() { pending_++; }
+
+		/// Publish the samples pushed since the last commit.
+		void commit() { write_.store(pending_, lslboost::memory_order_release); }
+
+		/// Wake up a waiting consumer for good (e.g., because the connection was lost).
+		void interrupt() { interrupted_ = true; }
+
+		// === consumer side ===
+
+		/**
+		* Wait until samples are available.
+		* @param timeout Timeout for the blocking, in seconds.
+		* @return Whether samples are available (false if the timeout expired or the ring was interrupted).
+		*/
+		bool wait(double timeout=FOREVER);
+
+		/**
+		* Pop up to max_samples samples into a typed buffer (the channel values of one sample after another) and their time stamps.
+		* Does not block.
+		* @return The number of samples popped.
+		*/
+		template<class T> std::size_t pop_samples(T *buffer, double *timestamps, std::size_t max_samples) {
+			if ((sizeof(T) == format_sizes[format_]) && ((lslboost::is_integral<T>::value && format_integral[format_]) || (lslboost::is_floating_point<T>::value && format_float[format_])))
+				return pop_samples_untyped(buffer, timestamps, max_samples);
+			for (;;) {
+				uint64_t read = read_.load(lslboost::memory_order_acquire), write = write_.load(lslboost::memory_order_acquire);
+				if (write <= read || !max_samples)
+					return 0;
+				const std::size_t n = (std::size_t)std::min<uint64_t>(write-read, max_samples);
+				for (std::size_t k=0, slot=(std::size_t)(read%capacity_); k<n; k++, slot=(slot+1==capacity_ ? 0 : slot+1)) {
+					convert_values(slot_values(slot), buffer+k*num_channels_);
+					if (timestamps)
+						timestamps[k] = *slot_timestamp(slot);
+				}
+				if (read_.compare_exchange_strong(read, read+n, lslboost::memory_order_acq_rel))
+					return n;
+			}
+		}
+
+		/**
+		* Pop up to max_samples samples into a raw buffer (sample_bytes() per sample) and their time stamps.
+		* Does not block.
+		* @return The number of samples popped.
+		*/
+		std::size_t pop_samples_untyped(void *buffer, double *timestamps, std::size_t max_samples);
+
+		/// Check whether the ring is empty.
+		bool empty() const { return read_.load(lslboost::memory_order_acquire) >= write_.load(lslboost::memory_order_acquire); }
+
+		/// The number of samples that are available to the consumer (may be outdated by the time it is used).
+		std::size_t size() const {
+			uint64_t read = read_.load(lslboost::memory_order_acquire), write = write_.load(lslboost::memory_order_acquire);
+			return write > read ? (std::size_t)(write-read) : 0;
+		}
+
+		/// The number of bytes of the channel values of a sample.
+		std::size_t sample_bytes() const { return sample_bytes_; }
+
+	private:
+		/// The time stamp of a slot (its block must have been allocated).
+		double *slot_timestamp(std::size_t slot) const { return (double*)blocks_[slot/block_slots_].get() + slot%block_slots_; }
+
+		/// The channel values of a slot (its block must have been allocated).
+		char *slot_values(std::size_t slot) const { return blocks_[slot/block_slots_].get() + block_slots_*sizeof(double) + (slot%block_slots_)*sample_bytes_; }
+
+		/// Convert the channel values of a slot to the given type.
+		template<class T> void convert_values(const char *src, T *d) const {
+			switch (format_) {
+				case cf_float32:  for (const float   *p=(const float*)  src,*e=p+num_channels_; p<e; *d++ = (T)*p++); break;
+				case cf_double64: for (const double  *p=(const double*) src,*e=p+num_channels_; p<e; *d++ = (T)*p++); break;
+				case cf_int8:     for (const int8_t  *p=(const int8_t*) src,*e=p+num_channels_; p<e; *d++ = (T)*p++); break;
+				case cf_int16:    for (const int16_t *p=(const int16_t*)src,*e=p+num_channels_; p<e; *d++ = (T)*p++); break;
+				case cf_int32:    for (const int32_t *p=(const int32_t*)src,*e=p+num_channels_; p<e; *d++ = (T)*p++); break;
+#ifndef BOOST_NO_INT64_T
+				case cf_int64:    for (const int64_t *p=(const int64_t*)src,*e=p+num_channels_; p<e; *d++ = (T)*p++); break;
+#endif
+				default: throw std::invalid_argument("Unsupported channel format.");
+			}
+		}
+		/// Conversion to strings (not a numeric cast).
+		void convert_values(const char *src, std::string *d) const;
+
+		channel_format_t format_;					// the channel format
+		std::size_t num_channels_;					// number of channels
+		std::size_t sample_bytes_;					// bytes of the channel values of a sample
+		std::size_t capacity_;						// number of slots
+		std::size_t block_slots_;					// number of slots per block
+		lslboost::scoped_array<lslboost::scoped_array<char> > blocks_;	// the blocks (empty until first written), each with the
+													// time stamps of its slots followed by their channel values
+		lslboost::atomic<uint64_t> read_;			// number of samples consumed or dropped so far
+		lslboost::atomic<uint64_t> write_;			// number of samples published so far
+		uint64_t pending_;							// number of samples written so far (producer only; the read index may
+													// pass write_ if uncommitted samples get dropped)
+		lslboost::atomic<bool> interrupted_;		// whether interrupt() was called
+	};
+
+}
+
+#endif
+
@@ -1,5 +1,7 @@
 #include "send_buffer.h"
+#include <iostream>
 #include <boost/bind.hpp>
+#include "api_config.h"
 
 
 // === implementation of the send_buffer class ===
@@ -10,7 +12,7 @@ using namespace lsl;
 * Create a new send buffer.
 * @param max_capacity Hard upper bound on queue capacity beyond which the oldest samples will be dropped.
 */
-send_buffer::send_buffer(int max_capacity): max_capacity_(max_capacity) {} 
+send_buffer::send_buffer(int max_capacity): max_capacity_(max_capacity), shared_consumers_(0), shared_unavailable_(false) {} 
 
 
 /**
@@ -19,27 +21,62 @@ send_buffer::send_buffer(int max_capacity): max_capacity_(max_capacity) {}
 * @param max_buffered If non-zero, the queue size for this consumer will be constrained to be no larger than this value.
 *					  Note that the actual queue size will also never exceed the max_capacity of the send_buffer (so this is 
 *					  a global limit).
+* @param listener The function that the queue calls when a chunk arrives after the consumer asked for a notification.
 * @return Shared pointer to the newly created queue.
 */
-consumer_queue_p send_buffer::new_consumer(int max_buffered) { 
+chunk_queue_p send_buffer::new_consumer(int max_buffered, const lslboost::function<void()> &listener) { 
 	max_buffered = max_buffered ? std::min(max_buffered,max_capacity_) : max_capacity_;
-	return consumer_queue_p(new consumer_queue(max_buffered, shared_from_this())); 
+	return chunk_queue_p(new chunk_queue(max_buffered, shared_from_this(), listener)); 
 }
 
 
 /**
-* Push a sample onto the send buffer.
-* Will subsequently be seen by all consumers.
+* Push a chunk of samples onto the send buffer.
+* Will subsequently be seen by all consumers (an empty chunk pointer wakes them up).
 */
-void send_buffer::push_sample(const sample_p &s) {
+void send_buffer::push_chunk(const sample_chunk_p &c) {
 	lslboost::lock_guard<lslboost::mutex> lock(consumers_mut_);
 	for (consumer_set::iterator i=consumers_.begin(); i != consumers_.end(); i++)
-		(*i)->push_sample(s);
+		(*i)->push_chunk(c);
+	if (shared_consumers_ && c)
+		shared_ring_->push_chunk(*c);
+}
+
+
+/**
+* Attach a consumer on the same host to the shared-memory ring of the stream (creating the ring on first use).
+* The ring is only written while consumers are attached, so a consumer gets all samples from its write index
+* right after the attachment onwards.
+* @return The ring, or an empty pointer if no shared-memory ring can be provided (then the consumer stays on TCP).
+*/
+shm_ring_p send_buffer::attach_shared_consumer(const std::string &uid, channel_format_t fmt, int num_channels, double srate) {
+	{
+		lslboost::lock_guard<lslboost::mutex> lock(consumers_mut_);
+		if (!shared_ring_ && !shared_unavailable_) {
+			try {
+				shared_ring_ = shm_ring::create(uid,fmt,num_channels,srate,api_config::get_instance()->shared_memory_bytes(),max_capacity_);
+			} catch(std::exception &e) {
+				std::cerr << "Could not set up the shared-memory transport (" << e.what() << "); local consumers will use TCP." << std::endl;
+				shared_unavailable_ = true;
+			}
+		}
+		if (!shared_ring_)
+			return shm_ring_p();
+		shared_consumers_++;
+	}
+	some_registered_.notify_all();
+	return shared_ring_;
+}
+
+/// Detach a consumer that was attached to the shared-memory ring.
+void send_buffer::detach_shared_consumer() {
+	lslboost::lock_guard<lslboost::mutex> lock(consumers_mut_);
+	shared_consumers_--;
 }
 
 
 /// Registered a new consumer.
-void send_buffer::register_consumer(consumer_queue *q) {
+void send_buffer::register_consumer(chunk_queue *q) {
 	{
 		lslboost::lock_guard<lslboost::mutex> lock(consumers_mut_);
 		consumers_.insert(q);
@@ -48,7 +85,7 @@ void send_buffer::register_consumer(consumer_queue *q) {
 }
 
 /// Unregister a previously registered consumer.
-void send_buffer::unregister_consumer(consumer_queue *q) {
+void send_buffer::unregister_consumer(chunk_queue *q) {
 	lslboost::lock_guard<lslboost::mutex> lock(consumers_mut_);
 	consumers_.erase(q);
 }
@@ -6,20 +6,23 @@
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
-#include "consumer_queue.h"
+#include "chunk_queue.h"
+#include "shm_ring.h"
 
 namespace lsl {
 
 	/**
-	* A thread-safe single-producer multiple-consumer queue where each consumer gets every pushed sample.
+	* A thread-safe single-producer multiple-consumer queue where each consumer gets every pushed chunk of samples.
 	* If the bounded capacity is exhausted, the oldest samples will be erased.
 	* 
 	* Note that the send_buffer is actually just a dispatcher that distributes the data to producer-consumer 
 	* queues (each of which can have its own capacity preferences). The ownership of the send_buffer is shared 
-	* between the consumer_queues and the owner of the send_buffer.
+	* between the chunk_queues and the owner of the send_buffer.
+	* Consumers on the same host can instead attach to a shared-memory ring, which the send_buffer writes
+	* each chunk into once (for as long as such consumers are attached).
 	*/
 	class send_buffer: public lslboost::enable_shared_from_this<send_buffer> {
-		typedef lslboost::container::flat_set<consumer_queue*> consumer_set;
+		typedef lslboost::container::flat_set<chunk_queue*> consumer_set;
 	public:
 		/**
 		* Create a new send buffer.
@@ -34,15 +37,29 @@ namespace lsl {
 		* @param max_buffered If non-zero, the queue size for this consumer will be constrained to be no larger than this value.
 		*					  Note that the actual queue size will never exceed the max_capacity of the send_buffer (so this is 
 		*					  a global limit).
+		* @param listener The function that the queue calls when a chunk arrives after the consumer asked for a notification.
 		* @return Shared pointer to the newly created consumer.
 		*/
-		consumer_queue_p new_consumer(int max_buffered=0);
+		chunk_queue_p new_consumer(int max_buffered, const lslboost::function<void()> &listener);
 
 		/** 
-		* Push a sample onto the send buffer. 
-		* Will subsequently be received by all consumers.
+		* Push a chunk of samples onto the send buffer. 
+		* Will subsequently be received by all consumers (an empty chunk pointer wakes them up).
 		*/
-		void push_sample(const sample_p &s);
+		void push_chunk(const sample_chunk_p &c);
+
+		/**
+		* Attach a consumer on the same host to the shared-memory ring of the stream (creating the ring on first use).
+		* @param uid The UID of the stream.
+		* @param fmt The channel format of the stream (must be numeric).
+		* @param num_channels The number of channels of the stream.
+		* @param srate The nominal sampling rate of the stream.
+		* @return The ring, or an empty pointer if no shared-memory ring can be provided (then the consumer stays on TCP).
+		*/
+		shm_ring_p attach_shared_consumer(const std::string &uid, channel_format_t fmt, int num_channels, double srate);
+
+		/// Detach a consumer that was attached to the shared-memory ring.
+		void detach_shared_consumer();
 
 		/// Wait until some consumers are present.
 		bool wait_for_consumers(double timeout=FOREVER);
@@ -51,18 +68,21 @@ namespace lsl {
 		bool have_consumers();
 
 	private:
-		friend class consumer_queue;
+		friend class chunk_queue;
 
-		/// Registered a new consumer (called by the consumer_queue).
-		void register_consumer(consumer_queue *q);
-		/// Unregister a previously registered consumer (called by the consumer_queue).
-		void unregister_consumer(consumer_queue *q);
+		/// Registered a new consumer (called by the chunk_queue).
+		void register_consumer(chunk_queue *q);
+		/// Unregister a previously registered consumer (called by the chunk_queue).
+		void unregister_consumer(chunk_queue *q);
 
 		/// wait_for_consumers is waiting for this
-		bool some_registered() const { return !consumers_.empty(); }
+		bool some_registered() const { return !consumers_.empty() || shared_consumers_; }
 
 		int max_capacity_;							// maximum capacity beyond which the oldest samples will be dropped
 		consumer_set consumers_;					// a set of registered consumer queues
+		shm_ring_p shared_ring_;					// the shared-memory ring for consumers on the same host (once created)
+		int shared_consumers_;						// the number of consumers attached to the shared-memory ring
+		bool shared_unavailable_;					// whether the shared-memory ring could not be created
 		lslboost::mutex consumers_mut_;				// mutex to protect the integrity of consumers_
 		lslboost::condition_variable some_registered_;	// condition variable signaling that a consumer has registered
 	};
@@ -0,0 +1,270 @@
+#include "shm_ring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <boost/atomic.hpp>
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+// === implementation of the shm_ring class ===
+
+using namespace lsl;
+
+/// identifies a segment of this layout
+static const char shm_magic[8] = "LSLSHM1";
+/// number of bytes of samples that a reader copies at a time, at most
+static const std::size_t max_read_bytes = 1 << 20;
+
+/// The header at the start of a segment; it is followed by the time stamps and then by the channel values of the slots.
+struct shm_ring::header {
+	char magic[8];								// shm_magic
+	char uid[48];								// the UID of the stream
+	int32_t format;								// the channel format
+	int32_t num_channels;						// the number of channels
+	uint64_t capacity;							// the number of slots
+	double srate;								// the nominal sampling rate
+	int64_t writer_pid;							// the process of the writer
+	lslboost::atomic<uint64_t> reserved;		// number of samples that the writer has begun to write (their slots may be in flux)
+	lslboost::atomic<uint64_t> written;			// number of samples published so far
+	lslboost::atomic<uint32_t> closed;			// set by the writer when it goes away
+};
+
+/// The offset of the time stamps in the segment.
+std::size_t shm_ring::timestamps_offset() { return (sizeof(header)+63) & ~(std::size_t)63; }
+
+/// Whether shared-memory rings are supported on this platform.
+bool shm_ring::supported() {
+#ifdef __linux__
+	return true;
+#else
+	return false;
+#endif
+}
+
+/// The name of the segment of a stream with the given UID.
+std::string shm_ring::segment_name(const std::string &uid) { return "/lsl-" + uid; }
+
+/**
+* Remove the segments that were left behind by writers that did not exit cleanly (e.g., killed with SIGKILL).
+* Segments whose header is not (yet) complete, or whose writer process still exists, are left alone.
+*/
+void shm_ring::remove_stale_segments() {
+#ifdef __linux__
+	DIR *dir = opendir("/dev/shm");
+	if (!dir)
+		return;
+	while (dirent *entry = readdir(dir)) {
+		if (strncmp(entry->d_name, "lsl-", 4))
+			continue;
+		const std::string name = std::string("/") + entry->d_name;
+		int fd = shm_open(name.c_str(), O_RDONLY, 0);
+		if (fd < 0)
+			continue;
+		struct stat st;
+		void *base = MAP_FAILED;
+		if (fstat(fd, &st) == 0 && (std::size_t)st.st_size >= sizeof(header))
+			base = mmap(NULL, sizeof(header), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED)
+			continue;
+		const header &hdr = *(const header*)base;
+		if (!memcmp(hdr.magic, shm_magic, sizeof(shm_magic)) && hdr.writer_pid > 0 && kill((pid_t)hdr.writer_pid, 0) != 0 && errno == ESRCH)
+			shm_unlink(name.c_str());
+		munmap(base, sizeof(header));
+	}
+	closedir(dir);
+#endif
+}
+
+shm_ring::shm_ring(int fd, void *base, std::size_t size, bool writer): fd_(fd), base_(base), size_(size), writer_(writer), hdr_((header*)base),
+	last_timestamp_(0.0)
+{
+	capacity_ = (std::size_t)hdr_->capacity;
+	sample_bytes_ = format_sizes[hdr_->format]*hdr_->num_channels;
+	timestamps_ = (double*)((char*)base + timestamps_offset());
+	values_ = (char*)(timestamps_ + capacity_);
+	if (!writer) {
+		const std::size_t max_read = std::min(capacity_, std::max<std::size_t>(max_read_bytes/(sizeof(double)+sample_bytes_),1));
+		read_timestamps_.resize(max_read);
+		read_values_.resize(max_read*sample_bytes_);
+	}
+}
+
+/**
+* Create the segment of a stream as its writer.
+* The segments of writers that were killed before they could remove theirs are cleaned up first.
+* The memory of the segment is reserved up front, so that running out of it fails here rather than with a SIGBUS later on.
+*/
+shm_ring_p shm_ring::create(const std::string &uid, channel_format_t fmt, int num_channels, double srate, std::size_t max_bytes, std::size_t max_capacity) {
+#ifdef __linux__
+	if (fmt == cf_string)
+		throw std::invalid_argument("A shared-memory ring cannot hold string-formatted samples.");
+	if (uid.size() >= sizeof(((header*)0)->uid))
+		throw std::invalid_argument("The stream UID is too long for a shared-memory segment.");
+	const std::size_t slot_bytes = sizeof(double) + format_sizes[fmt]*num_channels;
+	const std::size_t capacity = std::min(max_capacity, max_bytes > timestamps_offset() ? (max_bytes - timestamps_offset())/slot_bytes : 0);
+	if (!capacity)
+		throw std::runtime_error("The shared-memory segment would be too small for a single sample.");
+	const std::size_t size = timestamps_offset() + capacity*slot_bytes;
+	const std::string name = segment_name(uid);
+	remove_stale_segments();
+	// (only readable by the same user)
+	int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0)
+		throw std::runtime_error("Could not create the shared-memory segment " + name + ": " + strerror(errno));
+	int err = posix_fallocate(fd, 0, (off_t)size);
+	void *base = err ? MAP_FAILED : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		if (!err)
+			err = errno;
+		close(fd);
+		shm_unlink(name.c_str());
+		throw std::runtime_error("Could not allocate the shared-memory segment " + name + ": " + strerror(err));
+	}
+	header *hdr = new (base) header();
+	memcpy(hdr->magic, shm_magic, sizeof(shm_magic));
+	memcpy(hdr->uid, uid.c_str(), uid.size() + 1);
+	hdr->format = fmt;
+	hdr->num_channels = num_channels;
+	hdr->capacity = capacity;
+	hdr->srate = srate;
+	hdr->writer_pid = getpid();
+	hdr->reserved.store(0, lslboost::memory_order_relaxed);
+	hdr->written.store(0, lslboost::memory_order_relaxed);
+	hdr->closed.store(0, lslboost::memory_order_release);
+	shm_ring_p ring(new shm_ring(fd, base, size, true));
+	ring->name_ = name;
+	return ring;
+#else
+	throw std::runtime_error("Shared-memory rings are not supported on this platform.");
+#endif
+}
+
+/**
+* Open the segment of a stream as a reader.
+* The segment is mapped writable since the atomic loads of the indices may need write access on some platforms.
+*/
+shm_ring_p shm_ring::open(const std::string &uid, channel_format_t fmt, int num_channels) {
+#ifdef __linux__
+	const std::string name = segment_name(uid);
+	int fd = shm_open(name.c_str(), O_RDWR, 0);
+	if (fd < 0)
+		throw std::runtime_error("Could not open the shared-memory segment " + name + ": " + strerror(errno));
+	struct stat st;
+	void *base = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (std::size_t)st.st_size >= timestamps_offset())
+		base = mmap(NULL, (std::size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		close(fd);
+		throw std::runtime_error("Could not map the shared-memory segment " + name + ".");
+	}
+	shm_ring_p ring(new shm_ring(fd, base, (std::size_t)st.st_size, false));
+	const header &hdr = *ring->hdr_;
+	if (memcmp(hdr.magic, shm_magic, sizeof(shm_magic)) || strncmp(hdr.uid, uid.c_str(), sizeof(hdr.uid)) || hdr.format != fmt || hdr.num_channels != num_channels
+		|| (std::size_t)st.st_size < timestamps_offset() + hdr.capacity*(sizeof(double) + ring->sample_bytes_))
+		throw std::runtime_error("The shared-memory segment " + name + " does not match the stream.");
+	return ring;
+#else
+	throw std::runtime_error("Shared-memory rings are not supported on this platform.");
+#endif
+}
+
+/// Destructor. The writer marks the segment as closed and removes it.
+shm_ring::~shm_ring() {
+#ifdef __linux__
+	if (writer_)
+		hdr_->closed.store(1, lslboost::memory_order_release);
+	munmap(base_, size_);
+	close(fd_);
+	if (writer_)
+		shm_unlink(name_.c_str());
+#endif
+}
+
+/**
+* Append the samples of a chunk (called by a single thread at a time).
+* Deduced time stamps are resolved here, so the readers get the actual ones.
+*/
+void shm_ring::push_chunk(const sample_chunk &chunk) {
+	const std::size_t n = chunk.size();
+	const double *timestamps = chunk.timestamps();
+	const char *values = chunk.values();
+	const double srate = hdr_->srate;
+	const uint64_t write = hdr_->written.load(lslboost::memory_order_relaxed);
+	// of a chunk that is larger than the ring, only the last samples are written
+	const std::size_t skip = n > capacity_ ? n - capacity_ : 0;
+	// announce the slots that are going to be overwritten before writing them
+	hdr_->reserved.store(write + n, lslboost::memory_order_relaxed);
+	lslboost::atomic_thread_fence(lslboost::memory_order_release);
+	for (std::size_t k=0; k<n; k++) {
+		double timestamp = timestamps[k];
+		if (timestamp == DEDUCED_TIMESTAMP) {
+			timestamp = last_timestamp_;
+			if (srate != IRREGULAR_RATE)
+				timestamp += 1.0/srate;
+		}
+		last_timestamp_ = timestamp;
+		if (k < skip)
+			continue;
+		const std::size_t slot = (std::size_t)((write + k) % capacity_);
+		timestamps_[slot] = timestamp;
+		memcpy(values_ + slot*sample_bytes_, values + k*sample_bytes_, sample_bytes_);
+	}
+	hdr_->written.store(write + n, lslboost::memory_order_release);
+}
+
+/// The number of samples written so far.
+uint64_t shm_ring::write_index() const { return hdr_->written.load(lslboost::memory_order_acquire); }
+
+/**
+* Copy the samples after the cursor into a sample ring and commit them (up to a limited number at a time).
+* The samples are copied out of the shared ring first; those whose slots the writer has begun to overwrite in the
+* meantime are then discarded, and only the rest is appended.
+*/
+std::size_t shm_ring::read(sample_ring &dst, uint64_t &cursor) {
+	const uint64_t write = hdr_->written.load(lslboost::memory_order_acquire);
+	if (write <= cursor)
+		return 0;
+	if (write - cursor > capacity_)
+		cursor = write - capacity_;
+	const std::size_t n = (std::size_t)std::min<uint64_t>(write - cursor, read_timestamps_.size());
+	// copy the samples up to the end of the ring, then the rest from its start
+	const std::size_t slot = (std::size_t)(cursor % capacity_), first = std::min(n, capacity_ - slot);
+	memcpy(&read_timestamps_[0], timestamps_ + slot, first*sizeof(double));
+	memcpy(&read_timestamps_[first], timestamps_, (n - first)*sizeof(double));
+	memcpy(&read_values_[0], values_ + slot*sample_bytes_, first*sample_bytes_);
+	memcpy(&read_values_[first*sample_bytes_], values_, (n - first)*sample_bytes_);
+	lslboost::atomic_thread_fence(lslboost::memory_order_acquire);
+	const uint64_t reserved = hdr_->reserved.load(lslboost::memory_order_relaxed);
+	const std::size_t torn = (std::size_t)std::min<uint64_t>(n, reserved > cursor + capacity_ ? reserved - cursor - capacity_ : 0);
+	for (std::size_t k=torn; k<n; k++) {
+		double *timestamp;
+		memcpy(dst.next_slot(timestamp), &read_values_[k*sample_bytes_], sample_bytes_);
+		*timestamp = read_timestamps_[k];
+		dst.push_slot();
+	}
+	dst.commit();
+	cursor += n;
+	return n - torn;
+}
+
+/// Whether the writer has closed the segment.
+bool shm_ring::closed() const { return hdr_->closed.load(lslboost::memory_order_acquire) != 0; }
+
+/// Whether the process of the writer is still running.
+bool shm_ring::writer_alive() const {
+#ifdef __linux__
+	return kill((pid_t)hdr_->writer_pid, 0) == 0 || errno != ESRCH;
+#else
+	return true;
+#endif
+}
@@ -0,0 +1,110 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include "sample_chunk.h"
+#include "sample_ring.h"
+
+namespace lsl {
+
+	/// shared pointer to a shared-memory ring
+	typedef lslboost::shared_ptr<class shm_ring> shm_ring_p;
+
+	/**
+	* A ring of samples of a numeric stream in a POSIX shared-memory segment, through which an outlet serves the
+	* inlets on the same host (so that their samples need not go through the loopback TCP stack).
+	* The outlet is the single writer: it copies each pushed chunk into the ring once (resolving deduced time stamps),
+	* and any number of readers (the inlets, possibly in other processes) follow it, each at its own cursor. The writer
+	* never waits for a reader: a reader that falls behind by more than the capacity of the ring loses the oldest samples.
+	* The writer announces the slots it is about to overwrite before it writes them, so a reader can discard the samples
+	* that might have been overwritten while it copied them (like a seqlock).
+	* Only supported on Linux; elsewhere (and if the segment cannot be set up) the connections stay on TCP.
+	*/
+	class shm_ring: private lslboost::noncopyable {
+	public:
+		/// Whether shared-memory rings are supported on this platform.
+		static bool supported();
+
+		/// The name of the segment of a stream with the given UID.
+		static std::string segment_name(const std::string &uid);
+
+		/**
+		* Create the segment of a stream as its writer.
+		* The segment is removed when the writer is destroyed; segments left behind by writers that were killed are
+		* removed here.
+		* @param uid The UID of the stream.
+		* @param fmt The channel format (must not be cf_string).
+		* @param num_channels The number of channels per sample.
+		* @param srate The nominal sampling rate (used to deduce time stamps).
+		* @param max_bytes The size of the segment, at most (determines the capacity of the ring).
+		* @param max_capacity The capacity of the ring, at most (in samples).
+		* @throws std::runtime_error if the segment cannot be created.
+		*/
+		static shm_ring_p create(const std::string &uid, channel_format_t fmt, int num_channels, double srate, std::size_t max_bytes, std::size_t max_capacity);
+
+		/**
+		* Open the segment of a stream as a reader.
+		* @throws std::runtime_error if the segment does not exist or does not match the stream.
+		*/
+		static shm_ring_p open(const std::string &uid, channel_format_t fmt, int num_channels);
+
+		/// Destructor. The writer marks the segment as closed and removes it.
+		~shm_ring();
+
+		// === writer side ===
+
+		/// Append the samples of a chunk (called by a single thread at a time).
+		void push_chunk(const sample_chunk &chunk);
+
+		// === reader side ===
+
+		/// The number of samples written so far (the initial cursor of a reader that shall get all samples from now on).
+		uint64_t write_index() const;
+
+		/**
+		* Copy the samples after the cursor into a sample ring and commit them (up to a limited number at a time).
+		* Samples that were overwritten before they could be copied are skipped.
+		* @param dst The ring to append the samples to.
+		* @param cursor The number of samples of the shared ring read so far (updated).
+		* @return The number of samples appended.
+		*/
+		std::size_t read(sample_ring &dst, uint64_t &cursor);
+
+		/// Whether the writer has closed the segment.
+		bool closed() const;
+
+		/// Whether the process of the writer is still running.
+		bool writer_alive() const;
+
+	private:
+		struct header;
+
+		/// Remove the segments of writer processes that no longer exist.
+		static void remove_stale_segments();
+
+		shm_ring(int fd, void *base, std::size_t size, bool writer);
+
+		/// The offset of the time stamps in the segment.
+		static std::size_t timestamps_offset();
+
+		int fd_;									// the file descriptor of the segment
+		void *base_;								// the mapping of the segment
+		std::size_t size_;							// the size of the mapping
+		bool writer_;								// whether we are the writer
+		std::string name_;							// the name of the segment (writer only, for its removal)
+		header *hdr_;								// the header at the start of the segment
+		double *timestamps_;						// the time stamps of the slots
+		char *values_;								// the channel values of the slots
+		std::size_t capacity_;						// number of slots
+		std::size_t sample_bytes_;					// bytes of the channel values of a sample
+		double last_timestamp_;						// the time stamp of the last written sample (writer only, to deduce the next one)
+		std::vector<double> read_timestamps_;		// the time stamps copied by the last read (reader only)
+		std::vector<char> read_values_;				// the channel values copied by the last read (reader only)
+	};
+
+}
+
+#endif
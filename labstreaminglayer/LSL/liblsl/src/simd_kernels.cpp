@@ -0,0 +1,266 @@
+#include "simd_kernels.h"
+#include <cstring>
+#include <boost/cstdint.hpp>
+#include "endian/conversion.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define LSL_SIMD_X86
+	#define LSL_TARGET(isa) __attribute__((target(isa)))
+	#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#define LSL_SIMD_X86
+	#define LSL_TARGET(isa)
+	#include <intrin.h>
+	#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define LSL_SIMD_NEON
+	#include <arm_neon.h>
+#endif
+
+// === implementation of the vectorized channel data conversions ===
+
+using namespace lsl;
+
+namespace {
+
+	// --- scalar kernels (also used for the tails of the vectorized ones) ---
+
+	/// Reverse the byte order of values of type T (an unsigned integer of the value size).
+	template<class T> void reverse_scalar(char *p, std::size_t count) {
+		for (std::size_t k=0; k<count; k++, p+=sizeof(T)) {
+			T v; memcpy(&v,p,sizeof(T));
+			lslboost::endian::reverse(v);
+			memcpy(p,&v,sizeof(T));
+		}
+	}
+
+	void flush_scalar_32(char *p, std::size_t count) {
+		for (std::size_t k=0; k<count; k++, p+=4) {
+			uint32_t v; memcpy(&v,p,4);
+			if (v && ((v & UINT32_C(0x7fffffff)) <= UINT32_C(0x007fffff))) {
+				v &= UINT32_C(0x80000000);
+				memcpy(p,&v,4);
+			}
+		}
+	}
+
+	void flush_scalar_64(char *p, std::size_t count) {
+		for (std::size_t k=0; k<count; k++, p+=8) {
+			uint64_t v; memcpy(&v,p,8);
+			if (v && ((v & UINT64_C(0x7fffffffffffffff)) <= UINT64_C(0x000fffffffffffff))) {
+				v &= UINT64_C(0x8000000000000000);
+				memcpy(p,&v,8);
+			}
+		}
+	}
+
+	void reverse_bytes_scalar(char *p, std::size_t value_bytes, std::size_t count) {
+		switch (value_bytes) {
+			case 2: reverse_scalar<uint16_t>(p,count); break;
+			case 4: reverse_scalar<uint32_t>(p,count); break;
+			case 8: reverse_scalar<uint64_t>(p,count); break;
+		}
+	}
+
+	void flush_subnormals_scalar(char *p, std::size_t value_bytes, std::size_t count) {
+		if (value_bytes == 4)
+			flush_scalar_32(p,count);
+		else if (value_bytes == 8)
+			flush_scalar_64(p,count);
+	}
+
+#ifdef LSL_SIMD_X86
+	/// The pshufb control that reverses the bytes of each value of the given size within a 16-byte lane.
+	const char *shuffle_mask(std::size_t value_bytes) {
+		static const char masks[3][16] = {
+			{1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14},
+			{3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12},
+			{7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8}};
+		return masks[value_bytes==2 ? 0 : value_bytes==4 ? 1 : 2];
+	}
+
+	// --- SSSE3 kernels (16 bytes at a time) ---
+
+	LSL_TARGET("ssse3") void reverse_bytes_ssse3(char *p, std::size_t value_bytes, std::size_t count) {
+		if (value_bytes != 2 && value_bytes != 4 && value_bytes != 8)
+			return;
+		const __m128i mask = _mm_loadu_si128((const __m128i*)shuffle_mask(value_bytes));
+		char *end = p + (count*value_bytes & ~(std::size_t)15);
+		for (; p<end; p+=16)
+			_mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), mask));
+		reverse_bytes_scalar(p, value_bytes, count % (16/value_bytes));
+	}
+
+	// SSE2 suffices for these, but they are only dispatched along with the SSSE3 byte swap
+	LSL_TARGET("ssse3") void flush_subnormals_ssse3(char *p, std::size_t value_bytes, std::size_t count) {
+		if (value_bytes != 4 && value_bytes != 8)
+			return;
+		// a subnormal (or zero) has an all-zero exponent; its bits except for the sign are cleared
+		// (the exponent of a double is in the upper 32-bit half of its lane)
+		const __m128i exponent = value_bytes == 4 ? _mm_set1_epi32(0x7f800000) : _mm_set_epi32(0x7ff00000,0,0x7ff00000,0);
+		const __m128i magnitude = value_bytes == 4 ? _mm_set1_epi32(0x7fffffff) : _mm_set_epi32(0x7fffffff,-1,0x7fffffff,-1);
+		const __m128i zero = _mm_setzero_si128();
+		char *end = p + (count*value_bytes & ~(std::size_t)15);
+		for (; p<end; p+=16) {
+			__m128i v = _mm_loadu_si128((const __m128i*)p);
+			__m128i denormal = _mm_cmpeq_epi32(_mm_and_si128(v,exponent),zero);
+			if (value_bytes == 8)
+				denormal = _mm_shuffle_epi32(denormal,_MM_SHUFFLE(3,3,1,1));
+			_mm_storeu_si128((__m128i*)p, _mm_andnot_si128(_mm_and_si128(denormal,magnitude),v));
+		}
+		flush_subnormals_scalar(p, value_bytes, count % (16/value_bytes));
+	}
+
+	// --- AVX2 kernels (32 bytes at a time) ---
+
+	LSL_TARGET("avx2") void reverse_bytes_avx2(char *p, std::size_t value_bytes, std::size_t count) {
+		if (value_bytes != 2 && value_bytes != 4 && value_bytes != 8)
+			return;
+		const __m128i lane = _mm_loadu_si128((const __m128i*)shuffle_mask(value_bytes));
+		const __m256i mask = _mm256_inserti128_si256(_mm256_castsi128_si256(lane),lane,1);
+		char *end = p + (count*value_bytes & ~(std::size_t)31);
+		for (; p<end; p+=32)
+			_mm256_storeu_si256((__m256i*)p, _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)p), mask));
+		reverse_bytes_ssse3(p, value_bytes, count % (32/value_bytes));
+	}
+
+	LSL_TARGET("avx2") void flush_subnormals_avx2(char *p, std::size_t value_bytes, std::size_t count) {
+		if (value_bytes != 4 && value_bytes != 8)
+			return;
+		const __m256i exponent = value_bytes == 4 ? _mm256_set1_epi32(0x7f800000) : _mm256_set1_epi64x(0x7ff0000000000000LL);
+		const __m256i magnitude = value_bytes == 4 ? _mm256_set1_epi32(0x7fffffff) : _mm256_set1_epi64x(0x7fffffffffffffffLL);
+		const __m256i zero = _mm256_setzero_si256();
+		char *end = p + (count*value_bytes & ~(std::size_t)31);
+		for (; p<end; p+=32) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)p), masked = _mm256_and_si256(v,exponent);
+			__m256i denormal = value_bytes == 4 ? _mm256_cmpeq_epi32(masked,zero) : _mm256_cmpeq_epi64(masked,zero);
+			_mm256_storeu_si256((__m256i*)p, _mm256_andnot_si256(_mm256_and_si256(denormal,magnitude),v));
+		}
+		flush_subnormals_ssse3(p, value_bytes, count % (32/value_bytes));
+	}
+
+	/// Check which of the instruction sets the CPU (and the OS, for the AVX registers) supports.
+	bool cpu_has_ssse3() {
+#ifdef _MSC_VER
+		int info[4]; __cpuid(info,1);
+		return (info[2] & (1<<9)) != 0;
+#else
+		return __builtin_cpu_supports("ssse3");
+#endif
+	}
+	bool cpu_has_avx2() {
+#ifdef _MSC_VER
+		int info[4]; __cpuid(info,0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info,1);
+		// OSXSAVE and AVX, and the OS saves the YMM registers
+		if ((info[2] & (1<<27 | 1<<28)) != (1<<27 | 1<<28) || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info,7,0);
+		return (info[1] & (1<<5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+#ifdef LSL_SIMD_NEON
+	// --- NEON kernels (16 bytes at a time) ---
+
+	void reverse_bytes_neon(char *p, std::size_t value_bytes, std::size_t count) {
+		if (value_bytes != 2 && value_bytes != 4 && value_bytes != 8)
+			return;
+		char *end = p + (count*value_bytes & ~(std::size_t)15);
+		for (; p<end; p+=16) {
+			uint8x16_t v = vld1q_u8((const uint8_t*)p);
+			vst1q_u8((uint8_t*)p, value_bytes == 2 ? vrev16q_u8(v) : value_bytes == 4 ? vrev32q_u8(v) : vrev64q_u8(v));
+		}
+		reverse_bytes_scalar(p, value_bytes, count % (16/value_bytes));
+	}
+
+	void flush_subnormals_neon(char *p, std::size_t value_bytes, std::size_t count) {
+		if (value_bytes != 4 && value_bytes != 8)
+			return;
+		char *end = p + (count*value_bytes & ~(std::size_t)15);
+		if (value_bytes == 4) {
+			const uint32x4_t exponent = vdupq_n_u32(0x7f800000), sign = vdupq_n_u32(0x80000000);
+			for (; p<end; p+=16) {
+				uint32x4_t v = vld1q_u32((const uint32_t*)p);
+				// keep the sign only where the exponent is zero
+				uint32x4_t keep = vorrq_u32(vtstq_u32(v,exponent),sign);
+				vst1q_u32((uint32_t*)p, vandq_u32(v,keep));
+			}
+		} else {
+			// 64-bit lanes are compared through the upper 32-bit halves, which hold the exponent
+			const uint32x4_t exponent = vreinterpretq_u32_u64(vdupq_n_u64(UINT64_C(0x7ff0000000000000)));
+			const uint32x4_t sign = vreinterpretq_u32_u64(vdupq_n_u64(UINT64_C(0x8000000000000000)));
+			for (; p<end; p+=16) {
+				uint32x4_t v = vld1q_u32((const uint32_t*)p);
+				uint64x2_t normal = vreinterpretq_u64_u32(vtstq_u32(v,exponent));
+				// spread the result of the upper half over the whole lane
+				uint32x4_t keep = vorrq_u32(vreinterpretq_u32_u64(vorrq_u64(normal,vshrq_n_u64(normal,32))),sign);
+				vst1q_u32((uint32_t*)p, vandq_u32(v,keep));
+			}
+		}
+		flush_subnormals_scalar(p, value_bytes, count % (16/value_bytes));
+	}
+#endif
+
+	/// The kernels that are used on this machine.
+	struct kernels {
+		void (*reverse_bytes)(char *p, std::size_t value_bytes, std::size_t count);
+		void (*flush_subnormals)(char *p, std::size_t value_bytes, std::size_t count);
+		const char *isa;
+
+		kernels(): reverse_bytes(&reverse_bytes_scalar), flush_subnormals(&flush_subnormals_scalar), isa("scalar") {
+#if defined(LSL_SIMD_X86)
+			if (cpu_has_avx2()) {
+				reverse_bytes = &reverse_bytes_avx2;
+				flush_subnormals = &flush_subnormals_avx2;
+				isa = "avx2";
+			} else if (cpu_has_ssse3()) {
+				reverse_bytes = &reverse_bytes_ssse3;
+				flush_subnormals = &flush_subnormals_ssse3;
+				isa = "ssse3";
+			}
+#elif defined(LSL_SIMD_NEON)
+			reverse_bytes = &reverse_bytes_neon;
+			flush_subnormals = &flush_subnormals_neon;
+			isa = "neon";
+#endif
+		}
+
+		/// The kernels, selected at the first call.
+		static const kernels &get() {
+			static kernels instance;
+			return instance;
+		}
+	};
+
+}
+
+/**
+* Reverse the byte order of a number of consecutive values in-place.
+* @param data The values (need not be aligned).
+* @param value_bytes The size of a value: 2, 4 or 8 bytes (other sizes are left as they are).
+* @param count The number of values.
+*/
+void lsl::reverse_bytes(void *data, std::size_t value_bytes, std::size_t count) {
+	kernels::get().reverse_bytes((char*)data,value_bytes,count);
+}
+
+/**
+* Flush subnormal IEEE 754 numbers to zero (keeping their sign) in-place.
+* @param data The values (need not be aligned).
+* @param value_bytes The size of a value: 4 (float) or 8 (double) bytes (other sizes are left as they are).
+* @param count The number of values.
+*/
+void lsl::flush_subnormals(void *data, std::size_t value_bytes, std::size_t count) {
+	kernels::get().flush_subnormals((char*)data,value_bytes,count);
+}
+
+/// The name of the instruction set that the kernels use on this machine.
+const char *lsl::simd_kernels_isa() {
+	return kernels::get().isa;
+}
@@ -0,0 +1,37 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstddef>
+
+/**
+* Vectorized conversions of channel data, used by the (de)serialization of samples when the peer
+* uses the other byte order or does not support subnormal numbers.
+* On x86 the fastest kernel that the CPU supports (AVX2, SSSE3 or plain C++) is picked at the first
+* call; ARM builds with NEON use it unconditionally.
+*/
+
+namespace lsl {
+
+	/**
+	* Reverse the byte order of a number of consecutive values in-place.
+	* @param data The values (need not be aligned).
+	* @param value_bytes The size of a value: 2, 4 or 8 bytes (other sizes are left as they are).
+	* @param count The number of values.
+	*/
+	void reverse_bytes(void *data, std::size_t value_bytes, std::size_t count);
+
+	/**
+	* Flush subnormal IEEE 754 numbers to zero (keeping their sign) in-place.
+	* @param data The values (need not be aligned).
+	* @param value_bytes The size of a value: 4 (float) or 8 (double) bytes (other sizes are left as they are).
+	* @param count The number of values.
+	*/
+	void flush_subnormals(void *data, std::size_t value_bytes, std::size_t count);
+
+	/// The name of the instruction set that the kernels use on this machine ("avx2", "ssse3", "neon" or "scalar").
+	const char *simd_kernels_isa();
+
+}
+
+#endif
+
@@ -148,13 +148,16 @@ namespace lsl {
 				throw std::runtime_error("The number of buffer elements must be a multiple of the stream's channel count.");
 			if (timestamp_buffer && max_samples != timestamp_buffer_elements)
 				throw std::runtime_error("The timestamp buffer must hold the same number of samples as the data buffer.");
-			double end_time = timeout ? lsl_clock()+timeout : 0.0;
-			for (samples_written=0; samples_written<max_samples; samples_written++) {
-				if (double ts=pull_sample(&data_buffer[samples_written*num_chans],num_chans,timeout?end_time-lsl_clock():0.0)) {
-					if (timestamp_buffer)
-						timestamp_buffer[samples_written] = ts;
-				} else
-					break;
+			if (timestamp_buffer) {
+				samples_written = data_receiver_.pull_chunk_typed(data_buffer, timestamp_buffer, max_samples, timeout);
+				for (std::size_t k=0; k<samples_written; k++)
+					timestamp_buffer[k] = postprocess(timestamp_buffer[k]);
+			} else {
+				// the time stamps still go through the postprocessor, which may keep state
+				std::vector<double> timestamps(max_samples);
+				samples_written = data_receiver_.pull_chunk_typed(data_buffer, max_samples ? &timestamps[0] : NULL, max_samples, timeout);
+				for (std::size_t k=0; k<samples_written; k++)
+					postprocess(timestamps[k]);
 			}
 			return samples_written*num_chans;
 		}
@@ -230,7 +233,7 @@ namespace lsl {
 		* Query the current size of the buffer, i.e. the number of samples that are buffered.
 		* Note that this value may be inaccurate and should not be relied on for program logic.
 		*/
-		std::size_t samples_available() { return (std::size_t)(!data_receiver_.empty()); };
+		std::size_t samples_available() { return data_receiver_.size(); };
 
 		/** Query whether the clock was potentially reset since the last call to was_clock_reset().
 		* This is only interesting for applications that combine multiple time_correction values to estimate clock drift
@@ -7,7 +7,8 @@
 #include "common.h"
 #include "api_config.h"
 #include "udp_server.h"
-#include "sample.h"
+#include "io_pool.h"
+#include "sample_chunk.h"
 
 
 
@@ -15,8 +16,6 @@ namespace lsl {
 
 	/// pointer to a thread
 	typedef lslboost::shared_ptr<lslboost::thread> thread_p;
-	/// pointer to an io_service
-	typedef lslboost::shared_ptr<lslboost::asio::io_service> io_service_p;
 
 	/**
 	* A stream outlet.
@@ -103,11 +102,10 @@ namespace lsl {
 		* @param pushthrough Whether to push the sample through to the receivers instead of buffering it into a chunk according to network speeds.
 		*/
 		void push_numeric_raw(const void *data, double timestamp=0.0, bool pushthrough=true) {
-			if (lsl::api_config::get_instance()->force_default_timestamps())
-				timestamp = 0.0;
-			sample_p smp(sample_factory_->new_sample(timestamp == 0.0 ? lsl_clock() : timestamp, pushthrough));
-			smp->assign_untyped(data);
-			send_buffer_->push_sample(smp);
+			sample_chunk_p chunk(sample_chunk::create(info_->channel_format(),info_->channel_count(),1,pushthrough));
+			chunk->timestamps()[0] = effective_timestamp(timestamp,lsl::api_config::get_instance()->force_default_timestamps());
+			chunk->assign_untyped(data);
+			send_buffer_->push_chunk(chunk);
 		}
 
 		//
@@ -116,6 +114,7 @@ namespace lsl {
 
 		/**
 		* Push a chunk of multiplexed samples into the send buffer. One timestamp per sample is provided.
+		* The chunk is handed to the send buffer as a single element.
 		* IMPORTANT: Note that the provided buffer size is measured in channel values (e.g., floats) rather than in samples.
 		* @param data_buffer A buffer of channel values holding the data for zero or more successive samples to send.
 		* @param timestamp_buffer A buffer of timestamp values holding time stamps for each sample in the data buffer.
@@ -131,8 +130,15 @@ namespace lsl {
 				throw std::runtime_error("The data buffer pointer must not be NULL.");
 			if (!timestamp_buffer)
 				throw std::runtime_error("The timestamp buffer pointer must not be NULL.");
-			for (std::size_t k=0; k<num_samples; k++)
-				enqueue(&data_buffer[k*num_chans],timestamp_buffer[k],pushthrough && k==num_samples-1);
+			if (num_samples > 0) {
+				sample_chunk_p chunk(sample_chunk::create(info_->channel_format(),(int)num_chans,num_samples,pushthrough));
+				bool force_default = lsl::api_config::get_instance()->force_default_timestamps();
+				double *timestamps = chunk->timestamps();
+				for (std::size_t k=0; k<num_samples; k++)
+					timestamps[k] = effective_timestamp(timestamp_buffer[k],force_default);
+				chunk->assign_typed(data_buffer);
+				send_buffer_->push_chunk(chunk);
+			}
 		}
 
 		template<class T> int32_t push_chunk_multiplexed_noexcept(const T *data_buffer, const double *timestamp_buffer, std::size_t data_buffer_elements, bool pushthrough=true) BOOST_NOEXCEPT {
@@ -156,6 +162,7 @@ namespace lsl {
 
 		/**
 		* Push a chunk of multiplexed samples into the send buffer. Single timestamp provided.
+		* The chunk is handed to the send buffer as a single element.
 		* IMPORTANT: Note that the provided buffer size is measured in channel values (e.g., floats) rather than in samples.
 		* @param buffer A buffer of channel values holding the data for zero or more successive samples to send.
 		* @param buffer_elements The number of channel values (of type T) in the buffer. Must be a multiple of the channel count.
@@ -175,9 +182,13 @@ namespace lsl {
 					timestamp = lsl_clock();
 				if (info().nominal_srate() != IRREGULAR_RATE)
 					timestamp = timestamp - (num_samples-1)/info().nominal_srate();
-				push_sample(buffer,timestamp,pushthrough && (num_samples==1));
-				for (std::size_t k=1; k<num_samples; k++)
-					push_sample(&buffer[k*num_chans],DEDUCED_TIMESTAMP,pushthrough && (k==num_samples-1));
+				sample_chunk_p chunk(sample_chunk::create(info_->channel_format(),(int)num_chans,num_samples,pushthrough));
+				bool force_default = lsl::api_config::get_instance()->force_default_timestamps();
+				double *timestamps = chunk->timestamps();
+				for (std::size_t k=0; k<num_samples; k++)
+					timestamps[k] = effective_timestamp(k ? DEDUCED_TIMESTAMP : timestamp,force_default);
+				chunk->assign_typed(buffer);
+				send_buffer_->push_chunk(chunk);
 			}
 		}
 
@@ -230,16 +241,21 @@ namespace lsl {
 		void run_io(io_service_p &ios);
 
 		/**
-		* Allocate and enqueue a new sample into the send buffer.
+		* Allocate and enqueue a new sample (as a chunk of one) into the send buffer.
 		*/
 		template<class T> void enqueue(T* data, double timestamp, bool pushthrough) { 
-			if (lsl::api_config::get_instance()->force_default_timestamps())
-				timestamp = 0.0;
-			sample_p smp(sample_factory_->new_sample(timestamp == 0.0 ? lsl_clock() : timestamp, pushthrough));
-			smp->assign_typed(data);
-			send_buffer_->push_sample(smp);
+			sample_chunk_p chunk(sample_chunk::create(info_->channel_format(),info_->channel_count(),1,pushthrough));
+			chunk->timestamps()[0] = effective_timestamp(timestamp,lsl::api_config::get_instance()->force_default_timestamps());
+			chunk->assign_typed(data);
+			send_buffer_->push_chunk(chunk);
 		}
 
+		/**
+		* Get the time stamp to transmit for a time stamp given by the user.
+		* The current time is used if the time stamp is 0.0 (= omitted) or if default time stamps are forced by the configuration.
+		*/
+		static double effective_timestamp(double timestamp, bool force_default) { return (force_default || timestamp == 0.0) ? lsl_clock() : timestamp; }
+
 		/**
 		* Check whether some given number of channels matches the stream's channel_count.
 		* Throws an error if not.
@@ -249,16 +265,15 @@ namespace lsl {
 				throw std::range_error("The provided sample data has a different length than the stream's number of channels.");	
 		}
 
-		sample::factory_p sample_factory_;			// a factory for samples of appropriate type
 		int32_t chunk_size_;							// the preferred chunk size
 		stream_info_impl_p info_;					// stream_info shared between the various server instances
 		send_buffer_p send_buffer_;					// the single-producer, multiple-receiver send buffer
-		std::vector<io_service_p> ios_;				// the IO service objects (two per stack: one for UDP and one for TCP)
+		std::vector<io_service_p> ios_;				// the IO service objects (one per stack, for UDP; the TCP servers use the shared io_pool)
 
 		std::vector<tcp_server_p> tcp_servers_;		// the threaded TCP data server(s); two if using both IP stacks
 		std::vector<udp_server_p> udp_servers_;		// the UDP timing & ident service(s); two if using both IP stacks
 		std::vector<udp_server_p> responders_;		// UDP multicast responders for service discovery (time features disabled); also using only the allowed IP stacks
-		std::vector<thread_p> io_threads_;			// threads that handle the I/O operations (two per stack: one for UDP and one for TCP)
+		std::vector<thread_p> io_threads_;			// threads that handle the UDP I/O operations (one per stack)
 	};
 
 }
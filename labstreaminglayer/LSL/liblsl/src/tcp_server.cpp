@@ -7,6 +7,7 @@
 #include <boost/container/flat_set.hpp>
 #include "tcp_server.h"
 #include "socket_utils.h"
+#include "trace.h"
 
 // a convention that applies when including portable_oarchive.h in multiple .cpp files.
 // otherwise, the templates are instantiated in this file and sample.cpp which leads
@@ -32,7 +33,7 @@ using namespace lslboost::asio;
 * @param protocol The protocol (IPv4 or IPv6) that shall be serviced by this server.
 * @param chunk_size The preferred chunk size, in samples. If 0, the pushthrough flag determines the effective chunking.
 */
-tcp_server::tcp_server(const stream_info_impl_p &info, const io_service_p &io, const send_buffer_p &sendbuf, const sample::factory_p &factory, tcp protocol, int chunk_size): chunk_size_(chunk_size), shutdown_(false), info_(info), io_(io), factory_(factory), send_buffer_(sendbuf), acceptor_(new tcp::acceptor(*io)) {
+tcp_server::tcp_server(const stream_info_impl_p &info, const io_service_p &io, const send_buffer_p &sendbuf, tcp protocol, int chunk_size): chunk_size_(chunk_size), shutdown_(false), info_(info), io_(io), send_buffer_(sendbuf), acceptor_(new tcp::acceptor(*io)), accept_strand_(new io_service::strand(*io)) {
 	// open the server connection
 	acceptor_->open(protocol);
 
@@ -74,11 +75,11 @@ void tcp_server::end_serving() {
 	// the shutdown flag informs the transfer thread that we're shutting down
 	shutdown_ = true;
 	// issue closure of the server socket; this will result in a cancellation of the associated IO operations
-	io_->post(lslboost::bind(&tcp::acceptor::close,acceptor_));
+	accept_strand_->post(lslboost::bind(&tcp::acceptor::close,acceptor_));
 	// issue closure of all active client session sockets; cancels the related outstanding IO jobs
 	close_inflight_sockets();
-	// also notify any transfer threads that are blocked waiting for a sample by sending them one (= a ping)
-	send_buffer_->push_sample(factory_->new_sample(lsl_clock(), true));
+	// also notify any transfer threads that are blocked waiting for a chunk by sending them an empty one (= a ping)
+	send_buffer_->push_chunk(sample_chunk_p());
 }
 
 
@@ -91,7 +92,7 @@ void tcp_server::accept_next_connection() {
 		client_session_p newsession(new client_session(shared_from_this()));
 		// accept a connection on the session's socket
 		acceptor_->async_accept(*newsession->socket(),
-			lslboost::bind(&tcp_server::handle_accept_outcome,shared_from_this(),newsession,placeholders::error));
+			accept_strand_->wrap(lslboost::bind(&tcp_server::handle_accept_outcome,shared_from_this(),newsession,placeholders::error)));
 	}  catch(std::exception &e) {
 		std::cerr << "Error during tcp_server::accept_next_connection (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
 	}
@@ -112,9 +113,9 @@ void tcp_server::handle_accept_outcome(client_session_p newsession, error_code e
 // === graceful cancellation of in-flight sockets ===
 
 /// Register an in-flight (active) session socket with the server (so that we can close it when a shutdown is requested externally).
-void tcp_server::register_inflight_socket(const tcp_socket_p &sock) {
+void tcp_server::register_inflight_socket(const tcp_socket_p &sock, const strand_p &strand) {
 	lslboost::lock_guard<lslboost::recursive_mutex> lock(inflight_mut_);
-	inflight_.insert(sock);
+	inflight_.insert(std::make_pair(sock,strand));
 }
 
 /// Unregister an in-flight session socket.
@@ -138,11 +139,11 @@ template<class SocketPtr, class Protocol> void shutdown_and_close(SocketPtr sock
 	}
 }
 
-/// Post a close of all in-flight sockets.
+/// Post a close of all in-flight sockets (each on the strand of its session, so it cannot race with the session's handlers).
 void tcp_server::close_inflight_sockets() {
 	lslboost::lock_guard<lslboost::recursive_mutex> lock(inflight_mut_);
-	for (std::set<tcp_socket_p>::iterator i=inflight_.begin(); i!=inflight_.end(); i++)
-		io_->post(lslboost::bind(&shutdown_and_close<tcp_socket_p,tcp>,*i));
+	for (std::map<tcp_socket_p,strand_p>::iterator i=inflight_.begin(); i!=inflight_.end(); i++)
+		i->second->post(lslboost::bind(&shutdown_and_close<tcp_socket_p,tcp>,i->first));
 }
 
 
@@ -151,11 +152,16 @@ void tcp_server::close_inflight_sockets() {
 // === implementation of the tcp_server::client_session class ===
 //
 
+/// duration from which on a transfer is taken to measure the throughput of the link (faster ones were absorbed by the socket buffer)
+static const double link_measurement_seconds = 0.005;
+/// duration without a transfer that was held up by the link after which its measured throughput is forgotten (so that a feed that was compressed goes back to uncompressed once the link has recovered)
+static const double link_measurement_lifetime = 10.0;
+
 
 /// Instantiate a new session & its socket.
 tcp_server::client_session::client_session(const tcp_server_p &serv):
-    registered_(false), io_(serv->io_), serv_(serv), sock_(tcp_socket_p(new tcp::socket(*serv->io_))),
-    requeststream_(&requestbuf_), use_byte_order_(0), data_protocol_version_(100) {	}
+    registered_(false), io_(serv->io_), serv_(serv), sock_(tcp_socket_p(new tcp::socket(*serv->io_))), strand_(new io_service::strand(*serv->io_)),
+    requeststream_(&requestbuf_), use_byte_order_(0), data_protocol_version_(100), compress_auto_(false) {	}
 
 /**
 * Destructor. Unregisters the socket from the server & closes it.
@@ -165,6 +171,8 @@ tcp_server::client_session::~client_session() {
 	try {
 		if (registered_)
 			serv_->unregister_inflight_socket(sock_);
+		if (shared_ring_)
+			serv_->send_buffer_->detach_shared_consumer();
 	}
 	catch(std::exception &e) {
 		std::cerr << "Unexpected error in client_session destructor (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
@@ -182,16 +190,21 @@ void tcp_server::client_session::begin_processing() {
 	try {
 		sock_->set_option(lslboost::asio::ip::tcp::no_delay(true));
 		// register this socket as "in-flight" with the server (so that any subsequent ops on it can be aborted if necessary)
-		serv_->register_inflight_socket(sock_);
+		serv_->register_inflight_socket(sock_,strand_);
 		registered_ = true;
-		// read the request line
-		async_read_until(*sock_, requestbuf_, "\r\n",
-			lslboost::bind(&client_session::handle_read_command_outcome,shared_from_this(),placeholders::error));
+		// from here on, the socket may be closed through the strand, so it is only used on the strand
+		strand_->dispatch(lslboost::bind(&client_session::read_command,shared_from_this()));
 	} catch(std::exception &e) {
 		std::cerr << "Error during client_session::begin_processing (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
 	}
 }
 
+/// Read the request line.
+void tcp_server::client_session::read_command() {
+	async_read_until(*sock_, requestbuf_, "\r\n",
+		strand_->wrap(lslboost::bind(&client_session::handle_read_command_outcome,shared_from_this(),placeholders::error)));
+}
+
 /// Handler that gets called when the reading of the 1st line (request line) of the inbound message finished.
 void tcp_server::client_session::handle_read_command_outcome(error_code err) {
 	try {
@@ -201,22 +214,22 @@ void tcp_server::client_session::handle_read_command_outcome(error_code err) {
 			if (method == "LSL:shortinfo")
 				// shortinfo request: read the content query string
 				async_read_until(*sock_, requestbuf_, "\r\n",
-					lslboost::bind(&client_session::handle_read_query_outcome,shared_from_this(),placeholders::error));
+					strand_->wrap(lslboost::bind(&client_session::handle_read_query_outcome,shared_from_this(),placeholders::error)));
 			if (method == "LSL:fullinfo")
 				// fullinfo request: reply right away
 				async_write(*sock_, lslboost::asio::buffer(serv_->fullinfo_msg_),
-					lslboost::bind(&client_session::handle_send_outcome,shared_from_this(),placeholders::error));
+					strand_->wrap(lslboost::bind(&client_session::handle_send_outcome,shared_from_this(),placeholders::error)));
 			if (method == "LSL:streamfeed")
 				// streamfeed request (1.00): read feed parameters
 				async_read_until(*sock_, requestbuf_, "\r\n",
-					lslboost::bind(&client_session::handle_read_feedparams,shared_from_this(),100,"",placeholders::error));
+					strand_->wrap(lslboost::bind(&client_session::handle_read_feedparams,shared_from_this(),100,"",placeholders::error)));
 			if (lslboost::algorithm::starts_with(method,"LSL:streamfeed/")) {
 				// streamfeed request with version: read feed parameters
 				std::vector<std::string> parts; lslboost::algorithm::split(parts,method,lslboost::algorithm::is_any_of(" \t"));
 				int request_protocol_version = lslboost::lexical_cast<int>(parts[0].substr(parts[0].find_first_of('/')+1));
 				std::string request_uid = (parts.size()>1) ? parts[1] : "";
 				async_read_until(*sock_, requestbuf_, "\r\n\r\n",
-					lslboost::bind(&client_session::handle_read_feedparams,shared_from_this(),request_protocol_version,request_uid,placeholders::error));
+					strand_->wrap(lslboost::bind(&client_session::handle_read_feedparams,shared_from_this(),request_protocol_version,request_uid,placeholders::error)));
 			}
 		}
 	} catch(std::exception &e) {
@@ -233,7 +246,7 @@ void tcp_server::client_session::handle_read_query_outcome(error_code err) {
 			if (serv_->info_->matches_query(query))
 				// matches: reply (otherwise just close the stream)
 				async_write(*sock_, lslboost::asio::buffer(serv_->shortinfo_msg_),
-					lslboost::bind(&client_session::handle_send_outcome,shared_from_this(),placeholders::error));
+					strand_->wrap(lslboost::bind(&client_session::handle_send_outcome,shared_from_this(),placeholders::error)));
 		}
 	} catch(std::exception &e) {
 		std::cerr << "Unexpected error while parsing a client request (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
@@ -247,7 +260,7 @@ void tcp_server::client_session::handle_send_outcome(error_code err) { }
 void tcp_server::client_session::send_status_message(const std::string &str) {
 	string_p msg(new std::string(str));
 	async_write(*sock_, lslboost::asio::buffer(*msg),
-		lslboost::bind(&client_session::handle_status_outcome,shared_from_this(),msg,placeholders::error));
+		strand_->wrap(lslboost::bind(&client_session::handle_status_outcome,shared_from_this(),msg,placeholders::error)));
 }
 
 /// Handler that gets called after finishing the sending of a message, holding a reference to the message.
@@ -277,6 +290,9 @@ void tcp_server::client_session::handle_read_feedparams(int request_protocol_ver
 				bool client_supports_subnormals = true;	// the client supports subnormal numbers
 				int client_protocol_version = request_protocol_version;	// assume that the client wants to use the same version for data transmission
 				int client_value_size = serv_->info_->channel_bytes();	// assume that the client has a standard size for the relevant data type
+				bool client_shared_memory = false;		// whether the client is on the same host and can read the samples from shared memory
+				std::string client_compression;			// the codec of a compressed feed that the client asks for (if any)
+				bool client_compression_auto = false;	// whether the compression shall only be used while the link cannot keep up
 				channel_format_t format = serv_->info_->channel_format();
 
 				// read feed parameters
@@ -308,6 +324,12 @@ void tcp_server::client_session::handle_read_feedparams(int request_protocol_ver
 							chunk_granularity_ = lslboost::lexical_cast<int>(rest);
 						if (type == "protocol-version")
 							client_protocol_version = lslboost::lexical_cast<int>(rest);
+						if (type == "shared-memory")
+							client_shared_memory = lslboost::lexical_cast<bool>(rest);
+						if (type == "compression")
+							client_compression = rest;
+						if (type == "compression-mode")
+							client_compression_auto = (rest == "auto");
 					}
 				}
 
@@ -335,6 +357,16 @@ void tcp_server::client_session::handle_read_feedparams(int request_protocol_ver
 					// determine if subnormal suppression needs to be enabled
 					client_suppress_subnormals = (format_subnormal[format] && !client_supports_subnormals);
 				}
+				// a client on the same host can read numeric samples from the shared-memory ring of the outlet if it needs no conversions
+				uint64_t shared_start = 0;
+				if (client_shared_memory && data_protocol_version_ >= 110 && format != cf_string && use_byte_order_ == BOOST_BYTE_ORDER && !client_suppress_subnormals && max_buffered_ > 0)
+					if ((shared_ring_ = serv_->send_buffer_->attach_shared_consumer(serv_->info_->uid(),format,serv_->info_->channel_count(),serv_->info_->nominal_srate())))
+						shared_start = shared_ring_->write_index();
+				// a client (on another host) may ask for a compressed feed of numeric samples if both parties use the same byte order
+				if (client_compression == "delta-bitpack" && !shared_ring_ && data_protocol_version_ >= 110 && format != cf_string && client_byte_order == BOOST_BYTE_ORDER) {
+					encoder_.reset(new feed_encoder(format,serv_->info_->channel_count()));
+					compress_auto_ = client_compression_auto;
+				}
 
 				// send the response
 				std::ostream response_stream(&feedbuf_);
@@ -343,6 +375,10 @@ void tcp_server::client_session::handle_read_feedparams(int request_protocol_ver
 				response_stream << "Byte-Order: " << use_byte_order_ << "\r\n";
 				response_stream << "Suppress-Subnormals: " << client_suppress_subnormals << "\r\n";
 				response_stream << "Data-Protocol-Version: " << data_protocol_version_ << "\r\n";
+				if (shared_ring_)
+					response_stream << "Shared-Memory: " << shared_start << "\r\n";
+				if (encoder_)
+					response_stream << "Compression: delta-bitpack\r\n";
 				response_stream << "\r\n" << std::flush;
 			} else {
 				// read feed parameters
@@ -374,7 +410,7 @@ void tcp_server::client_session::handle_read_feedparams(int request_protocol_ver
 				*outarch_ << *temp;
 			// send off the newly created feedheader
 			async_write(*sock_,feedbuf_.data(),
-				lslboost::bind(&client_session::handle_send_feedheader_outcome,shared_from_this(),placeholders::error,placeholders::bytes_transferred));
+				strand_->wrap(lslboost::bind(&client_session::handle_send_feedheader_outcome,shared_from_this(),placeholders::error,placeholders::bytes_transferred)));
 		}
 	} catch(std::exception &e) {
 		std::cerr << "Unexpected error while serializing the feed header (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
@@ -386,84 +422,203 @@ void tcp_server::client_session::handle_send_feedheader_outcome(error_code err,
 	try {
 		if (!err) {
 			feedbuf_.consume(n);
-			// register outstanding work at the server (will be unregistered at session destruction)
-			work_.reset(new io_service::work(*serv_->io_));
-			// spawn a sample transfer thread
-			lslboost::thread(&client_session::transfer_samples_thread,this,shared_from_this());
+			if (max_buffered_ <= 0)
+				return;
+			if (shared_ring_) {
+				// the samples go through shared memory: just keep the connection until the client closes it
+				async_read(*sock_, requestbuf_, transfer_at_least(1),
+					strand_->wrap(lslboost::bind(&client_session::handle_shared_outcome,shared_from_this(),placeholders::error)));
+				return;
+			}
+			// set up the transfer state
+			if (data_protocol_version_ < 110)
+				temp_.reset(sample::factory::new_sample_unmanaged(serv_->info_->channel_format(),serv_->info_->channel_count(),0.0,false));
+			// the chunk granularity that overrides the pushthrough flag: that of the receiver (if set) or of the sender (if set)
+			granularity_ = chunk_granularity_ ? (uint32_t)chunk_granularity_ : (uint32_t)serv_->chunk_size_;
+			seqn_ = 0;
+			feedbuf_queued_ = pending_bytes_ = flush_parts_ = flush_feedbuf_ = 0;
+			link_rate_ = feed_rate_ = link_measured_ = 0.0;
+			rate_window_start_ = lsl_clock();
+			rate_window_bytes_ = 0;
+			// make a new consumer queue (its listener holds a reference to this session until the transfer ends)
+			queue_ = serv_->send_buffer_->new_consumer(max_buffered_, lslboost::bind(&client_session::schedule_transfer,shared_from_this()));
+			// and start transferring
+			transfer_chunks();
 		}
 	} catch(std::exception &e) {
 		std::cerr << "Unexpected error while handling the feedheader send outcome (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
 	}
 }
 
-/// Transfers samples from the server's send buffer into the async send queues of the IO threads.
-void tcp_server::client_session::transfer_samples_thread(client_session_p) {
-	if (max_buffered_ <= 0)
-		return;
+/// Handler that gets called when a client that reads from shared memory has closed the connection (which ends the session).
+void tcp_server::client_session::handle_shared_outcome(error_code) { }
+
+/// Schedule transfer_chunks() on the IO service (called by the chunk queue when a chunk arrives).
+void tcp_server::client_session::schedule_transfer() {
+	strand_->post(lslboost::bind(&client_session::transfer_chunks,shared_from_this()));
+}
+
+/**
+* Serialize the chunks that are available in the queue and send them off, or wait for more.
+* At most one of these handlers runs at a time: it is only ever invoked by the completion of a write or by a requested notification.
+* While a write is in flight, newly pushed chunks accumulate in the queue (whose capacity bounds the memory use for slow
+* receivers); they are then sent together with a single gathered write.
+*/
+void tcp_server::client_session::transfer_chunks() {
 	try {
-		// make a new consumer queue
-		consumer_queue_p queue = serv_->send_buffer_->new_consumer(max_buffered_);
-		// the sequence # is merely used to determine chunk boundaries (no need for int64)
-		uint32_t seqn = 0;
-		while (!serv_->shutdown_) {
-			try {
-				// get next sample from the sample queue (blocking)
-				sample_p samp(queue->pop_sample());
-				if (serv_->shutdown_)
-					break;
-				// ignore blank samples (they are basically wakeup notifiers from someone's end_serving())
-				if (!samp)
-					continue;
-				// optionally override the pushthrough flag by the chunk size of the receiver (if set) or of the sender (if set)
-				if (chunk_granularity_)
-					samp->pushthrough = (((++seqn) % (uint32_t)chunk_granularity_) == 0);
-				else
-					if (serv_->chunk_size_)
-						samp->pushthrough = (((++seqn) % (uint32_t)serv_->chunk_size_) == 0);
-				// serialize the sample into the stream
-				if (data_protocol_version_ >= 110)
-					samp->save_streambuf(feedbuf_,data_protocol_version_,use_byte_order_,scratch_.get());
-				else
-					*outarch_ << *samp;
-				// if the sample shall be pushed though...
-				if (samp->pushthrough) {
-					// send off the chunk that we aggregated so far
-					lslboost::unique_lock<lslboost::mutex> lock(completion_mut_);
-					transfer_completed_ = false;
-					async_write(*sock_,feedbuf_.data(),
-						lslboost::bind(&client_session::handle_chunk_transfer_outcome,shared_from_this(),placeholders::error,placeholders::bytes_transferred));
-					// wait for the completion condition
-					completion_cond_.wait(lock, lslboost::bind(&client_session::transfer_completed,this));
-					// handle transfer outcome
-					if (!transfer_error_) {
-						feedbuf_.consume(transfer_amount_);
-					} else
+		while (true) {
+			if (serv_->shutdown_)
+				return end_transfer();
+			// serialize what is available (up to a limit)
+			while (pending_bytes_ < max_transfer_bytes) {
+				if (!chunk_) {
+					sample_chunk_p next;
+					if (!queue_->pop_chunk(next))
 						break;
+					if (serv_->shutdown_)
+						return end_transfer();
+					// ignore blank chunks (they are basically wakeup notifiers from someone's end_serving())
+					if (!next)
+						continue;
+					chunk_ = next;
+					chunk_pos_ = 0;
+					// the serialization of a large chunk is computed once and shared with all other sessions that use the same byte order
+					chunk_shared_ = !encoder_ && data_protocol_version_ >= 110 && chunk_->size()*format_sizes[serv_->info_->channel_format()]*serv_->info_->channel_count() >= shared_serialization_bytes;
 				}
-
-			} catch(std::exception &e) {
-				std::cerr << "Unexpected glitch in transfer_samples_thread (id: " << lslboost::this_thread::get_id() << "): " << e.what() << std::endl;
+				serialize_segment();
+			}
+			// send everything up to the last push-through point (or everything, if the limit was reached)
+			if (!flush_parts_ && pending_bytes_ >= max_transfer_bytes) {
+				queue_feedbuf_part();
+				flush_parts_ = parts_.size();
+				flush_feedbuf_ = feedbuf_queued_;
+			}
+			if (flush_parts_) {
+				LSL_TRACE_SCOPE("transfer_chunk");
+				transfer_started_ = lsl_clock();
+				const char *feed = buffer_cast<const char*>(feedbuf_.data());
+				outbufs_.clear();
+				for (std::size_t k=0; k<flush_parts_; k++)
+					outbufs_.push_back(buffer(parts_[k].data ? parts_[k].data : feed + parts_[k].offset, parts_[k].length));
+				async_write(*sock_,outbufs_,
+					strand_->wrap(lslboost::bind(&client_session::handle_chunk_transfer_outcome,shared_from_this(),placeholders::error,placeholders::bytes_transferred)));
+				return;
 			}
+			// nothing to send yet: have the queue notify us of the next chunk (unless one has arrived in the meantime)
+			if (queue_->notify_when_nonempty())
+				return;
 		}
 	} catch(std::exception &e) {
-		std::cerr << "Unexpected error in transfer_samples_thread (id: " << lslboost::this_thread::get_id() << "): " << e.what() << "; exiting..." << std::endl;
+		std::cerr << "Unexpected error in transfer_chunks (id: " << lslboost::this_thread::get_id() << "): " << e.what() << "; closing the session..." << std::endl;
+		end_transfer();
 	}
 }
 
+/// Serialize the next segment of the current chunk (up to the next point at which the data shall be pushed through).
+void tcp_server::client_session::serialize_segment() {
+	LSL_TRACE_SCOPE("serialize_chunk");
+	std::size_t begin = chunk_pos_, end;
+	bool pushthrough;
+	if (granularity_) {
+		// a segment ends at the next multiple of the granularity (or at the end of the chunk)
+		end = std::min(chunk_->size(), begin + (granularity_ - seqn_ % granularity_));
+		seqn_ += (uint32_t)(end - begin);
+		pushthrough = (seqn_ % granularity_) == 0;
+	} else {
+		end = chunk_->size();
+		pushthrough = chunk_->pushthrough;
+	}
+	if (encoder_) {
+		// a compressed feed: encode the segment into frames
+		pending_bytes_ += encoder_->encode(*chunk_,begin,end,!compress_auto_ || link_limited(end-begin),feedbuf_);
+	} else if (chunk_shared_) {
+		const sample_chunk::serialized_chunk &ser = chunk_->serialized(use_byte_order_);
+		queue_feedbuf_part();
+		transfer_part part = {&ser.data[ser.offsets[begin]], 0, ser.offsets[end]-ser.offsets[begin], chunk_};
+		parts_.push_back(part);
+		pending_bytes_ += part.length;
+	} else {
+		std::size_t before = feedbuf_.size();
+		if (data_protocol_version_ >= 110)
+			chunk_->save_streambuf(feedbuf_,use_byte_order_,scratch_.get(),begin,end);
+		else
+			for (std::size_t k=begin; k<end; k++) {
+				chunk_->retrieve_sample(k,*temp_);
+				*outarch_ << *temp_;
+			}
+		pending_bytes_ += feedbuf_.size() - before;
+	}
+	// if the segment shall be pushed through, everything up to here goes into the next transfer
+	if (pushthrough) {
+		queue_feedbuf_part();
+		flush_parts_ = parts_.size();
+		flush_feedbuf_ = feedbuf_queued_;
+	}
+	chunk_pos_ = end;
+	if (chunk_pos_ == chunk_->size())
+		chunk_.reset();
+}
+
 /// Handler that gets called when a sample transfer has been completed.
 void tcp_server::client_session::handle_chunk_transfer_outcome(error_code err, std::size_t len) {
 	try {
-		{
-			lslboost::lock_guard<lslboost::mutex> lock(completion_mut_);
-			// assign the transfer outcome
-			transfer_error_ = err;
-			transfer_amount_ = len;
-			transfer_completed_ = true;
+		if (err)
+			return end_transfer();
+		// a transfer that took a while was limited by the link (rather than absorbed by the socket buffer), so it tells the link's throughput
+		const double now = lsl_clock(), elapsed = now - transfer_started_;
+		if (encoder_ && compress_auto_ && elapsed >= link_measurement_seconds && len >= link_measurement_bytes) {
+			link_rate_ = link_rate_ ? 0.8*link_rate_ + 0.2*len/elapsed : len/elapsed;
+			link_measured_ = now;
 		}
-		// notify the server thread
-		completion_cond_.notify_all();
+		// release the parts that were sent
+		parts_.erase(parts_.begin(),parts_.begin()+flush_parts_);
+		feedbuf_.consume(flush_feedbuf_);
+		for (std::vector<transfer_part>::iterator p=parts_.begin(); p!=parts_.end(); p++)
+			if (!p->data)
+				p->offset -= flush_feedbuf_;
+		feedbuf_queued_ -= flush_feedbuf_;
+		pending_bytes_ -= len;
+		flush_parts_ = flush_feedbuf_ = 0;
+		// and continue with the next transfer
+		transfer_chunks();
 	} catch(std::exception &e) {
-		std::cerr << "Catastrophic error in handling the chunk transfer outcome (in tcp_server): " << e.what() << std::endl;
+		std::cerr << "Catastrophic error in handling the chunk transfer outcome (in tcp_server): " << e.what() << "; closing the session..." << std::endl;
+		end_transfer();
 	}
 }
 
+/**
+* Account for the serialization of a segment and determine whether the link cannot keep up with the uncompressed feed.
+* That is assumed once the uncompressed data rate of the last second exceeds half of the link's measured throughput.
+* Only transfers that are held up by the link measure it, so the measurement expires when none has been for a while:
+* the feed then goes back to uncompressed, and is measured (and compressed) again if the link still cannot keep up.
+*/
+bool tcp_server::client_session::link_limited(std::size_t num_samples) {
+	const double now = lsl_clock();
+	rate_window_bytes_ += num_samples*(1 + sizeof(double) + serv_->info_->sample_bytes());
+	if (link_rate_ && now - link_measured_ >= link_measurement_lifetime)
+		link_rate_ = 0.0;
+	if (now - rate_window_start_ >= 1.0) {
+		feed_rate_ = rate_window_bytes_/(now - rate_window_start_);
+		rate_window_start_ = now;
+		rate_window_bytes_ = 0;
+	}
+	return link_rate_ > 0 && feed_rate_ > link_rate_/2;
+}
+
+/// End the data transfer (which releases the session unless other handlers are still pending).
+void tcp_server::client_session::end_transfer() {
+	// destroying the queue releases its listener's reference to this session
+	queue_.reset();
+	chunk_.reset();
+	parts_.clear();
+}
+
+/// Append the part of the feed buffer that has not been queued for the next transfer yet.
+void tcp_server::client_session::queue_feedbuf_part() {
+	if (feedbuf_.size() > feedbuf_queued_) {
+		transfer_part part = {NULL, feedbuf_queued_, feedbuf_.size()-feedbuf_queued_, sample_chunk_p()};
+		parts_.push_back(part);
+		feedbuf_queued_ = feedbuf_.size();
+	}
+}
@@ -4,16 +4,18 @@
 #pragma warning (disable:4800)	// (inefficiently converting int to bool in portable_oarchive instantiation...)
 
 #include "stream_info_impl.h"
-#include <set>
+#include <map>
 #include <iostream>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/streambuf.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/thread.hpp>
 #include "common.h"
 
 #include "send_buffer.h"
+#include "feed_codec.h"
 #include "api_config.h"
 
 using lslboost::asio::ip::tcp;
@@ -31,13 +33,16 @@ namespace lsl {
 	typedef lslboost::shared_ptr<class tcp_server> tcp_server_p;
 	/// pointer to an io_service
 	typedef lslboost::shared_ptr<lslboost::asio::io_service> io_service_p;
+	/// pointer to a strand (that serializes the handlers of a session)
+	typedef lslboost::shared_ptr<lslboost::asio::io_service::strand> strand_p;
 
 	/**
 	* The TCP data server.
 	* Acts as a TCP server on a free port (in the configured port range), and understands the following messages:
 	*  * LSL:streamfeed: A request to receive streaming data on the connection. The server responds with
 	*				     the shortinfo, two samples filled with a test pattern, followed by samples until
-	*					 the server outlet goes out of existence.
+	*					 the server outlet goes out of existence. A client on the same host may instead be
+	*					 told to read the samples from the outlet's shared-memory ring (see shm_ring).
 	*  * LSL:fullinfo: A request for the stream_info served by this server.
 	*  * LSL:shortinfo: A request for the stream_info served by this server if matching the provided query string.
 	*                   The short version of the stream_info (empty <desc> element) is returned.
@@ -54,11 +59,10 @@ namespace lsl {
 		* @param info A stream_info that is shared with other server objects.
 		* @param io An io_service that is shared with other server objects.
 		* @param sendbuf A send buffer that is shared with other server objects.
-		* @param factory A sample factory that is shared with other server objects.
 		* @param protocol The protocol (IPv4 or IPv6) that shall be serviced by this server.
 		* @param chunk_size The preferred chunk size, in samples. If 0, the pushthrough flag determines the effective chunking.
 		*/
-		tcp_server(const stream_info_impl_p &info, const io_service_p &io, const send_buffer_p &sendbuf, const sample::factory_p &factory, tcp protocol, int chunk_size);
+		tcp_server(const stream_info_impl_p &info, const io_service_p &io, const send_buffer_p &sendbuf, tcp protocol, int chunk_size);
 
 		/// Begin serving TCP connections.
 		/// Should not be called before info_ has been fully initialized by all involved parties (tcp_server, udp_server)
@@ -80,13 +84,13 @@ namespace lsl {
 		/// Handler that is called when the accept has finished.
 		void handle_accept_outcome(client_session_p newsession, error_code err);
 
-		/// Register an in-flight (active) session socket with the server (so that we can close it when a shutdown is requested externally).
-		void register_inflight_socket(const tcp_socket_p &sock);
+		/// Register an in-flight (active) session socket and the strand of its session with the server (so that we can close it when a shutdown is requested externally).
+		void register_inflight_socket(const tcp_socket_p &sock, const strand_p &strand);
 
 		/// Unregister an in-flight session socket.
 		void unregister_inflight_socket(const tcp_socket_p &sock);
 
-		/// Post a close of all in-flight sockets.
+		/// Post a close of all in-flight sockets (each on the strand of its session).
 		void close_inflight_sockets();
 
 		/**
@@ -99,14 +103,17 @@ namespace lsl {
 		*   instance). Their lifetime is managed by lslboost::asio and ends when the handler chain ends (e.g., is aborted). Since the TCP server
 		*   is referred to (occasionally) by handler code, the tcp_server is owned also by the client_sessions, and therefore kept alive for as
 		*   long as there is at least one request chain running.
-		* - There is a per-session transfer thread (transfer_samples_thread) that owns the respective client_session and therefore the 
-		*   TCP server, as well (since it may refer to it); it goes out of scope once the server is being shut down.
-		* - The TCP server and client session also have shared ownership of the io_service (since in some cases some transfer threads
+		* - The data transfer of a session is a handler chain, as well: each transfer handler either issues a write whose completion
+		*   handler continues the chain, or asks the session's chunk queue for a notification, whose listener (held by the queue, which
+		*   the session owns) posts the next transfer handler. This reference cycle is broken when the transfer ends (because of an
+		*   error or because the server is being shut down).
+		* - The io_service may be run by several threads, so all handlers of a session (and the closing of its socket at shutdown)
+		*   go through the session's strand: no two of them ever run concurrently.
+		* - The TCP server and client session also have shared ownership of the io_service (since in some cases some transfers
 		*	can outlive the stream outlet, and so the io_service is still kept around until all sockets have been properly released).
 		* - So memory is generally owned by the code (functors and stack frames) that needs to refer to it for the duration of the execution.
 		*/
 		class client_session: public lslboost::enable_shared_from_this<client_session> {
-			typedef lslboost::shared_ptr<lslboost::asio::io_service::work> work_p;
 		public:
 			/// Instantiate a new session & its socket.
 			client_session(const tcp_server_p &serv);
@@ -122,6 +129,9 @@ namespace lsl {
 
 		private:
 
+			/// Read the request line (the start of the session's handler chain on its strand).
+			void read_command();
+
 			/// Handler that gets called when the reading of the 1st line (command line) of the inbound message finished.
 			void handle_read_command_outcome(error_code err);
 
@@ -143,20 +153,43 @@ namespace lsl {
 			/// Handler that gets called sending the feedheader has completed.
 			void handle_send_feedheader_outcome(error_code err, std::size_t n);
 
-			/// Transfers samples from the server's send buffer into the async send queues of the IO threads.
-			void transfer_samples_thread(client_session_p sess);
+			/// Handler that gets called when a client that reads from shared memory has closed the connection.
+			void handle_shared_outcome(error_code);
+
+			/// Serialize the chunks that are available in the queue and send them off, or wait for more (at most one of these handlers runs at a time).
+			void transfer_chunks();
+
+			/// Schedule transfer_chunks() on the IO service (called by the chunk queue when a chunk arrives).
+			void schedule_transfer();
+
+			/// Serialize the next segment of the current chunk (up to the next point at which the data shall be pushed through).
+			void serialize_segment();
 
 			/// Handler that gets called when a sample transfer has been completed.
 			void handle_chunk_transfer_outcome(error_code err, std::size_t len);
 
-			/// There is a condition variable that is waiting on this condition in the inner transfer loop
-			bool transfer_completed() const { return transfer_completed_; }
+			/// Account for the serialization of a segment and determine whether the link cannot keep up with the uncompressed feed (auto compression).
+			bool link_limited(std::size_t num_samples);
+
+			/// End the data transfer (which releases the session unless other handlers are still pending).
+			void end_transfer();
+
+			/// Append the part of the feed buffer that has not been queued for the next transfer yet.
+			void queue_feedbuf_part();
+
+			/// A part of the next transfer: either a range of the feed buffer (if data is NULL) or a part of a shared chunk serialization.
+			struct transfer_part {
+				const char *data;				// the shared data, or NULL for a range of the feed buffer
+				std::size_t offset;				// offset of the range in the feed buffer
+				std::size_t length;				// length of the part
+				sample_chunk_p owner;			// the chunk that owns the shared data
+			};
 
 			bool registered_;					// whether we have registered ourselves at the server as active (so we need to unregister ourselves at destruction)
 			io_service_p io_;					// shared pointer to IO service; ensures that the IO is still around by the time the serv_ and sock_ need to be destroyed
 			tcp_server_p serv_;					// the server that is associated with this connection
 			tcp_socket_p sock_;					// connection socket
-			work_p work_;						// a RAII class indicating to the owning io_service that there is work to do even if no outstanding handler is present
+			strand_p strand_;					// serializes the handlers of this session (the IO service may be run by several threads)
 
 			// data used by the transfer thread (and some other handlers)
 			lslboost::asio::streambuf feedbuf_;	// this buffer holds the data feed generated by us
@@ -168,15 +201,39 @@ namespace lsl {
 			int use_byte_order_;				// byte order to use (0=portable, 1234=little endian, 4321=big endian, 2134=PDP endian, not supported)
 			int chunk_granularity_;				// our chunk granularity
 			int max_buffered_;					// maximum number of samples buffered
-
-			// data exchanged between the transfer completion handler and the transfer thread
-			bool transfer_completed_;			// whether the current transfer has finished (possibly with an error)
-			error_code transfer_error_;			// the outcome of the last chunk transfer
-			std::size_t transfer_amount_;		// the amount of bytes transferred
-			lslboost::mutex completion_mut_;		// a mutex that protects the completion data
-			lslboost::condition_variable completion_cond_;	// a condition variable that signals completion
+			shm_ring_p shared_ring_;			// the shared-memory ring that the client reads the samples from (if on the same host)
+			lslboost::scoped_ptr<feed_encoder> encoder_;	// the encoder of a compressed feed (if the client asked for one)
+			bool compress_auto_;				// whether the feed is only compressed while the link cannot keep up with it
+			double link_rate_;					// the measured throughput of the link, in bytes per second (0 if not measured yet)
+			double link_measured_;				// the time of the last measurement of the link's throughput
+			double feed_rate_;					// the uncompressed data rate of the feed in the last second, in bytes per second
+			double rate_window_start_;			// the start of the current second of the feed rate measurement
+			std::size_t rate_window_bytes_;		// the uncompressed bytes of the feed in the current second
+			double transfer_started_;			// the time at which the transfer in flight was started
+
+			// data used by the transfer handlers
+			chunk_queue_p queue_;				// the queue of chunks to send (empty once the transfer has ended)
+			sample_chunk_p chunk_;				// the chunk that is being serialized, if any
+			std::size_t chunk_pos_;				// the next sample of chunk_ to serialize
+			bool chunk_shared_;					// whether chunk_ is sent from its shared serialization
+			lslboost::scoped_ptr<sample> temp_;	// a sample to serialize the samples of a chunk with (protocol 1.00 only)
+			uint32_t granularity_;				// the chunk granularity that overrides the pushthrough flags (or 0)
+			uint32_t seqn_;						// the sequence # is merely used to determine chunk boundaries (no need for int64)
+			std::vector<transfer_part> parts_;	// the parts of the next transfers
+			std::size_t feedbuf_queued_;		// the number of bytes of the feed buffer that are in parts_
+			std::size_t pending_bytes_;			// the number of bytes serialized but not yet sent
+			std::size_t flush_parts_;			// the number of parts that are to be sent (i.e., up to the last push-through point)
+			std::size_t flush_feedbuf_;			// the number of bytes of the feed buffer in these parts
+			std::vector<lslboost::asio::const_buffer> outbufs_;	// the buffers of the transfer in flight
 		};
 
+		/// number of channel data bytes of a chunk from which on its serialization is shared between sessions (smaller chunks are serialized into each session's feed buffer)
+		static const std::size_t shared_serialization_bytes = 4096;
+		/// number of serialized bytes that a session gathers at a time (it sends them off even if no push-through point was reached)
+		static const std::size_t max_transfer_bytes = 1 << 20;
+		/// size from which on a transfer can measure the throughput of the link (smaller ones are absorbed by the socket buffer)
+		static const std::size_t link_measurement_bytes = 16384;
+
 		// data used by the transfer threads
 		int chunk_size_;						// the chunk size to use (or 0)
 		bool shutdown_;							// shutdown flag: tells the transfer thread that it should terminate itself asap
@@ -184,14 +241,14 @@ namespace lsl {
 		// data shared with the outlet
 		stream_info_impl_p info_;				// shared stream_info object
 		io_service_p io_;						// shared ptr to IO service; ensures that the IO is still around by the time the acceptor needs to be destroyed
-		sample::factory_p factory_;				// reference to the sample factory (which owns the samples)
 		send_buffer_p send_buffer_;				// the send buffer, shared with other TCP's and the outlet
 
 		// acceptor socket
 		tcp_acceptor_p acceptor_;				// our server socket
+		strand_p accept_strand_;				// serializes the accept handlers and the closing of the acceptor
 
 		// registry of in-flight client sockets (for cancellation)
-		std::set<tcp_socket_p> inflight_;		// registry of currently in-flight sockets
+		std::map<tcp_socket_p,strand_p> inflight_;	// registry of currently in-flight sockets (and the strands of their sessions)
 		lslboost::recursive_mutex inflight_mut_;	// mutex protecting the registry from concurrent access
 
 		// some cached data
@@ -14,9 +14,10 @@ using namespace lslboost::asio;
 /**
 * Construct a new time provider from an inlet connection
 */
-time_receiver::time_receiver(inlet_connection &conn): conn_(conn), was_reset_(false), timeoffset_(std::numeric_limits<double>::max()),
+time_receiver::time_receiver(inlet_connection &conn): conn_(conn), started_(false), was_reset_(false), timeoffset_(std::numeric_limits<double>::max()),
        remote_time_(std::numeric_limits<double>::max()), uncertainty_(std::numeric_limits<double>::max()),
-	   cfg_(api_config::get_instance()), time_sock_(time_io_), next_estimate_(time_io_), aggregate_results_(time_io_), next_packet_(time_io_) {
+	   cfg_(api_config::get_instance()), pooled_(io_pool::inlet_service()), time_io_(pooled_ ? io_pool::inlet_service() : io_service_p(new io_service())), strand_(*time_io_), shutdown_(false),
+	   time_sock_(*time_io_), next_estimate_(*time_io_), aggregate_results_(*time_io_), next_packet_(*time_io_) {
 	conn_.register_onlost(this,&timeoffset_upd_);
 	conn_.register_onrecover(this,lslboost::bind(&time_receiver::reset_timeoffset_on_recovery,this));
 	time_sock_.open(conn_.udp_protocol());
@@ -27,9 +28,19 @@ time_receiver::~time_receiver() {
 	try {
 		conn_.unregister_onrecover(this);
 		conn_.unregister_onlost(this);
-		time_io_.stop();
-		if (time_thread_.joinable())
-			time_thread_.join();
+		if (pooled_) {
+			if (started_) {
+				// cancel our operations on the shared IO service and wait until their handlers have finished
+				pending_.begin();
+				time_io_->post(strand_.wrap(lslboost::bind(&time_receiver::stop_pooled,this)));
+				pending_.wait();
+				conn_.release_watchdog();
+			}
+		} else {
+			time_io_->stop();
+			if (time_thread_.joinable())
+				time_thread_.join();
+		}
 	} 
 	catch(std::exception &e) {
 		std::cerr << "Unexpected error during destruction of a time_receiver: " << e.what() << std::endl;
@@ -62,9 +73,16 @@ double time_receiver::time_correction(double timeout) {
 double time_receiver::time_correction(double *remote_time, double *uncertainty, double timeout ) {
 	lslboost::unique_lock<lslboost::mutex> lock(timeoffset_mut_);
 	if (!timeoffset_available()) {
-		// start thread if not yet running
-		if (!time_thread_.joinable())
-			time_thread_ = lslboost::thread(&time_receiver::time_thread,this);
+		// start thread (or the operations on the shared IO service) if not yet running
+		if (!started_) {
+			started_ = true;
+			if (pooled_) {
+				conn_.acquire_watchdog();
+				pending_.begin();
+				time_io_->post(strand_.wrap(lslboost::bind(&time_receiver::start_pooled,this)));
+			} else
+				time_thread_ = lslboost::thread(&time_receiver::time_thread,this);
+		}
 		// wait until the timeoffset becomes available (or we time out)
 		if (timeout >= FOREVER)
 			timeoffset_upd_.wait(lock, lslboost::bind(&time_receiver::timeoffset_available,this));
@@ -99,7 +117,7 @@ void time_receiver::time_thread() {
 		// start the IO object (will keep running until cancelled)
 		while (true) {
 			try {
-				time_io_.run();
+				time_io_->run();
 				break;
 			} catch(std::exception &e) {
 				std::cerr << "Hiccup during time_thread io_service processing: " << e.what() << std::endl;
@@ -111,6 +129,27 @@ void time_receiver::time_thread() {
 	conn_.release_watchdog();
 }
 
+/// Start the time estimation on the shared I/O pool.
+void time_receiver::start_pooled() {
+	pending_operations::scope done(pending_);
+	try {
+		start_time_estimation();
+	} catch(std::exception &e) {
+		std::cerr << "Time estimation failed to start with message: " << e.what() << std::endl;
+	}
+}
+
+/// Cancel all time operations on the shared I/O pool (their handlers will not issue new ones).
+void time_receiver::stop_pooled() {
+	pending_operations::scope done(pending_);
+	shutdown_ = true;
+	error_code ec;
+	next_estimate_.cancel(ec);
+	aggregate_results_.cancel(ec);
+	next_packet_.cancel(ec);
+	time_sock_.close(ec);
+}
+
 /// Start a new multi-packet exchange for time estimation
 void time_receiver::start_time_estimation() {
 	// clear the estimates buffer
@@ -122,16 +161,19 @@ void time_receiver::start_time_estimation() {
 	send_next_packet(1);
 	receive_next_packet();
 	// schedule the aggregation of results (by the time when all replies should have been received)
+	pending_.begin();
 	aggregate_results_.expires_from_now(timeout_sec(cfg_->time_probe_max_rtt() + cfg_->time_probe_interval()*cfg_->time_probe_count()));
-	aggregate_results_.async_wait(lslboost::bind(&time_receiver::result_aggregation_scheduled,this,placeholders::error));
+	aggregate_results_.async_wait(strand_.wrap(lslboost::bind(&time_receiver::result_aggregation_scheduled,this,placeholders::error)));
 	// schedule the next estimation step
+	pending_.begin();
 	next_estimate_.expires_from_now(timeout_sec(cfg_->time_update_interval()));
-	next_estimate_.async_wait(lslboost::bind(&time_receiver::next_estimate_scheduled,this,placeholders::error));
+	next_estimate_.async_wait(strand_.wrap(lslboost::bind(&time_receiver::next_estimate_scheduled,this,placeholders::error)));
 }
 
 /// Handler that gets called once the next time estimation shall be scheduled
 void time_receiver::next_estimate_scheduled(error_code err) {
-	if (err != error::operation_aborted)
+	pending_operations::scope done(pending_);
+	if (err != error::operation_aborted && !shutdown_)
 		start_time_estimation();
 }
 
@@ -141,35 +183,43 @@ void time_receiver::send_next_packet(int packet_num) {
 		// form the request & send it
 		std::ostringstream request; request.precision(16); request << "LSL:timedata\r\n" << current_wave_id_ << " " << lsl_clock() << "\r\n";
 		string_p msg_buffer(new std::string(request.str()));
-		time_sock_.async_send_to(lslboost::asio::buffer(*msg_buffer), conn_.get_udp_endpoint(),
-			lslboost::bind(&time_receiver::handle_send_outcome,this,msg_buffer,placeholders::error));
+		udp::endpoint endpoint(conn_.get_udp_endpoint());
+		pending_.begin();
+		time_sock_.async_send_to(lslboost::asio::buffer(*msg_buffer), endpoint,
+			strand_.wrap(lslboost::bind(&time_receiver::handle_send_outcome,this,msg_buffer,placeholders::error)));
 	} catch(std::exception &e) {
 		std::cerr << "Error trying to send a time packet: " << e.what() << std::endl;
 	}
 	// schedule next packet
 	if (packet_num < cfg_->time_probe_count()) {
+		pending_.begin();
 		next_packet_.expires_from_now(timeout_sec(cfg_->time_probe_interval()));
-		next_packet_.async_wait(lslboost::bind(&time_receiver::next_packet_scheduled,this,++packet_num,placeholders::error));
+		next_packet_.async_wait(strand_.wrap(lslboost::bind(&time_receiver::next_packet_scheduled,this,++packet_num,placeholders::error)));
 	}
 }
 
 /// Handler that gets called once the sending of a packet has completed
-void time_receiver::handle_send_outcome(string_p, error_code) { }
+void time_receiver::handle_send_outcome(string_p, error_code) {
+	pending_operations::scope done(pending_);
+}
 
 /// Handler that gets called when the next packet shall be scheduled
 void time_receiver::next_packet_scheduled(int packet_num, error_code err) {
-	if (!err)
+	pending_operations::scope done(pending_);
+	if (!err && !shutdown_)
 		send_next_packet(packet_num);
 }
 
 /// Request reception of the next time packet
 void time_receiver::receive_next_packet() {
+	pending_.begin();
 	time_sock_.async_receive_from(lslboost::asio::buffer(recv_buffer_), remote_endpoint_,
-		lslboost::bind(&time_receiver::handle_receive_outcome, this, placeholders::error, placeholders::bytes_transferred));
+		strand_.wrap(lslboost::bind(&time_receiver::handle_receive_outcome, this, placeholders::error, placeholders::bytes_transferred)));
 }
 
 /// Handler that gets called once reception of a time packet has completed
 void time_receiver::handle_receive_outcome(error_code err, std::size_t len) {
+	pending_operations::scope done(pending_);
 	try {
 		if (!err) {
 			// parse the buffer contents
@@ -189,12 +239,13 @@ void time_receiver::handle_receive_outcome(error_code err, std::size_t len) {
 	} catch(std::exception &e) {
 		std::cerr << "Error while processing a time estimation return packet: " << e.what() << std::endl;
 	}
-	if (err != error::operation_aborted)
+	if (err != error::operation_aborted && !shutdown_)
 		receive_next_packet();
 }
 
 /// Handlers that gets called once the time estimation results shall be aggregated.
 void time_receiver::result_aggregation_scheduled(error_code err) {
+	pending_operations::scope done(pending_);
 	if (!err) {
 		if ((int)estimates_.size() >= cfg_->time_update_minprobes()) {
 			// take the estimate with the lowest error bound (=rtt), as in NTP
@@ -5,6 +5,7 @@
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/random.hpp>
 #include "inlet_connection.h"
@@ -27,6 +28,7 @@ namespace lsl {
 	/// The public function has an optional timeout after which it gives up, while the background thread 
 	/// continues to do its job (so the next public-function call may succeed within the timeout).
 	/// The background thread terminates only if the time_receiver is destroyed or the underlying connection is lost or shut down.
+	/// If the inlets share an I/O pool (tuning.InletIOThreads), the time probes run on that pool instead of a thread of their own.
 	class time_receiver {
 	public:
 		/// Construct a new time receiver for a given connection.
@@ -57,6 +59,12 @@ namespace lsl {
 		/// The time reader / updater thread.
 		void time_thread();
 
+		/// Start the time estimation on the shared I/O pool.
+		void start_pooled();
+
+		/// Cancel all time operations on the shared I/O pool.
+		void stop_pooled();
+
 		/// Start a new multi-packet exchange for time estimation
 		void start_time_estimation();
 
@@ -92,6 +100,7 @@ namespace lsl {
 		
 		// background reader thread and the data generated by it
 		lslboost::thread time_thread_;					// updates time offset
+		bool started_;								// whether the time estimation has been started
 		bool was_reset_;							// whether the clock was reset
 		double timeoffset_;							// the current time offset (or NOT_ASSIGNED if not yet assigned)
 		double remote_time_;                        // remote computer time at the specified timeoffset_
@@ -101,7 +110,11 @@ namespace lsl {
 
 		// data used internally by the background thread
 		const api_config *cfg_;						// the configuration object
-		lslboost::asio::io_service time_io_;			// an IO service for async time operations
+		bool pooled_;								// whether the time operations run on the shared I/O pool of the inlets
+		io_service_p time_io_;						// an IO service for async time operations (our own or the shared one)
+		lslboost::asio::io_service::strand strand_;	// serializes the handlers (in case the IO service is run by multiple threads)
+		pending_operations pending_;				// the pending handlers (waited for at destruction if pooled)
+		bool shutdown_;								// whether the time operations have been cancelled (if pooled)
 		char recv_buffer_[16384];					// a buffer to hold inbound packet contents
 		lslboost::random::mt19937 rng_;				// a random number generator
 		udp::socket time_sock_;						// the socket through which the time thread communicates
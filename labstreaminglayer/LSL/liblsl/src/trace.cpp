@@ -0,0 +1,111 @@
+#ifdef LSL_TRACING
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/tss.hpp>
+#include "api_config.h"
+#include "trace.h"
+
+
+// === implementation of the span tracing ===
+
+using namespace lsl;
+
+namespace {
+
+	// number of spans kept per thread (the oldest spans are overwritten)
+	const std::size_t trace_buffer_capacity = 1 << 16;
+
+	/// A completed span.
+	struct trace_event {
+		const char *name;	// the span name
+		double start;		// start time of the span (lsl_clock)
+		double duration;	// duration of the span, in seconds
+	};
+
+	/// The spans of a single thread (only written by that thread).
+	struct trace_buffer {
+		trace_buffer(int tid): tid(tid), written(0), events(trace_buffer_capacity) {}
+		int tid;							// sequential thread number
+		lslboost::atomic<uint64_t> written;	// number of spans written so far
+		std::vector<trace_event> events;	// the ring buffer
+	};
+	typedef lslboost::shared_ptr<trace_buffer> trace_buffer_p;
+
+	/// Buffers are owned by the registry, so that they outlive their threads.
+	void no_cleanup(trace_buffer *) {}
+
+	/// The registry of all trace buffers; writes them out when the library is unloaded.
+	class trace_registry {
+	public:
+		trace_registry(): filename_(api_config::get_instance()->trace_file()), current_(&no_cleanup) {}
+
+		~trace_registry() {
+			if (!filename_.empty() && !dump(filename_))
+				std::cerr << "Could not write the trace file " << filename_ << std::endl;
+		}
+
+		/// Get the calling thread's buffer (registering it on first use).
+		trace_buffer &thread_buffer() {
+			if (!current_.get()) {
+				lslboost::lock_guard<lslboost::mutex> lock(mut_);
+				buffers_.push_back(trace_buffer_p(new trace_buffer((int)buffers_.size()+1)));
+				current_.reset(buffers_.back().get());
+			}
+			return *current_;
+		}
+
+		/// Write all spans as Chrome trace JSON (spans overwritten during the dump may come out garbled).
+		bool dump(const std::string &filename) {
+			std::ofstream out(filename.c_str(), std::ios::trunc);
+			if (!out)
+				return false;
+			out.precision(3);
+			out << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			bool first = true;
+			lslboost::lock_guard<lslboost::mutex> lock(mut_);
+			for (std::size_t b=0; b<buffers_.size(); b++) {
+				const trace_buffer &buf = *buffers_[b];
+				uint64_t written = buf.written.load(lslboost::memory_order_acquire);
+				for (uint64_t k = written>trace_buffer_capacity ? written-trace_buffer_capacity : 0; k<written; k++) {
+					const trace_event &e = buf.events[k % trace_buffer_capacity];
+					out << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name << "\",\"cat\":\"liblsl\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buf.tid 
+						<< ",\"ts\":" << e.start*1e6 << ",\"dur\":" << e.duration*1e6 << '}';
+					first = false;
+				}
+			}
+			out << "\n]}\n";
+			return !out.fail();
+		}
+
+	private:
+		std::string filename_;								// the file to write at exit
+		lslboost::mutex mut_;								// protects buffers_ (not the buffers themselves)
+		std::vector<trace_buffer_p> buffers_;				// the buffers of all threads that recorded spans
+		lslboost::thread_specific_ptr<trace_buffer> current_;	// the calling thread's buffer
+	};
+
+	trace_registry &get_registry() {
+		static trace_registry registry;
+		return registry;
+	}
+}
+
+void lsl::record_trace_event(const char *name, double start, double duration) {
+	trace_buffer &buf = get_registry().thread_buffer();
+	uint64_t k = buf.written.load(lslboost::memory_order_relaxed);
+	trace_event &e = buf.events[k % trace_buffer_capacity];
+	e.name = name;
+	e.start = start;
+	e.duration = duration;
+	buf.written.store(k+1, lslboost::memory_order_release);
+}
+
+bool lsl::dump_trace(const std::string &filename) { return get_registry().dump(filename); }
+
+#endif
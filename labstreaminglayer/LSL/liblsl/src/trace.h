@@ -0,0 +1,49 @@
+#ifndef LSL_TRACE_H
+#define LSL_TRACE_H
+
+#include "common.h"
+
+/**
+* Optional tracing of hot-path spans (e.g., sample transfers), for profiling with chrome://tracing or Perfetto.
+* Only compiled in when building with LSL_TRACING; otherwise LSL_TRACE_SCOPE expands to nothing.
+* Spans go into per-thread ring buffers and are written as Chrome trace JSON to the file given by 
+* the TraceFile setting ([tuning] section of lsl_api.cfg) when the library is unloaded, or on demand with lsl_dump_trace().
+*/
+
+#ifdef LSL_TRACING
+
+#define LSL_TRACE_CONCAT_(a,b) a##b
+#define LSL_TRACE_CONCAT(a,b) LSL_TRACE_CONCAT_(a,b)
+/// Trace the enclosing scope under the given name (must be a string literal).
+#define LSL_TRACE_SCOPE(name) lsl::trace_scope LSL_TRACE_CONCAT(trace_scope_,__LINE__)(name)
+
+namespace lsl {
+
+	/// Record a completed span into the calling thread's trace buffer.
+	void record_trace_event(const char *name, double start, double duration);
+
+	/** 
+	* Write all recorded spans as Chrome trace JSON.
+	* @return Whether the file could be written.
+	*/
+	bool dump_trace(const std::string &filename);
+
+	/// Records a span from its construction to its destruction.
+	class trace_scope {
+	public:
+		explicit trace_scope(const char *name): name_(name), start_(lsl_clock()) {}
+		~trace_scope() { record_trace_event(name_,start_,lsl_clock()-start_); }
+	private:
+		const char *name_;	// the span name
+		double start_;		// start time of the span
+	};
+}
+
+#else
+
+#define LSL_TRACE_SCOPE(name)
+
+#endif
+
+#endif
+
@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include "../../include/lsl_cpp.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+using namespace std;
+
+/* Measure the bytes on the wire and the CPU time of a compressed data feed against an uncompressed one.
+   Run the sender and the receiver as two processes on the same host; the compression is asked for by the receiver,
+   so select it with an lsl_api.cfg for the receiving process (pointed to by LSLAPICFG), e.g.:
+     [tuning]
+     SharedMemoryTransport = 0
+     FeedCompression = always      (or off / auto)
+     CompressionBench send [int16|float32] [srate] [numchans] [seconds]
+     CompressionBench receive [seconds]
+   The bytes on the wire are taken from the counters of the loopback interface (Linux only), so other traffic on it skews them.
+   std::clock() measures the process CPU time on POSIX systems (wall time on Windows). */
+
+// the bytes received on the loopback interface so far (0 if unknown)
+double loopback_bytes() {
+	ifstream dev("/proc/net/dev");
+	string line;
+	while (getline(dev,line)) {
+		size_t colon = line.find(':');
+		string name;
+		if (colon == string::npos || !(istringstream(line.substr(0,colon)) >> name) || name != "lo")
+			continue;
+		double bytes = 0;
+		istringstream(line.substr(colon+1)) >> bytes;
+		return bytes;
+	}
+	return 0;
+}
+
+// EEG-like test signal: a few slow oscillations per channel plus some noise
+template<class T> void fill_chunk(vector<T> &chunk, int numchans, double srate, long first_sample, double scale) {
+	for (size_t k=0;k<chunk.size();k++) {
+		double t = (first_sample + (long)(k/numchans))/srate;
+		int chan = (int)(k % numchans);
+		chunk[k] = (T)(scale*(sin(2*3.14159*(10+chan%7)*t) + 0.3*sin(2*3.14159*(1+chan%3)*t) + 0.01*(rand()%100)));
+	}
+}
+
+// send samples at the given rate, in 10 ms chunks
+template<class T> void send(lsl::channel_format_t fmt, double scale, double srate, int numchans, double seconds) {
+	lsl::stream_info info("CompressionBench","Bench",numchans,srate,fmt,"CompressionBench");
+	lsl::stream_outlet outlet(info);
+	cout << "waiting for the receiver..." << endl;
+	while (!outlet.wait_for_consumers(1.0));
+	vector<T> chunk;
+	std::clock_t start_cpu = std::clock();
+	double start_time = lsl::local_clock();
+	for (long written=0;lsl::local_clock()-start_time < seconds;) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		long target = (long)floor((lsl::local_clock()-start_time)*srate);
+		chunk.resize((size_t)(std::min(target-written,(long)(srate/10))*numchans));
+		fill_chunk(chunk,numchans,srate,written,scale);
+		if (!chunk.empty())
+			outlet.push_chunk_multiplexed(&chunk[0],chunk.size());
+		written += (long)(chunk.size()/numchans);
+	}
+	double cpu = (double)(std::clock()-start_cpu)/CLOCKS_PER_SEC, wall = lsl::local_clock()-start_time;
+	cout << "sender finished (" << 100*cpu/wall << " % CPU, including the generation of the signal)." << endl;
+}
+
+// receive for the given time and report the throughput, the bytes on the wire and the CPU time
+void receive(double seconds) {
+	vector<lsl::stream_info> results = lsl::resolve_stream("name","CompressionBench");
+	lsl::stream_inlet inlet(results[0],10);
+	inlet.open_stream();
+	const int numchans = inlet.info().channel_count();
+	const double value_bytes = inlet.info().channel_bytes();
+	vector<double> buffer(numchans*10000);
+	vector<double> timestamps(10000);
+	// skip the first second (connection setup, page faults of the buffers)
+	for (double t=lsl::local_clock()+1;lsl::local_clock()<t;)
+		inlet.pull_chunk_multiplexed(&buffer[0],&timestamps[0],buffer.size(),timestamps.size(),0.1);
+	double bytes = 0, start_time = lsl::local_clock(), start_wire = loopback_bytes();
+	std::clock_t start_cpu = std::clock();
+	while (lsl::local_clock()-start_time < seconds)
+		bytes += inlet.pull_chunk_multiplexed(&buffer[0],&timestamps[0],buffer.size(),timestamps.size(),0.1) * value_bytes;
+	double cpu = (double)(std::clock()-start_cpu)/CLOCKS_PER_SEC, wall = lsl::local_clock()-start_time, wire = loopback_bytes()-start_wire;
+	cout << bytes/wall/1e6 << " MB/s of channel data, " << wire/wall/1e6 << " MB/s on the wire (" << (wire ? bytes/wire : 0)
+		<< " bytes of channel data per byte), " << 100*cpu/wall << " % CPU" << endl;
+}
+
+int main(int argc, char* argv[]) {
+	string role = argc > 1 ? argv[1] : "";
+	try {
+		if (role == "send") {
+			string format = argc > 2 ? argv[2] : "int16";
+			double srate = argc > 3 ? atof(argv[3]) : 10000;
+			int numchans = argc > 4 ? atoi(argv[4]) : 64;
+			double seconds = argc > 5 ? atof(argv[5]) : 20;
+			if (format == "float32")
+				send<float>(lsl::cf_float32,50.0,srate,numchans,seconds);
+			else
+				send<int16_t>(lsl::cf_int16,1000.0,srate,numchans,seconds);
+		}
+		else if (role == "receive")
+			receive(argc > 2 ? atof(argv[2]) : 10);
+		else {
+			cout << "Usage: CompressionBench send [int16|float32] [srate] [numchans] [seconds] | CompressionBench receive [seconds]" << endl;
+			return 1;
+		}
+	}
+	catch(std::exception &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
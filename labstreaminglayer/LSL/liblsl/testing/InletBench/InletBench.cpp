@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include "../../include/lsl_cpp.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+using namespace std;
+
+/* Measure the CPU time that an inlet spends per MB/s of received data.
+   Run the sender and the receiver as two processes, so that the CPU time of the
+   receiving process is that of the inlet (and of pull_chunk) alone:
+     InletBench send [srate] [numchans] [seconds]
+     InletBench receive [seconds]
+   std::clock() measures the process CPU time on POSIX systems (wall time on Windows). */
+
+// send float samples at the given rate, in 10 ms chunks
+void send(double srate, int numchans, double seconds) {
+	lsl::stream_info info("InletBench","Bench",numchans,srate,lsl::cf_float32,"InletBench");
+	lsl::stream_outlet outlet(info);
+	cout << "waiting for the receiver..." << endl;
+	while (!outlet.wait_for_consumers(1.0));
+	vector<float> chunk((std::size_t)(numchans*srate/100*5));
+	for (std::size_t k=0;k<chunk.size();k++)
+		chunk[k] = (float)(k % 1000);
+	double start_time = lsl::local_clock();
+	for (long written=0;lsl::local_clock()-start_time < seconds;) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		long target = (long)floor((lsl::local_clock()-start_time)*srate);
+		std::size_t num_elements = std::min((std::size_t)((target-written)*numchans),chunk.size());
+		outlet.push_chunk_multiplexed(&chunk[0],num_elements);
+		written += (long)(num_elements/numchans);
+	}
+	cout << "sender finished." << endl;
+}
+
+// receive for the given time and report the throughput and the CPU time
+void receive(double seconds) {
+	vector<lsl::stream_info> results = lsl::resolve_stream("name","InletBench");
+	lsl::stream_inlet inlet(results[0],10);
+	inlet.open_stream();
+	const int numchans = inlet.info().channel_count();
+	vector<float> buffer(numchans*10000);
+	vector<double> timestamps(10000);
+	// skip the first second (connection setup, page faults of the buffers)
+	for (double t=lsl::local_clock()+1;lsl::local_clock()<t;)
+		inlet.pull_chunk_multiplexed(&buffer[0],&timestamps[0],buffer.size(),timestamps.size(),0.1);
+	double bytes = 0, start_time = lsl::local_clock();
+	std::clock_t start_cpu = std::clock();
+	while (lsl::local_clock()-start_time < seconds)
+		bytes += inlet.pull_chunk_multiplexed(&buffer[0],&timestamps[0],buffer.size(),timestamps.size(),0.1) * sizeof(float);
+	double cpu = (double)(std::clock()-start_cpu)/CLOCKS_PER_SEC, wall = lsl::local_clock()-start_time;
+	double mbps = bytes/wall/1e6, cpu_percent = 100*cpu/wall;
+	cout << mbps << " MB/s of channel data, " << cpu_percent << " % CPU, " << cpu_percent/mbps << " % CPU per MB/s" << endl;
+}
+
+int main(int argc, char* argv[]) {
+	string role = argc > 1 ? argv[1] : "";
+	try {
+		if (role == "send")
+			send(argc > 2 ? atof(argv[2]) : 100000, argc > 3 ? atoi(argv[3]) : 64, argc > 4 ? atof(argv[4]) : 20);
+		else if (role == "receive")
+			receive(argc > 2 ? atof(argv[2]) : 10);
+		else {
+			cout << "Usage: InletBench send [srate] [numchans] [seconds] | InletBench receive [seconds]" << endl;
+			return 1;
+		}
+	}
+	catch(std::exception &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
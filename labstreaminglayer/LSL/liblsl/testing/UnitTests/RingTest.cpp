@@ -0,0 +1,75 @@
+#include "sample_ring.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Regression test: samples in a non-native byte order must be converted exactly once, also if the ring
+// wraps around onto the samples of the same buffer (i.e., if the ring holds fewer samples than one read).
+
+using namespace lsl;
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what) {
+	if (!ok) {
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+}
+
+/// Append the bytes of a value in reversed byte order.
+template<class T> static void put_reversed(std::string &buffer, T value) {
+	char bytes[sizeof(T)];
+	memcpy(bytes,&value,sizeof(T));
+	for (std::size_t k=sizeof(T); k>0; k--)
+		buffer.push_back(bytes[k-1]);
+}
+
+/// Parse num_samples samples (2 channels, every third with a deduced time stamp) into a ring of the given capacity and check what it holds.
+static void check_ring(std::size_t capacity, int num_samples) {
+	const int num_channels = 2;
+	const int foreign_order = BOOST_BYTE_ORDER == 1234 ? 4321 : 1234;
+	std::string buffer;
+	for (int s=0; s<num_samples; s++) {
+		if (s % 3) {
+			buffer.push_back((char)TAG_DEDUCED_TIMESTAMP);
+		} else {
+			buffer.push_back((char)TAG_TRANSMITTED_TIMESTAMP);
+			put_reversed(buffer,(double)s);
+		}
+		for (int c=0; c<num_channels; c++)
+			put_reversed(buffer,(float)(s*10+c));
+	}
+
+	sample_ring ring(cf_float32,num_channels,capacity);
+	double last_timestamp = 0.0;
+	const std::string name = "capacity " + lslboost::lexical_cast<std::string>(capacity);
+	check(ring.load_samples(buffer.data(),buffer.size(),foreign_order,false,1.0,last_timestamp) == buffer.size(), name + ": all bytes parsed");
+
+	std::vector<float> values(num_samples*num_channels);
+	std::vector<double> timestamps(num_samples);
+	const std::size_t expected = std::min<std::size_t>(capacity,num_samples);
+	const std::size_t popped = ring.pop_samples(&values[0],&timestamps[0],num_samples);
+	check(popped == expected, name + ": number of samples held");
+	for (std::size_t k=0; k<popped; k++) {
+		const int s = (int)(num_samples-expected+k);
+		check(timestamps[k] == (double)s, name + ": time stamp of sample " + lslboost::lexical_cast<std::string>(s));
+		for (int c=0; c<num_channels; c++)
+			check(values[k*num_channels+c] == (float)(s*10+c), name + ": value of sample " + lslboost::lexical_cast<std::string>(s));
+	}
+}
+
+int main() {
+	check_ring(100,10);		// no wrap-around
+	check_ring(4,10);		// wraps around twice within one buffer
+	check_ring(3,10);
+	check_ring(1,10);
+	check_ring(150000,200000);	// spans several blocks of slots
+	if (failures) {
+		std::cerr << failures << " check(s) failed." << std::endl;
+		return 1;
+	}
+	std::cout << "All checks passed." << std::endl;
+	return 0;
+}
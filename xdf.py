@@ -12,6 +12,12 @@ from collections import OrderedDict, defaultdict
 
 import numpy as np
 
+try:
+    # native reader (labstreaminglayer/Apps/CuriaRecorder/xdf_python.cpp)
+    import _xdf
+except ImportError:
+    _xdf = None
+
 __all__ = ['load_xdf']
 __version__ = '1.14.0'
 
@@ -172,6 +178,9 @@ def load_xdf(filename,
                         'float32': 'f', 'double64': 'd'}
             fmt2nbytes = {'int8': 1, 'int16': 2, 'int32': 4, 'int64': 8,
                           'float32': 4, 'double64': 8}
+            fmt2dtype = {'int8': np.int8, 'int16': np.int16,
+                         'int32': np.int32, 'int64': np.int64,
+                         'float32': np.float32, 'double64': np.float64}
             # number of channels
             self.nchns = int(xml['info']['channel_count'][0])
             # nominal sampling rate in Hz
@@ -196,6 +205,8 @@ def load_xdf(filename,
                 self.samplebytes = self.nchns * fmt2nbytes[self.fmt]
                 # format string to pass to struct.unpack() to handle one sample
                 self.structfmt = '<%s%s' % (self.nchns, fmt2char[self.fmt])
+                # dtype of the time series (as returned by the native reader)
+                self.dtype = fmt2dtype[self.fmt]
 
     if verbose:
         print('Importing XDF file %s...' % filename)
@@ -211,13 +222,111 @@ def load_xdf(filename,
     # number of bytes in the file for fault tolerance
     filesize = os.path.getsize(filename)
 
+    # the native reader also synchronizes and dejitters the time stamps,
+    # unless on_chunk gets to modify them first
+    native_sync = (_xdf is not None and on_chunk is None and
+                   (synchronize_clocks or dejitter_timestamps))
+    if _xdf is not None:
+        # decode with the native reader (much faster on large files)
+        sync = {}
+        if native_sync:
+            sync = dict(
+                synchronize_clocks=synchronize_clocks,
+                dejitter_timestamps=dejitter_timestamps,
+                handle_clock_resets=handle_clock_resets,
+                clock_reset_threshold_stds=clock_reset_threshold_stds,
+                clock_reset_threshold_seconds=clock_reset_threshold_seconds,
+                clock_reset_threshold_offset_stds=(
+                    clock_reset_threshold_offset_stds),
+                clock_reset_threshold_offset_seconds=(
+                    clock_reset_threshold_offset_seconds),
+                winsor_threshold=winsor_threshold,
+                jitter_break_threshold_seconds=jitter_break_threshold_seconds,
+                jitter_break_threshold_samples=jitter_break_threshold_samples)
+        fileheader = _read_native(filename, on_chunk, verbose, streams, temp,
+                                  StreamData, sync)
+    else:
+        fileheader = _read_python(filename, filesize, on_chunk, verbose,
+                                  streams, temp, StreamData)
+    
+    # Concatenate the signal across chunks
+    for stream in temp.values():
+        if stream.time_stamps:
+            # stream with non-empty list of chunks
+            if len(stream.time_stamps) == 1:
+                # a single chunk (or a natively decoded stream): no copy needed
+                stream.time_stamps = stream.time_stamps[0]
+                stream.time_series = stream.time_series[0]
+            elif stream.fmt == 'string':
+                stream.time_stamps = np.concatenate(stream.time_stamps)
+                stream.time_series = list(itertools.chain(*stream.time_series))
+            else:
+                stream.time_stamps = np.concatenate(stream.time_stamps)
+                stream.time_series = np.concatenate(stream.time_series)
+        else:
+            # stream without any chunks
+            stream.time_stamps = np.zeros((0,))
+            if stream.fmt == 'string':
+                stream.time_series = []
+            else:
+                stream.time_series = np.zeros((stream.nchns, 0),
+                                              dtype=stream.dtype)
+
+    # perform (fault-tolerant) clock synchronization if requested
+    if synchronize_clocks and not native_sync:
+        if verbose:
+            print('  performing clock synchronization...')
+        temp = _clock_sync(temp, handle_clock_resets,
+                           clock_reset_threshold_stds,
+                           clock_reset_threshold_seconds,
+                           clock_reset_threshold_offset_stds,
+                           clock_reset_threshold_offset_seconds,
+                           winsor_threshold)
+    
+    # perform jitter removal if requested
+    if native_sync:
+        pass  # done by the native reader
+    elif dejitter_timestamps:
+        if verbose:
+            print('  performing jitter removal...')
+        temp = _jitter_removal(temp, jitter_break_threshold_seconds,
+                               jitter_break_threshold_samples,)
+    else:
+        for stream in temp.values():
+            if len(stream.time_stamps) > 0:
+                duration = stream.time_stamps[-1] - stream.time_stamps[0]
+                stream.effective_srate = len(stream.time_stamps)/duration
+            else:
+                stream.effective_srate = 0
+
+    for k in streams.keys():
+        stream = streams[k]
+        tmp = temp[k]
+        stream['info']['effective_srate'] = tmp.effective_srate
+        stream['time_series'] = tmp.time_series
+        stream['time_stamps'] = tmp.time_stamps
+
+    streams = [s for s in streams.values()]
+    return streams, fileheader
+
+
+def _read_python(filename, filesize, on_chunk, verbose, streams, temp,
+                 StreamData):
+    """Read all chunks with the Python chunk loop.
+
+    Used when the native reader is not available; fills streams and temp
+    like _read_native (numeric samples with the stream's own dtype) and
+    returns the file header.
+
+    """
+    fileheader = None
     # read file contents ([SomeText] below refers to items in the XDF Spec)
     with open(filename, 'rb') as f:
 
         # read [MagicCode]
         if f.read(4) != b'XDF:':
             raise Exception('not a valid XDF file: %s' % filename)
-        
+    
         # for each chunk...
         while True:
 
@@ -286,7 +395,8 @@ def load_xdf(filename,
                                 values[k][ch] = raw.decode(errors='replace')
                     else:
                         # read a sample comprised of numeric values
-                        values = np.zeros((nsamples, temp[s].nchns))
+                        values = np.zeros((nsamples, temp[s].nchns),
+                                      dtype=temp[s].dtype)
                         # for each sample...
                         for k in range(nsamples):
                             # read or deduce time stamp
@@ -327,55 +437,62 @@ def load_xdf(filename,
             else:
                 # skip other chunk types (Boundary, ...)
                 f.read(chunklen-2)
-    
-    # Concatenate the signal across chunks
-    for stream in temp.values():
-        if stream.time_stamps:
-            # stream with non-empty list of chunks
-            stream.time_stamps = np.concatenate(stream.time_stamps)
-            if stream.fmt == 'string':
-                stream.time_series = list(itertools.chain(*stream.time_series))
-            else:
-                stream.time_series = np.concatenate(stream.time_series)
-        else:
-            # stream without any chunks
-            stream.time_stamps = np.zeros((0,))
-            if stream.fmt == 'string':
-                stream.time_series = []
-            else:
-                stream.time_series = np.zeros((stream.nchns, 0))
+    return fileheader
 
-    # perform (fault-tolerant) clock synchronization if requested
-    if synchronize_clocks:
-        if verbose:
-            print('  performing clock synchronization...')
-        temp = _clock_sync(temp, handle_clock_resets,
-                           clock_reset_threshold_stds,
-                           clock_reset_threshold_seconds,
-                           clock_reset_threshold_offset_stds,
-                           clock_reset_threshold_offset_seconds,
-                           winsor_threshold)
-    
-    # perform jitter removal if requested
-    if dejitter_timestamps:
-        if verbose:
-            print('  performing jitter removal...')
-        temp = _jitter_removal(temp, jitter_break_threshold_seconds,
-                               jitter_break_threshold_samples,)
-    else:
-        for stream in temp.values():
-            duration = stream.time_stamps[-1] - stream.time_stamps[0]
-            stream.effective_srate = len(stream.time_stamps)/duration
 
-    for k in streams.keys():
-        stream = streams[k]
-        tmp = temp[k]
-        stream['info']['effective_srate'] = tmp.effective_srate
-        stream['time_series'] = tmp.time_series
-        stream['time_stamps'] = tmp.time_stamps
+def _read_native(filename, on_chunk, verbose, streams, temp, StreamData,
+                 sync):
+    """Read all chunks with the native reader.
 
-    streams = [s for s in streams.values()]
-    return streams, fileheader
+    Fills streams and temp like the Python chunk loop (numeric samples
+    are zero-copy views of the decoded data, with the stream's own
+    dtype) and returns the file header. If sync is not empty, it holds
+    the clock synchronization and jitter removal arguments of
+    _xdf.read_xdf and the time stamps and effective sampling rates are
+    final.
+
+    """
+    result = _xdf.read_xdf(filename, **sync)
+    for warning in result['warnings']:
+        print('  ' + warning)
+    fileheader = None
+    if result['fileheader']:
+        fileheader = _xml2dict(ET.fromstring(result['fileheader']))
+    decoded = {}
+    for stream in result['streams']:
+        s = stream['stream_id']
+        hdr = _xml2dict(ET.fromstring(stream['header']))
+        streams[s] = hdr
+        if verbose:
+            print('  found stream ' + hdr['info']['name'][0])
+        temp[s] = StreamData(hdr)
+        if stream['footer'] is not None:
+            hdr['footer'] = _xml2dict(ET.fromstring(stream['footer']))
+        temp[s].clock_times = np.asarray(stream['clock_times'])
+        temp[s].clock_values = np.asarray(stream['clock_values'])
+        if 'effective_srate' in stream:
+            temp[s].effective_srate = stream['effective_srate']
+        values = stream['time_series']
+        if temp[s].fmt != 'string':
+            values = np.asarray(values)
+        decoded[s] = (values, np.asarray(stream['time_stamps']))
+    if on_chunk is None:
+        for s, (values, stamps) in decoded.items():
+            if len(stamps):
+                temp[s].time_series.append(values)
+                temp[s].time_stamps.append(stamps)
+    else:
+        # hand each chunk to on_chunk, in file order
+        for s, first, n in result['chunks']:
+            values, stamps = decoded[s]
+            values = values[first:first + n]
+            if temp[s].fmt != 'string':
+                values = values.copy()
+            values, stamps, streams[s] = on_chunk(
+                values, stamps[first:first + n].copy(), streams[s], s)
+            temp[s].time_series.append(values)
+            temp[s].time_stamps.append(stamps)
+    return fileheader
 
 
 def _read_varlen_int(f):
@@ -427,7 +544,7 @@ def _clock_sync(streams,
                 reset_threshold_offset_seconds=1,
                 winsor_threshold=0.0001):
     for stream in streams.values():
-        if len(stream.time_stamps) > 0:
+        if len(stream.time_stamps) > 0 and len(stream.clock_times) > 0:
             clock_times = stream.clock_times
             clock_values = stream.clock_values
 
@@ -473,9 +590,9 @@ def _clock_sync(streams,
                     ranges = [(0, len(clock_times)-1)]
                 else:
                     indices = np.where(resets_at)[0]
-                    indices = np.hstack((0, indices, indices+1,
-                                         len(resets_at)-1))
-                    ranges = np.reshape(indices, (2, -1)).T
+                    ranges = list(zip(
+                        np.hstack((0, indices+1)),
+                        np.hstack((indices, len(clock_times)-1))))
 
             # Otherwise we just assume that there are no clock resets
             else:
@@ -499,8 +616,13 @@ def _clock_sync(streams,
             if len(ranges) == 1:
                 stream.time_stamps += coef[0][0] + coef[0][1]*stream.time_stamps
             else:
-                for coef_i, range_i in zip(coef, ranges):
-                    r = slice(range_i[0], range_i[1])
+                # time stamps from the first measurement of a range on
+                # belong to that range
+                edges = [clock_times[range_i[0]] for range_i in ranges[1:]]
+                segment = np.searchsorted(edges, stream.time_stamps,
+                                          side='right')
+                for k, coef_i in enumerate(coef):
+                    r = segment == k
                     stream.time_stamps[r] += (coef_i[0] +
                                               coef_i[1]*stream.time_stamps[r])
     return streams
@@ -518,8 +640,8 @@ def _jitter_removal(streams,
                                         break_threshold_samples*stream.tdiff))
             if np.any(breaks_at):
                 indices = np.where(breaks_at)[0]
-                indices = np.hstack((0, indices, indices+1, nsamples-1))
-                ranges = np.reshape(indices, (2, -1)).T
+                ranges = list(zip(np.hstack((0, indices+1)),
+                                  np.hstack((indices, nsamples-1))))
             else:
                 ranges = [(0, nsamples-1)]
 
@@ -537,12 +659,17 @@ def _jitter_removal(streams,
                     e = np.ones((len(indices),))
                     X = np.reshape(np.hstack((e, indices)), (2, -1)).T
                     y = stream.time_stamps[indices]
-                    mapping = np.linalg.lstsq(X, y)[0]
-                    stream.time_stamps = mapping[0] + mapping[1]*indices
-                    effective_srate = np.array(effective_srate)
-                    num_samples = np.array(num_samples)
-                    x = np.sum(effective_srate/num_samples/np.sum(num_samples))
-                    stream.effective_srate = x
+                    mapping = np.linalg.lstsq(X, y, rcond=None)[0]
+                    stream.time_stamps[indices] = (mapping[0] +
+                                                   mapping[1]*indices)
+            # sample-weighted mean over the segments
+            if num_samples:
+                num_samples = np.array(num_samples)
+                stream.effective_srate = (
+                    np.sum(np.array(effective_srate)*num_samples) /
+                    np.sum(num_samples))
+            else:
+                stream.effective_srate = 0
         else:
             stream.effective_srate = 0
     return streams